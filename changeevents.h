@@ -0,0 +1,364 @@
+#ifndef CHANGE_EVENTS_H
+#define CHANGE_EVENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "filterchain.h"
+
+/**
+ * A filtered value that differs from the one before it. The filtered signal holds value from index on,
+ * until the next event, so a stream of change events reconstructs the filtered signal exactly.
+ */
+template<class T>
+struct ChangeEvent
+{
+    uint64_t index;     // the sample number, or the timestamp of the sample when update() was given timestamps
+    T value;
+};
+
+/**
+ * Runs a filter over blocks of raw values and emits only the change events of its output,
+ * so that a consumer that only cares about hasChanged() doesn't have to go through every filtered value.
+ *
+ * The block goes through the FilterChainStage kernel of the filter, like the block update() of a FilterChain,
+ * so Filter can be any filter or FilterChain. The loop writes every value into the next event slot
+ * and only moves on to the next slot when the value changed, so there is no branch on the change.
+ * The first value the ChangeEventFilter sees is always an event, so that the stream starts with a known value.
+ */
+template<class Filter>
+class ChangeEventFilter
+{
+  public:
+    typedef decltype(std::declval<const Filter &>().value()) ValueType;
+
+    explicit ChangeEventFilter(const Filter &filter):
+        mFilter(filter),
+        mIndex(0)
+    {
+    }
+
+    Filter &filter()
+    {
+        return mFilter;
+    }
+
+    const Filter &filter() const
+    {
+        return mFilter;
+    }
+
+    /**
+     * @brief index
+     * @return the sample number of the next raw value
+     */
+    uint64_t index() const
+    {
+        return mIndex;
+    }
+
+    /**
+     * @brief update filters a block of raw values
+     * @param rawValues the n raw values to be filtered
+     * @param n number of values in the block
+     * @param events receives the change events, needs room for n
+     * @param timestamps optional, the n timestamps of the raw values, used as the index of the events instead of the sample number
+     * @return the number of events written to events
+     */
+    size_t update(const ValueType *rawValues, size_t n, ChangeEvent<ValueType> *events, const uint64_t *timestamps = nullptr)
+    {
+        if (n == 0)
+        {
+            return 0;
+        }
+
+        // through update(), so that the filter sees its first value there, as in FilterChain
+        const ValueType firstValue = mFilter.update(rawValues[0]);
+        events[0].index = timestamps ? timestamps[0] : mIndex;
+        events[0].value = firstValue;
+        size_t eventCount = mIndex == 0 || mFilter.hasChanged();
+
+        if (n > 1)
+        {
+            const EventLoop loop = { rawValues, n, events + eventCount, timestamps, mIndex, firstValue };
+            eventCount += FilterChainStage<Filter>::run(mFilter, loop);
+        }
+
+        mIndex += n;
+        return eventCount;
+    }
+
+  private:
+    typedef ValueType T;
+
+    struct EventLoop
+    {
+        const T *rawValues;
+        size_t n;
+        ChangeEvent<T> *events;
+        const uint64_t *timestamps;
+        uint64_t firstIndex;
+        T previousValue;
+
+        template<class Kernel>
+        size_t operator()(Kernel &kernel) const
+        {
+            return timestamps ? run<true>(kernel) : run<false>(kernel);
+        }
+
+        template<bool Timestamps, class Kernel>
+        size_t run(Kernel &kernel) const
+        {
+            T previous = previousValue;
+            size_t eventCount = 0;
+
+            for (size_t i = 1; i < n; ++i)
+            {
+                const T filteredValue = kernel.filter(rawValues[i]);
+
+                events[eventCount].index = Timestamps ? timestamps[i] : firstIndex + i;
+                events[eventCount].value = filteredValue;
+                eventCount += filteredValue != previous;
+                previous = filteredValue;
+            }
+
+            return eventCount;
+        }
+    };
+
+    Filter mFilter;
+    uint64_t mIndex;
+};
+
+/**
+ * Maps the values to 64 bit codes whose differences the stream encodes.
+ * Integers are their value, floating point values their bit pattern, so that the round trip is exact.
+ */
+template<class T>
+struct ChangeEventValue
+{
+    static uint64_t code(T value) { return static_cast<uint64_t>(static_cast<int64_t>(value)); }
+    static T value(uint64_t code) { return static_cast<T>(static_cast<int64_t>(code)); }
+};
+
+template<>
+struct ChangeEventValue<float>
+{
+    static uint64_t code(float value) { uint32_t bits; memcpy(&bits, &value, sizeof(bits)); return bits; }
+    static float value(uint64_t code) { const uint32_t bits = static_cast<uint32_t>(code); float value; memcpy(&value, &bits, sizeof(value)); return value; }
+};
+
+template<>
+struct ChangeEventValue<double>
+{
+    static uint64_t code(double value) { uint64_t bits; memcpy(&bits, &value, sizeof(bits)); return bits; }
+    static double value(uint64_t code) { double value; memcpy(&value, &code, sizeof(value)); return value; }
+};
+
+/**
+ * Serializes change events as a byte stream:
+ * per event the index difference to the previous event as an unsigned LEB128 varint, followed by the
+ * difference of the value codes (see ChangeEventValue) zigzag encoded as a varint, both starting from 0.
+ * An integer signal moves in small steps between long runs, so most of its events take 2 to 3 bytes.
+ * The codes of floating point values are their bit patterns, where a small step changes the upper mantissa bits,
+ * so their events take about 4 bytes for float and 8 for double.
+ * The encoder carries the previous event over from one encode() to the next, so a stream can be encoded block by block.
+ */
+template<class T>
+class ChangeEventEncoder
+{
+  public:
+    // index and value varints of up to 10 bytes each
+    static const size_t MaximumEventSize = 20;
+
+    ChangeEventEncoder():
+        mIndex(0),
+        mCode(0)
+    {
+    }
+
+    /**
+     * @brief encode appends n events to the stream
+     * @param bytes receives the encoded events, needs room for MaximumEventSize*n bytes
+     * @return the number of bytes written
+     */
+    size_t encode(const ChangeEvent<T> *events, size_t n, uint8_t *bytes)
+    {
+        uint8_t *out = bytes;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const uint64_t code = ChangeEventValue<T>::code(events[i].value);
+            const int64_t difference = static_cast<int64_t>(code - mCode);
+
+            out = writeVarint(out, events[i].index - mIndex);
+            out = writeVarint(out, (static_cast<uint64_t>(difference) << 1) ^ static_cast<uint64_t>(difference >> 63));
+
+            mIndex = events[i].index;
+            mCode = code;
+        }
+        return out - bytes;
+    }
+
+  private:
+    static uint8_t *writeVarint(uint8_t *out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            *out++ = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+        *out++ = static_cast<uint8_t>(value);
+        return out;
+    }
+
+    uint64_t mIndex;
+    uint64_t mCode;
+};
+
+/**
+ * Reads back the stream of a ChangeEventEncoder, block by block as it arrives
+ */
+template<class T>
+class ChangeEventDecoder
+{
+  public:
+    ChangeEventDecoder():
+        mIndex(0),
+        mCode(0),
+        mCorrupt(false)
+    {
+    }
+
+    /**
+     * @brief isCorrupt
+     * @return if decode() ran into a varint of more than 10 bytes, which no ChangeEventEncoder writes.
+     * The stream can't be read past it, decode() doesn't read anything any more.
+     */
+    bool isCorrupt() const
+    {
+        return mCorrupt;
+    }
+
+    /**
+     * @brief decode reads events until the bytes or the room for events run out, or the stream turns out to be corrupt.
+     * An event that is cut off at the end of the bytes is left for the next decode().
+     * @param consumed set to the number of bytes read, the stream continues at bytes + consumed
+     * @return the number of events written to events
+     */
+    size_t decode(const uint8_t *bytes, size_t size, ChangeEvent<T> *events, size_t maximumCount, size_t *consumed)
+    {
+        const uint8_t *in = bytes;
+        const uint8_t *end = bytes + size;
+        size_t count = 0;
+
+        while (count < maximumCount && !mCorrupt)
+        {
+            uint64_t indexDifference;
+            uint64_t zigzag;
+            const uint8_t *next = readVarint(in, end, &indexDifference);
+            next = next ? readVarint(next, end, &zigzag) : nullptr;
+            if (!next)
+            {
+                break;
+            }
+
+            mIndex += indexDifference;
+            mCode += (zigzag >> 1) ^ (0 - (zigzag & 1));
+            events[count].index = mIndex;
+            events[count].value = ChangeEventValue<T>::value(mCode);
+            ++count;
+            in = next;
+        }
+
+        *consumed = in - bytes;
+        return count;
+    }
+
+  private:
+    /**
+     * @return the byte after the varint, nullptr if it doesn't end before end or runs past 10 bytes, which sets mCorrupt
+     */
+    const uint8_t *readVarint(const uint8_t *in, const uint8_t *end, uint64_t *value)
+    {
+        uint64_t result = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (in == end)
+            {
+                return nullptr;
+            }
+
+            const uint8_t byte = *in++;
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                *value = result;
+                return in;
+            }
+        }
+
+        mCorrupt = true;
+        return nullptr;
+    }
+
+    uint64_t mIndex;
+    uint64_t mCode;
+    bool mCorrupt;
+};
+
+/**
+ * Turns index keyed change events back into the filtered signal, block by block
+ */
+template<class T>
+class ChangeEventReplay
+{
+  public:
+    ChangeEventReplay():
+        mIndex(0),
+        mValue(T())
+    {
+    }
+
+    /**
+     * @brief index
+     * @return the sample number of the next value replay() writes
+     */
+    uint64_t index() const
+    {
+        return mIndex;
+    }
+
+    /**
+     * @brief replay writes the next n values of the signal
+     * @param events the events from index() on, in order. Only the ones before index() + n are used.
+     * @return the number of events used, the next replay() continues with the events after them
+     */
+    size_t replay(const ChangeEvent<T> *events, size_t count, T *values, size_t n)
+    {
+        const uint64_t end = mIndex + n;
+        size_t used = 0;
+        size_t filled = 0;
+
+        while (used < count && events[used].index < end)
+        {
+            const size_t eventOffset = static_cast<size_t>(std::max(events[used].index, mIndex) - mIndex);
+            std::fill(values + filled, values + eventOffset, mValue);
+            filled = eventOffset;
+            mValue = events[used].value;
+            ++used;
+        }
+
+        std::fill(values + filled, values + n, mValue);
+        mIndex = end;
+        return used;
+    }
+
+  private:
+    uint64_t mIndex;
+    T mValue;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef DECIMATING_FILTER_H
+#define DECIMATING_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+/**
+ * Runs a filter at 1/factor of the input rate, to shed load or to downsample without retuning the filter.
+ *
+ * Every factor raw values are averaged into one, which goes through the timestamped update() of the filter
+ * with the sample number as the timestamp, so that the filter compounds its coefficients over the factor
+ * sample intervals and keeps its time constant in input samples. The average rather than every factor-th value,
+ * so that the noise the filter sees is not aliased down from the input rate.
+ * Filter is EMANoiseFilter or SimpleNoiseFilter with the default sampleInterval() of 1.
+ */
+template<class Filter>
+class DecimatingFilter
+{
+  public:
+    typedef decltype(std::declval<const Filter &>().value()) ValueType;
+
+    DecimatingFilter(const Filter &filter, unsigned factor):
+        mFilter(filter),
+        mFactor(factor > 0 ? factor : 1),
+        mIndex(0),
+        mSum(0),
+        mCount(0)
+    {
+    }
+
+    Filter &filter()
+    {
+        return mFilter;
+    }
+
+    const Filter &filter() const
+    {
+        return mFilter;
+    }
+
+    unsigned factor() const
+    {
+        return mFactor;
+    }
+
+    /**
+     * @brief update filters a block of raw values. The blocks don't have to be multiples of factor(),
+     * the raw values left over are averaged together with the first ones of the next block.
+     * @param rawValues the n raw values to be filtered
+     * @param n number of values in the block
+     * @param filteredValues receives one filtered value per factor() raw values, needs room for n/factor() + 1
+     * @return the number of filtered values written
+     */
+    size_t update(const ValueType *rawValues, size_t n, ValueType *filteredValues)
+    {
+        size_t outputCount = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            mSum += rawValues[i];
+            if (++mCount < mFactor)
+            {
+                continue;
+            }
+
+            mIndex += mFactor;
+            filteredValues[outputCount++] = mFilter.update(static_cast<ValueType>(mSum/mFactor), mIndex);
+            mSum = 0;
+            mCount = 0;
+        }
+
+        return outputCount;
+    }
+
+  private:
+    Filter mFilter;
+    unsigned mFactor;
+    uint64_t mIndex;    // the number of raw values averaged so far, the timestamp of the next filtered value
+    double mSum;
+    unsigned mCount;
+};
+
+#endif
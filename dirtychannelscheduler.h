@@ -0,0 +1,177 @@
+#ifndef DIRTY_CHANNEL_SCHEDULER_H
+#define DIRTY_CHANNEL_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "filterinstrumentation.h"
+#include "workstealingpool.h"
+
+/**
+ * Updates the filters of many channels of which only a few, changing ones get a new sample at a time.
+ *
+ * push() stores the sample of a channel and sets the bit of the channel in a dirty bitmap,
+ * process() updates the filters of the dirty channels only. A summary bitmap above the dirty bitmap has a bit
+ * for every word of it that has bits set, so that process() skips 4096 clean channels per summary word
+ * and 64 per dirty word, and goes through the filters and samples of the dirty channels in ascending order,
+ * front to back through memory. When a pool is given and at least ParallelThreshold channels are dirty,
+ * the dirty channels are split between the workers of the pool in contiguous runs.
+ *
+ * push() is lock free and can be called from any number of threads, process() from one thread at a time,
+ * once the pushes of the tick are done. A push that overlaps process() can store its value after process() took
+ * the bit of the channel and before it read the value, the next process() then updates the channel with the same
+ * sample again. A channel that is pushed more than once before process() is updated once, with the last value,
+ * as a tick based plant would sample it.
+ * Filter is EMANoiseFilter, SimpleNoiseFilter, or anything else with update(T) and value().
+ */
+template<class Filter>
+class DirtyChannelScheduler
+{
+  public:
+    typedef decltype(std::declval<const Filter &>().value()) ValueType;
+
+    // below this many dirty channels, waking up the workers of a pool costs more than it saves
+    static const size_t ParallelThreshold = 4096;
+
+    // channels per range handed to a worker
+    static const size_t Grain = 1024;
+
+    /**
+     * @param channelCount number of channels
+     * @param filter every channel starts with a copy of it
+     */
+    DirtyChannelScheduler(size_t channelCount, const Filter &filter):
+        mFilters(channelCount, filter),
+        mValues(channelCount),
+        mDirty((channelCount + 63)/64),
+        mSummary((mDirty.size() + 63)/64)
+    {
+    }
+
+    DirtyChannelScheduler(const DirtyChannelScheduler &) = delete;
+    DirtyChannelScheduler &operator=(const DirtyChannelScheduler &) = delete;
+
+    size_t channelCount() const
+    {
+        return mFilters.size();
+    }
+
+    /**
+     * @brief filter
+     * @return the filter of the channel, only to be used while process() isn't running
+     */
+    Filter &filter(size_t channel)
+    {
+        return mFilters[channel];
+    }
+
+    const Filter &filter(size_t channel) const
+    {
+        return mFilters[channel];
+    }
+
+    /**
+     * @brief push queues a sample for the channel, to be filtered by the next process().
+     * Must not overlap process(), see above.
+     */
+    void push(size_t channel, ValueType value)
+    {
+        mValues[channel].store(value, std::memory_order_relaxed);
+
+        // release, so that process() sees the value once it sees the bit.
+        // Only the push that finds the word empty sets the summary bit, process() clears the summary bit before the word.
+        const size_t word = channel/64;
+        const uint64_t previous = mDirty[word].fetch_or(uint64_t(1) << (channel % 64), std::memory_order_release);
+        if (previous == 0)
+        {
+            mSummary[word/64].fetch_or(uint64_t(1) << (word % 64), std::memory_order_release);
+        }
+    }
+
+    /**
+     * @brief process updates the filter of every channel pushed since the last process() with its sample
+     * @param pool optional, shares out the channels when there are many
+     * @return the number of channels updated, dirtyChannels() lists them
+     */
+    size_t process(WorkStealingPool *pool = nullptr)
+    {
+        mDirtyChannels.clear();
+
+        for (size_t summaryWord = 0; summaryWord < mSummary.size(); ++summaryWord)
+        {
+            uint64_t summary = mSummary[summaryWord].exchange(0, std::memory_order_acquire);
+            while (summary)
+            {
+                const size_t word = summaryWord*64 + lowestBit(summary);
+                summary &= summary - 1;
+
+                uint64_t dirty = mDirty[word].exchange(0, std::memory_order_acquire);
+                while (dirty)
+                {
+                    mDirtyChannels.push_back(static_cast<uint32_t>(word*64 + lowestBit(dirty)));
+                    dirty &= dirty - 1;
+                }
+            }
+        }
+
+        if (pool && mDirtyChannels.size() >= ParallelThreshold)
+        {
+            pool->run(mDirtyChannels.size(), Grain, [this](size_t begin, size_t end, unsigned) { update(begin, end); });
+        }
+        else
+        {
+            update(0, mDirtyChannels.size());
+        }
+
+        return mDirtyChannels.size();
+    }
+
+    /**
+     * @brief dirtyChannels
+     * @return the channels the last process() updated, in ascending order, e.g. to pick up their new values
+     */
+    const std::vector<uint32_t> &dirtyChannels() const
+    {
+        return mDirtyChannels;
+    }
+
+  private:
+    static unsigned lowestBit(uint64_t bits)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(bits);
+#else
+        unsigned index = 0;
+        while (!(bits & 1))
+        {
+            bits >>= 1;
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+    void update(size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const uint32_t channel = mDirtyChannels[i];
+            mFilters[channel].update(mValues[channel].load(std::memory_order_relaxed));
+        }
+
+        // the per-value updates above only count into the thread, which may be a pool worker
+        FilterInstrumentation::flush();
+    }
+
+    std::vector<Filter> mFilters;
+    std::vector<std::atomic<ValueType>> mValues;
+    std::vector<std::atomic<uint64_t>> mDirty;
+    std::vector<std::atomic<uint64_t>> mSummary;
+    std::vector<uint32_t> mDirtyChannels;
+};
+
+#endif
@@ -2,26 +2,66 @@
 #define EMA_NOISE_FILTER_H
 
 #include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "filterinstrumentation.h"
+#include "sampleintervalclock.h"
+#include "snapcurve.h"
 
 //Thanks a LOT to http://damienclarke.me/code/posts/writing-a-better-noise-reducing-analogread
 
 template<class T>
+class EMANoiseFilterBank;
+
+template<class T, class Real>
+class EMANoiseFilterArray;
+
+template<class T, bool SleepEnabled, bool EdgeSnapEnabled, bool ClampEnabled, bool AlwaysEnabled, class Curve, class Real>
+class StaticEMANoiseFilter;
+
+template<class Filter>
+struct FilterChainStage;
+
+/**
+ * T is the type of the values, Real the type the filter computes in, double by default.
+ * With float the error EMA, the snap curve and the thresholds are computed in float, without conversions to double,
+ * at the cost of the accuracy reported by filtertester-bench (compute_type_accuracy).
+ * Values of T beyond 2^24 aren't exact in float.
+ */
+template<class T, class Real = double>
 class EMANoiseFilter
 {
+    friend class EMANoiseFilterBank<T>;
+    friend class EMANoiseFilterArray<T, Real>;
+
+    template<class, bool, bool, bool, bool, class, class>
+    friend class StaticEMANoiseFilter;
+
+    template<class>
+    friend struct FilterChainStage;
+
   public:
     EMANoiseFilter(T lowerBound,
                    T upperBound,
                    bool sleepEnabled = true,
-                   double snapMultiplier = 0.01):
+                   Real snapMultiplier = Real(0.01)):
         mEnabled(upperBound > lowerBound),
         mFirstValue(true),
         mSleepEnabled(sleepEnabled),
+        mEdgeSnapEnabled(false),
         mSleeping(false),
+        mSmoothValue(T()),
         mErrorEMA(0),
         mLowerBound(lowerBound),
         mUpperBound(upperBound),
+        mRawValue(T()),
+        mFilteredValue(T()),
+        mPrevResponsiveValue(T()),
+        mFilteredValueHasChanged(false),
         mSnapMultiplier(snapMultiplier),
-        mActivityThreshold((upperBound - lowerBound)*0.01) //Activity threshold is 1%
+        mActivityThreshold((upperBound - lowerBound)*Real(0.01)), //Activity threshold is 1%
+        mSnapCurve(SnapCurve::Exact)
     {
     }
 
@@ -100,6 +140,57 @@ class EMANoiseFilter
         return mSleeping;
     }
 
+    /**
+     * Everything update() carries over from one value to the next, without the settings,
+     * which are set up again when the filter is constructed.
+     * Plain data, so that arrays of snapshots can be written to a file and mapped back in, see filterstate.h.
+     */
+    struct Snapshot
+    {
+        Real errorEMA;
+        T smoothValue;
+        T filteredValue;
+        T previousValue;
+        uint8_t firstValue;
+        uint8_t sleeping;
+        uint8_t hasChanged;
+    };
+
+    /**
+     * @brief snapshot
+     * @return the state restore() continues from
+     */
+    Snapshot snapshot() const
+    {
+        Snapshot snapshot = {
+            mErrorEMA,
+            mSmoothValue,
+            mFilteredValue,
+            mPrevResponsiveValue,
+            mFirstValue,
+            mSleeping,
+            mFilteredValueHasChanged
+        };
+        return snapshot;
+    }
+
+    /**
+     * @brief restore continues from a snapshot, e.g. of the filter of the same channel before a restart,
+     * without the transient of a filter that starts from scratch.
+     * Timestamps aren't part of the snapshot, the first timestamped update() after restore() counts as one sample interval.
+     */
+    void restore(const Snapshot &snapshot)
+    {
+        mClock.reset();
+        mErrorEMA = snapshot.errorEMA;
+        mSmoothValue = snapshot.smoothValue;
+        mFilteredValue = snapshot.filteredValue;
+        mPrevResponsiveValue = snapshot.previousValue;
+        mFirstValue = snapshot.firstValue != 0;
+        mSleeping = snapshot.sleeping != 0;
+        mFilteredValueHasChanged = snapshot.hasChanged != 0;
+    }
+
     /**
      * @brief update
      * @param rawValue updates the filtered value based on the raw value being sent in
@@ -107,33 +198,147 @@ class EMANoiseFilter
      */
     T update(T rawValue)
     {
-        mPrevResponsiveValue = mFilteredValue;
-        mFilteredValue = mEnabled
-                         ? getFilteredValue(rawValue)
-                         : rawValue;
+        return updateValue(rawValue, Real(1));
+    }
 
-        mFilteredValueHasChanged = mFilteredValue != mPrevResponsiveValue;
-        return mFilteredValue;
+    /**
+     * @brief update for raw values that don't come every sampleInterval(), e.g. when samples are dropped or coalesced under load.
+     * The snap and the error EMA coefficient are per sample interval and compounded over the intervals since the
+     * previous timestamped update, as if the raw value had been held for all of them, so the filter keeps its time constant.
+     * With timestamps exactly sampleInterval() apart, the output is the same as that of update(rawValue).
+     * @param timestamp of the raw value, in the unit of sampleInterval(), e.g. ns. The first one counts as one sample interval,
+     * one that isn't after the previous one as none.
+     * @return returns the filtered value
+     */
+    T update(T rawValue, uint64_t timestamp)
+    {
+        return updateValue(rawValue, mClock.elapsedIntervals(timestamp));
+    }
+
+    /**
+     * @brief update filters a block of raw values in one go.
+     * The output is identical to calling update() on every value, but the
+     * enabled/sleep/edge snap checks are done once per block instead of once per value.
+     * @param rawValues the n raw values to be filtered
+     * @param filteredValues receives the n filtered values, can be the same buffer as rawValues
+     * @param n number of values in the block
+     * @param changed optional, receives hasChanged() for every value
+     * @return the number of values for which the filtered value has changed
+     */
+    size_t update(const T *rawValues, T *filteredValues, size_t n, bool *changed = nullptr)
+    {
+        if (n == 0)
+        {
+            return 0;
+        }
+
+        if (!mEnabled)
+        {
+            return updateBlock<false, false, false>(rawValues, filteredValues, n, changed);
+        }
+
+        if (mFirstValue)
+        {
+            mSmoothValue = rawValues[0];
+            mFirstValue = false;
+        }
+
+        switch (mSnapCurve)
+        {
+        case SnapCurve::Table:
+            return updateBlockWith<SnapCurveTable>(rawValues, filteredValues, n, changed);
+        case SnapCurve::Newton:
+            return updateBlockWith<SnapCurveNewton>(rawValues, filteredValues, n, changed);
+        case SnapCurve::Polynomial:
+            return updateBlockWith<SnapCurvePolynomial>(rawValues, filteredValues, n, changed);
+        default:
+            return updateBlockWith<SnapCurveExact>(rawValues, filteredValues, n, changed);
+        }
+    }
+
+    /**
+     * @brief advance is the same as calling update(rawValue) count times, for runs of identical raw values, e.g. of idle channels.
+     * Once an update leaves the state as it was, every further update of the run would repeat it, so the rest of the run is skipped.
+     * For integer T, and for floating point T with sleep enabled and a nonzero activity threshold, the smoothed value stops
+     * moving after a few updates, and the error EMA then closes in on the remaining difference by 0.6 per update until it
+     * stops changing as well: within about 80 updates when the smoothed value stopped short of rawValue, within about 1500
+     * when it reached rawValue and the error EMA has to decay through the denormals to 0.
+     * A run costs at most that many updates, however long it is.
+     * Floating point T without sleep has no such bound: the smoothed value approaches rawValue ever more slowly
+     * and keeps changing in its low bits, so a run can cost as much as count updates.
+     * @return returns the filtered value
+     */
+    T advance(T rawValue, size_t count)
+    {
+        if (count == 0)
+        {
+            return mFilteredValue;
+        }
+
+        if (!mEnabled)
+        {
+            InstrumentationCounters counters = InstrumentationCounters();
+            counters.countUpdates(count);
+            counters.countChanges(rawValue != mFilteredValue);
+            FilterInstrumentation::add(FilterInstrumentation::EMA, counters);
+
+            mPrevResponsiveValue = count > 1 ? rawValue : mFilteredValue;
+            mFilteredValue = rawValue;
+            mFilteredValueHasChanged = mFilteredValue != mPrevResponsiveValue;
+            return mFilteredValue;
+        }
+
+        if (mFirstValue)
+        {
+            mSmoothValue = rawValue;
+            mFirstValue = false;
+        }
+
+        switch (mSnapCurve)
+        {
+        case SnapCurve::Table:
+            return advanceWith<SnapCurveTable>(rawValue, count);
+        case SnapCurve::Newton:
+            return advanceWith<SnapCurveNewton>(rawValue, count);
+        case SnapCurve::Polynomial:
+            return advanceWith<SnapCurvePolynomial>(rawValue, count);
+        default:
+            return advanceWith<SnapCurveExact>(rawValue, count);
+        }
+    }
+
+    /**
+     * @brief sampleInterval
+     * @return the time between two samples the filter is tuned for, in the unit of the timestamps of the timestamped update()
+     */
+    uint64_t sampleInterval() const
+    {
+        return mClock.sampleInterval();
+    }
+
+    void setSampleInterval(uint64_t interval)
+    {
+        mClock.setSampleInterval(interval);
     }
 
     /**
      * @brief snapMultiplier
      * @return the snapMultiplier, which specifies how responsive the filtering should be
      */
-    double snapMultiplier() const
+    Real snapMultiplier() const
     {
         return mSnapMultiplier;
     }
 
-    void setSnapMultiplier(double multiplier)
+    void setSnapMultiplier(Real multiplier)
     {
-          if(multiplier > 1.0)
+          if(multiplier > Real(1))
           {
-              mSnapMultiplier = 1.0;
+              mSnapMultiplier = Real(1);
           }
-          else if(multiplier < 0.0)
+          else if(multiplier < Real(0))
           {
-              mSnapMultiplier = 0.0;
+              mSnapMultiplier = Real(0);
           }
           else
           {
@@ -188,10 +393,87 @@ class EMANoiseFilter
         mActivityThreshold = threshold;
     }
 
+    /**
+     * @brief snapCurve
+     * @return the implementation of the snap curve, see snapcurve.h
+     */
+    SnapCurve snapCurve() const
+    {
+        return mSnapCurve;
+    }
+
+    /**
+     * @brief setSnapCurve
+     * @param curve selects the exact snap curve, or one of the approximations that avoid its division
+     */
+    void setSnapCurve(SnapCurve curve)
+    {
+        mSnapCurve = curve;
+    }
+
 
   private:
 
-    T getFilteredValue(T newValue)
+    /**
+     * The configuration getFilteredValue() depends on, copied out of the members
+     * so that the block update can keep it in registers.
+     */
+    struct Parameters
+    {
+        T lowerBound;
+        T upperBound;
+        Real snapMultiplier;
+        Real activityThreshold;
+    };
+
+    /**
+     * The part of the filter state that changes on every getFilteredValue()
+     */
+    struct State
+    {
+        T smoothValue;
+        Real errorEMA;
+        bool sleeping;
+    };
+
+    Parameters parameters() const
+    {
+        Parameters parameters = { mLowerBound, mUpperBound, mSnapMultiplier, mActivityThreshold };
+        return parameters;
+    }
+
+    State state() const
+    {
+        State state = { mSmoothValue, mErrorEMA, mSleeping };
+        return state;
+    }
+
+    void setState(const State &state)
+    {
+        mSmoothValue = state.smoothValue;
+        mErrorEMA = state.errorEMA;
+        mSleeping = state.sleeping;
+    }
+
+    T updateValue(T rawValue, Real intervals)
+    {
+        InstrumentationCounters counters = InstrumentationCounters();
+
+        mPrevResponsiveValue = mFilteredValue;
+        mFilteredValue = mEnabled
+                         ? getFilteredValue(rawValue, intervals, counters)
+                         : rawValue;
+
+        mFilteredValueHasChanged = mFilteredValue != mPrevResponsiveValue;
+
+        counters.countUpdates(1);
+        counters.countChanges(mFilteredValueHasChanged);
+        FilterInstrumentation::add(FilterInstrumentation::EMA, counters);
+        return mFilteredValue;
+    }
+
+    template<class Counters>
+    T getFilteredValue(T newValue, Real intervals, Counters &counters)
     {
         if (mFirstValue)
         {
@@ -199,38 +481,230 @@ class EMANoiseFilter
             mFirstValue = false;
         }
 
+        const Parameters p = parameters();
+        State s = state();
+
+        switch (mSnapCurve)
+        {
+        case SnapCurve::Table:
+            newValue = filterValueWith<SnapCurveTable>(p, s, newValue, intervals, counters);
+            break;
+        case SnapCurve::Newton:
+            newValue = filterValueWith<SnapCurveNewton>(p, s, newValue, intervals, counters);
+            break;
+        case SnapCurve::Polynomial:
+            newValue = filterValueWith<SnapCurvePolynomial>(p, s, newValue, intervals, counters);
+            break;
+        default:
+            newValue = filterValueWith<SnapCurveExact>(p, s, newValue, intervals, counters);
+            break;
+        }
+
+        setState(s);
+        return newValue;
+    }
+
+    /**
+     * Dispatches to the filterValue() for the sleep and edge snap settings
+     */
+    template<class Curve, class Counters>
+    T filterValueWith(const Parameters &p, State &s, T newValue, Real intervals, Counters &counters) const
+    {
+        if (mSleepEnabled)
+        {
+            return mEdgeSnapEnabled
+                   ? filterValue<true, true, true, Curve>(p, s, newValue, intervals, counters)
+                   : filterValue<true, false, true, Curve>(p, s, newValue, intervals, counters);
+        }
+
+        return mEdgeSnapEnabled
+               ? filterValue<false, true, true, Curve>(p, s, newValue, intervals, counters)
+               : filterValue<false, false, true, Curve>(p, s, newValue, intervals, counters);
+    }
+
+    /**
+     * Dispatches to the updateBlock() for the sleep and edge snap settings
+     */
+    template<class Curve>
+    size_t updateBlockWith(const T *rawValues, T *filteredValues, size_t n, bool *changed)
+    {
+        if (mSleepEnabled)
+        {
+            return mEdgeSnapEnabled
+                   ? updateBlock<true, true, true, Curve>(rawValues, filteredValues, n, changed)
+                   : updateBlock<true, true, false, Curve>(rawValues, filteredValues, n, changed);
+        }
+
+        return mEdgeSnapEnabled
+               ? updateBlock<true, false, true, Curve>(rawValues, filteredValues, n, changed)
+               : updateBlock<true, false, false, Curve>(rawValues, filteredValues, n, changed);
+    }
+
+    /**
+     * Dispatches to the advanceRun() for the sleep and edge snap settings
+     */
+    template<class Curve>
+    T advanceWith(T rawValue, size_t count)
+    {
+        if (mSleepEnabled)
+        {
+            return mEdgeSnapEnabled
+                   ? advanceRun<true, true, Curve>(rawValue, count)
+                   : advanceRun<true, false, Curve>(rawValue, count);
+        }
+
+        return mEdgeSnapEnabled
+               ? advanceRun<false, true, Curve>(rawValue, count)
+               : advanceRun<false, false, Curve>(rawValue, count);
+    }
+
+    template<bool SleepEnabled, bool EdgeSnapEnabled, class Curve>
+    T advanceRun(T rawValue, size_t count)
+    {
+        const Parameters p = parameters();
+        State s = state();
+        T previousValue = mFilteredValue;
+        T filteredValue = previousValue;
+        size_t changeCount = 0;
+        InstrumentationCounters counters = InstrumentationCounters();
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const State before = s;
+            InstrumentationCounters step = InstrumentationCounters();
+
+            previousValue = filteredValue;
+            filteredValue = filterValue<SleepEnabled, EdgeSnapEnabled, true, Curve>(p, s, rawValue, step);
+            changeCount += filteredValue != previousValue;
+            counters.add(step, 1);
+
+            if (s.smoothValue == before.smoothValue && s.errorEMA == before.errorEMA && s.sleeping == before.sleeping)
+            {
+                // the remaining updates repeat this one, including what it counted, and return the same value
+                counters.add(step, count - i - 1);
+                if (i + 1 < count)
+                {
+                    previousValue = filteredValue;
+                }
+                break;
+            }
+        }
+
+        setState(s);
+        mPrevResponsiveValue = previousValue;
+        mFilteredValue = filteredValue;
+        mFilteredValueHasChanged = filteredValue != previousValue;
+
+        counters.countUpdates(count);
+        counters.countChanges(changeCount);
+        FilterInstrumentation::add(FilterInstrumentation::EMA, counters);
+        return filteredValue;
+    }
+
+    template<bool Enabled, bool SleepEnabled, bool EdgeSnapEnabled, class Curve = SnapCurveExact>
+    size_t updateBlock(const T *rawValues, T *filteredValues, size_t n, bool *changed)
+    {
+        const Parameters p = parameters();
+        State s = state();
+        T previousValue = mFilteredValue;
+        T filteredValue = previousValue;
+        size_t changeCount = 0;
+        InstrumentationCounters counters = InstrumentationCounters();
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            previousValue = filteredValue;
+            filteredValue = Enabled
+                            ? filterValue<SleepEnabled, EdgeSnapEnabled, true, Curve>(p, s, rawValues[i], counters)
+                            : rawValues[i];
+
+            const bool hasChanged = filteredValue != previousValue;
+            changeCount += hasChanged;
+            filteredValues[i] = filteredValue;
+
+            if (changed)
+            {
+                changed[i] = hasChanged;
+            }
+        }
+
+        if (Enabled)
+        {
+            setState(s);
+        }
+
+        mPrevResponsiveValue = previousValue;
+        mFilteredValue = filteredValue;
+        mFilteredValueHasChanged = filteredValue != previousValue;
+
+        counters.countUpdates(n);
+        counters.countChanges(changeCount);
+        FilterInstrumentation::addBlock(FilterInstrumentation::EMA, counters);
+        return changeCount;
+    }
+
+    /**
+     * ClampEnabled can only be turned off by StaticEMANoiseFilter, for inputs that are known to stay within the bounds.
+     * Curve is one of the snap curve implementations of snapcurve.h.
+     */
+    template<bool SleepEnabled, bool EdgeSnapEnabled, bool ClampEnabled = true, class Curve = SnapCurveExact>
+    static T filterValue(const Parameters &p, State &s, T newValue)
+    {
+        NoFilterCounters counters;
+        return filterValue<SleepEnabled, EdgeSnapEnabled, ClampEnabled, Curve>(p, s, newValue, counters);
+    }
+
+    /**
+     * Counters is FilterCounters or NoFilterCounters, see filterinstrumentation.h
+     */
+    template<bool SleepEnabled, bool EdgeSnapEnabled, bool ClampEnabled, class Curve, class Counters>
+    static T filterValue(const Parameters &p, State &s, T newValue, Counters &counters)
+    {
+        return filterValue<SleepEnabled, EdgeSnapEnabled, ClampEnabled, Curve>(p, s, newValue, Real(1), counters);
+    }
+
+    /**
+     * intervals is the number of sample intervals since the previous value, 1 but for the timestamped update().
+     * The error EMA coefficient and the snap are per interval and compounded over them.
+     */
+    template<bool SleepEnabled, bool EdgeSnapEnabled, bool ClampEnabled, class Curve, class Counters>
+    FILTER_ALWAYS_INLINE static T filterValue(const Parameters &p, State &s, T newValue, Real intervals, Counters &counters)
+    {
         // if sleep and edge snap are enabled and the new value is very close to an edge, drag it a little closer to the edges
         // This'll make it easier to pull the output values right to the extremes without sleeping,
         // and it'll make movements right near the edge appear larger, making it easier to wake up
-        if (mSleepEnabled && mEdgeSnapEnabled)
+        if (SleepEnabled && EdgeSnapEnabled)
         {
-            if (std::abs(newValue - mLowerBound) < mActivityThreshold)
+            if (std::abs(newValue - p.lowerBound) < p.activityThreshold)
             {
-                newValue = mLowerBound + std::abs((std::abs(newValue - mLowerBound)*2 - mActivityThreshold));
+                newValue = p.lowerBound + std::abs((std::abs(newValue - p.lowerBound)*2 - p.activityThreshold));
             }
-            else if( std::abs(newValue - mUpperBound) < mActivityThreshold)
+            else if( std::abs(newValue - p.upperBound) < p.activityThreshold)
             {
-                newValue = mUpperBound - std::abs((std::abs(newValue - mUpperBound)*2 - mActivityThreshold));
+                newValue = p.upperBound - std::abs((std::abs(newValue - p.upperBound)*2 - p.activityThreshold));
             }
         }
 
         // get difference between new input value and current smooth value
-        T diff = std::abs(newValue - mSmoothValue);
+        T diff = std::abs(newValue - s.smoothValue);
 
         // measure the difference between the new value and current value
         // and use another exponential moving average to work out what
         // the current margin of error is
-        mErrorEMA += ((newValue - mSmoothValue) - mErrorEMA) * 0.4;
+        const Real errorWeight = intervals == Real(1) ? Real(0.4) : SampleIntervalClock<Real>::compounded(Real(0.4), intervals);
+        s.errorEMA += ((newValue - s.smoothValue) - s.errorEMA) * errorWeight;
 
         // if sleep has been enabled, sleep when the amount of error is below the activity threshold
-        if(mSleepEnabled)
+        if(SleepEnabled)
         {
           // recalculate sleeping status
-          mSleeping = std::abs(mErrorEMA) < mActivityThreshold;
+          const bool wasSleeping = s.sleeping;
+          s.sleeping = std::abs(s.errorEMA) < p.activityThreshold;
+          counters.countSleepTransitions(s.sleeping != wasSleeping);
         }
 
         // Only update the value if we are not sleeping
-        if(!(mSleepEnabled && mSleeping))
+        if(!(SleepEnabled && s.sleeping))
         {
             // use a 'snap curve' function, where we pass in the diff (x) and get back a number from 0-1.
             // We want small values of x to result in an output close to zero, so when the smooth value is close to the input value
@@ -242,47 +716,45 @@ class EMANoiseFilter
             // Finally the result is multiplied by 2 and capped at a maximum of one, which means that at a certain point all larger movements are maximally snappy
 
             // then multiply the input by SNAP_MULTIPLER so input values fit the snap curve better.
-            auto snap = snapCurve(diff * mSnapMultiplier);
+            auto snap = Curve::value(static_cast<Real>(diff) * p.snapMultiplier);
 
             // when sleep is enabled, the emphasis is stopping on a responsiveValue quickly, and it's less about easing into position.
             // If sleep is enabled, add a small amount to snap so it'll tend to snap into a more accurate position before sleeping starts.
-            if(mSleepEnabled)
+            if(SleepEnabled)
             {
-              snap *= 0.5 + 0.5;
+              snap *= Real(0.5) + Real(0.5);
+            }
+
+            if (intervals != Real(1))
+            {
+                snap = SampleIntervalClock<Real>::compounded(snap, intervals);
             }
 
             // calculate the exponential moving average based on the snap
-            mSmoothValue += (newValue - mSmoothValue) * snap;
+            s.smoothValue += (newValue - s.smoothValue) * snap;
 
             // ensure output is in bounds
-            if(mSmoothValue < mLowerBound
-               || (mEdgeSnapEnabled
-                   && std::abs(mSmoothValue - mLowerBound) < mActivityThreshold))
+            const bool belowLowerBound = ClampEnabled && s.smoothValue < p.lowerBound;
+            if(belowLowerBound
+               || (EdgeSnapEnabled
+                   && std::abs(s.smoothValue - p.lowerBound) < p.activityThreshold))
             {
-              mSmoothValue = mLowerBound;
+              counters.countBoundClamps(belowLowerBound);
+              counters.countEdgeSnaps(!belowLowerBound && s.smoothValue != p.lowerBound);
+              s.smoothValue = p.lowerBound;
             }
-            if (mSmoothValue > mUpperBound
-                || (mEdgeSnapEnabled
-                    && std::abs(mSmoothValue - mUpperBound) < mActivityThreshold))
+            const bool aboveUpperBound = ClampEnabled && s.smoothValue > p.upperBound;
+            if (aboveUpperBound
+                || (EdgeSnapEnabled
+                    && std::abs(s.smoothValue - p.upperBound) < p.activityThreshold))
             {
-              mSmoothValue = mUpperBound;
+              counters.countBoundClamps(aboveUpperBound);
+              counters.countEdgeSnaps(!aboveUpperBound && s.smoothValue != p.upperBound);
+              s.smoothValue = p.upperBound;
             }
         }
 
-        return mSmoothValue;
-    }
-
-    double snapCurve(double x)
-    {
-        double y = 1.0 / (x + 1.0);
-        y = (1.0 - y) * 2.0;
-
-        if(y > 1.0)
-        {
-          y = 1.0;
-        }
-
-        return y;
+        return s.smoothValue;
     }
 
     bool mEnabled;
@@ -292,7 +764,7 @@ class EMANoiseFilter
     bool mSleeping;
 
     T mSmoothValue;
-    double mErrorEMA;
+    Real mErrorEMA;
 
     T mLowerBound;
     T mUpperBound;
@@ -303,8 +775,12 @@ class EMANoiseFilter
     T mPrevResponsiveValue;
     bool mFilteredValueHasChanged;
 
-    double mSnapMultiplier;
-    double mActivityThreshold;
+    Real mSnapMultiplier;
+    Real mActivityThreshold;
+
+    SnapCurve mSnapCurve;
+
+    SampleIntervalClock<Real> mClock;
 };
 
 #endif
@@ -0,0 +1,272 @@
+#ifndef EMA_NOISE_FILTER_ARRAY_H
+#define EMA_NOISE_FILTER_ARRAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "emanoisefilter.h"
+
+/**
+ * The settings of a group of channels of an EMANoiseFilterArray, with the defaults of EMANoiseFilter
+ */
+template<class T, class Real = double>
+struct EMANoiseFilterGroupParameters
+{
+    EMANoiseFilterGroupParameters(T lowerBound,
+                                  T upperBound,
+                                  bool sleepEnabled = true,
+                                  Real snapMultiplier = Real(0.01)):
+        lowerBound(lowerBound),
+        upperBound(upperBound),
+        snapMultiplier(snapMultiplier),
+        activityThreshold((upperBound - lowerBound)*Real(0.01)), //Activity threshold is 1%
+        enabled(upperBound > lowerBound),
+        sleepEnabled(sleepEnabled),
+        edgeSnapEnabled(false),
+        snapCurve(SnapCurve::Exact)
+    {
+    }
+
+    T lowerBound;
+    T upperBound;
+    Real snapMultiplier;
+    Real activityThreshold;
+    bool enabled;
+    bool sleepEnabled;
+    bool edgeSnapEnabled;
+    SnapCurve snapCurve;
+};
+
+/**
+ * What an EMANoiseFilterArray keeps per channel: what update() carries over from one value to the next
+ * and nothing else. The flags share a byte, so with int values that is 24 bytes per channel
+ * with a double error EMA and 16 bytes with a float one, a fraction of sizeof(EMANoiseFilter<int>),
+ * which holds the settings and the sample interval clock of the channel as well.
+ */
+template<class T, class Real = double>
+struct EMANoiseFilterPackedState
+{
+    Real errorEMA;
+    T smoothValue;
+    T filteredValue;
+    uint8_t sleeping : 1;
+    uint8_t firstValue : 1;
+    uint8_t hasChanged : 1;
+};
+
+/**
+ * EMANoiseFilter<T, Real> channels whose state is packed into one contiguous array, for a large number of channels.
+ *
+ * The channels are added in groups that share their settings, the parameter block of a group is stored once,
+ * and update() goes through the channels group by group with the settings of the group dispatched once,
+ * so that the loop only streams through the raw values and the packed states.
+ * The output of every channel is the same as that of an EMANoiseFilter<T, Real> with the settings of its group.
+ * Unlike EMANoiseFilterBank, the channels don't need to be in the same first value or enabled state,
+ * and there is no SIMD kernel: the loop is bound by memory bandwidth once the states don't fit in the caches.
+ */
+template<class T, class Real = double>
+class EMANoiseFilterArray
+{
+  public:
+    typedef EMANoiseFilterGroupParameters<T, Real> GroupParameters;
+    typedef EMANoiseFilterPackedState<T, Real> PackedState;
+
+    /**
+     * @brief addGroup appends channelCount channels with the given settings
+     * @return the index of the group, its channels follow those of the groups added before it
+     */
+    size_t addGroup(const GroupParameters &parameters, size_t channelCount)
+    {
+        const Group group = { parameters, mStates.size(), mStates.size() + channelCount };
+        mGroups.push_back(group);
+
+        PackedState state = PackedState();
+        state.firstValue = true;
+        mStates.resize(group.end, state);
+
+        return mGroups.size() - 1;
+    }
+
+    size_t channelCount() const
+    {
+        return mStates.size();
+    }
+
+    size_t groupCount() const
+    {
+        return mGroups.size();
+    }
+
+    /**
+     * @brief firstChannel
+     * @return the first channel of the group, the channels up to the first channel of the next group belong to it
+     */
+    size_t firstChannel(size_t group) const
+    {
+        return mGroups[group].begin;
+    }
+
+    const GroupParameters &parameters(size_t group) const
+    {
+        return mGroups[group].parameters;
+    }
+
+    /**
+     * @brief setParameters changes the settings of all channels of the group, e.g. setEnabled() of EMANoiseFilter
+     */
+    void setParameters(size_t group, const GroupParameters &parameters)
+    {
+        mGroups[group].parameters = parameters;
+    }
+
+    /**
+     * @brief value
+     * @return returns the last filtered value of the channel after calling update()
+     */
+    T value(size_t channel) const
+    {
+        return mStates[channel].filteredValue;
+    }
+
+    bool hasChanged(size_t channel) const
+    {
+        return mStates[channel].hasChanged;
+    }
+
+    bool isSleeping(size_t channel) const
+    {
+        return mStates[channel].sleeping;
+    }
+
+    /**
+     * @brief states
+     * @return the packed states of all channels, e.g. to save them in one go
+     */
+    const PackedState *states() const
+    {
+        return mStates.data();
+    }
+
+    PackedState *states()
+    {
+        return mStates.data();
+    }
+
+    /**
+     * @brief update advances every channel by one sample
+     * @param rawValues one raw value per channel
+     * @param filteredValues optional, receives the filtered value of every channel
+     * @param changed optional, receives hasChanged() of every channel
+     * @return the number of channels whose filtered value has changed
+     */
+    size_t update(const T *rawValues, T *filteredValues = nullptr, bool *changed = nullptr)
+    {
+        size_t changeCount = 0;
+        for (const Group &group : mGroups)
+        {
+            changeCount += updateGroup(group, rawValues, filteredValues, changed);
+        }
+        return changeCount;
+    }
+
+  private:
+    typedef EMANoiseFilter<T, Real> Filter;
+    typedef typename Filter::Parameters Parameters;
+    typedef typename Filter::State State;
+
+    struct Group
+    {
+        GroupParameters parameters;
+        size_t begin;
+        size_t end;
+    };
+
+    size_t updateGroup(const Group &group, const T *rawValues, T *filteredValues, bool *changed)
+    {
+        if (!group.parameters.enabled)
+        {
+            return updateChannels<false, false, false, SnapCurveExact>(group, rawValues, filteredValues, changed);
+        }
+
+        switch (group.parameters.snapCurve)
+        {
+        case SnapCurve::Table:
+            return updateGroupWith<SnapCurveTable>(group, rawValues, filteredValues, changed);
+        case SnapCurve::Newton:
+            return updateGroupWith<SnapCurveNewton>(group, rawValues, filteredValues, changed);
+        case SnapCurve::Polynomial:
+            return updateGroupWith<SnapCurvePolynomial>(group, rawValues, filteredValues, changed);
+        default:
+            return updateGroupWith<SnapCurveExact>(group, rawValues, filteredValues, changed);
+        }
+    }
+
+    template<class Curve>
+    size_t updateGroupWith(const Group &group, const T *rawValues, T *filteredValues, bool *changed)
+    {
+        if (group.parameters.sleepEnabled)
+        {
+            return group.parameters.edgeSnapEnabled
+                   ? updateChannels<true, true, true, Curve>(group, rawValues, filteredValues, changed)
+                   : updateChannels<true, true, false, Curve>(group, rawValues, filteredValues, changed);
+        }
+
+        return group.parameters.edgeSnapEnabled
+               ? updateChannels<true, false, true, Curve>(group, rawValues, filteredValues, changed)
+               : updateChannels<true, false, false, Curve>(group, rawValues, filteredValues, changed);
+    }
+
+    template<bool Enabled, bool SleepEnabled, bool EdgeSnapEnabled, class Curve>
+    size_t updateChannels(const Group &group, const T *rawValues, T *filteredValues, bool *changed)
+    {
+        const Parameters p = {
+            group.parameters.lowerBound,
+            group.parameters.upperBound,
+            group.parameters.snapMultiplier,
+            group.parameters.activityThreshold
+        };
+
+        size_t changeCount = 0;
+        for (size_t channel = group.begin; channel < group.end; ++channel)
+        {
+            PackedState &packed = mStates[channel];
+            const T rawValue = rawValues[channel];
+            T filteredValue = rawValue;
+
+            if (Enabled)
+            {
+                State s = { packed.firstValue ? rawValue : packed.smoothValue, packed.errorEMA, packed.sleeping != 0 };
+                filteredValue = Filter::template filterValue<SleepEnabled, EdgeSnapEnabled, true, Curve>(p, s, rawValue);
+
+                packed.smoothValue = s.smoothValue;
+                packed.errorEMA = s.errorEMA;
+                packed.sleeping = s.sleeping;
+                packed.firstValue = false;
+            }
+
+            const bool hasChanged = filteredValue != packed.filteredValue;
+            changeCount += hasChanged;
+            packed.filteredValue = filteredValue;
+            packed.hasChanged = hasChanged;
+
+            if (filteredValues)
+            {
+                filteredValues[channel] = filteredValue;
+            }
+
+            if (changed)
+            {
+                changed[channel] = hasChanged;
+            }
+        }
+
+        return changeCount;
+    }
+
+    std::vector<Group> mGroups;
+    std::vector<PackedState> mStates;
+};
+
+#endif
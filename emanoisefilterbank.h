@@ -0,0 +1,488 @@
+#ifndef EMA_NOISE_FILTER_BANK_H
+#define EMA_NOISE_FILTER_BANK_H
+
+#include <stddef.h>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define EMA_NOISE_FILTER_BANK_AVX2
+#define EMA_NOISE_FILTER_BANK_AVX2_TARGET
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// builds without -mavx2 compile the kernel for AVX2 anyway and only run it on CPUs that have it
+#include <immintrin.h>
+#define EMA_NOISE_FILTER_BANK_AVX2
+#define EMA_NOISE_FILTER_BANK_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#include "emanoisefilter.h"
+
+/**
+ * Pointers into the structure of arrays of an EMANoiseFilterBank,
+ * handed to the SIMD kernels so that they don't depend on the bank itself.
+ */
+template<class T>
+struct EMANoiseFilterBankLanes
+{
+    const T *rawValues;
+    T *filteredValues;
+    bool *changed;
+
+    T *smoothValues;
+    double *errorEMAs;
+    unsigned char *sleeping;
+    T *values;
+
+    const T *lowerBounds;
+    const T *upperBounds;
+    const double *activityThresholds;
+    double snapMultiplier;
+};
+
+/**
+ * SIMD kernels used by EMANoiseFilterBank.
+ * The generic version doesn't process any channel and leaves everything to the scalar fallback,
+ * the int specialization below processes as many channels as fit in whole vectors.
+ */
+template<class T>
+struct EMANoiseFilterBankSimd
+{
+    template<bool SleepEnabled, bool EdgeSnapEnabled>
+    static size_t update(const EMANoiseFilterBankLanes<T> &, size_t, size_t *)
+    {
+        return 0;
+    }
+};
+
+#if defined(EMA_NOISE_FILTER_BANK_AVX2)
+
+/**
+ * 4 int channels per step, widened to doubles so that the math is the same as EMANoiseFilter<int>
+ */
+struct EMANoiseFilterBankVector
+{
+    typedef __m256d Real;
+    static const size_t Width = 4;
+
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real load(const int *values) { return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(values))); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real load(const double *values) { return _mm256_loadu_pd(values); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static void store(int *values, Real v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(values), _mm256_cvttpd_epi32(v)); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static void store(double *values, Real v) { _mm256_storeu_pd(values, v); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real set(double value) { return _mm256_set1_pd(value); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real add(Real a, Real b) { return _mm256_add_pd(a, b); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real sub(Real a, Real b) { return _mm256_sub_pd(a, b); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real mul(Real a, Real b) { return _mm256_mul_pd(a, b); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real div(Real a, Real b) { return _mm256_div_pd(a, b); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real min(Real a, Real b) { return _mm256_min_pd(a, b); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real abs(Real a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real truncate(Real a) { return _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real less(Real a, Real b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real notEqual(Real a, Real b) { return _mm256_cmp_pd(a, b, _CMP_NEQ_UQ); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real maskOr(Real a, Real b) { return _mm256_or_pd(a, b); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real maskAndNot(Real a, Real b) { return _mm256_andnot_pd(a, b); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static Real select(Real mask, Real a, Real b) { return _mm256_blendv_pd(b, a, mask); }
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET static int bits(Real mask) { return _mm256_movemask_pd(mask); }
+};
+
+template<>
+struct EMANoiseFilterBankSimd<int>
+{
+    /**
+     * Runs EMANoiseFilter<int>::getFilteredValue() on Width channels at a time, on CPUs with AVX2.
+     * @return the number of channels processed, the rest is left to the scalar fallback
+     */
+    template<bool SleepEnabled, bool EdgeSnapEnabled>
+    static size_t update(const EMANoiseFilterBankLanes<int> &lanes, size_t channelCount, size_t *changeCount)
+    {
+#if defined(__AVX2__)
+        return updateVectors<SleepEnabled, EdgeSnapEnabled>(lanes, channelCount, changeCount);
+#else
+        return __builtin_cpu_supports("avx2")
+               ? updateVectors<SleepEnabled, EdgeSnapEnabled>(lanes, channelCount, changeCount)
+               : 0;
+#endif
+    }
+
+  private:
+    /**
+     * Every branch of the scalar code is evaluated on all lanes and the result picked with a mask
+     */
+    template<bool SleepEnabled, bool EdgeSnapEnabled>
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET
+    static size_t updateVectors(const EMANoiseFilterBankLanes<int> &lanes, size_t channelCount, size_t *changeCount)
+    {
+        typedef EMANoiseFilterBankVector V;
+        typedef V::Real Real;
+
+        const Real snapMultiplier = V::set(lanes.snapMultiplier);
+        const Real errorWeight = V::set(0.4);
+        const Real one = V::set(1.0);
+        const Real two = V::set(2.0);
+
+        size_t channel = 0;
+        for (; channel + V::Width <= channelCount; channel += V::Width)
+        {
+            const Real lowerBound = V::load(lanes.lowerBounds + channel);
+            const Real upperBound = V::load(lanes.upperBounds + channel);
+            const Real activityThreshold = V::load(lanes.activityThresholds + channel);
+            const Real smoothValue = V::load(lanes.smoothValues + channel);
+            Real newValue = V::load(lanes.rawValues + channel);
+
+            if (SleepEnabled && EdgeSnapEnabled)
+            {
+                const Real lowerDistance = V::abs(V::sub(newValue, lowerBound));
+                const Real upperDistance = V::abs(V::sub(newValue, upperBound));
+                const Real nearLower = V::less(lowerDistance, activityThreshold);
+                const Real nearUpper = V::maskAndNot(nearLower, V::less(upperDistance, activityThreshold));
+
+                const Real snappedLower = V::truncate(V::add(lowerBound, V::abs(V::sub(V::mul(lowerDistance, two), activityThreshold))));
+                const Real snappedUpper = V::truncate(V::sub(upperBound, V::abs(V::sub(V::mul(upperDistance, two), activityThreshold))));
+
+                newValue = V::select(nearLower, snappedLower, newValue);
+                newValue = V::select(nearUpper, snappedUpper, newValue);
+            }
+
+            const Real difference = V::sub(newValue, smoothValue);
+
+            Real errorEMA = V::load(lanes.errorEMAs + channel);
+            errorEMA = V::add(errorEMA, V::mul(V::sub(difference, errorEMA), errorWeight));
+            V::store(lanes.errorEMAs + channel, errorEMA);
+
+            Real sleeping = V::set(0.0);
+            if (SleepEnabled)
+            {
+                sleeping = V::less(V::abs(errorEMA), activityThreshold);
+
+                const int sleepingBits = V::bits(sleeping);
+                for (size_t lane = 0; lane < V::Width; ++lane)
+                {
+                    lanes.sleeping[channel + lane] = (sleepingBits >> lane) & 1;
+                }
+
+                // Most channels sleep most of the time, skip the snap curve when none of them is awake
+                if (sleepingBits == (1 << V::Width) - 1)
+                {
+                    publish(lanes, channel, smoothValue, changeCount);
+                    continue;
+                }
+            }
+
+            Real snap = V::div(one, V::add(V::mul(V::abs(difference), snapMultiplier), one));
+            snap = V::min(V::mul(V::sub(one, snap), two), one);
+
+            Real filteredValue = V::truncate(V::add(smoothValue, V::mul(difference, snap)));
+
+            const Real belowLower = EdgeSnapEnabled
+                                    ? V::maskOr(V::less(filteredValue, lowerBound),
+                                                V::less(V::abs(V::sub(filteredValue, lowerBound)), activityThreshold))
+                                    : V::less(filteredValue, lowerBound);
+            filteredValue = V::select(belowLower, lowerBound, filteredValue);
+
+            const Real aboveUpper = EdgeSnapEnabled
+                                    ? V::maskOr(V::less(upperBound, filteredValue),
+                                                V::less(V::abs(V::sub(filteredValue, upperBound)), activityThreshold))
+                                    : V::less(upperBound, filteredValue);
+            filteredValue = V::select(aboveUpper, upperBound, filteredValue);
+
+            if (SleepEnabled)
+            {
+                filteredValue = V::select(sleeping, smoothValue, filteredValue);
+            }
+
+            V::store(lanes.smoothValues + channel, filteredValue);
+            publish(lanes, channel, filteredValue, changeCount);
+        }
+
+        return channel;
+    }
+
+    /**
+     * Publishes the filtered values of the channels starting at channel
+     */
+    EMA_NOISE_FILTER_BANK_AVX2_TARGET
+    static void publish(const EMANoiseFilterBankLanes<int> &lanes, size_t channel, EMANoiseFilterBankVector::Real filteredValue, size_t *changeCount)
+    {
+        typedef EMANoiseFilterBankVector V;
+
+        const int changedBits = V::bits(V::notEqual(filteredValue, V::load(lanes.values + channel)));
+        V::store(lanes.values + channel, filteredValue);
+
+        if (lanes.filteredValues)
+        {
+            V::store(lanes.filteredValues + channel, filteredValue);
+        }
+
+        for (size_t lane = 0; lane < V::Width; ++lane)
+        {
+            const bool hasChanged = (changedBits >> lane) & 1;
+            *changeCount += hasChanged;
+
+            if (lanes.changed)
+            {
+                lanes.changed[channel + lane] = hasChanged;
+            }
+        }
+    }
+};
+
+#endif
+
+/**
+ * A bank of EMANoiseFilter<T> channels that are all updated with one sample per channel at a time.
+ * The per channel state is stored as a structure of arrays, so that for T = int
+ * the channels can be advanced 4 at a time with AVX2 instructions. Builds with -mavx2 always use them,
+ * other GCC and Clang builds for x86 check at runtime if the CPU has AVX2.
+ * Other types, CPUs and compilers, and the channels left over after the last full vector, use the scalar EMANoiseFilter code.
+ *
+ * The output is the same as running one EMANoiseFilter<T> per channel,
+ * as long as the compiler isn't allowed to contract the floating point math into FMAs (-ffp-contract=off).
+ * Sleep, edge snap, the snap multiplier and enabled are shared by all channels,
+ * the bounds and activity threshold are per channel.
+ */
+template<class T>
+class EMANoiseFilterBank
+{
+  public:
+    EMANoiseFilterBank(size_t channelCount,
+                       T lowerBound,
+                       T upperBound,
+                       bool sleepEnabled = true,
+                       double snapMultiplier = 0.01):
+        mEnabled(upperBound > lowerBound),
+        mFirstValue(true),
+        mSleepEnabled(sleepEnabled),
+        mEdgeSnapEnabled(false),
+        mSnapMultiplier(snapMultiplier),
+        mSmoothValue(channelCount),
+        mErrorEMA(channelCount, 0),
+        mSleeping(channelCount, 0),
+        mFilteredValue(channelCount),
+        mLowerBound(channelCount, lowerBound),
+        mUpperBound(channelCount, upperBound),
+        mActivityThreshold(channelCount, (upperBound - lowerBound)*0.01) //Activity threshold is 1%
+    {
+    }
+
+    size_t channelCount() const
+    {
+        return mSmoothValue.size();
+    }
+
+    /**
+     * @brief value
+     * @return returns the last filtered value of the channel after calling update()
+     */
+    T value(size_t channel) const
+    {
+        return mFilteredValue[channel];
+    }
+
+    /**
+     * @brief values
+     * @return the last filtered values of all the channels
+     */
+    const T *values() const
+    {
+        return mFilteredValue.data();
+    }
+
+    bool isSleeping(size_t channel) const
+    {
+        return mSleeping[channel] != 0;
+    }
+
+    T lowerBound(size_t channel) const
+    {
+        return mLowerBound[channel];
+    }
+
+    void setLowerBound(size_t channel, T lowerBound)
+    {
+        mLowerBound[channel] = lowerBound;
+    }
+
+    T upperBound(size_t channel) const
+    {
+        return mUpperBound[channel];
+    }
+
+    void setUpperBound(size_t channel, T upperBound)
+    {
+        mUpperBound[channel] = upperBound;
+    }
+
+    T activityThreshold(size_t channel) const
+    {
+        return mActivityThreshold[channel];
+    }
+
+    void setActivityThreshold(size_t channel, T threshold)
+    {
+        mActivityThreshold[channel] = threshold;
+    }
+
+    bool isEnabled() const
+    {
+        return mEnabled;
+    }
+
+    void setEnabled(bool enabled)
+    {
+        mEnabled = enabled;
+    }
+
+    bool sleepEnabled() const
+    {
+        return mSleepEnabled;
+    }
+
+    void setSleepEnabled(bool sleepEnabled)
+    {
+        mSleepEnabled = sleepEnabled;
+    }
+
+    bool edgeSnapEnabled() const
+    {
+        return mEdgeSnapEnabled;
+    }
+
+    void setEdgeSnapEnabled(bool edgeSnapEnabled)
+    {
+        mEdgeSnapEnabled = edgeSnapEnabled;
+    }
+
+    double snapMultiplier() const
+    {
+        return mSnapMultiplier;
+    }
+
+    void setSnapMultiplier(double multiplier)
+    {
+        mSnapMultiplier = multiplier > 1.0
+                          ? 1.0
+                          : multiplier < 0.0 ? 0.0 : multiplier;
+    }
+
+    /**
+     * @brief update advances every channel by one sample
+     * @param rawValues one raw value per channel
+     * @param filteredValues optional, receives the filtered value of every channel
+     * @param changed optional, receives hasChanged() of every channel
+     * @return the number of channels whose filtered value has changed
+     */
+    size_t update(const T *rawValues, T *filteredValues = nullptr, bool *changed = nullptr)
+    {
+        const size_t count = channelCount();
+
+        if (!mEnabled)
+        {
+            size_t changeCount = 0;
+            for (size_t channel = 0; channel < count; ++channel)
+            {
+                const bool hasChanged = rawValues[channel] != mFilteredValue[channel];
+                changeCount += hasChanged;
+                mFilteredValue[channel] = rawValues[channel];
+
+                if (filteredValues)
+                {
+                    filteredValues[channel] = rawValues[channel];
+                }
+
+                if (changed)
+                {
+                    changed[channel] = hasChanged;
+                }
+            }
+
+            return changeCount;
+        }
+
+        if (mFirstValue)
+        {
+            mSmoothValue.assign(rawValues, rawValues + count);
+            mFirstValue = false;
+        }
+
+        if (mSleepEnabled)
+        {
+            return mEdgeSnapEnabled
+                   ? updateChannels<true, true>(rawValues, filteredValues, changed)
+                   : updateChannels<true, false>(rawValues, filteredValues, changed);
+        }
+
+        return mEdgeSnapEnabled
+               ? updateChannels<false, true>(rawValues, filteredValues, changed)
+               : updateChannels<false, false>(rawValues, filteredValues, changed);
+    }
+
+  private:
+    typedef typename EMANoiseFilter<T>::Parameters Parameters;
+    typedef typename EMANoiseFilter<T>::State State;
+
+    template<bool SleepEnabled, bool EdgeSnapEnabled>
+    size_t updateChannels(const T *rawValues, T *filteredValues, bool *changed)
+    {
+        const EMANoiseFilterBankLanes<T> lanes = {
+            rawValues,
+            filteredValues,
+            changed,
+            mSmoothValue.data(),
+            mErrorEMA.data(),
+            mSleeping.data(),
+            mFilteredValue.data(),
+            mLowerBound.data(),
+            mUpperBound.data(),
+            mActivityThreshold.data(),
+            mSnapMultiplier
+        };
+
+        const size_t count = channelCount();
+        size_t changeCount = 0;
+        size_t channel = EMANoiseFilterBankSimd<T>::template update<SleepEnabled, EdgeSnapEnabled>(lanes, count, &changeCount);
+
+        for (; channel < count; ++channel)
+        {
+            const Parameters p = { mLowerBound[channel], mUpperBound[channel], mSnapMultiplier, mActivityThreshold[channel] };
+            State s = { mSmoothValue[channel], mErrorEMA[channel], mSleeping[channel] != 0 };
+
+            const T filteredValue = EMANoiseFilter<T>::template filterValue<SleepEnabled, EdgeSnapEnabled>(p, s, rawValues[channel]);
+
+            mSmoothValue[channel] = s.smoothValue;
+            mErrorEMA[channel] = s.errorEMA;
+            mSleeping[channel] = s.sleeping;
+
+            const bool hasChanged = filteredValue != mFilteredValue[channel];
+            changeCount += hasChanged;
+            mFilteredValue[channel] = filteredValue;
+
+            if (filteredValues)
+            {
+                filteredValues[channel] = filteredValue;
+            }
+
+            if (changed)
+            {
+                changed[channel] = hasChanged;
+            }
+        }
+
+        return changeCount;
+    }
+
+    bool mEnabled;
+    bool mFirstValue;
+    bool mSleepEnabled;
+    bool mEdgeSnapEnabled;
+    double mSnapMultiplier;
+
+    std::vector<T> mSmoothValue;
+    std::vector<double> mErrorEMA;
+    std::vector<unsigned char> mSleeping;
+    std::vector<T> mFilteredValue;
+
+    std::vector<T> mLowerBound;
+    std::vector<T> mUpperBound;
+    std::vector<double> mActivityThreshold;
+};
+
+#endif
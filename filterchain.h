@@ -0,0 +1,447 @@
+#ifndef FILTER_CHAIN_H
+#define FILTER_CHAIN_H
+
+#include <stddef.h>
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "emanoisefilter.h"
+#include "simplenoisefilter.h"
+#include "staticemanoisefilter.h"
+
+/**
+ * How FilterChain runs a block through a stage of type Filter.
+ *
+ * run() copies the settings and the state of the filter into a Kernel, hands it to function, which calls
+ * kernel.filter(value) for every value of the block, and then stores the kernel's state back into the filter.
+ * The kernel is a local value, so in the fused loop of the chain its state stays in registers, and because run()
+ * selects the kernel for the filter's settings once per block, as the block update() of the filters does,
+ * the loop has no per value checks of them.
+ *
+ * This generic version works for any filter with an update(T) and calls it for every value,
+ * the specializations below give the filters of this project kernels that don't go through their members.
+ * Kernels don't handle the first value of a filter, FilterChain always passes it through update().
+ */
+template<class Filter>
+struct FilterChainStage
+{
+    struct Kernel
+    {
+        Filter &stage;
+
+        template<class T>
+        T filter(T value)
+        {
+            return stage.update(value);
+        }
+    };
+
+    template<class Function>
+    static size_t run(Filter &filter, const Function &function)
+    {
+        Kernel kernel = { filter };
+        return function(kernel);
+    }
+};
+
+template<class T, class Real>
+struct FilterChainStage<EMANoiseFilter<T, Real>>
+{
+    typedef EMANoiseFilter<T, Real> Filter;
+
+    template<bool Enabled, bool SleepEnabled, bool EdgeSnapEnabled, class Curve>
+    struct Kernel
+    {
+        typename Filter::Parameters p;
+        typename Filter::State s;
+        T previousValue;
+        T filteredValue;
+        InstrumentationCounters counters;
+
+        T filter(T rawValue)
+        {
+            previousValue = filteredValue;
+            filteredValue = Enabled
+                            ? Filter::template filterValue<SleepEnabled, EdgeSnapEnabled, true, Curve>(p, s, rawValue, counters)
+                            : rawValue;
+
+            counters.countUpdates(1);
+            counters.countChanges(filteredValue != previousValue);
+            return filteredValue;
+        }
+    };
+
+    template<class Function>
+    static size_t run(Filter &filter, const Function &function)
+    {
+        if (!filter.mEnabled)
+        {
+            return runKernel<Kernel<false, false, false, SnapCurveExact>>(filter, function);
+        }
+
+        switch (filter.mSnapCurve)
+        {
+        case SnapCurve::Table:
+            return runWith<SnapCurveTable>(filter, function);
+        case SnapCurve::Newton:
+            return runWith<SnapCurveNewton>(filter, function);
+        case SnapCurve::Polynomial:
+            return runWith<SnapCurvePolynomial>(filter, function);
+        default:
+            return runWith<SnapCurveExact>(filter, function);
+        }
+    }
+
+  private:
+    template<class Curve, class Function>
+    static size_t runWith(Filter &filter, const Function &function)
+    {
+        if (filter.mSleepEnabled)
+        {
+            return filter.mEdgeSnapEnabled
+                   ? runKernel<Kernel<true, true, true, Curve>>(filter, function)
+                   : runKernel<Kernel<true, true, false, Curve>>(filter, function);
+        }
+
+        return filter.mEdgeSnapEnabled
+               ? runKernel<Kernel<true, false, true, Curve>>(filter, function)
+               : runKernel<Kernel<true, false, false, Curve>>(filter, function);
+    }
+
+    template<class StageKernel, class Function>
+    static size_t runKernel(Filter &filter, const Function &function)
+    {
+        StageKernel kernel = { filter.parameters(), filter.state(), filter.mPrevResponsiveValue, filter.mFilteredValue, InstrumentationCounters() };
+        const size_t result = function(kernel);
+
+        filter.setState(kernel.s);
+        filter.mPrevResponsiveValue = kernel.previousValue;
+        filter.mFilteredValue = kernel.filteredValue;
+        filter.mFilteredValueHasChanged = kernel.filteredValue != kernel.previousValue;
+        FilterInstrumentation::addBlock(FilterInstrumentation::EMA, kernel.counters);
+        return result;
+    }
+};
+
+template<class T, bool SleepEnabled, bool EdgeSnapEnabled, bool ClampEnabled, bool AlwaysEnabled, class Curve, class Real>
+struct FilterChainStage<StaticEMANoiseFilter<T, SleepEnabled, EdgeSnapEnabled, ClampEnabled, AlwaysEnabled, Curve, Real>>
+{
+    typedef StaticEMANoiseFilter<T, SleepEnabled, EdgeSnapEnabled, ClampEnabled, AlwaysEnabled, Curve, Real> Filter;
+
+    template<bool Enabled>
+    struct Kernel
+    {
+        typename Filter::Parameters p;
+        typename Filter::State s;
+        T previousValue;
+        T filteredValue;
+
+        T filter(T rawValue)
+        {
+            previousValue = filteredValue;
+            filteredValue = Enabled
+                            ? EMANoiseFilter<T, Real>::template filterValue<SleepEnabled, EdgeSnapEnabled, ClampEnabled, Curve>(p, s, rawValue)
+                            : rawValue;
+            return filteredValue;
+        }
+    };
+
+    template<class Function>
+    static size_t run(Filter &filter, const Function &function)
+    {
+        return filter.isEnabled()
+               ? runKernel<Kernel<true>>(filter, function)
+               : runKernel<Kernel<false>>(filter, function);
+    }
+
+  private:
+    template<class StageKernel, class Function>
+    static size_t runKernel(Filter &filter, const Function &function)
+    {
+        StageKernel kernel = { filter.mParameters, filter.mState, filter.mFilteredValue, filter.mFilteredValue };
+        const size_t result = function(kernel);
+
+        filter.mState = kernel.s;
+        filter.mFilteredValue = kernel.filteredValue;
+        filter.mFilteredValueHasChanged = kernel.filteredValue != kernel.previousValue;
+        return result;
+    }
+};
+
+template<class T, class Real>
+struct FilterChainStage<SimpleNoiseFilter<T, Real>>
+{
+    typedef SimpleNoiseFilter<T, Real> Filter;
+
+    template<bool Enabled>
+    struct Kernel
+    {
+        typename Filter::Parameters p;
+        typename Filter::State s;
+        T previousValue;
+        T filteredValue;
+        InstrumentationCounters counters;
+
+        T filter(T rawValue)
+        {
+            previousValue = filteredValue;
+            filteredValue = Enabled
+                            ? Filter::filterValue(p, s, rawValue, counters)
+                            : rawValue;
+
+            counters.countUpdates(1);
+            counters.countChanges(filteredValue != previousValue);
+            return filteredValue;
+        }
+    };
+
+    template<class Function>
+    static size_t run(Filter &filter, const Function &function)
+    {
+        return filter.mEnabled
+               ? runKernel<Kernel<true>>(filter, function)
+               : runKernel<Kernel<false>>(filter, function);
+    }
+
+  private:
+    template<class StageKernel, class Function>
+    static size_t runKernel(Filter &filter, const Function &function)
+    {
+        StageKernel kernel = { filter.parameters(), filter.state(), filter.mPrevResponsiveValue, filter.mFilteredValue, InstrumentationCounters() };
+        const size_t result = function(kernel);
+
+        filter.setState(kernel.s);
+        filter.mPrevResponsiveValue = kernel.previousValue;
+        filter.mFilteredValue = kernel.filteredValue;
+        filter.mFilteredValueHasChanged = kernel.filteredValue != kernel.previousValue;
+        FilterInstrumentation::addBlock(FilterInstrumentation::Simple, kernel.counters);
+        return result;
+    }
+};
+
+/**
+ * Filter stages composed at compile time, e.g. a SimpleNoiseFilter that rejects spikes feeding an EMANoiseFilter:
+ *
+ *     FilterChain<SimpleNoiseFilter<int>, EMANoiseFilter<int>> chain(SimpleNoiseFilter<int>(16, 3),
+ *                                                                    EMANoiseFilter<int>(0, 4095));
+ *
+ * update() runs every value through all stages in one loop, without intermediate buffers or virtual calls,
+ * and its output is identical to running the stages one after another. The stages stay accessible through stage<I>().
+ *
+ * The block update() instantiates its loop for every combination of the stage kernels, see FilterChainStage,
+ * 17 per EMANoiseFilter stage and 2 per SimpleNoiseFilter or StaticEMANoiseFilter stage,
+ * so chains of several EMANoiseFilter stages are better built from StaticEMANoiseFilter.
+ *
+ * A chain is a FilterChainStage itself, whose kernel runs the kernels of all stages,
+ * so it can be a stage of another chain or be run by ChangeEventFilter.
+ */
+template<class First, class... Rest>
+class FilterChain
+{
+    template<class>
+    friend struct FilterChainStage;
+
+  public:
+    typedef decltype(std::declval<const First &>().value()) ValueType;
+    typedef std::tuple<First, Rest...> Stages;
+
+    static const size_t StageCount = 1 + sizeof...(Rest);
+
+    explicit FilterChain(const First &first, const Rest &... rest):
+        mStages(first, rest...)
+    {
+    }
+
+    template<size_t I>
+    typename std::tuple_element<I, Stages>::type &stage()
+    {
+        return std::get<I>(mStages);
+    }
+
+    template<size_t I>
+    const typename std::tuple_element<I, Stages>::type &stage() const
+    {
+        return std::get<I>(mStages);
+    }
+
+    /**
+     * @brief value
+     * @return the last filtered value of the last stage
+     */
+    ValueType value() const
+    {
+        return std::get<StageCount - 1>(mStages).value();
+    }
+
+    /**
+     * @brief hasChanged
+     * @return returns if the output of the last stage has changed during the last update()
+     */
+    bool hasChanged() const
+    {
+        return std::get<StageCount - 1>(mStages).hasChanged();
+    }
+
+    /**
+     * @brief update runs a raw value through all stages
+     * @return the filtered value of the last stage
+     */
+    ValueType update(ValueType rawValue)
+    {
+        return updateStage(rawValue, std::integral_constant<size_t, 0>());
+    }
+
+    /**
+     * @brief update runs a block of raw values through all stages in one loop, same parameters as EMANoiseFilter::update()
+     * @return the number of values for which the output of the last stage has changed
+     */
+    size_t update(const ValueType *rawValues, ValueType *filteredValues, size_t n, bool *changed = nullptr)
+    {
+        if (n == 0)
+        {
+            return 0;
+        }
+
+        // through update(), so that the stages see their first value there
+        filteredValues[0] = update(rawValues[0]);
+        const bool firstChanged = hasChanged();
+        if (changed)
+        {
+            changed[0] = firstChanged;
+        }
+
+        if (n == 1)
+        {
+            return firstChanged;
+        }
+
+        const BlockLoop loop = { rawValues, filteredValues, n, changed, filteredValues[0] };
+        return firstChanged + runKernels<0>(loop, NoKernels(), std::false_type());
+    }
+
+  private:
+    typedef ValueType T;
+
+    /**
+     * The fused loop of the block update(), once the kernels of all stages are collected
+     */
+    struct BlockLoop
+    {
+        const T *rawValues;
+        T *filteredValues;
+        size_t n;
+        bool *changed;
+        T previousValue;
+
+        template<class StageKernels>
+        size_t operator()(StageKernels &kernels) const
+        {
+            T previous = previousValue;
+            size_t changeCount = 0;
+
+            for (size_t i = 1; i < n; ++i)
+            {
+                const T filteredValue = kernels.filter(rawValues[i]);
+
+                const bool hasChanged = filteredValue != previous;
+                changeCount += hasChanged;
+                filteredValues[i] = filteredValue;
+
+                if (changed)
+                {
+                    changed[i] = hasChanged;
+                }
+
+                previous = filteredValue;
+            }
+
+            return changeCount;
+        }
+    };
+
+    /**
+     * The kernels collected so far, applied in stage order
+     */
+    struct NoKernels
+    {
+        T filter(T value) const
+        {
+            return value;
+        }
+    };
+
+    template<class Kernel, class Previous>
+    struct Kernels
+    {
+        Kernel &kernel;
+        Previous previous;
+
+        T filter(T value) const
+        {
+            return kernel.filter(previous.filter(value));
+        }
+    };
+
+    /**
+     * Called back by FilterChainStage<stage I>::run() with the kernel of stage I
+     */
+    template<size_t I, class Function, class Previous>
+    struct Collect
+    {
+        FilterChain *chain;
+        const Function *function;
+        Previous previous;
+
+        template<class Kernel>
+        size_t operator()(Kernel &kernel) const
+        {
+            const Kernels<Kernel, Previous> kernels = { kernel, previous };
+            return chain->template runKernels<I + 1>(*function, kernels, std::integral_constant<bool, I + 1 == StageCount>());
+        }
+    };
+
+    T updateStage(T value, std::integral_constant<size_t, StageCount>)
+    {
+        return value;
+    }
+
+    template<size_t I>
+    T updateStage(T value, std::integral_constant<size_t, I>)
+    {
+        return updateStage(std::get<I>(mStages).update(value), std::integral_constant<size_t, I + 1>());
+    }
+
+    /**
+     * Collects the kernels of the stages from I on and calls function with all of them
+     */
+    template<size_t I, class Function, class Previous>
+    size_t runKernels(const Function &function, const Previous &previous, std::false_type)
+    {
+        typedef typename std::tuple_element<I, Stages>::type Stage;
+        const Collect<I, Function, Previous> collect = { this, &function, previous };
+        return FilterChainStage<Stage>::run(std::get<I>(mStages), collect);
+    }
+
+    template<size_t I, class Function, class StageKernels>
+    size_t runKernels(const Function &function, const StageKernels &kernels, std::true_type)
+    {
+        StageKernels chainKernels = kernels;
+        return function(chainKernels);
+    }
+
+    Stages mStages;
+};
+
+template<class First, class... Rest>
+struct FilterChainStage<FilterChain<First, Rest...>>
+{
+    template<class Function>
+    static size_t run(FilterChain<First, Rest...> &chain, const Function &function)
+    {
+        return chain.template runKernels<0>(function, typename FilterChain<First, Rest...>::NoKernels(), std::false_type());
+    }
+};
+
+#endif
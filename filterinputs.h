@@ -0,0 +1,90 @@
+#ifndef FILTER_INPUTS_H
+#define FILTER_INPUTS_H
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "signalgenerator.h"
+
+/**
+ * The input classes filtertester-bench times the filters on and filtertester-check checks their accuracy on
+ */
+enum class Shape
+{
+    Constant,
+    SmallNoise,
+    Ramp,
+    Steps,
+    RandomWalk
+};
+
+const Shape Shapes[] = { Shape::Constant, Shape::SmallNoise, Shape::Ramp, Shape::Steps, Shape::RandomWalk };
+
+inline const char *shapeName(Shape shape)
+{
+    switch (shape)
+    {
+    case Shape::Constant:
+        return "constant";
+    case Shape::SmallNoise:
+        return "small_noise";
+    case Shape::Ramp:
+        return "ramp";
+    case Shape::Steps:
+        return "steps";
+    case Shape::RandomWalk:
+        return "random_walk";
+    }
+    return "";
+}
+
+/**
+ * @brief makeInput generates n samples between lowerBound and upperBound
+ */
+template<class T>
+std::vector<T> makeInput(Shape shape, size_t n, unsigned int seed, int lowerBound, int upperBound)
+{
+    // Xoshiro256 rather than the std distributions, whose output differs between standard libraries
+    Xoshiro256 random(seed);
+    auto noise = [&]() { return static_cast<int>(random.below(11)) - 5; };
+    auto level = [&]() { return lowerBound + static_cast<int>(random.below(upperBound - lowerBound + 1)); };
+    auto walk = [&]() { return static_cast<int>(random.below(33)) - 16; };
+
+    std::vector<T> input(n);
+    int value = (lowerBound + upperBound)/2;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        switch (shape)
+        {
+        case Shape::Constant:
+            break;
+        case Shape::SmallNoise:
+            value = (lowerBound + upperBound)/2 + noise();
+            break;
+        case Shape::Ramp:
+        {
+            const int phase = i % (2*(upperBound - lowerBound));
+            value = lowerBound + (phase < upperBound - lowerBound ? phase : 2*(upperBound - lowerBound) - phase);
+            break;
+        }
+        case Shape::Steps:
+            if (i % 2048 == 0)
+            {
+                value = level();
+            }
+            break;
+        case Shape::RandomWalk:
+            value = std::min(upperBound, std::max(lowerBound, value + walk()));
+            break;
+        }
+
+        input[i] = static_cast<T>(shape == Shape::Steps ? value + noise() : value);
+    }
+
+    return input;
+}
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef FILTER_INSTRUMENTATION_H
+#define FILTER_INSTRUMENTATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * What the filters did, counted while they run when FILTERTESTER_INSTRUMENTATION is defined.
+ * The EMA filter doesn't suppress samples and the simple filter doesn't sleep, snap or clamp,
+ * so those counters stay 0 for the other filter.
+ */
+struct FilterCounters
+{
+    uint64_t updates;                   // values filtered
+    uint64_t changes;                   // updates after which hasChanged() was true
+    uint64_t sleepTransitions;          // the EMA filter fell asleep or woke up
+    uint64_t edgeSnaps;                 // the EMA output was moved onto a bound because it was within the activity threshold
+    uint64_t boundClamps;               // the EMA output was moved back onto a bound it had crossed
+    uint64_t suppressedSamples;         // the simple filter held a value beyond the activity threshold back
+    uint64_t suppressionBreakthroughs;  // the simple filter gave in after suppressionCount values and reset its count
+
+    void countUpdates(uint64_t n) { updates += n; }
+    void countChanges(uint64_t n) { changes += n; }
+    void countSleepTransitions(uint64_t n) { sleepTransitions += n; }
+    void countEdgeSnaps(uint64_t n) { edgeSnaps += n; }
+    void countBoundClamps(uint64_t n) { boundClamps += n; }
+    void countSuppressedSamples(uint64_t n) { suppressedSamples += n; }
+    void countSuppressionBreakthroughs(uint64_t n) { suppressionBreakthroughs += n; }
+
+    /**
+     * @brief add counts what counters counted times over, e.g. for updates skipped because they repeat one that was counted
+     */
+    void add(const FilterCounters &counters, uint64_t times)
+    {
+        updates += counters.updates*times;
+        changes += counters.changes*times;
+        sleepTransitions += counters.sleepTransitions*times;
+        edgeSnaps += counters.edgeSnaps*times;
+        boundClamps += counters.boundClamps*times;
+        suppressedSamples += counters.suppressedSamples*times;
+        suppressionBreakthroughs += counters.suppressionBreakthroughs*times;
+    }
+};
+
+/**
+ * Stands in for FilterCounters when the instrumentation is compiled out, counting nothing at no cost
+ */
+struct NoFilterCounters
+{
+    void countUpdates(uint64_t) {}
+    void countChanges(uint64_t) {}
+    void countSleepTransitions(uint64_t) {}
+    void countEdgeSnaps(uint64_t) {}
+    void countBoundClamps(uint64_t) {}
+    void countSuppressedSamples(uint64_t) {}
+    void countSuppressionBreakthroughs(uint64_t) {}
+    void add(const NoFilterCounters &, uint64_t) {}
+};
+
+#ifdef FILTERTESTER_INSTRUMENTATION
+typedef FilterCounters InstrumentationCounters;
+#else
+typedef NoFilterCounters InstrumentationCounters;
+#endif
+
+// For the per-value kernels, which the counters grow beyond what the compiler inlines on its own,
+// leaving the filter state of the caller's loop in memory
+#if defined(__GNUC__)
+#define FILTER_ALWAYS_INLINE __attribute__((always_inline)) inline
+#elif defined(_MSC_VER)
+#define FILTER_ALWAYS_INLINE __forceinline
+#else
+#define FILTER_ALWAYS_INLINE inline
+#endif
+
+/**
+ * Collects the counters of all filter instances on all threads.
+ *
+ * The filters count in a local FilterCounters during an update() and add it to plain, non atomic pending counters
+ * of their thread at the end. add() never makes a call, a possible call in the per-value update() would make
+ * the compiler keep the filter state of the caller's loop in memory instead of registers.
+ * flush() moves the pending counters into the slot of the thread: addBlock() flushes once per block,
+ * total() flushes the thread that calls it, and threads that filter with the per-value update() flush
+ * after every batch of work, see DirtyChannelScheduler and FilterPipeline. A thread also flushes when it ends,
+ * provided it flushed at least once before, which is when it gets its slot.
+ *
+ * Every thread gets its own slot, padded to its own cache lines, which only that thread writes,
+ * with plain relaxed loads and stores instead of atomic read-modify-writes, so counting never contends between threads.
+ * total() sums the slots on demand, from any thread. The slot of a finished thread is kept with its counts
+ * and handed to the next new thread.
+ */
+class FilterInstrumentation
+{
+  public:
+    enum Filter
+    {
+        EMA,
+        Simple,
+        FilterCount
+    };
+
+    static constexpr bool enabled()
+    {
+#ifdef FILTERTESTER_INSTRUMENTATION
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief add counts into the pending counters of the thread, for the per-value updates
+     */
+    static void add(Filter filter, const FilterCounters &counters)
+    {
+        FilterCounters &pending = threadPending()[filter];
+        pending.updates += counters.updates;
+        pending.changes += counters.changes;
+
+        // the rest rarely fire, one test skips them all
+        if (counters.sleepTransitions | counters.edgeSnaps | counters.boundClamps
+            | counters.suppressedSamples | counters.suppressionBreakthroughs)
+        {
+            pending.sleepTransitions += counters.sleepTransitions;
+            pending.edgeSnaps += counters.edgeSnaps;
+            pending.boundClamps += counters.boundClamps;
+            pending.suppressedSamples += counters.suppressedSamples;
+            pending.suppressionBreakthroughs += counters.suppressionBreakthroughs;
+        }
+    }
+
+    static void add(Filter, const NoFilterCounters &)
+    {
+    }
+
+    /**
+     * @brief addBlock adds and flushes, for the block updates
+     */
+    static void addBlock(Filter filter, const FilterCounters &counters)
+    {
+        add(filter, counters);
+        flush();
+    }
+
+    static void addBlock(Filter, const NoFilterCounters &)
+    {
+    }
+
+    /**
+     * @brief flush moves the pending counters of the calling thread into its slot, where total() sees them
+     */
+    static void flush()
+    {
+        if (enabled())
+        {
+            flushPending(threadSlot());
+        }
+    }
+
+    /**
+     * @brief total sums the counts of all threads up to their last flush() and all of the calling thread's.
+     * Counts flushed concurrently may or may not be included.
+     */
+    static FilterCounters total(Filter filter)
+    {
+        flush();
+
+        FilterCounters total = FilterCounters();
+
+        Registry &registry = Registry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const std::unique_ptr<Slot> &slot : registry.slots)
+        {
+            const Counters &counters = slot->counters[filter];
+            total.updates += counters.updates.load(std::memory_order_relaxed);
+            total.changes += counters.changes.load(std::memory_order_relaxed);
+            total.sleepTransitions += counters.sleepTransitions.load(std::memory_order_relaxed);
+            total.edgeSnaps += counters.edgeSnaps.load(std::memory_order_relaxed);
+            total.boundClamps += counters.boundClamps.load(std::memory_order_relaxed);
+            total.suppressedSamples += counters.suppressedSamples.load(std::memory_order_relaxed);
+            total.suppressionBreakthroughs += counters.suppressionBreakthroughs.load(std::memory_order_relaxed);
+        }
+
+        return total;
+    }
+
+  private:
+    struct Counters
+    {
+        std::atomic<uint64_t> updates;
+        std::atomic<uint64_t> changes;
+        std::atomic<uint64_t> sleepTransitions;
+        std::atomic<uint64_t> edgeSnaps;
+        std::atomic<uint64_t> boundClamps;
+        std::atomic<uint64_t> suppressedSamples;
+        std::atomic<uint64_t> suppressionBreakthroughs;
+    };
+
+    // Padding rather than alignas, operator new doesn't honour over alignment before C++17
+    struct Slot
+    {
+        char padding0[64];
+        Counters counters[FilterCount];
+        char padding1[64];
+    };
+
+    struct Registry
+    {
+        static Registry &instance()
+        {
+            static Registry registry;
+            return registry;
+        }
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::vector<Slot *> freeSlots;
+    };
+
+    /**
+     * Flushes the pending counters of a thread and returns its slot to the free slots when the thread ends
+     */
+    struct SlotRelease
+    {
+        Slot *slot;
+
+        ~SlotRelease()
+        {
+            flushPending(slot);
+
+            Registry &registry = Registry::instance();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.freeSlots.push_back(slot);
+        }
+    };
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static FilterCounters *threadPending()
+    {
+        // trivial thread_locals are plain loads and stores, without the initialisation check of a non trivial one
+        static thread_local FilterCounters pending[FilterCount];
+        return pending;
+    }
+
+    static void flushPending(Slot *slot)
+    {
+        FilterCounters *pending = threadPending();
+        for (int filter = 0; filter < FilterCount; ++filter)
+        {
+            const FilterCounters &counters = pending[filter];
+            Counters &counts = slot->counters[filter];
+            add(counts.updates, counters.updates);
+            add(counts.changes, counters.changes);
+            add(counts.sleepTransitions, counters.sleepTransitions);
+            add(counts.edgeSnaps, counters.edgeSnaps);
+            add(counts.boundClamps, counters.boundClamps);
+            add(counts.suppressedSamples, counters.suppressedSamples);
+            add(counts.suppressionBreakthroughs, counters.suppressionBreakthroughs);
+            pending[filter] = FilterCounters();
+        }
+    }
+
+    static Slot *threadSlot()
+    {
+        // only the first call of a thread takes the lock
+        static thread_local Slot *slot = nullptr;
+        if (!slot)
+        {
+            slot = claimSlot();
+        }
+        return slot;
+    }
+
+    static Slot *claimSlot()
+    {
+        Registry &registry = Registry::instance();
+        Slot *slot;
+        {
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            if (registry.freeSlots.empty())
+            {
+                registry.slots.emplace_back(new Slot());
+                slot = registry.slots.back().get();
+            }
+            else
+            {
+                slot = registry.freeSlots.back();
+                registry.freeSlots.pop_back();
+            }
+        }
+
+        static thread_local SlotRelease release = { nullptr };
+        release.slot = slot;
+        return slot;
+    }
+};
+
+#endif
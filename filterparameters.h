@@ -0,0 +1,142 @@
+#ifndef FILTER_PARAMETERS_H
+#define FILTER_PARAMETERS_H
+
+#include <stdlib.h>
+#include <string>
+
+#include "emanoisefilter.h"
+#include "simplenoisefilter.h"
+
+/**
+ * The filter settings exposed by the GUI, with the GUI's defaults,
+ * so that the command line tools filter exactly like the tester does.
+ */
+struct FilterParameters
+{
+    FilterParameters():
+        filtersEnabled(true),
+        lowerBound(0),
+        upperBound(1024),
+        emaActivityThreshold(10),
+        snapMultiplier(0.01),
+        sleepEnabled(true),
+        edgeSnapEnabled(true),
+        simpleActivityThreshold(10),
+        suppressionCount(5)
+    {
+    }
+
+    bool filtersEnabled;
+
+    int lowerBound;
+    int upperBound;
+    int emaActivityThreshold;
+    double snapMultiplier;
+    bool sleepEnabled;
+    bool edgeSnapEnabled;
+
+    int simpleActivityThreshold;
+    int suppressionCount;
+
+    template<class T, class Real>
+    void configure(EMANoiseFilter<T, Real> &filter) const
+    {
+        filter.setEnabled(filtersEnabled);
+        filter.setLowerBound(lowerBound);
+        filter.setUpperBound(upperBound);
+        filter.setActivityThreshold(emaActivityThreshold);
+        filter.setSnapMultiplier(snapMultiplier);
+        filter.setSleepEnabled(sleepEnabled);
+        filter.setEdgeSnapEnabled(edgeSnapEnabled);
+    }
+
+    template<class T, class Real>
+    void configure(SimpleNoiseFilter<T, Real> &filter) const
+    {
+        filter.setEnabled(filtersEnabled);
+        filter.setActivityThreshold(simpleActivityThreshold);
+        filter.setSuppressionCount(suppressionCount);
+    }
+
+    /**
+     * @brief parseOption sets one of the parameters from a command line option
+     * @param option the option, e.g. "--lower-bound"
+     * @param value the value following the option, or nullptr if there is none
+     * @param consumedValue set to true when value was used by the option
+     * @return false if option isn't a filter parameter
+     */
+    bool parseOption(const std::string &option, const char *value, bool *consumedValue)
+    {
+        *consumedValue = false;
+
+        if (option == "--no-filters")
+        {
+            filtersEnabled = false;
+            return true;
+        }
+        if (option == "--no-sleep")
+        {
+            sleepEnabled = false;
+            return true;
+        }
+        if (option == "--no-edge-snap")
+        {
+            edgeSnapEnabled = false;
+            return true;
+        }
+
+        if (!value)
+        {
+            return false;
+        }
+
+        *consumedValue = true;
+        if (option == "--lower-bound")
+        {
+            lowerBound = atoi(value);
+        }
+        else if (option == "--upper-bound")
+        {
+            upperBound = atoi(value);
+        }
+        else if (option == "--ema-threshold")
+        {
+            emaActivityThreshold = atoi(value);
+        }
+        else if (option == "--snap-multiplier")
+        {
+            snapMultiplier = atof(value);
+        }
+        else if (option == "--simple-threshold")
+        {
+            simpleActivityThreshold = atoi(value);
+        }
+        else if (option == "--suppression-count")
+        {
+            suppressionCount = atoi(value);
+        }
+        else
+        {
+            *consumedValue = false;
+            return false;
+        }
+
+        return true;
+    }
+
+    static const char *usage()
+    {
+        return "Filter parameters (defaults are the same as the GUI):\n"
+               "  --lower-bound N         EMA filter lower bound (0)\n"
+               "  --upper-bound N         EMA filter upper bound (1024)\n"
+               "  --ema-threshold N       EMA filter activity threshold (10)\n"
+               "  --snap-multiplier X     EMA filter snap multiplier (0.01)\n"
+               "  --no-sleep              disable EMA filter sleeping\n"
+               "  --no-edge-snap          disable EMA filter snapping to the bounds\n"
+               "  --simple-threshold N    simple filter activity threshold (10)\n"
+               "  --suppression-count N   simple filter suppression count (5)\n"
+               "  --no-filters            pass the input through unfiltered\n";
+    }
+};
+
+#endif
@@ -0,0 +1,452 @@
+#include "filterpipeline.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Polls of empty rings before an idle thread starts yielding its core
+const int SpinCount = 1000;
+
+void increment(std::atomic<uint64_t> &counter, uint64_t n)
+{
+    // only the owning thread writes the counter, so it doesn't need an atomic add
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+int latencyBucket(uint64_t latency)
+{
+    int bucket = 0;
+    while (latency > 1 && bucket < 63)
+    {
+        latency >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+uint64_t latencyPercentile(const std::vector<uint64_t> &counts, uint64_t total, double fraction)
+{
+    const uint64_t rank = static_cast<uint64_t>(total*fraction);
+    uint64_t count = 0;
+    for (size_t bucket = 0; bucket < counts.size(); ++bucket)
+    {
+        count += counts[bucket];
+        if (count > rank)
+        {
+            return bucket < 63 ? (uint64_t(2) << bucket) - 1 : UINT64_MAX;
+        }
+    }
+    return 0;
+}
+
+}
+
+FilterPipeline::FilterPipeline(const Configuration &configuration, const Sink &sink):
+    mConfiguration(configuration),
+    mSink(sink),
+    mStopping(false),
+    mRunningWorkerCount(0),
+    mStartTime(0),
+    mStopTime(0),
+    mRestoredCount(0)
+{
+    mConfiguration.producerCount = std::max(1u, mConfiguration.producerCount);
+    mConfiguration.workerCount = std::max(1u, mConfiguration.workerCount);
+    mConfiguration.sinkCount = std::max(1u, std::min(mConfiguration.sinkCount, mConfiguration.workerCount));
+
+    const FilterParameters &parameters = mConfiguration.parameters;
+
+    for (unsigned i = 0; i < mConfiguration.workerCount; ++i)
+    {
+        std::unique_ptr<Worker> worker(new Worker);
+        for (uint32_t channel = i; channel < mConfiguration.channelCount; channel += mConfiguration.workerCount)
+        {
+            worker->emaFilters.push_back(EMANoiseFilter<int>(parameters.lowerBound,
+                                                             parameters.upperBound,
+                                                             parameters.sleepEnabled,
+                                                             parameters.snapMultiplier));
+            worker->simpleFilters.push_back(SimpleNoiseFilter<int>(parameters.simpleActivityThreshold,
+                                                                   parameters.suppressionCount));
+            parameters.configure(worker->emaFilters.back());
+            parameters.configure(worker->simpleFilters.back());
+        }
+
+        worker->output.reset(new SpscRingBuffer<PipelineOutput>(mConfiguration.queueCapacity));
+        worker->filteredCount = 0;
+        worker->stallCount = 0;
+        mWorkers.push_back(std::move(worker));
+    }
+
+    for (unsigned i = 0; i < mConfiguration.producerCount; ++i)
+    {
+        std::unique_ptr<Producer> producer(new Producer);
+        for (unsigned j = 0; j < mConfiguration.workerCount; ++j)
+        {
+            mInputs.emplace_back(new SpscRingBuffer<PipelineSample>(mConfiguration.queueCapacity));
+            producer->mRings.push_back(mInputs.back().get());
+        }
+
+        producer->mChannelCount = mConfiguration.channelCount;
+        producer->mPushedCount = 0;
+        producer->mStallCount = 0;
+        producer->mRejectedCount = 0;
+        mProducers.push_back(std::move(producer));
+    }
+
+    for (unsigned i = 0; i < mConfiguration.sinkCount; ++i)
+    {
+        std::unique_ptr<SinkThread> sinkThread(new SinkThread);
+        for (unsigned j = i; j < mConfiguration.workerCount; j += mConfiguration.sinkCount)
+        {
+            sinkThread->inputs.push_back(mWorkers[j]->output.get());
+        }
+
+        sinkThread->consumedCount = 0;
+        sinkThread->latencySum = 0;
+        sinkThread->maximumLatency = 0;
+        for (std::atomic<uint64_t> &count : sinkThread->latencyCounts)
+        {
+            count = 0;
+        }
+        mSinks.push_back(std::move(sinkThread));
+    }
+
+    if (!mConfiguration.stateFileName.empty())
+    {
+        restore();
+        mCheckpointer.reset(new FilterCheckpointer<int>(mConfiguration.stateFileName,
+                                                         mConfiguration.channelCount,
+                                                         mConfiguration.workerCount));
+    }
+}
+
+FilterPipeline::~FilterPipeline()
+{
+    stop();
+}
+
+void FilterPipeline::start()
+{
+    mStopping = false;
+    mRunningWorkerCount = mConfiguration.workerCount;
+    mStartTime = now();
+    mStopTime = 0;
+
+    for (unsigned i = 0; i < mWorkers.size(); ++i)
+    {
+        mWorkers[i]->thread = std::thread(&FilterPipeline::work, this, i);
+    }
+
+    for (unsigned i = 0; i < mSinks.size(); ++i)
+    {
+        mSinks[i]->thread = std::thread(&FilterPipeline::sink, this, i);
+    }
+
+    if (mCheckpointer && mConfiguration.checkpointInterval > 0)
+    {
+        mCheckpointer->start(std::chrono::milliseconds(mConfiguration.checkpointInterval));
+    }
+}
+
+void FilterPipeline::stop()
+{
+    if (mWorkers.empty() || !mWorkers[0]->thread.joinable())
+    {
+        return;
+    }
+
+    mStopping.store(true, std::memory_order_release);
+
+    for (const std::unique_ptr<Worker> &worker : mWorkers)
+    {
+        worker->thread.join();
+    }
+
+    for (const std::unique_ptr<SinkThread> &sinkThread : mSinks)
+    {
+        sinkThread->thread.join();
+    }
+
+    mStopTime = now();
+
+    if (mCheckpointer)
+    {
+        // the workers are gone, so this thread can capture the final state of all channels itself
+        mCheckpointer->stop();
+        for (unsigned i = 0; i < mWorkers.size(); ++i)
+        {
+            capture(i);
+        }
+
+        if (!mCheckpointer->write())
+        {
+            mStateErrorString = mCheckpointer->errorString();
+        }
+    }
+}
+
+FilterPipeline::Statistics FilterPipeline::statistics() const
+{
+    Statistics statistics = Statistics();
+
+    for (const std::unique_ptr<Producer> &producer : mProducers)
+    {
+        statistics.pushedCount += producer->mPushedCount.load(std::memory_order_relaxed);
+        statistics.producerStallCount += producer->mStallCount.load(std::memory_order_relaxed);
+        statistics.rejectedCount += producer->mRejectedCount.load(std::memory_order_relaxed);
+    }
+
+    for (const std::unique_ptr<Worker> &worker : mWorkers)
+    {
+        statistics.filteredCount += worker->filteredCount.load(std::memory_order_relaxed);
+        statistics.workerStallCount += worker->stallCount.load(std::memory_order_relaxed);
+    }
+
+    uint64_t latencySum = 0;
+    std::vector<uint64_t> latencyCounts(LatencyBucketCount);
+    for (const std::unique_ptr<SinkThread> &sinkThread : mSinks)
+    {
+        statistics.consumedCount += sinkThread->consumedCount.load(std::memory_order_relaxed);
+        statistics.maximumLatency = std::max(statistics.maximumLatency,
+                                             sinkThread->maximumLatency.load(std::memory_order_relaxed));
+        latencySum += sinkThread->latencySum.load(std::memory_order_relaxed);
+        for (int i = 0; i < LatencyBucketCount; ++i)
+        {
+            latencyCounts[i] += sinkThread->latencyCounts[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t latencyCount = 0;
+    for (uint64_t count : latencyCounts)
+    {
+        latencyCount += count;
+    }
+
+    statistics.restoredCount = mRestoredCount;
+    statistics.checkpointCount = mCheckpointer ? mCheckpointer->writtenCount() : 0;
+
+    if (mStartTime)
+    {
+        statistics.seconds = ((mStopTime ? mStopTime : now()) - mStartTime)*1e-9;
+    }
+    if (latencyCount)
+    {
+        statistics.meanLatency = static_cast<double>(latencySum)/latencyCount;
+        statistics.medianLatency = latencyPercentile(latencyCounts, latencyCount, 0.5);
+        statistics.p99Latency = latencyPercentile(latencyCounts, latencyCount, 0.99);
+    }
+
+    return statistics;
+}
+
+uint64_t FilterPipeline::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool FilterPipeline::pinCurrentThread(unsigned cpu)
+{
+#if defined(__linux__)
+    const unsigned cpuCount = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu % cpuCount, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+void FilterPipeline::pin(unsigned offset)
+{
+    if (mConfiguration.pinThreads)
+    {
+        pinCurrentThread(mConfiguration.firstCpu + offset);
+    }
+}
+
+void FilterPipeline::restore()
+{
+    // no state file yet is the normal first start, not worth an error
+    if (access(mConfiguration.stateFileName.c_str(), F_OK) != 0)
+    {
+        return;
+    }
+
+    FilterStateReader reader;
+    if (!reader.open(mConfiguration.stateFileName))
+    {
+        mStateErrorString = reader.errorString();
+        return;
+    }
+
+    const EMANoiseFilter<int>::Snapshot *emaSnapshots = reader.emaSnapshots<int>();
+    const SimpleNoiseFilter<int>::Snapshot *simpleSnapshots = reader.simpleSnapshots<int>();
+    if (!emaSnapshots || !simpleSnapshots)
+    {
+        mStateErrorString = mConfiguration.stateFileName + ": the state was saved by an incompatible build";
+        return;
+    }
+
+    const unsigned workerCount = mConfiguration.workerCount;
+    const uint64_t count = std::min<uint64_t>(std::min(reader.header().emaCount, reader.header().simpleCount),
+                                              mConfiguration.channelCount);
+    for (uint64_t channel = 0; channel < count; ++channel)
+    {
+        Worker &worker = *mWorkers[channel % workerCount];
+        worker.emaFilters[channel/workerCount].restore(emaSnapshots[channel]);
+        worker.simpleFilters[channel/workerCount].restore(simpleSnapshots[channel]);
+    }
+
+    mRestoredCount = count;
+}
+
+void FilterPipeline::capture(unsigned index)
+{
+    Worker &worker = *mWorkers[index];
+    const unsigned workerCount = mConfiguration.workerCount;
+    for (size_t i = 0; i < worker.emaFilters.size(); ++i)
+    {
+        mCheckpointer->capture(i*workerCount + index, worker.emaFilters[i], worker.simpleFilters[i]);
+    }
+}
+
+void FilterPipeline::work(unsigned index)
+{
+    pin(index);
+
+    Worker &worker = *mWorkers[index];
+    const unsigned workerCount = mConfiguration.workerCount;
+    PipelineSample samples[BatchSize];
+    PipelineOutput outputs[BatchSize];
+    int idleCount = 0;
+
+    for (;;)
+    {
+        // read before polling, so that an empty pass after stop() was called means everything has been filtered
+        const bool stopping = mStopping.load(std::memory_order_acquire);
+        bool idle = true;
+
+        if (mCheckpointer && mCheckpointer->pending(index))
+        {
+            capture(index);
+            mCheckpointer->captured(index);
+        }
+
+        for (unsigned producer = 0; producer < mProducers.size(); ++producer)
+        {
+            SpscRingBuffer<PipelineSample> &input = *mInputs[producer*workerCount + index];
+            const size_t n = input.pop(samples, BatchSize);
+            if (n == 0)
+            {
+                continue;
+            }
+            idle = false;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                const PipelineSample &sample = samples[i];
+                const uint32_t channel = sample.channel/workerCount;
+                outputs[i].channel = sample.channel;
+                outputs[i].emaValue = worker.emaFilters[channel].update(sample.value);
+                outputs[i].simpleValue = worker.simpleFilters[channel].update(sample.value);
+                outputs[i].timestamp = sample.timestamp;
+            }
+
+            // the per-value updates above only count into the thread
+            FilterInstrumentation::flush();
+
+            size_t pushed = worker.output->push(outputs, n);
+            if (pushed < n)
+            {
+                increment(worker.stallCount, 1);
+                while (pushed < n)
+                {
+                    std::this_thread::yield();
+                    pushed += worker.output->push(outputs + pushed, n - pushed);
+                }
+            }
+
+            increment(worker.filteredCount, n);
+        }
+
+        if (!idle)
+        {
+            idleCount = 0;
+        }
+        else if (stopping)
+        {
+            break;
+        }
+        else if (++idleCount > SpinCount)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    mRunningWorkerCount.fetch_sub(1, std::memory_order_release);
+}
+
+void FilterPipeline::sink(unsigned index)
+{
+    pin(mConfiguration.workerCount + index);
+
+    SinkThread &sinkThread = *mSinks[index];
+    PipelineOutput outputs[BatchSize];
+    int idleCount = 0;
+
+    for (;;)
+    {
+        const bool stopping = mRunningWorkerCount.load(std::memory_order_acquire) == 0;
+        bool idle = true;
+
+        for (SpscRingBuffer<PipelineOutput> *input : sinkThread.inputs)
+        {
+            const size_t n = input->pop(outputs, BatchSize);
+            if (n == 0)
+            {
+                continue;
+            }
+            idle = false;
+
+            mSink(outputs, n, index);
+
+            const uint64_t time = now();
+            uint64_t latencySum = 0;
+            uint64_t maximumLatency = sinkThread.maximumLatency.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint64_t latency = time - outputs[i].timestamp;
+                latencySum += latency;
+                maximumLatency = std::max(maximumLatency, latency);
+                increment(sinkThread.latencyCounts[latencyBucket(latency)], 1);
+            }
+
+            increment(sinkThread.latencySum, latencySum);
+            sinkThread.maximumLatency.store(maximumLatency, std::memory_order_relaxed);
+            increment(sinkThread.consumedCount, n);
+        }
+
+        if (!idle)
+        {
+            idleCount = 0;
+        }
+        else if (stopping)
+        {
+            break;
+        }
+        else if (++idleCount > SpinCount)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,277 @@
+#ifndef FILTER_PIPELINE_H
+#define FILTER_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "emanoisefilter.h"
+#include "filterparameters.h"
+#include "filterstate.h"
+#include "simplenoisefilter.h"
+#include "spscringbuffer.h"
+
+struct PipelineSample
+{
+    uint32_t channel;
+    int32_t value;
+    uint64_t timestamp;     // FilterPipeline::now() when the sample was pushed
+};
+
+struct PipelineOutput
+{
+    uint32_t channel;
+    int32_t emaValue;
+    int32_t simpleValue;
+    uint64_t timestamp;     // of the input sample
+};
+
+/**
+ * Runs the EMA and simple noise filters over many channels as a streaming service:
+ * producers -> channel sharded filter workers -> sinks.
+ *
+ * Every producer has an SpscRingBuffer to every worker, and every worker one to its sink (worker % sinkCount),
+ * so each ring has exactly one writer and one reader and nothing on the way from a producer to a sink takes a lock.
+ * Channel c is filtered by worker c % workerCount, which owns the filters of its channels outright.
+ * The rings are bounded: a producer that gets ahead of the workers spins until there is room, and counts a stall.
+ * Samples of one channel stay in order as long as the channel is only pushed by one producer.
+ *
+ * With a stateFileName, the filters start from the state saved in that file, if there is one, instead of from scratch,
+ * are checkpointed to it every checkpointInterval while the pipeline runs and saved to it once more by stop().
+ *
+ * Usage: construct, start(), push from the producer threads through producer(i), and stop()
+ * once the producers are done, which returns after everything pushed has reached the sinks.
+ */
+class FilterPipeline
+{
+  public:
+    struct Configuration
+    {
+        Configuration():
+            channelCount(1),
+            producerCount(1),
+            workerCount(1),
+            sinkCount(1),
+            queueCapacity(4096),
+            pinThreads(false),
+            firstCpu(0),
+            checkpointInterval(1000)
+        {
+        }
+
+        uint32_t channelCount;
+        unsigned producerCount;
+        unsigned workerCount;
+        unsigned sinkCount;
+        size_t queueCapacity;   // per ring, rounded up to a power of two
+        bool pinThreads;        // pin the workers and then the sinks to consecutive CPUs from firstCpu
+        unsigned firstCpu;
+        FilterParameters parameters;
+        std::string stateFileName;      // empty for no warm start and no checkpoints
+        unsigned checkpointInterval;    // in milliseconds, 0 to only save the state in stop()
+    };
+
+    /**
+     * @brief Sink called on the sink thread with each batch of filtered samples
+     */
+    typedef std::function<void(const PipelineOutput *outputs, size_t n, unsigned sink)> Sink;
+
+    struct Statistics
+    {
+        uint64_t pushedCount;           // samples pushed by the producers
+        uint64_t filteredCount;         // samples filtered by the workers
+        uint64_t consumedCount;         // samples handed to the sinks
+        uint64_t producerStallCount;    // times a producer found its ring full
+        uint64_t rejectedCount;         // samples the producers dropped because their channel isn't below channelCount
+        uint64_t workerStallCount;      // times a worker found its sink's ring full
+        double seconds;                 // since start()
+        double meanLatency;             // push to sink, in nanoseconds
+        uint64_t medianLatency;         // upper bound, the latencies are counted in power of two buckets
+        uint64_t p99Latency;
+        uint64_t maximumLatency;
+        uint64_t restoredCount;         // channels restored from the state file
+        uint64_t checkpointCount;       // state files written
+    };
+
+    class Producer
+    {
+      public:
+        /**
+         * @brief push queues a sample, spinning while the worker's ring is full
+         * @return false if the channel isn't below channelCount, the sample is dropped then
+         */
+        bool push(uint32_t channel, int32_t value)
+        {
+            const PipelineSample sample = { channel, value, now() };
+            return push(sample);
+        }
+
+        /**
+         * @brief push queues n samples of the same timestamp
+         * @return the number of samples queued, the samples of channels that aren't below channelCount are dropped
+         */
+        size_t push(const uint32_t *channels, const int32_t *values, size_t n)
+        {
+            const uint64_t timestamp = now();
+            size_t queued = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                const PipelineSample sample = { channels[i], values[i], timestamp };
+                queued += push(sample);
+            }
+            return queued;
+        }
+
+        bool push(const PipelineSample &sample)
+        {
+            // the worker indexes its filters with the channel
+            if (sample.channel >= mChannelCount)
+            {
+                mRejectedCount.store(mRejectedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            SpscRingBuffer<PipelineSample> &ring = *mRings[sample.channel % mRings.size()];
+            if (!ring.push(sample))
+            {
+                mStallCount.store(mStallCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                while (!ring.push(sample))
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            mPushedCount.store(mPushedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+      private:
+        friend class FilterPipeline;
+
+        // one per worker, owned by the pipeline
+        std::vector<SpscRingBuffer<PipelineSample> *> mRings;
+        uint32_t mChannelCount;
+
+        // only written by the producer thread, atomic so that statistics() can read them while it runs
+        std::atomic<uint64_t> mPushedCount;
+        std::atomic<uint64_t> mStallCount;
+        std::atomic<uint64_t> mRejectedCount;
+        char mPadding[64];
+    };
+
+    FilterPipeline(const Configuration &configuration, const Sink &sink);
+    ~FilterPipeline();
+
+    FilterPipeline(const FilterPipeline &) = delete;
+    FilterPipeline &operator=(const FilterPipeline &) = delete;
+
+    const Configuration &configuration() const
+    {
+        return mConfiguration;
+    }
+
+    /**
+     * @brief start starts the worker and sink threads
+     */
+    void start();
+
+    /**
+     * @brief stop waits until all the pushed samples reached the sinks and stops the threads.
+     * Call it after the producers stopped pushing.
+     */
+    void stop();
+
+    /**
+     * @brief producer
+     * @return the producer index, to be used from one thread only
+     */
+    Producer &producer(unsigned index)
+    {
+        return *mProducers[index];
+    }
+
+    /**
+     * @brief statistics can be called while the pipeline is running
+     */
+    Statistics statistics() const;
+
+    /**
+     * @brief now
+     * @return the steady clock in nanoseconds, the time base of the sample timestamps
+     */
+    static uint64_t now();
+
+    /**
+     * @brief pinCurrentThread restricts the calling thread to one CPU, e.g. to pin the producers
+     * @return false if that isn't supported or failed
+     */
+    static bool pinCurrentThread(unsigned cpu);
+
+    /**
+     * @brief stateErrorString
+     * @return why the state file couldn't be read or written last, empty if it could
+     */
+    const std::string &stateErrorString() const
+    {
+        return mStateErrorString;
+    }
+
+  private:
+    static const size_t BatchSize = 256;
+    static const int LatencyBucketCount = 64;
+
+    struct Worker
+    {
+        std::vector<EMANoiseFilter<int>> emaFilters;
+        std::vector<SimpleNoiseFilter<int>> simpleFilters;
+        std::unique_ptr<SpscRingBuffer<PipelineOutput>> output;
+        std::thread thread;
+
+        std::atomic<uint64_t> filteredCount;
+        std::atomic<uint64_t> stallCount;
+        char padding[64];
+    };
+
+    struct SinkThread
+    {
+        std::vector<SpscRingBuffer<PipelineOutput> *> inputs;
+        std::thread thread;
+
+        std::atomic<uint64_t> consumedCount;
+        std::atomic<uint64_t> latencySum;
+        std::atomic<uint64_t> maximumLatency;
+        std::atomic<uint64_t> latencyCounts[LatencyBucketCount];
+        char padding[64];
+    };
+
+    void work(unsigned index);
+    void sink(unsigned index);
+    void pin(unsigned offset);
+    void restore();
+    void capture(unsigned index);
+
+    Configuration mConfiguration;
+    Sink mSink;
+
+    std::vector<std::unique_ptr<SpscRingBuffer<PipelineSample>>> mInputs;  // producer*workerCount + worker
+    std::vector<std::unique_ptr<Producer>> mProducers;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::vector<std::unique_ptr<SinkThread>> mSinks;
+
+    std::atomic<bool> mStopping;
+    std::atomic<unsigned> mRunningWorkerCount;
+    uint64_t mStartTime;
+    uint64_t mStopTime;
+
+    std::unique_ptr<FilterCheckpointer<int>> mCheckpointer;
+    std::string mStateErrorString;
+    uint64_t mRestoredCount;
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "filterresponse.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "emanoisefilter.h"
+#include "simplenoisefilter.h"
+#include "workstealingpool.h"
+
+namespace {
+
+/**
+ * @return the first sample of the window at which values has moved at least half of size away from start, or -1
+ */
+long halfwayIndex(const int *values, size_t n, int start, int size)
+{
+    const int direction = size < 0 ? -1 : 1;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (2*static_cast<long>(values[i] - start)*direction >= static_cast<long>(size)*direction)
+        {
+            return static_cast<long>(i);
+        }
+    }
+    return -1;
+}
+
+EMANoiseFilter<int> makeFilter(const FilterParameters &parameters, const EMANoiseFilter<int> *)
+{
+    EMANoiseFilter<int> filter(parameters.lowerBound, parameters.upperBound);
+    parameters.configure(filter);
+    return filter;
+}
+
+SimpleNoiseFilter<int> makeFilter(const FilterParameters &parameters, const SimpleNoiseFilter<int> *)
+{
+    SimpleNoiseFilter<int> filter(parameters.simpleActivityThreshold, parameters.suppressionCount);
+    parameters.configure(filter);
+    return filter;
+}
+
+}
+
+std::string Stimulus::name() const
+{
+    char name[64];
+    switch (type)
+    {
+    case Step:
+        snprintf(name, sizeof(name), "step %+d", size);
+        break;
+    case Ramp:
+        snprintf(name, sizeof(name), "ramp %+d/%d", size, riseLength);
+        break;
+    case NoiseFloor:
+        snprintf(name, sizeof(name), "noise %g", noiseAmplitude);
+        break;
+    }
+    return name;
+}
+
+FilterCharacterization::FilterCharacterization(const std::vector<Stimulus> &stimuli,
+                                               const CharacterizationSettings &settings,
+                                               const FilterParameters &parameters):
+    mStimuli(stimuli),
+    mSettings(settings),
+    mParameters(parameters),
+    mInputs(stimuli.size()),
+    mTruths(stimuli.size())
+{
+    const size_t runLength = this->runLength();
+    std::vector<int> noise(runLength);
+
+    for (size_t s = 0; s < mStimuli.size(); ++s)
+    {
+        const Stimulus &stimulus = mStimuli[s];
+        std::vector<int> &inputs = mInputs[s];
+        std::vector<int> &truths = mTruths[s];
+        inputs.resize(runLength*mSettings.runCount);
+        truths.resize(runLength*mSettings.runCount);
+
+        std::vector<int> truth(runLength, mSettings.level);
+        if (stimulus.type != Stimulus::NoiseFloor)
+        {
+            const size_t riseLength = stimulus.type == Stimulus::Ramp ? std::max(1, stimulus.riseLength) : 1;
+            for (size_t i = 0; i < mSettings.windowLength; ++i)
+            {
+                const double progress = std::min<double>(1.0, static_cast<double>(i + 1)/riseLength);
+                truth[mSettings.preRollLength + i] = mSettings.level + static_cast<int>(lround(stimulus.size*progress));
+            }
+        }
+
+        // the same noise sequences for every stimulus, seeded per run
+        SignalGenerator generator(mSettings.seed);
+        generator.setShape(SignalGenerator::Shape::Constant);
+        generator.setNoise(mSettings.noise);
+        generator.setNoiseAmplitude(stimulus.noiseAmplitude);
+
+        for (size_t run = 0; run < mSettings.runCount; ++run)
+        {
+            generator.setSeed(mSettings.seed + run);
+            generator.generate(noise.data(), runLength);
+
+            for (size_t i = 0; i < runLength; ++i)
+            {
+                inputs[run*runLength + i] = truth[i] + noise[i];
+                truths[run*runLength + i] = truth[i];
+            }
+        }
+    }
+}
+
+std::vector<ResponseResult> FilterCharacterization::run(const std::vector<SweepConfiguration> &configurations, WorkStealingPool &pool) const
+{
+    const size_t stimulusCount = mStimuli.size();
+    std::vector<ResponseResult> results(configurations.size()*stimulusCount);
+    std::vector<std::vector<int>> scratch(pool.threadCount());
+
+    pool.run(results.size(), 1, [&](size_t begin, size_t end, unsigned worker) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            results[i].configuration = configurations[i/stimulusCount];
+            results[i].stimulus = i%stimulusCount;
+            results[i].metrics = evaluate(results[i].configuration, results[i].stimulus, scratch[worker]);
+        }
+    });
+
+    return results;
+}
+
+ResponseMetrics FilterCharacterization::evaluate(const SweepConfiguration &configuration, size_t stimulus, std::vector<int> &scratch) const
+{
+    FilterParameters parameters = mParameters;
+    configuration.apply(&parameters);
+
+    if (configuration.filter == SweepConfiguration::EMA)
+    {
+        return measure<EMANoiseFilter<int>>(parameters, stimulus, scratch);
+    }
+
+    return measure<SimpleNoiseFilter<int>>(parameters, stimulus, scratch);
+}
+
+template<class Filter>
+ResponseMetrics FilterCharacterization::measure(const FilterParameters &parameters, size_t stimulus, std::vector<int> &scratch) const
+{
+    const Stimulus &definition = mStimuli[stimulus];
+    const size_t runLength = this->runLength();
+    const size_t preRollLength = mSettings.preRollLength;
+    const size_t n = mSettings.windowLength;
+    const int size = definition.type == Stimulus::NoiseFloor ? 0 : definition.size;
+    const int direction = size < 0 ? -1 : 1;
+    const double tolerance = std::max(1.0, std::max(definition.noiseAmplitude, mSettings.tolerance*abs(size)));
+
+    ResponseMetrics metrics = { 0, true, 0, 0, 0, 0 };
+    double delaySum = 0;
+    size_t delayCount = 0;
+    double varianceSum = 0;
+    uint64_t spuriousChanges = 0;
+
+    scratch.resize(runLength);
+
+    for (size_t run = 0; run < mSettings.runCount; ++run)
+    {
+        const int *input = mInputs[stimulus].data() + run*runLength;
+        const int *truth = mTruths[stimulus].data() + run*runLength + preRollLength;
+        const int *output = scratch.data() + preRollLength;
+
+        // a fresh filter per run, so that runs don't depend on the order they're measured in
+        Filter filter = makeFilter(parameters, static_cast<const Filter *>(nullptr));
+        filter.update(input, scratch.data(), runLength);
+
+        const int start = truth[-1];
+        const int target = truth[n - 1];
+
+        size_t settleIndex = 0;
+        if (size != 0)
+        {
+            settleIndex = n;
+            while (settleIndex > 0 && fabs(output[settleIndex - 1] - target) <= tolerance)
+            {
+                --settleIndex;
+            }
+
+            const long truthHalfway = halfwayIndex(truth, n, start, size);
+            const long outputHalfway = halfwayIndex(output, n, start, size);
+            if (outputHalfway >= 0)
+            {
+                delaySum += outputHalfway - truthHalfway;
+                ++delayCount;
+            }
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                metrics.overshoot = std::max(metrics.overshoot, static_cast<double>(output[i] - target)*direction/abs(size));
+            }
+        }
+
+        const bool settled = settleIndex < n;
+        metrics.settled = metrics.settled && settled;
+        metrics.settlingTime = std::max(metrics.settlingTime, static_cast<double>(settleIndex));
+
+        // once settled, any change of the output is a spurious hasChanged()
+        const size_t quietBegin = settled && size != 0 ? settleIndex : n/2;
+        double sum = 0;
+        double squares = 0;
+        for (size_t i = quietBegin; i < n; ++i)
+        {
+            sum += output[i];
+            squares += static_cast<double>(output[i])*output[i];
+            spuriousChanges += i > quietBegin && output[i] != output[i - 1];
+        }
+
+        const size_t quietLength = n - quietBegin;
+        if (quietLength > 0)
+        {
+            const double mean = sum/quietLength;
+            varianceSum += std::max(0.0, squares/quietLength - mean*mean);
+        }
+    }
+
+    const size_t runCount = std::max<size_t>(mSettings.runCount, 1);
+    metrics.groupDelay = delayCount > 0 ? delaySum/delayCount : std::numeric_limits<double>::quiet_NaN();
+    metrics.jitter = sqrt(varianceSum/runCount);
+    metrics.spuriousChanges = static_cast<double>(spuriousChanges)/runCount;
+    return metrics;
+}
@@ -0,0 +1,145 @@
+#ifndef FILTER_RESPONSE_H
+#define FILTER_RESPONSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "filterparameters.h"
+#include "parametersweep.h"
+#include "signalgenerator.h"
+
+class WorkStealingPool;
+
+/**
+ * A standard input the filters are characterized with.
+ * Every stimulus holds the level for a while, so that the filter has settled, then starts at sample 0 of its window:
+ * Step         jumps by size
+ * Ramp         moves by size linearly over riseLength samples
+ * NoiseFloor   stays at the level, with noiseAmplitude of noise, where any output change is spurious
+ */
+struct Stimulus
+{
+    enum Type
+    {
+        Step,
+        Ramp,
+        NoiseFloor
+    };
+
+    Type type;
+    int size;
+    int riseLength;
+    double noiseAmplitude;
+
+    /**
+     * @brief name
+     * @return e.g. "step +32", "ramp +128/1000" or "noise 5"
+     */
+    std::string name() const;
+};
+
+/**
+ * How a filter responds to one stimulus, over all its runs
+ */
+struct ResponseMetrics
+{
+    double settlingTime;        // worst case samples until the output stays within the tolerance of the final level
+    bool settled;               // false if the output didn't settle within the window in some run
+    double groupDelay;          // mean samples the output crosses halfway after the input does, NaN if it never did
+    double overshoot;           // worst case fraction of the size the output went past the final level
+    double jitter;              // standard deviation of the output once settled
+    double spuriousChanges;     // mean hasChanged() events per run once settled
+};
+
+struct ResponseResult
+{
+    SweepConfiguration configuration;
+    size_t stimulus;
+    ResponseMetrics metrics;
+};
+
+struct CharacterizationSettings
+{
+    CharacterizationSettings():
+        level(256),
+        preRollLength(1000),
+        windowLength(10000),
+        runCount(16),
+        seed(1),
+        noise(SignalGenerator::Noise::Uniform),
+        tolerance(0.05)
+    {
+    }
+
+    int level;                      // level before every stimulus
+    size_t preRollLength;           // samples at the level before the stimulus starts
+    size_t windowLength;            // samples measured from the start of the stimulus
+    size_t runCount;                // runs of every stimulus, each with different noise
+    uint64_t seed;
+    SignalGenerator::Noise noise;
+    double tolerance;               // settling band as a fraction of the size, at least the noise amplitude and 1
+};
+
+/**
+ * Drives the filters with a set of stimuli and measures settling time, group delay, overshoot,
+ * residual jitter and spurious output changes, the numbers the choice between the EMA and the simple filter comes down to.
+ *
+ * The stimuli are generated once and shared by all configurations, which see exactly the same noise,
+ * so that differences between configurations aren't hidden by differences in the noise.
+ * Once settled means from the last sample outside the settling band on,
+ * or over the second half of the window for runs that never settle and for noise floors.
+ */
+class FilterCharacterization
+{
+  public:
+    /**
+     * @param parameters the parameters that aren't characterized, e.g. the bounds and sleep
+     */
+    FilterCharacterization(const std::vector<Stimulus> &stimuli,
+                           const CharacterizationSettings &settings,
+                           const FilterParameters &parameters);
+
+    const std::vector<Stimulus> &stimuli() const
+    {
+        return mStimuli;
+    }
+
+    const CharacterizationSettings &settings() const
+    {
+        return mSettings;
+    }
+
+    /**
+     * @brief run measures every configuration with every stimulus, spread over the workers of the pool
+     * @return the results of the first configuration for every stimulus, then of the second, and so on
+     */
+    std::vector<ResponseResult> run(const std::vector<SweepConfiguration> &configurations, WorkStealingPool &pool) const;
+
+    /**
+     * @brief evaluate measures one configuration with one stimulus
+     * @param scratch holds the filtered samples, resized as needed
+     */
+    ResponseMetrics evaluate(const SweepConfiguration &configuration, size_t stimulus, std::vector<int> &scratch) const;
+
+  private:
+    template<class Filter>
+    ResponseMetrics measure(const FilterParameters &parameters, size_t stimulus, std::vector<int> &scratch) const;
+
+    size_t runLength() const
+    {
+        return mSettings.preRollLength + mSettings.windowLength;
+    }
+
+    std::vector<Stimulus> mStimuli;
+    CharacterizationSettings mSettings;
+    FilterParameters mParameters;
+
+    // runCount runs of runLength() samples per stimulus
+    std::vector<std::vector<int>> mInputs;
+    std::vector<std::vector<int>> mTruths;
+};
+
+#endif
@@ -0,0 +1,33 @@
+# The filters are header only and, like the trace files, don't depend on Qt,
+# so they are shared between the GUI and the command line tools.
+
+INCLUDEPATH += $$PWD
+
+HEADERS += \
+    $$PWD/changeevents.h \
+    $$PWD/decimatingfilter.h \
+    $$PWD/emanoisefilter.h \
+    $$PWD/emanoisefilterarray.h \
+    $$PWD/emanoisefilterbank.h \
+    $$PWD/filterchain.h \
+    $$PWD/filterinstrumentation.h \
+    $$PWD/filterstate.h \
+    $$PWD/fixedpointemanoisefilter.h \
+    $$PWD/fixedpointemanoisefilterbank.h \
+    $$PWD/sampleintervalclock.h \
+    $$PWD/signalgenerator.h \
+    $$PWD/simplenoisefilter.h \
+    $$PWD/simplenoisefilterbank.h \
+    $$PWD/snapcurve.h \
+    $$PWD/staticemanoisefilter.h \
+    $$PWD/tracefile.h
+
+SOURCES += \
+    $$PWD/filterstate.cpp \
+    $$PWD/tracefile.cpp
+
+# The int filter banks use AVX2 when it is enabled (the fixed point bank also SSE4.1), uncomment to build for CPUs that have it.
+#QMAKE_CXXFLAGS += -mavx2
+
+# Uncomment to count what the EMA and simple filters do, see filterinstrumentation.h. Compiled out otherwise.
+#DEFINES += FILTERTESTER_INSTRUMENTATION
@@ -0,0 +1,146 @@
+#include "filterstate.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char StateMagic[8] = { 'F', 'T', 'S', 'T', 'A', 'T', 'E', 0 };
+const uint32_t StateByteOrder = 0x01020304;
+const uint32_t StateVersion = 1;
+
+}
+
+bool writeFilterStateFile(const std::string &fileName,
+                          const FilterStateHeader &header,
+                          const void *emaSnapshots,
+                          const void *simpleSnapshots,
+                          std::string *errorString)
+{
+    FilterStateHeader completeHeader = header;
+    memcpy(completeHeader.magic, StateMagic, sizeof(StateMagic));
+    completeHeader.byteOrder = StateByteOrder;
+    completeHeader.version = StateVersion;
+
+    const std::string temporaryFileName = fileName + ".tmp";
+    FILE *file = fopen(temporaryFileName.c_str(), "wb");
+    if (!file)
+    {
+        *errorString = temporaryFileName + ": " + strerror(errno);
+        return false;
+    }
+
+    const size_t emaSize = header.emaCount*header.emaSnapshotSize;
+    const size_t simpleSize = header.simpleCount*header.simpleSnapshotSize;
+    bool ok = fwrite(&completeHeader, sizeof(completeHeader), 1, file) == 1
+              && (emaSize == 0 || fwrite(emaSnapshots, emaSize, 1, file) == 1)
+              && (simpleSize == 0 || fwrite(simpleSnapshots, simpleSize, 1, file) == 1)
+              && fflush(file) == 0;
+
+    // the data has to be on the disk before the rename, or a crash can leave an empty file under the final name
+    ok = ok && fsync(fileno(file)) == 0;
+    const int error = errno;
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(temporaryFileName.c_str(), fileName.c_str()) != 0)
+    {
+        *errorString = temporaryFileName + ": " + strerror(ok ? errno : error);
+        remove(temporaryFileName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+FilterStateReader::FilterStateReader():
+    mData(nullptr),
+    mSize(0),
+    mSnapshots(nullptr)
+{
+    memset(&mHeader, 0, sizeof(mHeader));
+}
+
+FilterStateReader::~FilterStateReader()
+{
+    close();
+}
+
+bool FilterStateReader::open(const std::string &fileName)
+{
+    close();
+
+    const int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        mErrorString = fileName + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(FilterStateHeader))
+    {
+        mErrorString = fileName + ": not a filter state file";
+        ::close(fd);
+        return false;
+    }
+
+    mSize = status.st_size;
+    mData = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mData == MAP_FAILED)
+    {
+        mData = nullptr;
+        mErrorString = fileName + ": " + strerror(errno);
+        return false;
+    }
+
+    memcpy(&mHeader, mData, sizeof(mHeader));
+
+    // each count against the size left for it by division, a product of the header fields could wrap around and pass
+    uint64_t remaining = mSize - sizeof(FilterStateHeader);
+    auto fits = [&remaining](uint64_t count, uint32_t snapshotSize) {
+        if (count == 0)
+        {
+            return true;
+        }
+        if (snapshotSize == 0 || count > remaining/snapshotSize)
+        {
+            return false;
+        }
+        remaining -= count*snapshotSize;
+        return true;
+    };
+
+    if (memcmp(mHeader.magic, StateMagic, sizeof(StateMagic)) != 0
+        || mHeader.byteOrder != StateByteOrder
+        || mHeader.version != StateVersion
+        || !fits(mHeader.emaCount, mHeader.emaSnapshotSize)
+        || !fits(mHeader.simpleCount, mHeader.simpleSnapshotSize))
+    {
+        mErrorString = fileName + ": not a valid filter state file";
+        close();
+        return false;
+    }
+
+    mSnapshots = static_cast<const char *>(mData) + sizeof(FilterStateHeader);
+    mErrorString.clear();
+    return true;
+}
+
+void FilterStateReader::close()
+{
+    if (mData)
+    {
+        munmap(mData, mSize);
+    }
+
+    mData = nullptr;
+    mSize = 0;
+    mSnapshots = nullptr;
+}
@@ -0,0 +1,321 @@
+#ifndef FILTER_STATE_H
+#define FILTER_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "emanoisefilter.h"
+#include "simplenoisefilter.h"
+#include "tracefile.h"
+
+/**
+ * Filter state file format (.ftstate), all fields in native byte order, like the traces.
+ *
+ * The file starts with a 64 byte FilterStateHeader, followed by emaCount EMANoiseFilter<T>::Snapshot
+ * and then simpleCount SimpleNoiseFilter<T>::Snapshot, one per channel.
+ * The snapshots are stored as they are in memory, so the file is only read back by a build with the same
+ * snapshot layouts, which the sizes in the header check, and restoring thousands of filters is a copy out of the mapping.
+ */
+struct FilterStateHeader
+{
+    char magic[8];                  // "FTSTATE" followed by a 0
+    uint32_t byteOrder;             // 0x01020304 written in native byte order
+    uint32_t version;               // 1
+    uint32_t valueType;             // TraceHeader::SampleType of T
+    uint32_t emaSnapshotSize;
+    uint32_t simpleSnapshotSize;
+    uint32_t reserved;
+    uint64_t emaCount;
+    uint64_t simpleCount;
+    uint64_t sequence;              // counts the checkpoints of the writer
+    uint64_t timestamp;             // written at, in nanoseconds since 1970
+};
+
+static_assert(sizeof(FilterStateHeader) == 64, "FilterStateHeader must stay 64 bytes so that the snapshots are aligned");
+
+/**
+ * @brief writeFilterStateFile writes a state file next to fileName and renames it over fileName once it's complete,
+ * so that a crash while writing leaves the previous state file intact
+ * @return false with errorString set if the file couldn't be written
+ */
+bool writeFilterStateFile(const std::string &fileName,
+                          const FilterStateHeader &header,
+                          const void *emaSnapshots,
+                          const void *simpleSnapshots,
+                          std::string *errorString);
+
+/**
+ * The snapshots of the filters of a number of channels, what a state file holds
+ */
+template<class T>
+struct FilterState
+{
+    typedef typename EMANoiseFilter<T>::Snapshot EMASnapshot;
+    typedef typename SimpleNoiseFilter<T>::Snapshot SimpleSnapshot;
+
+    FilterState():
+        sequence(0)
+    {
+    }
+
+    std::vector<EMASnapshot> ema;
+    std::vector<SimpleSnapshot> simple;
+    uint64_t sequence;
+
+    bool save(const std::string &fileName, std::string *errorString) const
+    {
+        FilterStateHeader header = FilterStateHeader();
+        header.valueType = TraceSampleType<T>::value;
+        header.emaSnapshotSize = sizeof(EMASnapshot);
+        header.simpleSnapshotSize = sizeof(SimpleSnapshot);
+        header.emaCount = ema.size();
+        header.simpleCount = simple.size();
+        header.sequence = sequence;
+        header.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::system_clock::now().time_since_epoch()).count();
+        return writeFilterStateFile(fileName, header, ema.data(), simple.data(), errorString);
+    }
+};
+
+/**
+ * Memory maps a state file for reading. The snapshots point into the mapping until the reader is closed.
+ */
+class FilterStateReader
+{
+  public:
+    FilterStateReader();
+    ~FilterStateReader();
+
+    FilterStateReader(const FilterStateReader &) = delete;
+    FilterStateReader &operator=(const FilterStateReader &) = delete;
+
+    bool open(const std::string &fileName);
+    void close();
+
+    bool isOpen() const { return mData != nullptr; }
+    const std::string &errorString() const { return mErrorString; }
+    const FilterStateHeader &header() const { return mHeader; }
+
+    /**
+     * @brief emaSnapshots
+     * @return header().emaCount snapshots, nullptr if they aren't snapshots of EMANoiseFilter<T> of this build
+     */
+    template<class T>
+    const typename EMANoiseFilter<T>::Snapshot *emaSnapshots() const
+    {
+        return matches<T, typename EMANoiseFilter<T>::Snapshot>(mHeader.emaSnapshotSize)
+               ? reinterpret_cast<const typename EMANoiseFilter<T>::Snapshot *>(mSnapshots)
+               : nullptr;
+    }
+
+    /**
+     * @brief simpleSnapshots
+     * @return header().simpleCount snapshots, nullptr if they aren't snapshots of SimpleNoiseFilter<T> of this build
+     */
+    template<class T>
+    const typename SimpleNoiseFilter<T>::Snapshot *simpleSnapshots() const
+    {
+        return matches<T, typename SimpleNoiseFilter<T>::Snapshot>(mHeader.simpleSnapshotSize)
+               ? reinterpret_cast<const typename SimpleNoiseFilter<T>::Snapshot *>(mSnapshots + mHeader.emaCount*mHeader.emaSnapshotSize)
+               : nullptr;
+    }
+
+  private:
+    template<class T, class Snapshot>
+    bool matches(uint32_t snapshotSize) const
+    {
+        return mData && mHeader.valueType == TraceSampleType<T>::value && snapshotSize == sizeof(Snapshot);
+    }
+
+    FilterStateHeader mHeader;
+    std::string mErrorString;
+    void *mData;
+    size_t mSize;
+    const char *mSnapshots;
+};
+
+/**
+ * Checkpoints the filters of channelCount channels to a state file every interval, without stalling the threads updating them.
+ *
+ * The channels are split between ownerCount threads that each own the filters of their channels, like the workers of a
+ * FilterPipeline. When a checkpoint is due, the checkpointer thread bumps the checkpoint number; every owner notices
+ * it with a relaxed load in its update loop, copies the snapshots of its channels with capture() and calls captured().
+ * Once all owners captured, the checkpointer thread writes the file while the owners carry on,
+ * so an owner only ever spends the time of copying its snapshots, a few ns per channel, and never waits for a lock or the disk.
+ * The channels of one owner are captured at the same point in its stream, those of different owners at nearby points.
+ */
+template<class T>
+class FilterCheckpointer
+{
+  public:
+    FilterCheckpointer(const std::string &fileName, size_t channelCount, unsigned ownerCount):
+        mFileName(fileName),
+        mRequested(0),
+        mStopping(false),
+        mWrittenCount(0)
+    {
+        mState.ema.resize(channelCount);
+        mState.simple.resize(channelCount);
+
+        for (unsigned i = 0; i < std::max(1u, ownerCount); ++i)
+        {
+            mOwners.emplace_back(new Owner);
+            mOwners.back()->captured = 0;
+        }
+    }
+
+    ~FilterCheckpointer()
+    {
+        stop();
+    }
+
+    FilterCheckpointer(const FilterCheckpointer &) = delete;
+    FilterCheckpointer &operator=(const FilterCheckpointer &) = delete;
+
+    /**
+     * @brief start starts requesting a checkpoint every interval
+     */
+    void start(std::chrono::milliseconds interval)
+    {
+        stop();
+        mStopping = false;
+        mThread = std::thread(&FilterCheckpointer::run, this, interval);
+    }
+
+    /**
+     * @brief stop stops the checkpointer thread, abandoning a checkpoint that not all owners captured yet
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mWake.notify_all();
+
+        if (mThread.joinable())
+        {
+            mThread.join();
+        }
+    }
+
+    /**
+     * @brief pending is called by an owner from its update loop
+     * @return true when the owner should capture() its channels and call captured()
+     */
+    bool pending(unsigned owner) const
+    {
+        // acquire, so that the owner's capture() comes after the checkpointer thread wrote the previous checkpoint
+        return mOwners[owner]->captured.load(std::memory_order_relaxed) != mRequested.load(std::memory_order_acquire);
+    }
+
+    void capture(size_t channel, const EMANoiseFilter<T> &ema, const SimpleNoiseFilter<T> &simple)
+    {
+        mState.ema[channel] = ema.snapshot();
+        mState.simple[channel] = simple.snapshot();
+    }
+
+    /**
+     * @brief captured tells the checkpointer thread that the owner's snapshots are complete
+     */
+    void captured(unsigned owner)
+    {
+        mOwners[owner]->captured.store(mRequested.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /**
+     * @brief write writes the captured snapshots right away, e.g. the final state after the owners stopped
+     */
+    bool write()
+    {
+        std::lock_guard<std::mutex> lock(mWriteMutex);
+        ++mState.sequence;
+        if (!mState.save(mFileName, &mErrorString))
+        {
+            return false;
+        }
+        mWrittenCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief writtenCount
+     * @return the number of state files written so far
+     */
+    uint64_t writtenCount() const
+    {
+        return mWrittenCount.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief errorString of the last failed write, only valid while the checkpointer thread isn't running
+     */
+    const std::string &errorString() const
+    {
+        return mErrorString;
+    }
+
+  private:
+    struct Owner
+    {
+        std::atomic<uint64_t> captured;
+        char padding[64];
+    };
+
+    void run(std::chrono::milliseconds interval)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mWake.wait_for(lock, interval, [this] { return mStopping; }))
+        {
+            const uint64_t requested = mRequested.load(std::memory_order_relaxed) + 1;
+            mRequested.store(requested, std::memory_order_release);
+
+            // the owners don't signal, they mustn't take a lock, so poll until all of them captured
+            bool complete = false;
+            while (!complete && !mWake.wait_for(lock, std::chrono::milliseconds(1), [this] { return mStopping; }))
+            {
+                complete = true;
+                for (const std::unique_ptr<Owner> &owner : mOwners)
+                {
+                    complete = complete && owner->captured.load(std::memory_order_acquire) == requested;
+                }
+            }
+
+            if (complete)
+            {
+                lock.unlock();
+                write();
+                lock.lock();
+            }
+        }
+    }
+
+    std::string mFileName;
+    FilterState<T> mState;
+    std::vector<std::unique_ptr<Owner>> mOwners;
+    char mPadding0[64];
+
+    std::atomic<uint64_t> mRequested;
+    char mPadding1[64];
+
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    bool mStopping;
+    std::thread mThread;
+
+    std::mutex mWriteMutex;
+    std::atomic<uint64_t> mWrittenCount;
+    std::string mErrorString;
+};
+
+#endif
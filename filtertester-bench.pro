@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Benchmarks of the filter update hot paths, printed as JSON
+#
+#-------------------------------------------------
+
+TARGET = filtertester-bench
+TEMPLATE = app
+CONFIG += console c++11 thread
+CONFIG -= qt app_bundle
+
+include(filters.pri)
+
+SOURCES += \
+        filtertesterbench.cpp \
+        workstealingpool.cpp
+
+HEADERS += \
+    dirtychannelscheduler.h \
+    filterinputs.h \
+    workstealingpool.h
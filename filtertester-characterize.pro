@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Settling time, lag, overshoot and jitter of the filters
+#
+#-------------------------------------------------
+
+TARGET = filtertester-characterize
+TEMPLATE = app
+CONFIG += console c++11 thread
+CONFIG -= qt app_bundle
+
+include(filters.pri)
+
+SOURCES += \
+        filtertestercharacterize.cpp \
+        filterresponse.cpp \
+        parametersweep.cpp \
+        workstealingpool.cpp
+
+HEADERS += \
+    filterparameters.h \
+    filterresponse.h \
+    parametersweep.h \
+    workstealingpool.h
@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Headless checks, exits non-zero when one fails
+#
+#-------------------------------------------------
+
+TARGET = filtertester-check
+TEMPLATE = app
+CONFIG += console c++11 thread
+CONFIG -= qt app_bundle
+
+include(filters.pri)
+
+SOURCES += \
+        filtertestercheck.cpp \
+        workstealingpool.cpp
+
+HEADERS += \
+    dirtychannelscheduler.h \
+    filterinputs.h \
+    workstealingpool.h
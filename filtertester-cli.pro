@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Headless replay of recorded input traces through the filters
+#
+#-------------------------------------------------
+
+TARGET = filtertester-cli
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= qt app_bundle
+
+include(filters.pri)
+
+SOURCES += \
+        filtertestercli.cpp
+
+HEADERS += \
+    filterparameters.h
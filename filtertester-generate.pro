@@ -0,0 +1,15 @@
+#-------------------------------------------------
+#
+# Reproducible synthetic test signals written to traces
+#
+#-------------------------------------------------
+
+TARGET = filtertester-generate
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= qt app_bundle
+
+include(filters.pri)
+
+SOURCES += \
+        filtertestergenerate.cpp
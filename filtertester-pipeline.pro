@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Streaming pipeline of producers, filter workers and sinks
+#
+#-------------------------------------------------
+
+TARGET = filtertester-pipeline
+TEMPLATE = app
+CONFIG += console c++11 thread
+CONFIG -= qt app_bundle
+
+include(filters.pri)
+
+SOURCES += \
+        filterpipeline.cpp \
+        filtertesterpipeline.cpp
+
+HEADERS += \
+    filterparameters.h \
+    filterpipeline.h \
+    spscringbuffer.h
@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Filter engine fed through shared memory rings by an acquisition process,
+# and a trace replaying stand-in for that process
+#
+#-------------------------------------------------
+
+TARGET = filtertester-shm
+TEMPLATE = app
+CONFIG += console c++11 thread
+CONFIG -= qt app_bundle
+
+include(filters.pri)
+
+SOURCES += \
+        filtertestershm.cpp \
+        sharedmemoryring.cpp
+
+HEADERS += \
+    filterparameters.h \
+    sharedmemoryring.h
+
+# shm_open() is in librt before glibc 2.34
+linux: LIBS += -lrt
@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Parallel parameter sweep over recorded traces
+#
+#-------------------------------------------------
+
+TARGET = filtertester-sweep
+TEMPLATE = app
+CONFIG += console c++11 thread
+CONFIG -= qt app_bundle
+
+include(filters.pri)
+
+SOURCES += \
+        filtertestersweep.cpp \
+        parametersweep.cpp \
+        workstealingpool.cpp
+
+HEADERS += \
+    filterparameters.h \
+    parametersweep.h \
+    workstealingpool.h
@@ -10,7 +10,7 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = filtertester
 TEMPLATE = app
-CONFIG += c++11
+CONFIG += c++11 thread
 
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which has been marked as deprecated (the exact warnings
@@ -23,15 +23,22 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(filters.pri)
 
 SOURCES += \
+        filterworker.cpp \
         main.cpp \
-        mainwindow.cpp
+        mainwindow.cpp \
+        plotwidget.cpp
 
 HEADERS += \
+        filterparameters.h \
+        filterworker.h \
         mainwindow.h \
-    emanoisefilter.h \
-    simplenoisefilter.h
+        minmaxhistory.h \
+        plotwidget.h \
+        spscringbuffer.h \
+        triplebuffer.h
 
 FORMS += \
         mainwindow.ui
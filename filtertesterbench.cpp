@@ -0,0 +1,758 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "decimatingfilter.h"
+#include "dirtychannelscheduler.h"
+#include "emanoisefilter.h"
+#include "emanoisefilterarray.h"
+#include "emanoisefilterbank.h"
+#include "filterchain.h"
+#include "filterinputs.h"
+#include "fixedpointemanoisefilterbank.h"
+#include "simplenoisefilter.h"
+#include "signalgenerator.h"
+#include "simplenoisefilterbank.h"
+#include "staticemanoisefilter.h"
+
+//Measures the filter update hot paths and prints the results as JSON, so that they can be compared across releases.
+
+namespace {
+
+const int LowerBound = 0;
+const int UpperBound = 1024;
+const size_t BankChannelCount = 64;
+const unsigned DecimationFactor = 4;
+const size_t SparseChannelCount = 65536;
+const size_t SparseDirtyCount = SparseChannelCount/100;   // channels getting a sample per tick
+
+template<class T> const char *typeName();
+template<> const char *typeName<int>() { return "int"; }
+template<> const char *typeName<float>() { return "float"; }
+template<> const char *typeName<double>() { return "double"; }
+
+struct Result
+{
+    std::string filter;
+    std::string type;
+    std::string path;
+    int sleepEnabled;      // -1 when the option doesn't apply to the filter
+    int edgeSnapEnabled;
+    std::string input;
+    double nanosecondsPerSample;
+    std::string snapCurve; // empty when it doesn't apply
+    std::string compute;   // the compute type of the filter, empty when it doesn't apply
+};
+
+const SnapCurve SnapCurves[] = { SnapCurve::Exact, SnapCurve::Table, SnapCurve::Newton, SnapCurve::Polynomial };
+
+const char *snapCurveName(SnapCurve curve)
+{
+    switch (curve)
+    {
+    case SnapCurve::Exact:
+        return "exact";
+    case SnapCurve::Table:
+        return "table";
+    case SnapCurve::Newton:
+        return "newton";
+    case SnapCurve::Polynomial:
+        return "polynomial";
+    }
+    return "";
+}
+
+/**
+ * How far an approximate snap curve is from the exact one
+ */
+struct SnapCurveAccuracy
+{
+    SnapCurve curve;
+    double maximumDeviation;
+};
+
+/**
+ * How far FixedPointEMANoiseFilter is from EMANoiseFilter<int>
+ */
+struct Accuracy
+{
+    bool sleepEnabled;
+    bool edgeSnapEnabled;
+    std::string input;
+    double differingFraction;
+    int maximumDifference;
+};
+
+/**
+ * How far a filter computing in float is from the same filter computing in double
+ */
+struct ComputeTypeAccuracy
+{
+    std::string filter;
+    std::string type;
+    int sleepEnabled;      // -1 when the option doesn't apply to the filter
+    std::string input;
+    double differingFraction;
+    double maximumDifference;
+};
+
+struct Options
+{
+    size_t sampleCount;
+    int repetitions;
+};
+
+volatile double checksumSink;
+
+/**
+ * @brief measure runs benchmark repetitions times
+ * @return the fastest run in ns per sample
+ */
+template<class Benchmark>
+double measure(const Options &options, size_t sampleCount, Benchmark benchmark)
+{
+    double best = 0;
+    for (int repetition = 0; repetition < options.repetitions; ++repetition)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        checksumSink = benchmark();
+        const double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        if (repetition == 0 || nanoseconds < best)
+        {
+            best = nanoseconds;
+        }
+    }
+
+    return best/sampleCount;
+}
+
+template<class T>
+EMANoiseFilter<T> makeEMANoiseFilter(bool sleepEnabled, bool edgeSnapEnabled)
+{
+    EMANoiseFilter<T> filter(LowerBound, UpperBound, sleepEnabled);
+    filter.setEdgeSnapEnabled(edgeSnapEnabled);
+    return filter;
+}
+
+template<class T>
+SimpleNoiseFilter<T> makeSimpleNoiseFilter()
+{
+    return SimpleNoiseFilter<T>(10, 5);
+}
+
+template<class Filter, class T>
+double runSingle(Filter filter, const std::vector<T> &input)
+{
+    double checksum = 0;
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        checksum += filter.update(input[i]);
+    }
+    return checksum;
+}
+
+template<class Filter, class T>
+double runBlock(Filter filter, const std::vector<T> &input, std::vector<T> &output)
+{
+    filter.update(input.data(), output.data(), input.size());
+    return output.back();
+}
+
+/**
+ * @brief runAdvance feeds the input as runs of identical values through advance()
+ */
+template<class Filter, class T>
+double runAdvance(Filter filter, const std::vector<T> &input)
+{
+    double checksum = 0;
+    for (size_t i = 0; i < input.size();)
+    {
+        size_t end = i + 1;
+        while (end < input.size() && input[end] == input[i])
+        {
+            ++end;
+        }
+        checksum += filter.advance(input[i], end - i);
+        i = end;
+    }
+    return checksum;
+}
+
+template<class Bank, class T>
+double runBank(Bank bank, const std::vector<T> &frames, std::vector<T> &output)
+{
+    const size_t channelCount = bank.channelCount();
+    for (size_t frame = 0; frame + channelCount <= frames.size(); frame += channelCount)
+    {
+        bank.update(&frames[frame], output.data());
+    }
+    return output.back();
+}
+
+/**
+ * @brief makeFrames generates sampleCount samples as interleaved frames of BankChannelCount channels
+ */
+template<class T>
+std::vector<T> makeFrames(Shape shape, size_t sampleCount)
+{
+    std::vector<T> frames(sampleCount/BankChannelCount*BankChannelCount);
+    for (size_t channel = 0; channel < BankChannelCount; ++channel)
+    {
+        const std::vector<T> channelInput = makeInput<T>(shape, frames.size()/BankChannelCount, channel + 1, LowerBound, UpperBound);
+        for (size_t frame = 0; frame < channelInput.size(); ++frame)
+        {
+            frames[frame*BankChannelCount + channel] = channelInput[frame];
+        }
+    }
+    return frames;
+}
+
+template<class T, bool SleepEnabled, bool EdgeSnapEnabled>
+Result benchmarkStatic(const Options &options, Shape shape, const std::vector<T> &input)
+{
+    // the bounds are valid, so the filter never needs its enabled check
+    const StaticEMANoiseFilter<T, SleepEnabled, EdgeSnapEnabled, true, true> filter(LowerBound, UpperBound);
+    const Result result = { "StaticEMANoiseFilter", typeName<T>(), "single", SleepEnabled, EdgeSnapEnabled, shapeName(shape),
+                            measure(options, input.size(), [&]() { return runSingle(filter, input); }), "exact", "double" };
+    return result;
+}
+
+/**
+ * @brief benchmarkChain times a SimpleNoiseFilter feeding an EMANoiseFilter, as two block updates through a buffer
+ * and as one FilterChain block update
+ */
+template<class T>
+void benchmarkChain(const Options &options, Shape shape, const std::vector<T> &input, std::vector<T> &output, std::vector<Result> &results)
+{
+    std::vector<T> intermediate(input.size());
+
+    for (int sleepEnabled = 0; sleepEnabled < 2; ++sleepEnabled)
+    {
+        const SimpleNoiseFilter<T> simple = makeSimpleNoiseFilter<T>();
+        const EMANoiseFilter<T> ema = makeEMANoiseFilter<T>(sleepEnabled, true);
+        const FilterChain<SimpleNoiseFilter<T>, EMANoiseFilter<T>> chain(simple, ema);
+
+        const Result twoPass = { "SimpleNoiseFilter+EMANoiseFilter", typeName<T>(), "two_pass", sleepEnabled, true, shapeName(shape),
+                                 measure(options, input.size(), [&]() {
+                                     runBlock(simple, input, intermediate);
+                                     return runBlock(ema, intermediate, output);
+                                 }), "exact", "double" };
+        const Result fused = { "FilterChain<SimpleNoiseFilter,EMANoiseFilter>", typeName<T>(), "chain", sleepEnabled, true, shapeName(shape),
+                               measure(options, input.size(), [&]() { return runBlock(chain, input, output); }), "exact", "double" };
+        results.push_back(twoPass);
+        results.push_back(fused);
+    }
+}
+
+/**
+ * @brief benchmarkAdvance times advance() on the runs of identical values of the input.
+ * The scan for the end of the runs is included, as the caller of advance() would have to do it.
+ */
+template<class T>
+void benchmarkAdvance(const Options &options, Shape shape, const std::vector<T> &input, std::vector<Result> &results)
+{
+    for (int sleepEnabled = 0; sleepEnabled < 2; ++sleepEnabled)
+    {
+        const EMANoiseFilter<T> filter = makeEMANoiseFilter<T>(sleepEnabled, true);
+        const Result result = { "EMANoiseFilter", typeName<T>(), "advance", sleepEnabled, true, shapeName(shape),
+                                measure(options, input.size(), [&]() { return runAdvance(filter, input); }), "exact", "double" };
+        results.push_back(result);
+    }
+
+    const SimpleNoiseFilter<T> filter = makeSimpleNoiseFilter<T>();
+    const Result result = { "SimpleNoiseFilter", typeName<T>(), "advance", -1, -1, shapeName(shape),
+                            measure(options, input.size(), [&]() { return runAdvance(filter, input); }), "", "double" };
+    results.push_back(result);
+}
+
+template<class Filter, class T>
+double runDecimating(const Filter &filter, const std::vector<T> &input, std::vector<T> &output)
+{
+    DecimatingFilter<Filter> decimating(filter, DecimationFactor);
+    const size_t n = decimating.update(input.data(), input.size(), output.data());
+    return n > 0 ? output[n - 1] : 0;
+}
+
+/**
+ * @brief benchmarkDecimating times the filters running at 1/DecimationFactor of the input rate, in ns per input sample
+ */
+template<class T>
+void benchmarkDecimating(const Options &options, Shape shape, const std::vector<T> &input, std::vector<T> &output, std::vector<Result> &results)
+{
+    const std::string path = "decimated_" + std::to_string(DecimationFactor);
+
+    for (int sleepEnabled = 0; sleepEnabled < 2; ++sleepEnabled)
+    {
+        const EMANoiseFilter<T> filter = makeEMANoiseFilter<T>(sleepEnabled, true);
+        const Result result = { "EMANoiseFilter", typeName<T>(), path, sleepEnabled, true, shapeName(shape),
+                                measure(options, input.size(), [&]() { return runDecimating(filter, input, output); }), "exact", "double" };
+        results.push_back(result);
+    }
+
+    const SimpleNoiseFilter<T> filter = makeSimpleNoiseFilter<T>();
+    const Result result = { "SimpleNoiseFilter", typeName<T>(), path, -1, -1, shapeName(shape),
+                            measure(options, input.size(), [&]() { return runDecimating(filter, input, output); }), "", "double" };
+    results.push_back(result);
+}
+
+/**
+ * @brief benchmarkSnapCurves times the block update with every snap curve.
+ * Sleep is disabled so that the snap curve is evaluated for every sample.
+ */
+template<class T>
+void benchmarkSnapCurves(const Options &options, Shape shape, const std::vector<T> &input, std::vector<T> &output, std::vector<Result> &results)
+{
+    for (SnapCurve curve : SnapCurves)
+    {
+        EMANoiseFilter<T> filter = makeEMANoiseFilter<T>(false, false);
+        filter.setSnapCurve(curve);
+
+        const Result result = { "EMANoiseFilter", typeName<T>(), "block", false, false, shapeName(shape),
+                                measure(options, input.size(), [&]() { return runBlock(filter, input, output); }),
+                                snapCurveName(curve), "double" };
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief runAllChannels goes through every channel per tick and updates those that got a sample
+ */
+template<class Filter, class T>
+double runAllChannels(std::vector<Filter> filters, const std::vector<uint32_t> &channels, const std::vector<T> &input)
+{
+    std::vector<T> values(filters.size());
+    std::vector<unsigned char> pending(filters.size(), 0);
+    double checksum = 0;
+
+    for (size_t tick = 0; tick + SparseDirtyCount <= channels.size(); tick += SparseDirtyCount)
+    {
+        for (size_t i = tick; i < tick + SparseDirtyCount; ++i)
+        {
+            values[channels[i]] = input[i];
+            pending[channels[i]] = 1;
+        }
+
+        for (size_t channel = 0; channel < filters.size(); ++channel)
+        {
+            if (pending[channel])
+            {
+                checksum += filters[channel].update(values[channel]);
+                pending[channel] = 0;
+            }
+        }
+    }
+
+    return checksum;
+}
+
+/**
+ * @brief runDirtyChannels pushes the samples of a tick into a DirtyChannelScheduler and processes the dirty channels
+ */
+template<class Filter, class T>
+double runDirtyChannels(const Filter &filter, const std::vector<uint32_t> &channels, const std::vector<T> &input)
+{
+    DirtyChannelScheduler<Filter> scheduler(SparseChannelCount, filter);
+    double checksum = 0;
+
+    for (size_t tick = 0; tick + SparseDirtyCount <= channels.size(); tick += SparseDirtyCount)
+    {
+        for (size_t i = tick; i < tick + SparseDirtyCount; ++i)
+        {
+            scheduler.push(channels[i], input[i]);
+        }
+
+        scheduler.process();
+        for (uint32_t channel : scheduler.dirtyChannels())
+        {
+            checksum += scheduler.filter(channel).value();
+        }
+    }
+
+    return checksum;
+}
+
+/**
+ * @brief benchmarkSparse times ticks in which 1% of SparseChannelCount random channels get a sample,
+ * going through all channels and through a DirtyChannelScheduler, in ns per sample
+ */
+void benchmarkSparse(const Options &options, std::vector<Result> &results)
+{
+    Xoshiro256 random(1);
+    std::vector<uint32_t> channels(options.sampleCount/SparseDirtyCount*SparseDirtyCount);
+    for (uint32_t &channel : channels)
+    {
+        channel = static_cast<uint32_t>(random.below(SparseChannelCount));
+    }
+    const std::vector<int> input = makeInput<int>(Shape::Steps, channels.size(), 1, LowerBound, UpperBound);
+
+    const EMANoiseFilter<int> ema = makeEMANoiseFilter<int>(true, true);
+    const std::vector<EMANoiseFilter<int>> emaFilters(SparseChannelCount, ema);
+    const SimpleNoiseFilter<int> simple = makeSimpleNoiseFilter<int>();
+    const std::vector<SimpleNoiseFilter<int>> simpleFilters(SparseChannelCount, simple);
+
+    const Result emaAll = { "EMANoiseFilter", "int", "all_channels", true, true, "sparse",
+                            measure(options, channels.size(), [&]() { return runAllChannels(emaFilters, channels, input); }), "exact", "double" };
+    const Result emaDirty = { "DirtyChannelScheduler<EMANoiseFilter>", "int", "dirty_channels", true, true, "sparse",
+                              measure(options, channels.size(), [&]() { return runDirtyChannels(ema, channels, input); }), "exact", "double" };
+    const Result simpleAll = { "SimpleNoiseFilter", "int", "all_channels", -1, -1, "sparse",
+                               measure(options, channels.size(), [&]() { return runAllChannels(simpleFilters, channels, input); }), "", "double" };
+    const Result simpleDirty = { "DirtyChannelScheduler<SimpleNoiseFilter>", "int", "dirty_channels", -1, -1, "sparse",
+                                 measure(options, channels.size(), [&]() { return runDirtyChannels(simple, channels, input); }), "", "double" };
+    results.push_back(emaAll);
+    results.push_back(emaDirty);
+    results.push_back(simpleAll);
+    results.push_back(simpleDirty);
+}
+
+template<class Curve>
+double maximumSnapCurveDeviation()
+{
+    double maximumDeviation = 0;
+    for (int i = 0; i <= 2000000; ++i)
+    {
+        const double x = i*1e-6;
+        maximumDeviation = std::max(maximumDeviation, std::abs(Curve::value(x) - SnapCurveExact::value(x)));
+    }
+    return maximumDeviation;
+}
+
+/**
+ * @brief measureSnapCurves evaluates every approximate snap curve on a dense grid, through and past the saturation at 1
+ */
+std::vector<SnapCurveAccuracy> measureSnapCurves()
+{
+    std::vector<SnapCurveAccuracy> accuracies;
+
+    const SnapCurveAccuracy table = { SnapCurve::Table, maximumSnapCurveDeviation<SnapCurveTable>() };
+    const SnapCurveAccuracy newton = { SnapCurve::Newton, maximumSnapCurveDeviation<SnapCurveNewton>() };
+    const SnapCurveAccuracy polynomial = { SnapCurve::Polynomial, maximumSnapCurveDeviation<SnapCurvePolynomial>() };
+    accuracies.push_back(table);
+    accuracies.push_back(newton);
+    accuracies.push_back(polynomial);
+
+    return accuracies;
+}
+
+template<class T>
+void benchmarkType(const Options &options, std::vector<Result> &results)
+{
+    std::vector<T> output(options.sampleCount);
+    std::vector<T> bankOutput(BankChannelCount);
+
+    for (Shape shape : Shapes)
+    {
+        const std::vector<T> input = makeInput<T>(shape, options.sampleCount, 1, LowerBound, UpperBound);
+        const std::vector<T> frames = makeFrames<T>(shape, options.sampleCount);
+
+        for (int optionBits = 0; optionBits < 4; ++optionBits)
+        {
+            const bool sleepEnabled = optionBits & 1;
+            const bool edgeSnapEnabled = optionBits & 2;
+            const EMANoiseFilter<T> filter = makeEMANoiseFilter<T>(sleepEnabled, edgeSnapEnabled);
+
+            EMANoiseFilterBank<T> bank(BankChannelCount, LowerBound, UpperBound, sleepEnabled);
+            bank.setEdgeSnapEnabled(edgeSnapEnabled);
+
+            EMANoiseFilterGroupParameters<T> groupParameters(LowerBound, UpperBound, sleepEnabled);
+            groupParameters.edgeSnapEnabled = edgeSnapEnabled;
+            EMANoiseFilterArray<T> array;
+            array.addGroup(groupParameters, BankChannelCount);
+
+            const Result single = { "EMANoiseFilter", typeName<T>(), "single", sleepEnabled, edgeSnapEnabled, shapeName(shape),
+                                    measure(options, input.size(), [&]() { return runSingle(filter, input); }), "exact", "double" };
+            const Result block = { "EMANoiseFilter", typeName<T>(), "block", sleepEnabled, edgeSnapEnabled, shapeName(shape),
+                                   measure(options, input.size(), [&]() { return runBlock(filter, input, output); }), "exact", "double" };
+            const Result banked = { "EMANoiseFilterBank", typeName<T>(), "bank", sleepEnabled, edgeSnapEnabled, shapeName(shape),
+                                    measure(options, frames.size(), [&]() { return runBank(bank, frames, bankOutput); }), "exact", "double" };
+            const Result packed = { "EMANoiseFilterArray", typeName<T>(), "packed", sleepEnabled, edgeSnapEnabled, shapeName(shape),
+                                    measure(options, frames.size(), [&]() { return runBank(array, frames, bankOutput); }), "exact", "double" };
+            results.push_back(single);
+            results.push_back(block);
+            results.push_back(banked);
+            results.push_back(packed);
+        }
+
+        results.push_back(benchmarkStatic<T, false, false>(options, shape, input));
+        results.push_back(benchmarkStatic<T, true, false>(options, shape, input));
+        results.push_back(benchmarkStatic<T, false, true>(options, shape, input));
+        results.push_back(benchmarkStatic<T, true, true>(options, shape, input));
+
+        benchmarkSnapCurves<T>(options, shape, input, output, results);
+        benchmarkChain<T>(options, shape, input, output, results);
+        benchmarkAdvance<T>(options, shape, input, results);
+        benchmarkDecimating<T>(options, shape, input, output, results);
+
+        const SimpleNoiseFilter<T> filter = makeSimpleNoiseFilter<T>();
+        const SimpleNoiseFilterBank<T> bank(BankChannelCount, 10, 5);
+
+        const Result single = { "SimpleNoiseFilter", typeName<T>(), "single", -1, -1, shapeName(shape),
+                                measure(options, input.size(), [&]() { return runSingle(filter, input); }), "", "double" };
+        const Result block = { "SimpleNoiseFilter", typeName<T>(), "block", -1, -1, shapeName(shape),
+                               measure(options, input.size(), [&]() { return runBlock(filter, input, output); }), "", "double" };
+        const Result banked = { "SimpleNoiseFilterBank", typeName<T>(), "bank", -1, -1, shapeName(shape),
+                                measure(options, frames.size(), [&]() { return runBank(bank, frames, bankOutput); }), "", "double" };
+        results.push_back(single);
+        results.push_back(block);
+        results.push_back(banked);
+    }
+}
+
+/**
+ * @brief compareOutputs runs the same input through both filters
+ * @return how far the output of filter is from the output of reference
+ */
+template<class Reference, class Filter, class T>
+ComputeTypeAccuracy compareOutputs(Reference reference, Filter filter, const std::vector<T> &input)
+{
+    size_t differingCount = 0;
+    double maximumDifference = 0;
+
+    for (T value : input)
+    {
+        const double difference = std::abs(static_cast<double>(reference.update(value)) - static_cast<double>(filter.update(value)));
+        differingCount += difference != 0;
+        maximumDifference = std::max(maximumDifference, difference);
+    }
+
+    const ComputeTypeAccuracy accuracy = { "", typeName<T>(), -1, "", double(differingCount)/input.size(), maximumDifference };
+    return accuracy;
+}
+
+/**
+ * @brief benchmarkComputeType times EMANoiseFilter and SimpleNoiseFilter computing in float,
+ * and compares their output against computing in double
+ */
+template<class T>
+void benchmarkComputeType(const Options &options, std::vector<Result> &results, std::vector<ComputeTypeAccuracy> &accuracies)
+{
+    std::vector<T> output(options.sampleCount);
+
+    for (Shape shape : Shapes)
+    {
+        const std::vector<T> input = makeInput<T>(shape, options.sampleCount, 1, LowerBound, UpperBound);
+
+        for (int sleepEnabled = 0; sleepEnabled < 2; ++sleepEnabled)
+        {
+            const EMANoiseFilter<T> reference = makeEMANoiseFilter<T>(sleepEnabled, true);
+            EMANoiseFilter<T, float> filter(LowerBound, UpperBound, sleepEnabled);
+            filter.setEdgeSnapEnabled(true);
+
+            const Result single = { "EMANoiseFilter", typeName<T>(), "single", sleepEnabled, true, shapeName(shape),
+                                    measure(options, input.size(), [&]() { return runSingle(filter, input); }), "exact", "float" };
+            const Result block = { "EMANoiseFilter", typeName<T>(), "block", sleepEnabled, true, shapeName(shape),
+                                   measure(options, input.size(), [&]() { return runBlock(filter, input, output); }), "exact", "float" };
+            results.push_back(single);
+            results.push_back(block);
+
+            ComputeTypeAccuracy accuracy = compareOutputs(reference, filter, input);
+            accuracy.filter = "EMANoiseFilter";
+            accuracy.sleepEnabled = sleepEnabled;
+            accuracy.input = shapeName(shape);
+            accuracies.push_back(accuracy);
+        }
+
+        const SimpleNoiseFilter<T, float> filter(10, 5);
+        const Result block = { "SimpleNoiseFilter", typeName<T>(), "block", -1, -1, shapeName(shape),
+                               measure(options, input.size(), [&]() { return runBlock(filter, input, output); }), "", "float" };
+        results.push_back(block);
+
+        ComputeTypeAccuracy accuracy = compareOutputs(makeSimpleNoiseFilter<T>(), filter, input);
+        accuracy.filter = "SimpleNoiseFilter";
+        accuracy.input = shapeName(shape);
+        accuracies.push_back(accuracy);
+    }
+}
+
+/**
+ * @brief benchmarkFixedPoint times FixedPointEMANoiseFilter and its bank,
+ * and compares its output against EMANoiseFilter<int>
+ */
+void benchmarkFixedPoint(const Options &options, std::vector<Result> &results, std::vector<Accuracy> &accuracies)
+{
+    std::vector<int> output(options.sampleCount);
+    std::vector<int> bankOutput(BankChannelCount);
+
+    for (Shape shape : Shapes)
+    {
+        const std::vector<int> input = makeInput<int>(shape, options.sampleCount, 1, LowerBound, UpperBound);
+        const std::vector<int> frames = makeFrames<int>(shape, options.sampleCount);
+
+        for (int optionBits = 0; optionBits < 4; ++optionBits)
+        {
+            const bool sleepEnabled = optionBits & 1;
+            const bool edgeSnapEnabled = optionBits & 2;
+
+            FixedPointEMANoiseFilter filter(LowerBound, UpperBound, sleepEnabled);
+            filter.setEdgeSnapEnabled(edgeSnapEnabled);
+
+            FixedPointEMANoiseFilterBank bank(BankChannelCount, LowerBound, UpperBound, sleepEnabled);
+            bank.setEdgeSnapEnabled(edgeSnapEnabled);
+
+            const Result single = { "FixedPointEMANoiseFilter", "int", "single", sleepEnabled, edgeSnapEnabled, shapeName(shape),
+                                    measure(options, input.size(), [&]() { return runSingle(filter, input); }), "", "" };
+            const Result banked = { "FixedPointEMANoiseFilterBank", "int", "bank", sleepEnabled, edgeSnapEnabled, shapeName(shape),
+                                    measure(options, frames.size(), [&]() { return runBank(bank, frames, bankOutput); }), "", "" };
+            results.push_back(single);
+            results.push_back(banked);
+
+            EMANoiseFilter<int> reference = makeEMANoiseFilter<int>(sleepEnabled, edgeSnapEnabled);
+            size_t differingCount = 0;
+            int maximumDifference = 0;
+
+            for (int value : input)
+            {
+                const int difference = std::abs(reference.update(value) - filter.update(value));
+                differingCount += difference != 0;
+                maximumDifference = std::max(maximumDifference, difference);
+            }
+
+            const Accuracy accuracy = { sleepEnabled, edgeSnapEnabled, shapeName(shape), double(differingCount)/input.size(), maximumDifference };
+            accuracies.push_back(accuracy);
+        }
+    }
+}
+
+const char *jsonOption(int value)
+{
+    return value < 0 ? "null" : value ? "true" : "false";
+}
+
+void printJson(const Options &options,
+               const std::vector<Result> &results,
+               const std::vector<Accuracy> &accuracies,
+               const std::vector<SnapCurveAccuracy> &snapCurveAccuracies,
+               const std::vector<ComputeTypeAccuracy> &computeTypeAccuracies)
+{
+    printf("{\n");
+    printf("  \"benchmark\": \"filtertester\",\n");
+    printf("  \"samples\": %zu,\n", options.sampleCount);
+    printf("  \"repetitions\": %d,\n", options.repetitions);
+    printf("  \"bank_channels\": %zu,\n", BankChannelCount);
+    printf("  \"sparse_channels\": %zu,\n", SparseChannelCount);
+    printf("  \"sparse_dirty_channels\": %zu,\n", SparseDirtyCount);
+    printf("  \"results\": [\n");
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &result = results[i];
+        const std::string snapCurve = result.snapCurve.empty() ? "null" : "\"" + result.snapCurve + "\"";
+        const std::string compute = result.compute.empty() ? "null" : "\"" + result.compute + "\"";
+        printf("    {\"filter\": \"%s\", \"type\": \"%s\", \"path\": \"%s\", \"sleep\": %s, \"edge_snap\": %s, \"snap_curve\": %s, "
+               "\"compute\": %s, \"input\": \"%s\", \"ns_per_sample\": %.3f, \"samples_per_second\": %.0f}%s\n",
+               result.filter.c_str(),
+               result.type.c_str(),
+               result.path.c_str(),
+               jsonOption(result.sleepEnabled),
+               jsonOption(result.edgeSnapEnabled),
+               snapCurve.c_str(),
+               compute.c_str(),
+               result.input.c_str(),
+               result.nanosecondsPerSample,
+               1e9/result.nanosecondsPerSample,
+               i + 1 < results.size() ? "," : "");
+    }
+
+    printf("  ],\n");
+    printf("  \"fixed_point_accuracy\": [\n");
+
+    for (size_t i = 0; i < accuracies.size(); ++i)
+    {
+        const Accuracy &accuracy = accuracies[i];
+        printf("    {\"sleep\": %s, \"edge_snap\": %s, \"input\": \"%s\", \"differing_fraction\": %.6f, \"max_difference\": %d}%s\n",
+               jsonOption(accuracy.sleepEnabled),
+               jsonOption(accuracy.edgeSnapEnabled),
+               accuracy.input.c_str(),
+               accuracy.differingFraction,
+               accuracy.maximumDifference,
+               i + 1 < accuracies.size() ? "," : "");
+    }
+
+    printf("  ],\n");
+    printf("  \"snap_curve_accuracy\": [\n");
+
+    for (size_t i = 0; i < snapCurveAccuracies.size(); ++i)
+    {
+        printf("    {\"snap_curve\": \"%s\", \"max_deviation\": %.3g}%s\n",
+               snapCurveName(snapCurveAccuracies[i].curve),
+               snapCurveAccuracies[i].maximumDeviation,
+               i + 1 < snapCurveAccuracies.size() ? "," : "");
+    }
+
+    printf("  ],\n");
+    printf("  \"compute_type_accuracy\": [\n");
+
+    for (size_t i = 0; i < computeTypeAccuracies.size(); ++i)
+    {
+        const ComputeTypeAccuracy &accuracy = computeTypeAccuracies[i];
+        printf("    {\"filter\": \"%s\", \"type\": \"%s\", \"compute\": \"float\", \"reference\": \"double\", \"sleep\": %s, "
+               "\"input\": \"%s\", \"differing_fraction\": %.6f, \"max_difference\": %.6g}%s\n",
+               accuracy.filter.c_str(),
+               accuracy.type.c_str(),
+               jsonOption(accuracy.sleepEnabled),
+               accuracy.input.c_str(),
+               accuracy.differingFraction,
+               accuracy.maximumDifference,
+               i + 1 < computeTypeAccuracies.size() ? "," : "");
+    }
+
+    printf("  ]\n");
+    printf("}\n");
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    Options options = { 1 << 20, 5 };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        if (option == "--samples" && i + 1 < argc)
+        {
+            options.sampleCount = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (option == "--repetitions" && i + 1 < argc)
+        {
+            options.repetitions = atoi(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr,
+                    "Usage: filtertester-bench [--samples N] [--repetitions N]\n"
+                    "Prints the ns/sample and samples/s of every filter update path as JSON,\n"
+                    "how far the fixed point EMA filter is from EMANoiseFilter<int>\n"
+                    "and how far the filters computing in float are from computing in double.\n"
+                    "Each case runs N samples (default 1048576) and the fastest of the repetitions (default 5) is reported.\n");
+            return option == "-h" || option == "--help" ? 0 : 1;
+        }
+    }
+
+    if (options.sampleCount < SparseDirtyCount || options.repetitions < 1)
+    {
+        fprintf(stderr, "At least %zu samples and 1 repetition are needed\n", SparseDirtyCount);
+        return 1;
+    }
+
+    std::vector<Result> results;
+    benchmarkType<int>(options, results);
+    benchmarkType<float>(options, results);
+    benchmarkType<double>(options, results);
+
+    benchmarkSparse(options, results);
+
+    std::vector<Accuracy> accuracies;
+    benchmarkFixedPoint(options, results, accuracies);
+
+    std::vector<ComputeTypeAccuracy> computeTypeAccuracies;
+    benchmarkComputeType<int>(options, results, computeTypeAccuracies);
+    benchmarkComputeType<float>(options, results, computeTypeAccuracies);
+
+    printJson(options, results, accuracies, measureSnapCurves(), computeTypeAccuracies);
+    return 0;
+}
@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "filterparameters.h"
+#include "filterresponse.h"
+#include "parametersweep.h"
+#include "workstealingpool.h"
+
+//Measures how the filters respond to steps, ramps and noise, to choose between them with numbers.
+
+namespace {
+
+enum class OutputFormat
+{
+    Table,
+    Csv
+};
+
+enum class FilterSelection
+{
+    Both,
+    EMA,
+    Simple
+};
+
+struct Options
+{
+    Options():
+        stepSizes({ 8, 32, 128, -128, 512 }),
+        rampSize(128),
+        rampLengths({ 100, 1000 }),
+        noiseAmplitude(4),
+        noiseFloors({ 2, 5, 10, 20 }),
+        filters(FilterSelection::Both),
+        threadCount(0),
+        outputFormat(OutputFormat::Table)
+    {
+        // 0 steps stands for the value of the filter parameters
+        ranges.snapMultiplier = { 0, 0, 0 };
+        ranges.emaActivityThreshold = { 0, 0, 0 };
+        ranges.simpleActivityThreshold = { 0, 0, 0 };
+        ranges.suppressionCount = { 0, 0, 0 };
+    }
+
+    std::vector<double> stepSizes;
+    int rampSize;
+    std::vector<double> rampLengths;
+    double noiseAmplitude;
+    std::vector<double> noiseFloors;
+    CharacterizationSettings settings;
+    SweepRanges ranges;
+    FilterSelection filters;
+    unsigned int threadCount;
+    OutputFormat outputFormat;
+};
+
+void printUsage()
+{
+    fprintf(stderr,
+            "Usage: filtertester-characterize [options]\n"
+            "Drives the EMA and simple noise filters with steps, ramps and noise floors and reports per stimulus\n"
+            "  settling    worst case samples until the output stays within the tolerance of the final level\n"
+            "  delay       mean samples the output crosses halfway after the input\n"
+            "  overshoot   worst case distance past the final level, in percent of the size\n"
+            "  jitter      standard deviation of the output once settled\n"
+            "  spurious    mean output changes (hasChanged() events) per run once settled\n"
+            "Noise floors hold the level, so their jitter and changes are measured over the second half of the window.\n"
+            "Lists are comma separated, ranges are MIN:MAX:STEPS or a single value and default to the filter parameters.\n"
+            "\n"
+            "  --steps LIST                 step sizes (8,32,128,-128,512)\n"
+            "  --ramp-size N                size of the ramps (128)\n"
+            "  --ramp-lengths LIST          samples the ramps take (100,1000)\n"
+            "  --noise-amplitude X          noise added to the steps and ramps (4)\n"
+            "  --noise-floors LIST          noise amplitudes of the noise floors (2,5,10,20)\n"
+            "  --noise NOISE                uniform, gaussian or impulse (uniform)\n"
+            "  --level N                    level the stimuli start at (256)\n"
+            "  --pre-roll N                 samples at the level before each stimulus (1000)\n"
+            "  --window N                   samples measured from the start of each stimulus (10000)\n"
+            "  --runs N                     runs of each stimulus, with different noise (16)\n"
+            "  --seed N                     seed of the noise (1)\n"
+            "  --tolerance PERCENT          settling band in percent of the size, at least the noise amplitude (5)\n"
+            "  --filter FILTER              ema, simple or both (both)\n"
+            "  --snap-multipliers RANGE     EMA filter snap multipliers\n"
+            "  --ema-thresholds RANGE       EMA filter activity thresholds\n"
+            "  --simple-thresholds RANGE    simple filter activity thresholds\n"
+            "  --suppression-counts RANGE   simple filter suppression counts\n"
+            "  --threads N                  worker threads, 0 for one per hardware thread (0)\n"
+            "  --output FORMAT              table or csv (table)\n"
+            "\n"
+            "%s", FilterParameters::usage());
+}
+
+bool parseList(const char *value, std::vector<double> *list)
+{
+    std::vector<double> parsed;
+    const char *begin = value;
+    for (;;)
+    {
+        char *end = nullptr;
+        parsed.push_back(strtod(begin, &end));
+        if (end == begin || (*end != ',' && *end != 0))
+        {
+            fprintf(stderr, "Invalid list %s\n", value);
+            return false;
+        }
+        if (*end == 0)
+        {
+            break;
+        }
+        begin = end + 1;
+    }
+
+    *list = parsed;
+    return true;
+}
+
+bool parseRange(const char *value, SweepRange *range)
+{
+    SweepRange parsed;
+    if (!parsed.parse(value))
+    {
+        fprintf(stderr, "Invalid range %s\n", value);
+        return false;
+    }
+
+    *range = parsed;
+    return true;
+}
+
+void setDefaultRange(SweepRange *range, double value)
+{
+    if (range->steps == 0)
+    {
+        *range = { value, value, 1 };
+    }
+}
+
+std::vector<Stimulus> makeStimuli(const Options &options)
+{
+    std::vector<Stimulus> stimuli;
+
+    for (double size : options.stepSizes)
+    {
+        const Stimulus stimulus = { Stimulus::Step, static_cast<int>(lround(size)), 1, options.noiseAmplitude };
+        stimuli.push_back(stimulus);
+    }
+
+    for (double length : options.rampLengths)
+    {
+        const Stimulus stimulus = { Stimulus::Ramp, options.rampSize, static_cast<int>(lround(length)), options.noiseAmplitude };
+        stimuli.push_back(stimulus);
+    }
+
+    for (double amplitude : options.noiseFloors)
+    {
+        const Stimulus stimulus = { Stimulus::NoiseFloor, 0, 0, amplitude };
+        stimuli.push_back(stimulus);
+    }
+
+    return stimuli;
+}
+
+std::string configurationName(const SweepConfiguration &configuration)
+{
+    char name[128];
+    if (configuration.filter == SweepConfiguration::EMA)
+    {
+        snprintf(name, sizeof(name), "EMA filter, snap multiplier %g, activity threshold %d",
+                 configuration.snapMultiplier, configuration.activityThreshold);
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "Simple filter, activity threshold %d, suppression count %d",
+                 configuration.activityThreshold, configuration.suppressionCount);
+    }
+    return name;
+}
+
+void printResults(const std::vector<ResponseResult> &results, const FilterCharacterization &characterization, const Options &options)
+{
+    const std::vector<Stimulus> &stimuli = characterization.stimuli();
+    const size_t windowLength = characterization.settings().windowLength;
+
+    if (options.outputFormat == OutputFormat::Csv)
+    {
+        printf("filter,snap_multiplier,activity_threshold,suppression_count,stimulus,size,rise_length,noise_amplitude,"
+               "settling,settled,delay,overshoot,jitter,spurious\n");
+    }
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const ResponseResult &result = results[i];
+        const SweepConfiguration &configuration = result.configuration;
+        const Stimulus &stimulus = stimuli[result.stimulus];
+        const ResponseMetrics &metrics = result.metrics;
+        const bool noiseFloor = stimulus.type == Stimulus::NoiseFloor;
+
+        if (options.outputFormat == OutputFormat::Csv)
+        {
+            const char *types[] = { "step", "ramp", "noise" };
+            printf("%s,%g,%d,%d,%s,%d,%d,%g,%g,%d,%g,%g,%g,%g\n",
+                   configuration.filter == SweepConfiguration::EMA ? "ema" : "simple",
+                   configuration.snapMultiplier,
+                   configuration.activityThreshold,
+                   configuration.suppressionCount,
+                   types[stimulus.type],
+                   stimulus.size,
+                   stimulus.riseLength,
+                   stimulus.noiseAmplitude,
+                   metrics.settlingTime,
+                   metrics.settled,
+                   metrics.groupDelay,
+                   metrics.overshoot*100,
+                   metrics.jitter,
+                   metrics.spuriousChanges);
+            continue;
+        }
+
+        if (result.stimulus == 0)
+        {
+            printf("%s%s\n"
+                   "  stimulus           settling      delay  overshoot     jitter   spurious\n",
+                   i > 0 ? "\n" : "",
+                   configurationName(configuration).c_str());
+        }
+
+        char settling[32] = "-";
+        char delay[32] = "-";
+        char overshoot[32] = "-";
+        if (!noiseFloor)
+        {
+            if (metrics.settled)
+            {
+                snprintf(settling, sizeof(settling), "%.0f", metrics.settlingTime);
+            }
+            else
+            {
+                snprintf(settling, sizeof(settling), ">%zu", windowLength);
+            }
+            if (!isnan(metrics.groupDelay))
+            {
+                snprintf(delay, sizeof(delay), "%.1f", metrics.groupDelay);
+            }
+            snprintf(overshoot, sizeof(overshoot), "%.1f%%", metrics.overshoot*100);
+        }
+
+        printf("  %-16s %10s %10s %10s %10.3f %10.2f\n",
+               stimulus.name().c_str(),
+               settling,
+               delay,
+               overshoot,
+               metrics.jitter,
+               metrics.spuriousChanges);
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    FilterParameters parameters;
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool consumedValue = value != nullptr;
+        bool valid = true;
+
+        if (option == "-h" || option == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (option == "--steps" && value)
+        {
+            valid = parseList(value, &options.stepSizes);
+        }
+        else if (option == "--ramp-size" && value)
+        {
+            options.rampSize = atoi(value);
+        }
+        else if (option == "--ramp-lengths" && value)
+        {
+            valid = parseList(value, &options.rampLengths);
+        }
+        else if (option == "--noise-amplitude" && value)
+        {
+            options.noiseAmplitude = atof(value);
+        }
+        else if (option == "--noise-floors" && value)
+        {
+            valid = parseList(value, &options.noiseFloors);
+        }
+        else if (option == "--noise" && value)
+        {
+            if (strcmp(value, "uniform") == 0)
+            {
+                options.settings.noise = SignalGenerator::Noise::Uniform;
+            }
+            else if (strcmp(value, "gaussian") == 0)
+            {
+                options.settings.noise = SignalGenerator::Noise::Gaussian;
+            }
+            else if (strcmp(value, "impulse") == 0)
+            {
+                options.settings.noise = SignalGenerator::Noise::Impulse;
+            }
+            else
+            {
+                fprintf(stderr, "Invalid noise %s\n", value);
+                valid = false;
+            }
+        }
+        else if (option == "--level" && value)
+        {
+            options.settings.level = atoi(value);
+        }
+        else if (option == "--pre-roll" && value)
+        {
+            options.settings.preRollLength = std::max<size_t>(1, strtoul(value, nullptr, 10));
+        }
+        else if (option == "--window" && value)
+        {
+            options.settings.windowLength = std::max<size_t>(1, strtoul(value, nullptr, 10));
+        }
+        else if (option == "--runs" && value)
+        {
+            options.settings.runCount = std::max<size_t>(1, strtoul(value, nullptr, 10));
+        }
+        else if (option == "--seed" && value)
+        {
+            options.settings.seed = strtoull(value, nullptr, 10);
+        }
+        else if (option == "--tolerance" && value)
+        {
+            options.settings.tolerance = atof(value)/100;
+        }
+        else if (option == "--filter" && value && (std::string(value) == "ema" || std::string(value) == "simple" || std::string(value) == "both"))
+        {
+            options.filters = std::string(value) == "ema" ? FilterSelection::EMA
+                              : std::string(value) == "simple" ? FilterSelection::Simple
+                              : FilterSelection::Both;
+        }
+        else if (option == "--snap-multipliers" && value)
+        {
+            valid = parseRange(value, &options.ranges.snapMultiplier);
+        }
+        else if (option == "--ema-thresholds" && value)
+        {
+            valid = parseRange(value, &options.ranges.emaActivityThreshold);
+        }
+        else if (option == "--simple-thresholds" && value)
+        {
+            valid = parseRange(value, &options.ranges.simpleActivityThreshold);
+        }
+        else if (option == "--suppression-counts" && value)
+        {
+            valid = parseRange(value, &options.ranges.suppressionCount);
+        }
+        else if (option == "--threads" && value)
+        {
+            options.threadCount = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--output" && value && (std::string(value) == "table" || std::string(value) == "csv"))
+        {
+            options.outputFormat = std::string(value) == "csv" ? OutputFormat::Csv : OutputFormat::Table;
+        }
+        else if (!parameters.parseOption(option, value, &consumedValue))
+        {
+            fprintf(stderr, "Unknown option %s\n", option.c_str());
+            printUsage();
+            return 1;
+        }
+
+        if (!valid)
+        {
+            return 1;
+        }
+
+        i += consumedValue;
+    }
+
+    setDefaultRange(&options.ranges.snapMultiplier, parameters.snapMultiplier);
+    setDefaultRange(&options.ranges.emaActivityThreshold, parameters.emaActivityThreshold);
+    setDefaultRange(&options.ranges.simpleActivityThreshold, parameters.simpleActivityThreshold);
+    setDefaultRange(&options.ranges.suppressionCount, parameters.suppressionCount);
+
+    std::vector<SweepConfiguration> configurations;
+    for (const SweepConfiguration &configuration : ParameterSweep::grid(options.ranges))
+    {
+        if (options.filters == FilterSelection::Both
+            || (options.filters == FilterSelection::EMA) == (configuration.filter == SweepConfiguration::EMA))
+        {
+            configurations.push_back(configuration);
+        }
+    }
+
+    const std::vector<Stimulus> stimuli = makeStimuli(options);
+    if (stimuli.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    WorkStealingPool pool(options.threadCount);
+    const FilterCharacterization characterization(stimuli, options.settings, parameters);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::vector<ResponseResult> results = characterization.run(configurations, pool);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printResults(results, characterization, options);
+
+    const CharacterizationSettings &settings = characterization.settings();
+    const double sampleCount = static_cast<double>(settings.preRollLength + settings.windowLength)*settings.runCount*results.size();
+    fprintf(stderr,
+            "%zu configurations, %zu stimuli of %zu runs in %.3f s on %u threads, %.1f Msamples/s\n",
+            configurations.size(),
+            stimuli.size(),
+            settings.runCount,
+            seconds,
+            pool.threadCount(),
+            seconds > 0 ? sampleCount/seconds/1e6 : 0.0);
+
+    return 0;
+}
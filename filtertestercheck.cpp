@@ -0,0 +1,1165 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "changeevents.h"
+#include "decimatingfilter.h"
+#include "dirtychannelscheduler.h"
+#include "emanoisefilter.h"
+#include "emanoisefilterarray.h"
+#include "emanoisefilterbank.h"
+#include "filterchain.h"
+#include "filterinputs.h"
+#include "fixedpointemanoisefilterbank.h"
+#include "simplenoisefilter.h"
+#include "simplenoisefilterbank.h"
+#include "workstealingpool.h"
+
+//Headless checks of the filters and the infrastructure around them, exits non-zero when one of them fails.
+
+namespace {
+
+/**
+ * Back to back run()s of different sizes on a pool with more workers than CPUs,
+ * so that workers are still spinning at the end of one run() when the next one hands out its ranges.
+ * Every index has to be visited exactly once per run().
+ */
+bool checkWorkStealingPool()
+{
+    WorkStealingPool pool(8);
+    std::vector<std::atomic<unsigned>> visits(20000);
+    std::atomic<unsigned> badWorkers(0);
+
+    for (unsigned run = 0; run < 2000; ++run)
+    {
+        const size_t count = 1 + (run*7919) % visits.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            visits[i].store(0, std::memory_order_relaxed);
+        }
+
+        pool.run(count, 1 + run % 64, [&](size_t begin, size_t end, unsigned worker) {
+            if (worker >= pool.threadCount())
+            {
+                ++badWorkers;
+            }
+            for (size_t i = begin; i < end; ++i)
+            {
+                visits[i].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (visits[i].load(std::memory_order_relaxed) != 1)
+            {
+                fprintf(stderr, "run %u: index %zu of %zu visited %u times\n", run, i, count, visits[i].load());
+                return false;
+            }
+        }
+    }
+
+    return badWorkers == 0;
+}
+
+/**
+ * Fills a channel major block of random walks with noise and occasional steps, within [0, 1024]
+ */
+template<class T>
+void generateWalks(std::mt19937 &generator, size_t channelCount, size_t sampleCount, std::vector<T> *samples)
+{
+    std::uniform_int_distribution<int> step(-2, 2);
+    std::uniform_int_distribution<int> noise(-12, 12);
+    std::uniform_int_distribution<int> jump(0, 1023);
+
+    samples->resize(channelCount*sampleCount);
+    for (size_t channel = 0; channel < channelCount; ++channel)
+    {
+        int position = jump(generator);
+        for (size_t i = 0; i < sampleCount; ++i)
+        {
+            position = jump(generator) < 2 ? jump(generator) : std::max(0, std::min(1024, position + step(generator)));
+            (*samples)[channel*sampleCount + i] = static_cast<T>(std::max(0, std::min(1024, position + noise(generator))));
+        }
+    }
+}
+
+const SnapCurve SnapCurves[] = { SnapCurve::Exact, SnapCurve::Table, SnapCurve::Newton, SnapCurve::Polynomial };
+
+/**
+ * Everything the filters carry over from one update to the next, compared bit for bit through their snapshots
+ */
+template<class T, class Real>
+bool sameState(const EMANoiseFilter<T, Real> &filter, const EMANoiseFilter<T, Real> &reference)
+{
+    const typename EMANoiseFilter<T, Real>::Snapshot a = filter.snapshot();
+    const typename EMANoiseFilter<T, Real>::Snapshot b = reference.snapshot();
+    return a.errorEMA == b.errorEMA && a.smoothValue == b.smoothValue && a.filteredValue == b.filteredValue
+           && a.previousValue == b.previousValue && a.firstValue == b.firstValue && a.sleeping == b.sleeping
+           && a.hasChanged == b.hasChanged;
+}
+
+template<class T, class Real>
+bool sameState(const SimpleNoiseFilter<T, Real> &filter, const SimpleNoiseFilter<T, Real> &reference)
+{
+    const typename SimpleNoiseFilter<T, Real>::Snapshot a = filter.snapshot();
+    const typename SimpleNoiseFilter<T, Real>::Snapshot b = reference.snapshot();
+    return a.smoothValue == b.smoothValue && a.filteredValue == b.filteredValue && a.previousValue == b.previousValue
+           && a.currentSuppressionCount == b.currentSuppressionCount && a.firstValue == b.firstValue
+           && a.hasChanged == b.hasChanged;
+}
+
+/**
+ * A raw value within [0, range], with a fraction for floating point T
+ */
+template<class T>
+T randomValue(std::mt19937 &generator, int range)
+{
+    std::uniform_int_distribution<int> value(0, range);
+    std::uniform_int_distribution<int> fraction(0, 3);
+    return static_cast<T>(value(generator) + fraction(generator)*0.25);
+}
+
+/**
+ * Runs of random length of the same raw value through advance() on filter and through update() on reference,
+ * failing as soon as the state, the value or hasChanged() differ. The filters are disabled for a few runs now and then.
+ */
+template<class Filter, class T>
+bool checkAdvanceRuns(Filter filter, Filter reference, int range, unsigned seed, const char *configuration)
+{
+    const size_t lengths[] = { 0, 1, 1, 2, 3, 7, 40, 300, 3000 };
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<size_t> length(0, sizeof(lengths)/sizeof(lengths[0]) - 1);
+
+    for (unsigned run = 0; run < 300; ++run)
+    {
+        const bool enabled = run % 50 < 45;
+        filter.setEnabled(enabled);
+        reference.setEnabled(enabled);
+
+        const T rawValue = randomValue<T>(generator, range);
+        const size_t count = lengths[length(generator)];
+        const T value = filter.advance(rawValue, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            reference.update(rawValue);
+        }
+
+        if (value != reference.value() || filter.hasChanged() != reference.hasChanged() || !sameState(filter, reference))
+        {
+            fprintf(stderr, "%s, run %u: advance(%g, %zu) returned %g instead of %g\n",
+                    configuration, run, double(rawValue), count, double(value), double(reference.value()));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * EMANoiseFilter::advance(v, n) against n update(v), with and without sleep and edge snap, with every snap curve
+ */
+template<class T>
+bool checkEMANoiseFilterAdvance()
+{
+    for (SnapCurve curve : SnapCurves)
+    {
+        for (int optionBits = 0; optionBits < 4; ++optionBits)
+        {
+            EMANoiseFilter<T> filter(0, 1023, optionBits & 1);
+            filter.setEdgeSnapEnabled(optionBits & 2);
+            filter.setSnapCurve(curve);
+
+            char configuration[64];
+            snprintf(configuration, sizeof(configuration), "curve %d, sleep %d, edge snap %d",
+                     static_cast<int>(curve), optionBits & 1, (optionBits & 2) != 0);
+            if (!checkAdvanceRuns<EMANoiseFilter<T>, T>(filter, filter, 1023, optionBits + 1, configuration))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * SimpleNoiseFilter::advance(v, n) against n update(v), also over raw values 0 to 2,
+ * where the averages of integer T truncate back onto the smooth value
+ */
+template<class T>
+bool checkSimpleNoiseFilterAdvance()
+{
+    const T thresholds[] = { 0, 1, 10 };
+    const int suppressionCounts[] = { 0, 1, 3, 10 };
+    const int ranges[] = { 2, 1023 };
+
+    for (T threshold : thresholds)
+    {
+        for (int suppressionCount : suppressionCounts)
+        {
+            for (int range : ranges)
+            {
+                const SimpleNoiseFilter<T> filter(threshold, suppressionCount);
+
+                char configuration[64];
+                snprintf(configuration, sizeof(configuration), "threshold %g, suppression count %d, range %d",
+                         double(threshold), suppressionCount, range);
+                if (!checkAdvanceRuns<SimpleNoiseFilter<T>, T>(filter, filter, range, suppressionCount + 1, configuration))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Blocks of random length through the block update() of filter and sample by sample through update() of reference,
+ * failing as soon as a value, a changed flag, the change count or the state differ.
+ * The filters are disabled for a few blocks now and then.
+ */
+template<class Filter, class T>
+bool checkBlockRuns(Filter filter, Filter reference, unsigned seed, const char *configuration)
+{
+    const size_t maximumLength = 257;
+    const size_t lengths[] = { 0, 1, 2, 5, 64, maximumLength };
+    const size_t sampleCount = 20000;
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<size_t> length(0, sizeof(lengths)/sizeof(lengths[0]) - 1);
+    std::vector<T> samples;
+    generateWalks(generator, 1, sampleCount, &samples);
+
+    std::vector<T> filteredValues(maximumLength);
+    bool changed[maximumLength];
+    unsigned block = 0;
+
+    for (size_t i = 0; i < sampleCount; ++block)
+    {
+        const bool enabled = block % 20 < 17;
+        filter.setEnabled(enabled);
+        reference.setEnabled(enabled);
+
+        const size_t n = std::min(lengths[length(generator)], sampleCount - i);
+        const size_t changeCount = filter.update(&samples[i], filteredValues.data(), n, changed);
+        size_t expectedChangeCount = 0;
+
+        for (size_t j = 0; j < n; ++j)
+        {
+            const T value = reference.update(samples[i + j]);
+            expectedChangeCount += reference.hasChanged();
+
+            if (filteredValues[j] != value || changed[j] != reference.hasChanged())
+            {
+                fprintf(stderr, "%s, sample %zu: %g instead of %g\n",
+                        configuration, i + j, double(filteredValues[j]), double(value));
+                return false;
+            }
+        }
+
+        if (changeCount != expectedChangeCount || filter.hasChanged() != reference.hasChanged() || !sameState(filter, reference))
+        {
+            fprintf(stderr, "%s, block %u: %zu changes instead of %zu, or a different state\n",
+                    configuration, block, changeCount, expectedChangeCount);
+            return false;
+        }
+
+        i += n;
+    }
+
+    return true;
+}
+
+/**
+ * EMANoiseFilter's block update() against its update() per sample, with and without sleep and edge snap,
+ * with every snap curve
+ */
+template<class T>
+bool checkEMANoiseFilterBlockUpdate()
+{
+    for (SnapCurve curve : SnapCurves)
+    {
+        for (int optionBits = 0; optionBits < 4; ++optionBits)
+        {
+            EMANoiseFilter<T> filter(0, 1024, optionBits & 1);
+            filter.setEdgeSnapEnabled(optionBits & 2);
+            filter.setSnapCurve(curve);
+
+            char configuration[64];
+            snprintf(configuration, sizeof(configuration), "curve %d, sleep %d, edge snap %d",
+                     static_cast<int>(curve), optionBits & 1, (optionBits & 2) != 0);
+            if (!checkBlockRuns<EMANoiseFilter<T>, T>(filter, filter, optionBits + 1, configuration))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * SimpleNoiseFilter's block update() against its update() per sample, over several thresholds and suppression counts
+ */
+template<class T>
+bool checkSimpleNoiseFilterBlockUpdate()
+{
+    const T thresholds[] = { 0, 1, 10, 50 };
+    const int suppressionCounts[] = { 0, 1, 3, 10 };
+
+    for (T threshold : thresholds)
+    {
+        for (int suppressionCount : suppressionCounts)
+        {
+            const SimpleNoiseFilter<T> filter(threshold, suppressionCount);
+
+            char configuration[64];
+            snprintf(configuration, sizeof(configuration), "threshold %g, suppression count %d", double(threshold), suppressionCount);
+            if (!checkBlockRuns<SimpleNoiseFilter<T>, T>(filter, filter, suppressionCount + 1, configuration))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * A FilterChain of a SimpleNoiseFilter, an EMANoiseFilter and a StaticEMANoiseFilter against the three filters
+ * run one after another, through single and block updates of random length. Between the updates the EMANoiseFilter
+ * gets random sleep, edge snap and snap curve settings, and every stage is disabled now and then.
+ */
+template<class T>
+bool checkFilterChain()
+{
+    typedef SimpleNoiseFilter<T> Simple;
+    typedef EMANoiseFilter<T> EMA;
+    typedef StaticEMANoiseFilter<T, true, true> Static;
+
+    const size_t maximumLength = 257;
+    const size_t lengths[] = { 0, 1, 2, 5, 64, maximumLength };
+    const size_t sampleCount = 50000;
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<size_t> length(0, sizeof(lengths)/sizeof(lengths[0]) - 1);
+    std::uniform_int_distribution<int> setting(0, 15);
+    std::vector<T> samples;
+    generateWalks(generator, 1, sampleCount, &samples);
+
+    FilterChain<Simple, EMA, Static> chain(Simple(10, 2), EMA(0, 1024), Static(0, 1024));
+    Simple simple(10, 2);
+    EMA ema(0, 1024);
+    Static last(0, 1024);
+
+    std::vector<T> filteredValues(maximumLength);
+    bool changed[maximumLength];
+    unsigned block = 0;
+
+    for (size_t i = 0; i < sampleCount; ++block)
+    {
+        const int settings = setting(generator);
+        const bool stageEnabled[] = { settings != 1, settings != 2, settings != 3 };
+        const SnapCurve curve = SnapCurves[setting(generator) % 4];
+        const bool sleepEnabled = setting(generator) % 2;
+        const bool edgeSnapEnabled = setting(generator) % 2;
+
+        chain.template stage<0>().setEnabled(stageEnabled[0]);
+        chain.template stage<1>().setEnabled(stageEnabled[1]);
+        chain.template stage<1>().setSnapCurve(curve);
+        chain.template stage<1>().setSleepEnabled(sleepEnabled);
+        chain.template stage<1>().setEdgeSnapEnabled(edgeSnapEnabled);
+        chain.template stage<2>().setEnabled(stageEnabled[2]);
+        simple.setEnabled(stageEnabled[0]);
+        ema.setEnabled(stageEnabled[1]);
+        ema.setSnapCurve(curve);
+        ema.setSleepEnabled(sleepEnabled);
+        ema.setEdgeSnapEnabled(edgeSnapEnabled);
+        last.setEnabled(stageEnabled[2]);
+
+        // every third block goes through the single value update()
+        const size_t n = std::min(lengths[length(generator)], sampleCount - i);
+        const bool single = block % 3 == 0;
+        size_t changeCount = 0;
+        for (size_t j = 0; single && j < n; ++j)
+        {
+            filteredValues[j] = chain.update(samples[i + j]);
+            changed[j] = chain.hasChanged();
+            changeCount += changed[j];
+        }
+        if (!single)
+        {
+            changeCount = chain.update(&samples[i], filteredValues.data(), n, changed);
+        }
+
+        size_t expectedChangeCount = 0;
+        for (size_t j = 0; j < n; ++j)
+        {
+            const T value = last.update(ema.update(simple.update(samples[i + j])));
+            expectedChangeCount += last.hasChanged();
+
+            if (filteredValues[j] != value || changed[j] != last.hasChanged())
+            {
+                fprintf(stderr, "%s update, sample %zu: %g instead of %g\n",
+                        single ? "single" : "block", i + j, double(filteredValues[j]), double(value));
+                return false;
+            }
+        }
+
+        if (changeCount != expectedChangeCount || !sameState(chain.template stage<0>(), simple)
+            || !sameState(chain.template stage<1>(), ema) || chain.template stage<2>().value() != last.value()
+            || chain.template stage<2>().isSleeping() != last.isSleeping() || chain.hasChanged() != last.hasChanged())
+        {
+            fprintf(stderr, "%s update, block %u: %zu changes instead of %zu, or a different state\n",
+                    single ? "single" : "block", block, changeCount, expectedChangeCount);
+            return false;
+        }
+
+        i += n;
+    }
+
+    return true;
+}
+
+/**
+ * The change events of an EMANoiseFilter through ChangeEventEncoder, ChangeEventDecoder fed with chunks of random size
+ * that cut events apart, and ChangeEventReplay, against the filtered values of the filter itself.
+ * A varint that runs past 10 bytes has to stop the decoder as corrupt instead of waiting for more bytes.
+ */
+template<class T>
+bool checkChangeEventRoundTrip()
+{
+    const size_t blockLength = 256;
+    const size_t sampleCount = 100000;
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<size_t> chunkSize(0, 40);
+    std::vector<T> samples;
+    generateWalks(generator, 1, sampleCount, &samples);
+
+    ChangeEventFilter<EMANoiseFilter<T>> eventFilter(EMANoiseFilter<T>(0, 1024));
+    EMANoiseFilter<T> reference(0, 1024);
+    ChangeEventEncoder<T> encoder;
+    std::vector<ChangeEvent<T>> events(blockLength);
+    std::vector<uint8_t> bytes;
+
+    for (size_t i = 0; i < sampleCount; i += blockLength)
+    {
+        const size_t eventCount = eventFilter.update(&samples[i], blockLength, events.data());
+        const size_t size = bytes.size();
+        bytes.resize(size + eventCount*ChangeEventEncoder<T>::MaximumEventSize);
+        bytes.resize(size + encoder.encode(events.data(), eventCount, &bytes[size]));
+    }
+
+    ChangeEventDecoder<T> decoder;
+    ChangeEventReplay<T> replay;
+    std::vector<ChangeEvent<T>> decoded;
+    std::vector<T> values(sampleCount);
+    size_t position = 0;
+    size_t pending = 0;
+
+    while (position < bytes.size())
+    {
+        // the bytes arrive in chunks, what the decoder leaves of a cut off event comes again with the next chunk
+        const size_t available = std::min(bytes.size() - position, pending + 1 + chunkSize(generator));
+        std::vector<ChangeEvent<T>> chunkEvents(available);
+        size_t consumed = 0;
+        const size_t count = decoder.decode(&bytes[position], available, chunkEvents.data(), available, &consumed);
+        decoded.insert(decoded.end(), chunkEvents.begin(), chunkEvents.begin() + count);
+        position += consumed;
+        pending = available - consumed;
+
+        if (decoder.isCorrupt() || (consumed == 0 && position + available == bytes.size()))
+        {
+            fprintf(stderr, "the decoder stopped at byte %zu of %zu\n", position, bytes.size());
+            return false;
+        }
+    }
+
+    replay.replay(decoded.data(), decoded.size(), values.data(), sampleCount);
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        const T value = reference.update(samples[i]);
+        if (values[i] != value)
+        {
+            fprintf(stderr, "sample %zu: replayed %g instead of %g\n", i, double(values[i]), double(value));
+            return false;
+        }
+    }
+
+    const uint8_t overlong[] = { 0x01, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+    ChangeEventDecoder<T> corruptDecoder;
+    ChangeEvent<T> event;
+    size_t consumed = 0;
+    if (corruptDecoder.decode(overlong, sizeof(overlong), &event, 1, &consumed) != 0 || !corruptDecoder.isCorrupt())
+    {
+        fprintf(stderr, "an 11 byte varint isn't reported as corrupt\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * update(rawValue, timestamp) with timestamps one sampleInterval() apart against update(rawValue), which the
+ * timestamped update() documents as giving the same output
+ */
+template<class Filter, class T>
+bool checkTimestampRuns(Filter reference, const char *configuration)
+{
+    const uint64_t sampleInterval = 1000;
+    const size_t sampleCount = 5000;
+    std::mt19937 generator(17);
+    std::vector<T> samples;
+    generateWalks(generator, 1, sampleCount, &samples);
+
+    Filter filter = reference;
+    filter.setSampleInterval(sampleInterval);
+
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        const T value = filter.update(samples[i], 5000000000ull + i*sampleInterval);
+        if (value != reference.update(samples[i]) || filter.hasChanged() != reference.hasChanged() || !sameState(filter, reference))
+        {
+            fprintf(stderr, "%s, sample %zu: %g instead of %g\n", configuration, i, double(value), double(reference.value()));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * The compounded weight 1 - (1 - w)^n of the timestamped updates against n updates of a constant input:
+ * SampleIntervalClock::compounded() against the weight applied n times, and the error EMA of a sleeping
+ * EMANoiseFilter and the smoothed value of a SimpleNoiseFilter, whose smoothed value doesn't move for
+ * the EMANoiseFilter and is averaged in every update for the SimpleNoiseFilter, over one timestamped update
+ * n intervals later against n updates
+ */
+bool checkCompoundedWeight()
+{
+    const double weights[] = { 0.01, 0.4, 0.5, 0.9 };
+    const double intervalCounts[] = { 1, 2, 3, 7, 16, 63, 64, 65, 100, 2.5 };
+
+    for (double weight : weights)
+    {
+        for (double intervals : intervalCounts)
+        {
+            // a fractional count has no repeated updates to compare with, only pow()
+            double repeated = 0;
+            for (unsigned i = 0; i < intervals; ++i)
+            {
+                repeated += (1 - repeated)*weight;
+            }
+            const double expected = static_cast<unsigned>(intervals) == intervals ? repeated : 1 - pow(1 - weight, intervals);
+            const double compounded = SampleIntervalClock<double>::compounded(weight, intervals);
+
+            if (fabs(compounded - expected) > 1e-12)
+            {
+                fprintf(stderr, "weight %g over %g intervals: %.17g instead of %.17g\n", weight, intervals, compounded, expected);
+                return false;
+            }
+        }
+    }
+
+    for (unsigned intervals = 1; intervals <= 100; ++intervals)
+    {
+        EMANoiseFilter<double> ema(0, 1024);
+        ema.setActivityThreshold(1e9);
+        SimpleNoiseFilter<double> simple(1e9, 0);
+        ema.update(100, 0);
+        simple.update(100, 0);
+
+        EMANoiseFilter<double> repeatedEMA = ema;
+        SimpleNoiseFilter<double> repeatedSimple = simple;
+        for (unsigned i = 0; i < intervals; ++i)
+        {
+            repeatedEMA.update(900);
+            repeatedSimple.update(900);
+        }
+        ema.update(900, intervals);
+        simple.update(900, intervals);
+
+        if (fabs(ema.snapshot().errorEMA - repeatedEMA.snapshot().errorEMA) > 1e-9
+            || fabs(simple.value() - repeatedSimple.value()) > 1e-9)
+        {
+            fprintf(stderr, "%u intervals: error EMA %.17g instead of %.17g, simple value %.17g instead of %.17g\n",
+                    intervals, ema.snapshot().errorEMA, repeatedEMA.snapshot().errorEMA, simple.value(), repeatedSimple.value());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * The timestamped update() of EMANoiseFilter with every snap curve, with and without sleep and edge snap,
+ * and of SimpleNoiseFilter over several thresholds and suppression counts, against update()
+ */
+template<class T>
+bool checkTimestampedUpdate()
+{
+    for (SnapCurve curve : SnapCurves)
+    {
+        for (int optionBits = 0; optionBits < 4; ++optionBits)
+        {
+            EMANoiseFilter<T> filter(0, 1024, optionBits & 1);
+            filter.setEdgeSnapEnabled(optionBits & 2);
+            filter.setSnapCurve(curve);
+
+            char configuration[64];
+            snprintf(configuration, sizeof(configuration), "curve %d, sleep %d, edge snap %d",
+                     static_cast<int>(curve), optionBits & 1, (optionBits & 2) != 0);
+            if (!checkTimestampRuns<EMANoiseFilter<T>, T>(filter, configuration))
+            {
+                return false;
+            }
+        }
+    }
+
+    const T thresholds[] = { 0, 1, 10 };
+    const int suppressionCounts[] = { 0, 1, 3 };
+    for (T threshold : thresholds)
+    {
+        for (int suppressionCount : suppressionCounts)
+        {
+            char configuration[64];
+            snprintf(configuration, sizeof(configuration), "threshold %g, suppression count %d", double(threshold), suppressionCount);
+            if (!checkTimestampRuns<SimpleNoiseFilter<T>, T>(SimpleNoiseFilter<T>(threshold, suppressionCount), configuration))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * DecimatingFilter over blocks of random length, which mostly aren't multiples of the factor: with factor 1 against
+ * update() per sample, with larger factors against the filter given the average of every factor raw values
+ * with the sample number as timestamp, as DecimatingFilter documents
+ */
+template<class Filter, class T>
+bool checkDecimatingRuns(const Filter &filter, const char *name)
+{
+    const unsigned factors[] = { 1, 2, 4, 7 };
+    const size_t sampleCount = 20000;
+    std::mt19937 generator(19);
+    std::uniform_int_distribution<size_t> length(0, 100);
+    std::vector<T> samples;
+    generateWalks(generator, 1, sampleCount, &samples);
+
+    for (unsigned factor : factors)
+    {
+        DecimatingFilter<Filter> decimating(filter, factor);
+        Filter reference = filter;
+        std::vector<T> filteredValues(sampleCount/factor + 1);
+        size_t outputCount = 0;
+
+        for (size_t i = 0; i < sampleCount;)
+        {
+            const size_t n = std::min(length(generator), sampleCount - i);
+            outputCount += decimating.update(&samples[i], n, &filteredValues[outputCount]);
+            i += n;
+        }
+
+        if (outputCount != sampleCount/factor)
+        {
+            fprintf(stderr, "%s, factor %u: %zu filtered values instead of %zu\n", name, factor, outputCount, sampleCount/factor);
+            return false;
+        }
+
+        for (size_t j = 0; j < outputCount; ++j)
+        {
+            double sum = 0;
+            for (size_t i = j*factor; i < (j + 1)*factor; ++i)
+            {
+                sum += samples[i];
+            }
+
+            const T value = factor == 1
+                            ? reference.update(samples[j])
+                            : reference.update(static_cast<T>(sum/factor), (j + 1)*factor);
+            if (filteredValues[j] != value)
+            {
+                fprintf(stderr, "%s, factor %u, filtered value %zu: %g instead of %g\n",
+                        name, factor, j, double(filteredValues[j]), double(value));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+template<class T>
+bool checkDecimatingFilter()
+{
+    EMANoiseFilter<T> ema(0, 1024);
+    ema.setEdgeSnapEnabled(true);
+    return checkDecimatingRuns<EMANoiseFilter<T>, T>(ema, "EMANoiseFilter")
+           && checkDecimatingRuns<SimpleNoiseFilter<T>, T>(SimpleNoiseFilter<T>(10, 3), "SimpleNoiseFilter");
+}
+
+/**
+ * SimpleNoiseFilterBank against one SimpleNoiseFilter per channel, over several thresholds and suppression counts,
+ * with a channel count that leaves channels for the scalar tail after the SIMD kernel
+ */
+template<class T>
+bool checkSimpleNoiseFilterBank()
+{
+    const size_t channelCount = 37;
+    const size_t sampleCount = 4000;
+    const T thresholds[] = { 0, 1, 5, 10, 50 };
+    const int suppressionCounts[] = { 0, 1, 3, 5, 10 };
+
+    std::mt19937 generator(3);
+    std::vector<T> samples;
+    generateWalks(generator, channelCount, sampleCount, &samples);
+
+    for (T threshold : thresholds)
+    {
+        for (int suppressionCount : suppressionCounts)
+        {
+            SimpleNoiseFilterBank<T> bank(channelCount, threshold, suppressionCount);
+            std::vector<SimpleNoiseFilter<T>> filters(channelCount, SimpleNoiseFilter<T>(threshold, suppressionCount));
+            std::vector<T> rawValues(channelCount);
+            std::vector<T> filteredValues(channelCount);
+            bool changed[channelCount];
+
+            for (size_t i = 0; i < sampleCount; ++i)
+            {
+                for (size_t channel = 0; channel < channelCount; ++channel)
+                {
+                    rawValues[channel] = samples[channel*sampleCount + i];
+                }
+
+                const size_t changeCount = bank.update(rawValues.data(), filteredValues.data(), changed);
+                size_t expectedChangeCount = 0;
+
+                for (size_t channel = 0; channel < channelCount; ++channel)
+                {
+                    const T value = filters[channel].update(rawValues[channel]);
+                    expectedChangeCount += filters[channel].hasChanged();
+
+                    // before the first value the filters have no previous value to have changed from
+                    if (filteredValues[channel] != value || (i > 0 && changed[channel] != filters[channel].hasChanged()))
+                    {
+                        fprintf(stderr, "threshold %g, suppression count %d, sample %zu, channel %zu: %g instead of %g\n",
+                                double(threshold), suppressionCount, i, channel, double(filteredValues[channel]), double(value));
+                        return false;
+                    }
+                }
+
+                if (i > 0 && changeCount != expectedChangeCount)
+                {
+                    fprintf(stderr, "threshold %g, suppression count %d, sample %zu: %zu changes instead of %zu\n",
+                            double(threshold), suppressionCount, i, changeCount, expectedChangeCount);
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * EMANoiseFilterBank against one EMANoiseFilter per channel, with and without sleep and edge snap,
+ * with a channel count that leaves channels for the scalar tail after the SIMD kernel
+ */
+template<class T>
+bool checkEMANoiseFilterBank()
+{
+    const size_t channelCount = 37;
+    const size_t sampleCount = 4000;
+
+    std::mt19937 generator(5);
+    std::vector<T> samples;
+    generateWalks(generator, channelCount, sampleCount, &samples);
+
+    for (int optionBits = 0; optionBits < 4; ++optionBits)
+    {
+        const bool sleepEnabled = optionBits & 1;
+        const bool edgeSnapEnabled = optionBits & 2;
+
+        EMANoiseFilterBank<T> bank(channelCount, 0, 1024, sleepEnabled);
+        bank.setEdgeSnapEnabled(edgeSnapEnabled);
+        std::vector<EMANoiseFilter<T>> filters(channelCount, EMANoiseFilter<T>(0, 1024, sleepEnabled));
+        std::vector<T> rawValues(channelCount);
+        std::vector<T> filteredValues(channelCount);
+        bool changed[channelCount];
+
+        for (EMANoiseFilter<T> &filter : filters)
+        {
+            filter.setEdgeSnapEnabled(edgeSnapEnabled);
+        }
+
+        for (size_t i = 0; i < sampleCount; ++i)
+        {
+            for (size_t channel = 0; channel < channelCount; ++channel)
+            {
+                rawValues[channel] = samples[channel*sampleCount + i];
+            }
+
+            const size_t changeCount = bank.update(rawValues.data(), filteredValues.data(), changed);
+            size_t expectedChangeCount = 0;
+
+            for (size_t channel = 0; channel < channelCount; ++channel)
+            {
+                const T value = filters[channel].update(rawValues[channel]);
+                expectedChangeCount += filters[channel].hasChanged();
+
+                // before the first value the filters have no previous value to have changed from
+                if (filteredValues[channel] != value || bank.isSleeping(channel) != filters[channel].isSleeping()
+                    || (i > 0 && changed[channel] != filters[channel].hasChanged()))
+                {
+                    fprintf(stderr, "sleep %d, edge snap %d, sample %zu, channel %zu: %g instead of %g\n",
+                            sleepEnabled, edgeSnapEnabled, i, channel, double(filteredValues[channel]), double(value));
+                    return false;
+                }
+            }
+
+            if (i > 0 && changeCount != expectedChangeCount)
+            {
+                fprintf(stderr, "sleep %d, edge snap %d, sample %zu: %zu changes instead of %zu\n",
+                        sleepEnabled, edgeSnapEnabled, i, changeCount, expectedChangeCount);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * EMANoiseFilterArray against one EMANoiseFilter per channel, with a group for every snap curve and every combination
+ * of sleep and edge snap, of different channel counts. Now and then a group is disabled or enabled again.
+ */
+template<class T>
+bool checkEMANoiseFilterArray()
+{
+    const size_t sampleCount = 4000;
+    EMANoiseFilterArray<T> array;
+    std::vector<EMANoiseFilter<T>> filters;
+
+    for (SnapCurve curve : SnapCurves)
+    {
+        for (int optionBits = 0; optionBits < 4; ++optionBits)
+        {
+            typename EMANoiseFilterArray<T>::GroupParameters parameters(0, 1024, optionBits & 1);
+            parameters.edgeSnapEnabled = optionBits & 2;
+            parameters.snapCurve = curve;
+            const size_t channelCount = 1 + filters.size() % 5;
+            array.addGroup(parameters, channelCount);
+
+            EMANoiseFilter<T> filter(0, 1024, optionBits & 1);
+            filter.setEdgeSnapEnabled(optionBits & 2);
+            filter.setSnapCurve(curve);
+            filters.insert(filters.end(), channelCount, filter);
+        }
+    }
+
+    const size_t channelCount = filters.size();
+    std::mt19937 generator(13);
+    std::uniform_int_distribution<size_t> groups(0, array.groupCount() - 1);
+    std::vector<T> samples;
+    generateWalks(generator, channelCount, sampleCount, &samples);
+    std::vector<T> rawValues(channelCount);
+    std::vector<T> filteredValues(channelCount);
+    std::unique_ptr<bool[]> changed(new bool[channelCount]);
+
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        if (i % 100 == 0)
+        {
+            const size_t group = groups(generator);
+            typename EMANoiseFilterArray<T>::GroupParameters parameters = array.parameters(group);
+            parameters.enabled = !parameters.enabled;
+            array.setParameters(group, parameters);
+
+            const size_t end = group + 1 < array.groupCount() ? array.firstChannel(group + 1) : channelCount;
+            for (size_t channel = array.firstChannel(group); channel < end; ++channel)
+            {
+                filters[channel].setEnabled(parameters.enabled);
+            }
+        }
+
+        for (size_t channel = 0; channel < channelCount; ++channel)
+        {
+            rawValues[channel] = samples[channel*sampleCount + i];
+        }
+
+        const size_t changeCount = array.update(rawValues.data(), filteredValues.data(), changed.get());
+        size_t expectedChangeCount = 0;
+
+        for (size_t channel = 0; channel < channelCount; ++channel)
+        {
+            const T value = filters[channel].update(rawValues[channel]);
+            expectedChangeCount += filters[channel].hasChanged();
+
+            if (filteredValues[channel] != value || array.value(channel) != value
+                || changed[channel] != filters[channel].hasChanged() || array.hasChanged(channel) != filters[channel].hasChanged()
+                || array.isSleeping(channel) != filters[channel].isSleeping())
+            {
+                fprintf(stderr, "sample %zu, channel %zu: %g instead of %g\n",
+                        i, channel, double(filteredValues[channel]), double(value));
+                return false;
+            }
+        }
+
+        if (changeCount != expectedChangeCount)
+        {
+            fprintf(stderr, "sample %zu: %zu changes instead of %zu\n", i, changeCount, expectedChangeCount);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * The bounds fixedpointemanoisefilter.h documents for FixedPointEMANoiseFilter against EMANoiseFilter<int>,
+ * 0..1024 with the default parameters
+ */
+struct FixedPointBound
+{
+    double differingFraction;
+    int maximumDifference;
+};
+
+FixedPointBound fixedPointBound(Shape shape, bool sleepEnabled, bool edgeSnapEnabled)
+{
+    const double activityThreshold = 1024*0.01;
+    const double snapMultiplier = 0.01;
+    auto snap = [=](double difference) { return 2 - 2/(1 + difference*snapMultiplier); };
+
+    // the largest input change per sample that doesn't wake the filter by itself, the +-5 noise of the steps
+    // between the steps, and the +-16 of the random walk, see filterinputs.h
+    const double inputStep = shape == Shape::Steps ? 10 : 16;
+    const double crossingDifference = activityThreshold + 1.5*inputStep;
+
+    // the solution of y*snap(y) = activityThreshold
+    const double t = activityThreshold;
+    const double m = snapMultiplier;
+    const double snappedDistance = (t*m + sqrt(t*t*m*m + 8*m*t))/(4*m);
+
+    const int maximumDifference = 1 + (sleepEnabled ? static_cast<int>(crossingDifference*snap(crossingDifference)) : 0)
+                                  + (edgeSnapEnabled ? static_cast<int>(snappedDistance) : 0);
+
+    switch (shape)
+    {
+    case Shape::Steps:
+        return { sleepEnabled ? 0.0051 : 2.2e-5, maximumDifference };
+    case Shape::RandomWalk:
+        return { sleepEnabled ? 0.05 : 0.026, maximumDifference };
+    default:
+        return { 0, 0 };
+    }
+}
+
+/**
+ * FixedPointEMANoiseFilter and FixedPointEMANoiseFilterBank against EMANoiseFilter<int> over 1M samples of each
+ * of the input classes of filtertester-bench, with and without sleep and edge snap, failing on a documented bound
+ * that is exceeded. The bank channels get the input of the single filter with different seeds.
+ */
+bool checkFixedPointAccuracy()
+{
+    const int lowerBound = 0;
+    const int upperBound = 1024;
+    const size_t sampleCount = 1000000;
+    const size_t channelCount = 13;
+    bool passed = true;
+
+    for (Shape shape : Shapes)
+    {
+        std::vector<std::vector<int>> inputs;
+        for (size_t channel = 0; channel < channelCount; ++channel)
+        {
+            inputs.push_back(makeInput<int>(shape, sampleCount/channelCount, channel + 1, lowerBound, upperBound));
+        }
+        const std::vector<int> input = makeInput<int>(shape, sampleCount, 1, lowerBound, upperBound);
+
+        for (int optionBits = 0; optionBits < 4; ++optionBits)
+        {
+            const bool sleepEnabled = optionBits & 1;
+            const bool edgeSnapEnabled = optionBits & 2;
+            const FixedPointBound bound = fixedPointBound(shape, sleepEnabled, edgeSnapEnabled);
+
+            EMANoiseFilter<int> reference(lowerBound, upperBound, sleepEnabled);
+            reference.setEdgeSnapEnabled(edgeSnapEnabled);
+            FixedPointEMANoiseFilter filter(lowerBound, upperBound, sleepEnabled);
+            filter.setEdgeSnapEnabled(edgeSnapEnabled);
+
+            size_t differingCount = 0;
+            int maximumDifference = 0;
+            for (int value : input)
+            {
+                const int difference = std::abs(reference.update(value) - filter.update(value));
+                differingCount += difference != 0;
+                maximumDifference = std::max(maximumDifference, difference);
+            }
+
+            std::vector<EMANoiseFilter<int>> references(channelCount, EMANoiseFilter<int>(lowerBound, upperBound, sleepEnabled));
+            FixedPointEMANoiseFilterBank bank(channelCount, lowerBound, upperBound, sleepEnabled);
+            bank.setEdgeSnapEnabled(edgeSnapEnabled);
+            std::vector<int32_t> frame(channelCount);
+            std::vector<int32_t> filteredValues(channelCount);
+
+            size_t bankDifferingCount = 0;
+            int bankMaximumDifference = 0;
+            for (size_t i = 0; i < sampleCount/channelCount; ++i)
+            {
+                for (size_t channel = 0; channel < channelCount; ++channel)
+                {
+                    frame[channel] = inputs[channel][i];
+                }
+                bank.update(frame.data(), filteredValues.data());
+
+                for (size_t channel = 0; channel < channelCount; ++channel)
+                {
+                    references[channel].setEdgeSnapEnabled(edgeSnapEnabled);
+                    const int difference = std::abs(references[channel].update(frame[channel]) - filteredValues[channel]);
+                    bankDifferingCount += difference != 0;
+                    bankMaximumDifference = std::max(bankMaximumDifference, difference);
+                }
+            }
+
+            const double differingFraction = double(differingCount)/sampleCount;
+            const double bankDifferingFraction = double(bankDifferingCount)/(sampleCount/channelCount*channelCount);
+            if (differingFraction > bound.differingFraction || maximumDifference > bound.maximumDifference
+                || bankDifferingFraction > bound.differingFraction || bankMaximumDifference > bound.maximumDifference)
+            {
+                fprintf(stderr, "%s, sleep %d, edge snap %d: %.6f of the samples differ by up to %d, %.6f by up to %d in the bank, "
+                                "documented are %g by up to %d\n",
+                        shapeName(shape), sleepEnabled, edgeSnapEnabled, differingFraction, maximumDifference,
+                        bankDifferingFraction, bankMaximumDifference, bound.differingFraction, bound.maximumDifference);
+                passed = false;
+            }
+        }
+    }
+
+    return passed;
+}
+
+/**
+ * DirtyChannelScheduler ticks with enough dirty channels to go through the pool, a different half of the channels
+ * every tick, against one EMANoiseFilter per channel updated in order
+ */
+bool checkDirtyChannelScheduler()
+{
+    const size_t channelCount = 16384;
+    const EMANoiseFilter<int> filter(0, 1024);
+    DirtyChannelScheduler<EMANoiseFilter<int>> scheduler(channelCount, filter);
+    std::vector<EMANoiseFilter<int>> references(channelCount, filter);
+    WorkStealingPool pool(8);
+
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> values(0, 1024);
+
+    // the channels are only compared every 16 ticks, so that the process()es run nearly back to back
+    for (unsigned tick = 0; tick < 1024; ++tick)
+    {
+        const size_t first = (tick*1237) % channelCount;
+        for (size_t i = 0; i < channelCount/2; ++i)
+        {
+            const size_t channel = (first + i*2) % channelCount;
+            const int value = values(generator);
+            scheduler.push(channel, value);
+            references[channel].update(value);
+        }
+
+        if (scheduler.process(&pool) != channelCount/2)
+        {
+            fprintf(stderr, "tick %u: %zu dirty channels\n", tick, scheduler.dirtyChannels().size());
+            return false;
+        }
+
+        for (size_t channel = 0; channel < channelCount && tick % 16 == 15; ++channel)
+        {
+            if (scheduler.filter(channel).value() != references[channel].value())
+            {
+                fprintf(stderr, "tick %u: channel %zu is %d instead of %d\n",
+                        tick, channel, scheduler.filter(channel).value(), references[channel].value());
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+struct Check
+{
+    const char *name;
+    bool (*function)();
+};
+
+const Check Checks[] = {
+    { "work_stealing_pool", checkWorkStealingPool },
+    { "dirty_channel_scheduler", checkDirtyChannelScheduler },
+    { "simple_noise_filter_bank_int", checkSimpleNoiseFilterBank<int> },
+    { "simple_noise_filter_bank_float", checkSimpleNoiseFilterBank<float> },
+    { "ema_noise_filter_bank_int", checkEMANoiseFilterBank<int> },
+    { "ema_noise_filter_bank_float", checkEMANoiseFilterBank<float> },
+    { "ema_noise_filter_array_int", checkEMANoiseFilterArray<int> },
+    { "ema_noise_filter_array_float", checkEMANoiseFilterArray<float> },
+    { "fixed_point_accuracy", checkFixedPointAccuracy },
+    { "ema_noise_filter_advance_int", checkEMANoiseFilterAdvance<int> },
+    { "ema_noise_filter_advance_float", checkEMANoiseFilterAdvance<float> },
+    { "ema_noise_filter_advance_double", checkEMANoiseFilterAdvance<double> },
+    { "simple_noise_filter_advance_int", checkSimpleNoiseFilterAdvance<int> },
+    { "simple_noise_filter_advance_float", checkSimpleNoiseFilterAdvance<float> },
+    { "simple_noise_filter_advance_double", checkSimpleNoiseFilterAdvance<double> },
+    { "ema_noise_filter_block_update_int", checkEMANoiseFilterBlockUpdate<int> },
+    { "ema_noise_filter_block_update_float", checkEMANoiseFilterBlockUpdate<float> },
+    { "ema_noise_filter_block_update_double", checkEMANoiseFilterBlockUpdate<double> },
+    { "simple_noise_filter_block_update_int", checkSimpleNoiseFilterBlockUpdate<int> },
+    { "simple_noise_filter_block_update_float", checkSimpleNoiseFilterBlockUpdate<float> },
+    { "simple_noise_filter_block_update_double", checkSimpleNoiseFilterBlockUpdate<double> },
+    { "filter_chain_int", checkFilterChain<int> },
+    { "filter_chain_float", checkFilterChain<float> },
+    { "change_event_round_trip_int", checkChangeEventRoundTrip<int> },
+    { "change_event_round_trip_float", checkChangeEventRoundTrip<float> },
+    { "change_event_round_trip_double", checkChangeEventRoundTrip<double> },
+    { "timestamped_update_int", checkTimestampedUpdate<int> },
+    { "timestamped_update_float", checkTimestampedUpdate<float> },
+    { "timestamped_update_double", checkTimestampedUpdate<double> },
+    { "compounded_weight", checkCompoundedWeight },
+    { "decimating_filter_int", checkDecimatingFilter<int> },
+    { "decimating_filter_double", checkDecimatingFilter<double> }
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+    // with names on the command line, only those checks run
+    int failureCount = 0;
+    for (const Check &check : Checks)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i)
+        {
+            selected = selected || strcmp(argv[i], check.name) == 0;
+        }
+        if (!selected)
+        {
+            continue;
+        }
+
+        const bool passed = check.function();
+        printf("%s: %s\n", check.name, passed ? "ok" : "FAILED");
+        failureCount += !passed;
+    }
+
+    return failureCount > 0 ? 1 : 0;
+}
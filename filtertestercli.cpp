@@ -0,0 +1,731 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "changeevents.h"
+#include "emanoisefilter.h"
+#include "filterparameters.h"
+#include "simplenoisefilter.h"
+#include "tracefile.h"
+
+//Replays a recorded input trace through both filters without the GUI, as fast as the disk allows.
+
+namespace {
+
+const size_t BlockSize = 64*1024;
+
+enum class Format
+{
+    Csv,
+    Raw,
+    Trace
+};
+
+Format formatForFile(const std::string &fileName)
+{
+    const size_t dot = fileName.rfind('.');
+    const std::string extension = dot == std::string::npos ? std::string() : fileName.substr(dot);
+    if (extension == ".csv" || extension == ".txt")
+    {
+        return Format::Csv;
+    }
+
+    return extension == ".fttrace"
+           ? Format::Trace
+           : Format::Raw;
+}
+
+class SampleReader
+{
+  public:
+    virtual ~SampleReader() {}
+
+    /**
+     * @brief read reads up to BlockSize samples
+     * @param values set to the samples read, valid until the next read()
+     * @return the number of samples read, 0 at the end of the input
+     */
+    virtual size_t read(const int **values) = 0;
+};
+
+/**
+ * Reads native endian int32 samples
+ */
+class RawSampleReader : public SampleReader
+{
+  public:
+    explicit RawSampleReader(FILE *file):
+        mFile(file),
+        mBuffer(BlockSize)
+    {
+    }
+
+    size_t read(const int **values) override
+    {
+        *values = mBuffer.data();
+        return fread(mBuffer.data(), sizeof(int), BlockSize, mFile);
+    }
+
+  private:
+    FILE *mFile;
+    std::vector<int> mBuffer;
+};
+
+/**
+ * Reads one channel of an int32 trace.
+ * Planar and single channel traces are read straight out of the mapping,
+ * only the channels of multi channel interleaved traces need to be gathered.
+ */
+class TraceSampleReader : public SampleReader
+{
+  public:
+    TraceSampleReader(const TraceReader &trace, uint32_t channel):
+        mTrace(trace),
+        mChannel(channel),
+        mBlock(0),
+        mFrame(0),
+        mBlockFrame(0),
+        mBuffer(BlockSize)
+    {
+    }
+
+    size_t read(const int **values) override
+    {
+        const TraceHeader &header = mTrace.header();
+        if (mFrame >= header.frameCount)
+        {
+            return 0;
+        }
+
+        if (header.layout == TraceHeader::Interleaved && header.channelCount > 1)
+        {
+            const size_t n = std::min<uint64_t>(BlockSize, header.frameCount - mFrame);
+            const int *frames = mTrace.frames<int32_t>(mFrame) + mChannel;
+            for (size_t i = 0; i < n; ++i)
+            {
+                mBuffer[i] = frames[i*header.channelCount];
+            }
+
+            *values = mBuffer.data();
+            mFrame += n;
+            return n;
+        }
+
+        const size_t blockFrames = mTrace.blockFrameCount(mBlock);
+        const size_t n = std::min(BlockSize, blockFrames - mBlockFrame);
+        *values = mTrace.channel<int32_t>(mBlock, mChannel) + mBlockFrame;
+
+        mFrame += n;
+        mBlockFrame += n;
+        if (mBlockFrame == blockFrames)
+        {
+            ++mBlock;
+            mBlockFrame = 0;
+        }
+
+        return n;
+    }
+
+  private:
+    const TraceReader &mTrace;
+    uint32_t mChannel;
+    uint64_t mBlock;
+    uint64_t mFrame;
+    size_t mBlockFrame;
+    std::vector<int> mBuffer;
+};
+
+/**
+ * Reads the first column of every line as an integer sample.
+ * Lines that don't start with a number (e.g. a header) are skipped.
+ */
+class CsvSampleReader : public SampleReader
+{
+  public:
+    explicit CsvSampleReader(FILE *file):
+        mFile(file),
+        mValues(BlockSize),
+        mBuffer(1 << 20),
+        mBegin(0),
+        mEnd(0),
+        mEndOfFile(false)
+    {
+    }
+
+    size_t read(const int **values) override
+    {
+        size_t count = 0;
+        while (count < BlockSize)
+        {
+            const char *line = mBuffer.data() + mBegin;
+            const char *end = mBuffer.data() + mEnd;
+            const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+
+            if (!lineEnd)
+            {
+                if (mEndOfFile)
+                {
+                    if (line == end)
+                    {
+                        break;
+                    }
+                    lineEnd = end;
+                }
+                else
+                {
+                    fill();
+                    continue;
+                }
+            }
+
+            if (parseValue(line, lineEnd, &mValues[count]))
+            {
+                ++count;
+            }
+            mBegin = lineEnd == end ? mEnd : lineEnd - mBuffer.data() + 1;
+        }
+
+        *values = mValues.data();
+        return count;
+    }
+
+  private:
+    static bool parseValue(const char *begin, const char *end, int *value)
+    {
+        while (begin < end && (*begin == ' ' || *begin == '\t'))
+        {
+            ++begin;
+        }
+
+        const bool negative = begin < end && *begin == '-';
+        if (negative || (begin < end && *begin == '+'))
+        {
+            ++begin;
+        }
+
+        if (begin == end || *begin < '0' || *begin > '9')
+        {
+            return false;
+        }
+
+        int result = 0;
+        for (; begin < end && *begin >= '0' && *begin <= '9'; ++begin)
+        {
+            result = result*10 + (*begin - '0');
+        }
+
+        *value = negative ? -result : result;
+        return true;
+    }
+
+    void fill()
+    {
+        const size_t remaining = mEnd - mBegin;
+        if (remaining == mBuffer.size())
+        {
+            mBuffer.resize(mBuffer.size()*2);
+        }
+
+        memmove(mBuffer.data(), mBuffer.data() + mBegin, remaining);
+        mBegin = 0;
+        mEnd = remaining + fread(mBuffer.data() + remaining, 1, mBuffer.size() - remaining, mFile);
+        mEndOfFile = mEnd < mBuffer.size();
+    }
+
+    FILE *mFile;
+    std::vector<int> mValues;
+    std::vector<char> mBuffer;
+    size_t mBegin;
+    size_t mEnd;
+    bool mEndOfFile;
+};
+
+class SampleWriter
+{
+  public:
+    virtual ~SampleWriter() {}
+
+    virtual void write(const int *input, const int *emaOutput, const int *simpleOutput, size_t n) = 0;
+};
+
+/**
+ * Writes input, EMA output and simple output as interleaved native endian int32 triples
+ */
+class RawSampleWriter : public SampleWriter
+{
+  public:
+    explicit RawSampleWriter(FILE *file):
+        mFile(file),
+        mBuffer(BlockSize*3)
+    {
+    }
+
+    void write(const int *input, const int *emaOutput, const int *simpleOutput, size_t n) override
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            mBuffer[i*3] = input[i];
+            mBuffer[i*3 + 1] = emaOutput[i];
+            mBuffer[i*3 + 2] = simpleOutput[i];
+        }
+
+        fwrite(mBuffer.data(), sizeof(int), n*3, mFile);
+    }
+
+  private:
+    FILE *mFile;
+    std::vector<int> mBuffer;
+};
+
+/**
+ * Writes "input,ema,simple" lines
+ */
+class CsvSampleWriter : public SampleWriter
+{
+  public:
+    explicit CsvSampleWriter(FILE *file):
+        mFile(file),
+        mBuffer(BlockSize*3*12)
+    {
+        fputs("input,ema,simple\n", mFile);
+    }
+
+    void write(const int *input, const int *emaOutput, const int *simpleOutput, size_t n) override
+    {
+        char *out = mBuffer.data();
+        for (size_t i = 0; i < n; ++i)
+        {
+            out = format(out, input[i]);
+            *out++ = ',';
+            out = format(out, emaOutput[i]);
+            *out++ = ',';
+            out = format(out, simpleOutput[i]);
+            *out++ = '\n';
+        }
+
+        fwrite(mBuffer.data(), 1, out - mBuffer.data(), mFile);
+    }
+
+  private:
+    static char *format(char *out, int value)
+    {
+        unsigned int magnitude = value < 0 ? 0u - static_cast<unsigned int>(value) : value;
+        if (value < 0)
+        {
+            *out++ = '-';
+        }
+
+        char digits[10];
+        int count = 0;
+        do
+        {
+            digits[count++] = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude);
+
+        while (count)
+        {
+            *out++ = digits[--count];
+        }
+        return out;
+    }
+
+    FILE *mFile;
+    std::vector<char> mBuffer;
+};
+
+/**
+ * Writes input, EMA output and simple output as the 3 channels of an int32 trace
+ */
+class TraceSampleWriter : public SampleWriter
+{
+  public:
+    explicit TraceSampleWriter(TraceWriter &trace):
+        mTrace(trace),
+        mBuffer(BlockSize*3)
+    {
+    }
+
+    void write(const int *input, const int *emaOutput, const int *simpleOutput, size_t n) override
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            mBuffer[i*3] = input[i];
+            mBuffer[i*3 + 1] = emaOutput[i];
+            mBuffer[i*3 + 2] = simpleOutput[i];
+        }
+
+        mTrace.writeFrames<int32_t>(mBuffer.data(), n);
+    }
+
+  private:
+    TraceWriter &mTrace;
+    std::vector<int> mBuffer;
+};
+
+/**
+ * Runs one filter through a ChangeEventFilter and writes its encoded change event stream to a file,
+ * replaying the events into the filtered values when those are needed as well
+ */
+template<class Filter>
+class ChangeEventWriter
+{
+  public:
+    ChangeEventWriter(const Filter &filter, FILE *file):
+        mFilter(filter),
+        mFile(file),
+        mEvents(BlockSize),
+        mBytes(BlockSize*ChangeEventEncoder<int>::MaximumEventSize),
+        mByteCount(0)
+    {
+    }
+
+    ~ChangeEventWriter()
+    {
+        fclose(mFile);
+    }
+
+    /**
+     * @brief update filters a block and writes its events
+     * @param filteredValues receives the filtered values, nullptr if they aren't needed
+     * @return the number of changes of the filtered value, counted like the block update() of the filter
+     * counts them, so without the first event of the stream unless the first value changed the filter's output
+     */
+    size_t update(const int *rawValues, int *filteredValues, size_t n)
+    {
+        const bool firstBlock = mFilter.index() == 0;
+        const int previousValue = mFilter.filter().value();
+        const size_t eventCount = mFilter.update(rawValues, n, mEvents.data());
+        const size_t byteCount = mEncoder.encode(mEvents.data(), eventCount, mBytes.data());
+        fwrite(mBytes.data(), 1, byteCount, mFile);
+        mByteCount += byteCount;
+
+        if (filteredValues)
+        {
+            mReplay.replay(mEvents.data(), eventCount, filteredValues, n);
+        }
+        return eventCount - (firstBlock && eventCount > 0 && mEvents[0].value == previousValue);
+    }
+
+    unsigned long long byteCount() const
+    {
+        return mByteCount;
+    }
+
+  private:
+    ChangeEventFilter<Filter> mFilter;
+    ChangeEventEncoder<int> mEncoder;
+    ChangeEventReplay<int> mReplay;
+    FILE *mFile;
+    std::vector<ChangeEvent<int>> mEvents;
+    std::vector<uint8_t> mBytes;
+    unsigned long long mByteCount;
+};
+
+void printUsage()
+{
+    fprintf(stderr,
+            "Usage: filtertester-cli [options] input [output]\n"
+            "Streams a recorded input trace through the EMA and simple noise filters.\n"
+            "input and output can be - for stdin/stdout. Without an output only the throughput is reported.\n"
+            "\n"
+            "  --input-format FORMAT   csv: one sample per line, raw: native int32 samples,\n"
+            "                          trace: int32 .fttrace file, read through a memory mapping\n"
+            "                          (default: csv for .csv/.txt, trace for .fttrace, raw otherwise)\n"
+            "  --output-format FORMAT  csv: input,ema,simple lines, raw: interleaved int32 triples,\n"
+            "                          trace: .fttrace file with input, ema and simple channels\n"
+            "  --channel N             trace channel to filter (0)\n"
+            "  --ema-events FILE       write only the changes of the EMA filter output to FILE,\n"
+            "                          as a delta and varint encoded change event stream, see changeevents.h\n"
+            "  --simple-events FILE    same for the simple filter output\n"
+            "\n"
+            "%s", FilterParameters::usage());
+}
+
+bool parseFormat(const char *value, Format *format)
+{
+    if (strcmp(value, "csv") == 0)
+    {
+        *format = Format::Csv;
+        return true;
+    }
+    if (strcmp(value, "raw") == 0)
+    {
+        *format = Format::Raw;
+        return true;
+    }
+    if (strcmp(value, "trace") == 0)
+    {
+        *format = Format::Trace;
+        return true;
+    }
+    return false;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    FilterParameters parameters;
+    std::vector<std::string> files;
+    bool hasInputFormat = false;
+    bool hasOutputFormat = false;
+    Format inputFormat = Format::Raw;
+    Format outputFormat = Format::Raw;
+    uint32_t channel = 0;
+    std::string emaEventsFileName;
+    std::string simpleEventsFileName;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool consumedValue = false;
+
+        if (option == "-h" || option == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (option == "--input-format" && value && parseFormat(value, &inputFormat))
+        {
+            hasInputFormat = true;
+            consumedValue = true;
+        }
+        else if (option == "--output-format" && value && parseFormat(value, &outputFormat))
+        {
+            hasOutputFormat = true;
+            consumedValue = true;
+        }
+        else if (option == "--channel" && value)
+        {
+            channel = atoi(value);
+            consumedValue = true;
+        }
+        else if (option == "--ema-events" && value)
+        {
+            emaEventsFileName = value;
+            consumedValue = true;
+        }
+        else if (option == "--simple-events" && value)
+        {
+            simpleEventsFileName = value;
+            consumedValue = true;
+        }
+        else if (option.size() > 1 && option[0] == '-' && option[1] == '-')
+        {
+            if (!parameters.parseOption(option, value, &consumedValue))
+            {
+                fprintf(stderr, "Unknown option %s\n", option.c_str());
+                printUsage();
+                return 1;
+            }
+        }
+        else
+        {
+            files.push_back(option);
+        }
+
+        i += consumedValue;
+    }
+
+    if (files.empty() || files.size() > 2)
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (!hasInputFormat)
+    {
+        inputFormat = formatForFile(files[0]);
+    }
+    if (!hasOutputFormat && files.size() == 2)
+    {
+        outputFormat = formatForFile(files[1]);
+    }
+
+    TraceReader trace;
+    FILE *input = nullptr;
+    SampleReader *reader = nullptr;
+
+    if (inputFormat == Format::Trace)
+    {
+        if (!trace.open(files[0]))
+        {
+            fprintf(stderr, "%s\n", trace.errorString().c_str());
+            return 1;
+        }
+        if (trace.header().sampleType != TraceHeader::Int32 || channel >= trace.header().channelCount)
+        {
+            fprintf(stderr, "%s: channel %u isn't an int32 channel of the trace\n", files[0].c_str(), channel);
+            return 1;
+        }
+
+        reader = new TraceSampleReader(trace, channel);
+    }
+    else
+    {
+        input = files[0] == "-" ? stdin : fopen(files[0].c_str(), "rb");
+        if (!input)
+        {
+            perror(files[0].c_str());
+            return 1;
+        }
+
+        reader = inputFormat == Format::Csv
+                 ? static_cast<SampleReader *>(new CsvSampleReader(input))
+                 : static_cast<SampleReader *>(new RawSampleReader(input));
+    }
+
+    TraceWriter traceWriter;
+    FILE *output = nullptr;
+    SampleWriter *writer = nullptr;
+
+    if (files.size() == 2 && outputFormat == Format::Trace)
+    {
+        if (!traceWriter.open(files[1],
+                              TraceHeader::Int32,
+                              3,
+                              trace.isOpen() ? trace.header().sampleRate : 0,
+                              parameters.lowerBound,
+                              parameters.upperBound))
+        {
+            fprintf(stderr, "%s\n", traceWriter.errorString().c_str());
+            return 1;
+        }
+
+        writer = new TraceSampleWriter(traceWriter);
+    }
+    else if (files.size() == 2)
+    {
+        output = files[1] == "-" ? stdout : fopen(files[1].c_str(), "wb");
+        if (!output)
+        {
+            perror(files[1].c_str());
+            return 1;
+        }
+
+        writer = outputFormat == Format::Csv
+                 ? static_cast<SampleWriter *>(new CsvSampleWriter(output))
+                 : static_cast<SampleWriter *>(new RawSampleWriter(output));
+    }
+
+    EMANoiseFilter<int> emaNoiseFilter(parameters.lowerBound,
+                                       parameters.upperBound,
+                                       parameters.sleepEnabled,
+                                       parameters.snapMultiplier);
+    SimpleNoiseFilter<int> simpleNoiseFilter(parameters.simpleActivityThreshold,
+                                             parameters.suppressionCount);
+    parameters.configure(emaNoiseFilter);
+    parameters.configure(simpleNoiseFilter);
+
+    ChangeEventWriter<EMANoiseFilter<int>> *emaEvents = nullptr;
+    ChangeEventWriter<SimpleNoiseFilter<int>> *simpleEvents = nullptr;
+
+    if (!emaEventsFileName.empty())
+    {
+        FILE *file = fopen(emaEventsFileName.c_str(), "wb");
+        if (!file)
+        {
+            perror(emaEventsFileName.c_str());
+            return 1;
+        }
+        emaEvents = new ChangeEventWriter<EMANoiseFilter<int>>(emaNoiseFilter, file);
+    }
+    if (!simpleEventsFileName.empty())
+    {
+        FILE *file = fopen(simpleEventsFileName.c_str(), "wb");
+        if (!file)
+        {
+            perror(simpleEventsFileName.c_str());
+            return 1;
+        }
+        simpleEvents = new ChangeEventWriter<SimpleNoiseFilter<int>>(simpleNoiseFilter, file);
+    }
+
+    std::vector<int> emaValues(BlockSize);
+    std::vector<int> simpleValues(BlockSize);
+    unsigned long long sampleCount = 0;
+    unsigned long long emaChangeCount = 0;
+    unsigned long long simpleChangeCount = 0;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const int *inputValues = nullptr;
+    while (size_t n = reader->read(&inputValues))
+    {
+        // the event streams need no filtered values, they are only replayed from the events for the output
+        emaChangeCount += emaEvents
+                          ? emaEvents->update(inputValues, writer ? emaValues.data() : nullptr, n)
+                          : emaNoiseFilter.update(inputValues, emaValues.data(), n);
+        simpleChangeCount += simpleEvents
+                             ? simpleEvents->update(inputValues, writer ? simpleValues.data() : nullptr, n)
+                             : simpleNoiseFilter.update(inputValues, simpleValues.data(), n);
+
+        if (writer)
+        {
+            writer->write(inputValues, emaValues.data(), simpleValues.data(), n);
+        }
+
+        sampleCount += n;
+        trace.release(sampleCount);
+    }
+
+    delete writer;
+    delete reader;
+    traceWriter.close();
+    if (output && output != stdout)
+    {
+        fclose(output);
+    }
+    if (input && input != stdin)
+    {
+        fclose(input);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr,
+            "%llu samples in %.3f s, %.1f Msamples/s, %llu EMA changes, %llu simple changes\n",
+            sampleCount,
+            seconds,
+            seconds > 0 ? sampleCount/seconds/1e6 : 0.0,
+            emaChangeCount,
+            simpleChangeCount);
+
+    if (emaEvents)
+    {
+        fprintf(stderr, "EMA events: %llu bytes, %.4f bytes/sample\n",
+                emaEvents->byteCount(), sampleCount ? double(emaEvents->byteCount())/sampleCount : 0.0);
+    }
+    if (simpleEvents)
+    {
+        fprintf(stderr, "Simple events: %llu bytes, %.4f bytes/sample\n",
+                simpleEvents->byteCount(), sampleCount ? double(simpleEvents->byteCount())/sampleCount : 0.0);
+    }
+    delete emaEvents;
+    delete simpleEvents;
+
+    if (FilterInstrumentation::enabled())
+    {
+        const FilterCounters ema = FilterInstrumentation::total(FilterInstrumentation::EMA);
+        const FilterCounters simple = FilterInstrumentation::total(FilterInstrumentation::Simple);
+        fprintf(stderr,
+                "EMA filter: %llu updates, %llu changes, %llu sleep transitions, %llu edge snaps, %llu bound clamps\n"
+                "Simple filter: %llu updates, %llu changes, %llu suppressed samples, %llu suppression breakthroughs\n",
+                static_cast<unsigned long long>(ema.updates),
+                static_cast<unsigned long long>(ema.changes),
+                static_cast<unsigned long long>(ema.sleepTransitions),
+                static_cast<unsigned long long>(ema.edgeSnaps),
+                static_cast<unsigned long long>(ema.boundClamps),
+                static_cast<unsigned long long>(simple.updates),
+                static_cast<unsigned long long>(simple.changes),
+                static_cast<unsigned long long>(simple.suppressedSamples),
+                static_cast<unsigned long long>(simple.suppressionBreakthroughs));
+    }
+
+    return 0;
+}
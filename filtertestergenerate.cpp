@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "signalgenerator.h"
+#include "tracefile.h"
+
+//Writes a reproducible synthetic input, and the clean signal as its ground truth, to a trace.
+
+namespace {
+
+const size_t BlockSize = 64*1024;
+
+struct ShapeName
+{
+    const char *name;
+    SignalGenerator::Shape shape;
+};
+
+const ShapeName ShapeNames[] = {
+    { "constant", SignalGenerator::Shape::Constant },
+    { "step", SignalGenerator::Shape::Step },
+    { "ramp", SignalGenerator::Shape::Ramp },
+    { "sine", SignalGenerator::Shape::Sine }
+};
+
+struct NoiseName
+{
+    const char *name;
+    SignalGenerator::Noise noise;
+};
+
+const NoiseName NoiseNames[] = {
+    { "none", SignalGenerator::Noise::None },
+    { "uniform", SignalGenerator::Noise::Uniform },
+    { "gaussian", SignalGenerator::Noise::Gaussian },
+    { "impulse", SignalGenerator::Noise::Impulse },
+    { "quantization", SignalGenerator::Noise::Quantization }
+};
+
+void printUsage()
+{
+    fprintf(stderr,
+            "Usage: filtertester-generate [options] output.fttrace\n"
+            "Generates a noisy test signal on a virtual clock and writes it as channel 0 of an int32 trace,\n"
+            "with the clean signal as channel 1, e.g. for filtertester-sweep --truth-channel 1.\n"
+            "The same options always give the same trace.\n"
+            "\n"
+            "  --samples N                 samples to generate (1000000)\n"
+            "  --sample-rate X             samples per second of virtual time (1000)\n"
+            "  --seed N                    random seed (1)\n"
+            "  --shape SHAPE               constant, step, ramp or sine (step)\n"
+            "  --level X                   base level of the shape (256)\n"
+            "  --amplitude X               height of the step, ramp or sine (512)\n"
+            "  --period X                  seconds per period of the shape (2)\n"
+            "  --noise NOISE               none, uniform, gaussian, impulse or quantization (uniform)\n"
+            "  --noise-amplitude X         half range of uniform noise, standard deviation of gaussian noise,\n"
+            "                              height of the impulses (12.8)\n"
+            "  --impulse-probability X     probability of an impulse per sample (0.001)\n"
+            "  --quantization-step X       step the signal is rounded to by quantization noise (16)\n"
+            "  --lower-bound N             lower bound stored in the trace header (0)\n"
+            "  --upper-bound N             upper bound stored in the trace header (1024)\n");
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    SignalGenerator generator(1, 1000);
+    generator.setShape(SignalGenerator::Shape::Step);
+    generator.setLevel(256);
+    generator.setAmplitude(512);
+    generator.setPeriod(2);
+    generator.setNoise(SignalGenerator::Noise::Uniform);
+    generator.setNoiseAmplitude(12.8);
+    generator.setQuantizationStep(16);
+
+    unsigned long long sampleCount = 1000000;
+    int lowerBound = 0;
+    int upperBound = 1024;
+    std::string fileName;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool consumedValue = value != nullptr;
+        bool valid = true;
+
+        if (option == "-h" || option == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (option == "--samples" && value)
+        {
+            sampleCount = strtoull(value, nullptr, 10);
+        }
+        else if (option == "--sample-rate" && value)
+        {
+            generator.setSampleRate(atof(value));
+        }
+        else if (option == "--seed" && value)
+        {
+            generator.setSeed(strtoull(value, nullptr, 10));
+        }
+        else if (option == "--shape" && value)
+        {
+            valid = false;
+            for (const ShapeName &shape : ShapeNames)
+            {
+                if (strcmp(value, shape.name) == 0)
+                {
+                    generator.setShape(shape.shape);
+                    valid = true;
+                }
+            }
+        }
+        else if (option == "--level" && value)
+        {
+            generator.setLevel(atof(value));
+        }
+        else if (option == "--amplitude" && value)
+        {
+            generator.setAmplitude(atof(value));
+        }
+        else if (option == "--period" && value)
+        {
+            generator.setPeriod(atof(value));
+        }
+        else if (option == "--noise" && value)
+        {
+            valid = false;
+            for (const NoiseName &noise : NoiseNames)
+            {
+                if (strcmp(value, noise.name) == 0)
+                {
+                    generator.setNoise(noise.noise);
+                    valid = true;
+                }
+            }
+        }
+        else if (option == "--noise-amplitude" && value)
+        {
+            generator.setNoiseAmplitude(atof(value));
+        }
+        else if (option == "--impulse-probability" && value)
+        {
+            generator.setImpulseProbability(atof(value));
+        }
+        else if (option == "--quantization-step" && value)
+        {
+            generator.setQuantizationStep(atof(value));
+        }
+        else if (option == "--lower-bound" && value)
+        {
+            lowerBound = atoi(value);
+        }
+        else if (option == "--upper-bound" && value)
+        {
+            upperBound = atoi(value);
+        }
+        else if (option[0] != '-' && fileName.empty())
+        {
+            fileName = option;
+            consumedValue = false;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "Invalid option %s\n", option.c_str());
+            printUsage();
+            return 1;
+        }
+
+        i += consumedValue;
+    }
+
+    if (fileName.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    // planar, so that the input and the truth can both be read straight out of the mapping
+    TraceWriter trace;
+    if (!trace.open(fileName,
+                    TraceHeader::Int32,
+                    2,
+                    generator.sampleRate(),
+                    lowerBound,
+                    upperBound,
+                    TraceHeader::Planar,
+                    BlockSize))
+    {
+        fprintf(stderr, "%s\n", trace.errorString().c_str());
+        return 1;
+    }
+
+    std::vector<int32_t> values(BlockSize);
+    std::vector<int32_t> truth(BlockSize);
+    std::vector<int32_t> frames(BlockSize*2);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (unsigned long long written = 0; written < sampleCount;)
+    {
+        const size_t n = static_cast<size_t>(std::min<unsigned long long>(BlockSize, sampleCount - written));
+        generator.generate(values.data(), n, truth.data());
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            frames[i*2] = values[i];
+            frames[i*2 + 1] = truth[i];
+        }
+
+        trace.writeFrames(frames.data(), n);
+        written += n;
+    }
+
+    if (!trace.close())
+    {
+        fprintf(stderr, "%s\n", trace.errorString().c_str());
+        return 1;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr,
+            "%llu samples, %.3f s of virtual time, generated in %.3f s, %.1f Msamples/s\n",
+            sampleCount,
+            sampleCount/generator.sampleRate(),
+            seconds,
+            seconds > 0 ? sampleCount/seconds/1e6 : 0.0);
+
+    return 0;
+}
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "filterparameters.h"
+#include "filterpipeline.h"
+
+//Streams synthetic noisy channels through the filter pipeline and reports its throughput and latency.
+
+namespace {
+
+const size_t ProducerBlockSize = 64;
+
+struct Options
+{
+    Options():
+        seconds(5),
+        rate(0)
+    {
+        configuration.channelCount = 1024;
+        configuration.producerCount = 1;
+        configuration.workerCount = 2;
+        configuration.sinkCount = 1;
+    }
+
+    FilterPipeline::Configuration configuration;
+    double seconds;
+    double rate;    // samples/s per producer, 0 for as fast as possible
+};
+
+/**
+ * Pushes a random walk with noise on each of the channels c with c % producerCount == index
+ */
+void produce(FilterPipeline &pipeline, const Options &options, unsigned index, const std::atomic<bool> &running)
+{
+    const FilterPipeline::Configuration &configuration = pipeline.configuration();
+    if (configuration.pinThreads)
+    {
+        FilterPipeline::pinCurrentThread(configuration.firstCpu + configuration.workerCount + configuration.sinkCount + index);
+    }
+
+    const FilterParameters &parameters = configuration.parameters;
+    std::vector<uint32_t> channels;
+    for (uint32_t channel = index; channel < configuration.channelCount; channel += configuration.producerCount)
+    {
+        channels.push_back(channel);
+    }
+    if (channels.empty())
+    {
+        return;
+    }
+
+    std::mt19937 generator(index + 1);
+    std::uniform_int_distribution<int> step(-1, 1);
+    std::uniform_int_distribution<int> noise(-8, 8);
+    std::vector<int> positions(channels.size(), (parameters.lowerBound + parameters.upperBound)/2);
+
+    uint32_t blockChannels[ProducerBlockSize];
+    int32_t blockValues[ProducerBlockSize];
+    FilterPipeline::Producer &producer = pipeline.producer(index);
+
+    const uint64_t start = FilterPipeline::now();
+    uint64_t sampleCount = 0;
+    size_t next = 0;
+
+    while (running.load(std::memory_order_relaxed))
+    {
+        for (size_t i = 0; i < ProducerBlockSize; ++i)
+        {
+            int &position = positions[next];
+            position = std::max(parameters.lowerBound, std::min(parameters.upperBound, position + step(generator)));
+
+            blockChannels[i] = channels[next];
+            blockValues[i] = position + noise(generator);
+            next = next + 1 < channels.size() ? next + 1 : 0;
+        }
+
+        producer.push(blockChannels, blockValues, ProducerBlockSize);
+        sampleCount += ProducerBlockSize;
+
+        if (options.rate > 0)
+        {
+            while ((FilterPipeline::now() - start)*1e-9*options.rate < sampleCount && running.load(std::memory_order_relaxed))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+void printUsage()
+{
+    fprintf(stderr,
+            "Usage: filtertester-pipeline [options]\n"
+            "Streams synthetic noisy channels from producer threads through channel sharded filter workers to sink threads\n"
+            "and reports the throughput and the push to sink latency.\n"
+            "\n"
+            "  --channels N            channels (1024)\n"
+            "  --producers N           producer threads (1)\n"
+            "  --workers N             filter worker threads (2)\n"
+            "  --sinks N               sink threads (1)\n"
+            "  --queue N               capacity of each ring buffer (4096)\n"
+            "  --pin                   pin the workers, sinks and producers to consecutive CPUs\n"
+            "  --first-cpu N           first CPU to pin to (0)\n"
+            "  --seconds X             run time (5)\n"
+            "  --rate X                samples/s per producer, 0 for as fast as possible (0)\n"
+            "  --state FILE            start the filters from the state saved in FILE, checkpoint and save them to it\n"
+            "  --checkpoint-interval MS  time between checkpoints to the state file, 0 to only save it at the end (1000)\n"
+            "\n"
+            "%s", FilterParameters::usage());
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    FilterPipeline::Configuration &configuration = options.configuration;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool consumedValue = value != nullptr;
+
+        if (option == "-h" || option == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (option == "--channels" && value)
+        {
+            configuration.channelCount = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--producers" && value)
+        {
+            configuration.producerCount = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--workers" && value)
+        {
+            configuration.workerCount = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--sinks" && value)
+        {
+            configuration.sinkCount = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--queue" && value)
+        {
+            configuration.queueCapacity = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--pin")
+        {
+            configuration.pinThreads = true;
+            consumedValue = false;
+        }
+        else if (option == "--first-cpu" && value)
+        {
+            configuration.firstCpu = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--seconds" && value)
+        {
+            options.seconds = atof(value);
+        }
+        else if (option == "--rate" && value)
+        {
+            options.rate = atof(value);
+        }
+        else if (option == "--state" && value)
+        {
+            configuration.stateFileName = value;
+        }
+        else if (option == "--checkpoint-interval" && value)
+        {
+            configuration.checkpointInterval = strtoul(value, nullptr, 10);
+        }
+        else if (!configuration.parameters.parseOption(option, value, &consumedValue))
+        {
+            fprintf(stderr, "Unknown option %s\n", option.c_str());
+            printUsage();
+            return 1;
+        }
+
+        i += consumedValue;
+    }
+
+    // the sinks only fold the outputs into a checksum, a real service would forward them
+    std::vector<uint64_t> checksums(std::max(1u, configuration.sinkCount)*8);
+    FilterPipeline pipeline(configuration, [&](const PipelineOutput *outputs, size_t n, unsigned sink) {
+        uint64_t checksum = checksums[sink*8];
+        for (size_t i = 0; i < n; ++i)
+        {
+            checksum = checksum*31 + outputs[i].channel*7 + outputs[i].emaValue*3 + outputs[i].simpleValue;
+        }
+        checksums[sink*8] = checksum;
+    });
+
+    if (!pipeline.stateErrorString().empty())
+    {
+        fprintf(stderr, "%s, starting from scratch\n", pipeline.stateErrorString().c_str());
+    }
+
+    std::atomic<bool> running(true);
+    std::vector<std::thread> producers;
+
+    pipeline.start();
+    for (unsigned i = 0; i < pipeline.configuration().producerCount; ++i)
+    {
+        producers.push_back(std::thread(produce, std::ref(pipeline), std::cref(options), i, std::cref(running)));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+    running = false;
+    for (std::thread &producer : producers)
+    {
+        producer.join();
+    }
+    pipeline.stop();
+
+    if (!pipeline.stateErrorString().empty())
+    {
+        fprintf(stderr, "%s\n", pipeline.stateErrorString().c_str());
+    }
+
+    const FilterPipeline::Statistics statistics = pipeline.statistics();
+    const FilterPipeline::Configuration &used = pipeline.configuration();
+    printf("{\n"
+           "  \"channels\": %u,\n"
+           "  \"producers\": %u,\n"
+           "  \"workers\": %u,\n"
+           "  \"sinks\": %u,\n"
+           "  \"seconds\": %.3f,\n"
+           "  \"samples\": %llu,\n"
+           "  \"samples_per_second\": %.0f,\n"
+           "  \"producer_stalls\": %llu,\n"
+           "  \"rejected_samples\": %llu,\n"
+           "  \"worker_stalls\": %llu,\n"
+           "  \"latency_mean_ns\": %.0f,\n"
+           "  \"latency_median_ns\": %llu,\n"
+           "  \"latency_p99_ns\": %llu,\n"
+           "  \"latency_max_ns\": %llu,\n"
+           "  \"restored_channels\": %llu,\n"
+           "  \"checkpoints\": %llu\n"
+           "}\n",
+           used.channelCount,
+           used.producerCount,
+           used.workerCount,
+           used.sinkCount,
+           statistics.seconds,
+           static_cast<unsigned long long>(statistics.consumedCount),
+           statistics.seconds > 0 ? statistics.consumedCount/statistics.seconds : 0.0,
+           static_cast<unsigned long long>(statistics.producerStallCount),
+           static_cast<unsigned long long>(statistics.rejectedCount),
+           static_cast<unsigned long long>(statistics.workerStallCount),
+           statistics.meanLatency,
+           static_cast<unsigned long long>(statistics.medianLatency),
+           static_cast<unsigned long long>(statistics.p99Latency),
+           static_cast<unsigned long long>(statistics.maximumLatency),
+           static_cast<unsigned long long>(statistics.restoredCount),
+           static_cast<unsigned long long>(statistics.checkpointCount));
+
+    return statistics.consumedCount == statistics.pushedCount ? 0 : 1;
+}
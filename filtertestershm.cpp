@@ -0,0 +1,533 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "emanoisefilter.h"
+#include "filterparameters.h"
+#include "sharedmemoryring.h"
+#include "simplenoisefilter.h"
+#include "tracefile.h"
+
+//Filters sample blocks from an acquisition process in place in shared memory, and stands in for that process.
+
+namespace {
+
+struct Options
+{
+    Options():
+        inputRing("/filtertester-input"),
+        outputRing("/filtertester-output"),
+        blockLength(1024),
+        slotCount(64),
+        timeout(10000),
+        rate(0),
+        realtime(false),
+        loops(1)
+    {
+    }
+
+    std::string mode;
+    std::string traceFileName;
+    std::string outputTraceFileName;
+    std::string inputRing;
+    std::string outputRing;
+    uint32_t blockLength;
+    uint32_t slotCount;
+    unsigned timeout;   // milliseconds
+    double rate;        // frames/s, 0 for as fast as possible
+    bool realtime;
+    unsigned loops;
+    FilterParameters parameters;
+};
+
+uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * The filter engine: filters every channel of the blocks of the input ring with the EMA and the simple noise filter,
+ * straight from the input slot into the output slot. Channel c of the input becomes channel c (EMA)
+ * and channel channelCount + c (simple) of the output, which has the same block length.
+ */
+int runFilter(const Options &options)
+{
+    SharedMemoryRing input;
+    if (!input.open(options.inputRing, options.timeout))
+    {
+        fprintf(stderr, "%s\n", input.errorString().c_str());
+        return 1;
+    }
+
+    const SharedRingHeader &header = input.header();
+    if (header.sampleType != TraceHeader::Int32)
+    {
+        fprintf(stderr, "%s: the filters take int32 samples\n", options.inputRing.c_str());
+        return 1;
+    }
+
+    SharedMemoryRing output;
+    if (!output.create(options.outputRing,
+                       TraceHeader::Int32,
+                       header.channelCount*2,
+                       header.blockLength,
+                       header.slotCount,
+                       header.sampleRate,
+                       header.lowerBound,
+                       header.upperBound))
+    {
+        fprintf(stderr, "%s\n", output.errorString().c_str());
+        return 1;
+    }
+
+    const FilterParameters &parameters = options.parameters;
+    EMANoiseFilter<int> emaNoiseFilter(parameters.lowerBound,
+                                       parameters.upperBound,
+                                       parameters.sleepEnabled,
+                                       parameters.snapMultiplier);
+    SimpleNoiseFilter<int> simpleNoiseFilter(parameters.simpleActivityThreshold,
+                                             parameters.suppressionCount);
+    parameters.configure(emaNoiseFilter);
+    parameters.configure(simpleNoiseFilter);
+
+    const uint32_t channelCount = header.channelCount;
+    std::vector<EMANoiseFilter<int>> emaNoiseFilters(channelCount, emaNoiseFilter);
+    std::vector<SimpleNoiseFilter<int>> simpleNoiseFilters(channelCount, simpleNoiseFilter);
+
+    unsigned long long blockCount = 0;
+    unsigned long long frameCount = 0;
+
+    while (const SharedRingSlot *in = input.beginRead(options.timeout))
+    {
+        SharedRingSlot *out = output.beginWrite(options.timeout);
+        if (!out)
+        {
+            fprintf(stderr, "%s: nothing reads the filtered values\n", options.outputRing.c_str());
+            return 1;
+        }
+
+        const size_t n = std::min(in->frameCount, header.blockLength);
+        out->firstFrame = in->firstFrame;
+        out->timestamp = in->timestamp;
+        out->frameCount = n;
+
+        for (uint32_t channel = 0; channel < channelCount; ++channel)
+        {
+            const int32_t *rawValues = input.samples<int32_t>(in, channel);
+            emaNoiseFilters[channel].update(rawValues, output.samples<int32_t>(out, channel), n);
+            simpleNoiseFilters[channel].update(rawValues, output.samples<int32_t>(out, channelCount + channel), n);
+        }
+
+        output.publish();
+        input.release();
+
+        ++blockCount;
+        frameCount += n;
+    }
+
+    if (!input.isFinished())
+    {
+        fprintf(stderr, "%s: the acquisition process stopped\n", options.inputRing.c_str());
+        return 1;
+    }
+
+    output.closeWriting();
+    if (!output.waitUntilRead(options.timeout))
+    {
+        fprintf(stderr, "%s: the filtered values weren't all read\n", options.outputRing.c_str());
+    }
+
+    printf("{\n"
+           "  \"mode\": \"filter\",\n"
+           "  \"channels\": %u,\n"
+           "  \"block_length\": %u,\n"
+           "  \"blocks\": %llu,\n"
+           "  \"frames\": %llu,\n"
+           "  \"input_waits\": %llu,\n"
+           "  \"output_waits\": %llu\n"
+           "}\n",
+           channelCount,
+           header.blockLength,
+           blockCount,
+           frameCount,
+           static_cast<unsigned long long>(input.waitCount()),
+           static_cast<unsigned long long>(output.waitCount()));
+
+    return 0;
+}
+
+/**
+ * Copies n frames of a channel of the trace, from frame first on, whatever the layout
+ */
+void readFrames(const TraceReader &trace, uint32_t channel, uint64_t first, size_t n, int32_t *values)
+{
+    const TraceHeader &header = trace.header();
+    if (header.layout == TraceHeader::Interleaved)
+    {
+        const int32_t *frame = trace.frames<int32_t>(first) + channel;
+        for (size_t i = 0; i < n; ++i, frame += header.channelCount)
+        {
+            values[i] = *frame;
+        }
+        return;
+    }
+
+    while (n > 0)
+    {
+        const uint64_t block = first/header.blockLength;
+        const size_t offset = first % header.blockLength;
+        const size_t count = std::min(n, trace.blockFrameCount(block) - offset);
+        memcpy(values, trace.channel<int32_t>(block, channel) + offset, count*sizeof(int32_t));
+
+        values += count;
+        first += count;
+        n -= count;
+    }
+}
+
+struct DrainResult
+{
+    DrainResult():
+        ok(false),
+        frameCount(0),
+        checksum(0),
+        waitCount(0)
+    {
+    }
+
+    bool ok;
+    std::string errorString;
+    unsigned long long frameCount;
+    unsigned long long checksum;
+    unsigned long long waitCount;
+    std::vector<uint64_t> latencies;    // per block, from the producer's timestamp to the filtered block being read
+};
+
+/**
+ * Reads the output ring of the filter engine, as the downstream consumer of the filtered values would,
+ * and optionally saves them to a trace with the EMA channels first and the simple channels after them.
+ */
+void drain(const Options &options, DrainResult *result)
+{
+    SharedMemoryRing output;
+    if (!output.open(options.outputRing, options.timeout))
+    {
+        result->errorString = output.errorString();
+        return;
+    }
+
+    const SharedRingHeader &header = output.header();
+    TraceWriter trace;
+    if (!options.outputTraceFileName.empty()
+        && !trace.open(options.outputTraceFileName,
+                       TraceHeader::Int32,
+                       header.channelCount,
+                       header.sampleRate,
+                       header.lowerBound,
+                       header.upperBound))
+    {
+        result->errorString = trace.errorString();
+        return;
+    }
+
+    std::vector<int32_t> frames;
+    unsigned long long checksum = 0;
+
+    while (const SharedRingSlot *slot = output.beginRead(options.timeout))
+    {
+        result->latencies.push_back(now() - slot->timestamp);
+
+        const size_t n = std::min(slot->frameCount, header.blockLength);
+        for (uint32_t channel = 0; channel < header.channelCount; ++channel)
+        {
+            const int32_t *values = output.samples<int32_t>(slot, channel);
+            for (size_t i = 0; i < n; ++i)
+            {
+                checksum = checksum*31 + values[i];
+            }
+        }
+
+        if (trace.isOpen())
+        {
+            frames.resize(n*header.channelCount);
+            for (uint32_t channel = 0; channel < header.channelCount; ++channel)
+            {
+                const int32_t *values = output.samples<int32_t>(slot, channel);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    frames[i*header.channelCount + channel] = values[i];
+                }
+            }
+            trace.writeFrames(frames.data(), n);
+        }
+
+        output.release();
+        result->frameCount += n;
+    }
+
+    result->checksum = checksum;
+    result->waitCount = output.waitCount();
+    if (trace.isOpen() && !trace.close())
+    {
+        result->errorString = trace.errorString();
+        return;
+    }
+
+    result->ok = output.isFinished();
+    if (!result->ok)
+    {
+        result->errorString = options.outputRing + ": the filter engine stopped";
+    }
+}
+
+/**
+ * The stand-in for the acquisition process: replays a trace into the input ring, block by block,
+ * and reads the filtered values back from the output ring on a second thread
+ */
+int runReplay(const Options &options)
+{
+    TraceReader trace;
+    if (!trace.open(options.traceFileName))
+    {
+        fprintf(stderr, "%s\n", trace.errorString().c_str());
+        return 1;
+    }
+
+    const TraceHeader &traceHeader = trace.header();
+    if (traceHeader.sampleType != TraceHeader::Int32 || traceHeader.frameCount == 0)
+    {
+        fprintf(stderr, "%s: the filters take int32 samples\n", options.traceFileName.c_str());
+        return 1;
+    }
+
+    SharedMemoryRing input;
+    if (!input.create(options.inputRing,
+                      TraceHeader::Int32,
+                      traceHeader.channelCount,
+                      options.blockLength,
+                      options.slotCount,
+                      traceHeader.sampleRate,
+                      traceHeader.lowerBound,
+                      traceHeader.upperBound))
+    {
+        fprintf(stderr, "%s\n", input.errorString().c_str());
+        return 1;
+    }
+
+    DrainResult drainResult;
+    std::thread drainer(drain, std::cref(options), &drainResult);
+
+    const double rate = options.realtime ? traceHeader.sampleRate : options.rate;
+    const uint64_t start = now();
+    uint64_t frame = 0;
+    bool stalled = false;
+
+    for (unsigned loop = 0; loop < options.loops && !stalled; ++loop)
+    {
+        for (uint64_t first = 0; first < traceHeader.frameCount; first += options.blockLength)
+        {
+            if (rate > 0)
+            {
+                const uint64_t due = start + static_cast<uint64_t>(frame*1e9/rate);
+                const uint64_t time = now();
+                if (due > time)
+                {
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(due - time));
+                }
+            }
+
+            SharedRingSlot *slot = input.beginWrite(options.timeout);
+            if (!slot)
+            {
+                fprintf(stderr, "%s: nothing reads the samples\n", options.inputRing.c_str());
+                stalled = true;
+                break;
+            }
+
+            const size_t n = std::min<uint64_t>(options.blockLength, traceHeader.frameCount - first);
+            for (uint32_t channel = 0; channel < traceHeader.channelCount; ++channel)
+            {
+                readFrames(trace, channel, first, n, input.samples<int32_t>(slot, channel));
+            }
+
+            slot->firstFrame = frame;
+            slot->frameCount = n;
+            slot->timestamp = now();
+            input.publish();
+            frame += n;
+        }
+    }
+
+    input.closeWriting();
+    drainer.join();
+    const double seconds = (now() - start)*1e-9;
+
+    if (!drainResult.ok)
+    {
+        fprintf(stderr, "%s\n", drainResult.errorString.c_str());
+        return 1;
+    }
+
+    std::vector<uint64_t> &latencies = drainResult.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    double meanLatency = 0;
+    for (uint64_t latency : latencies)
+    {
+        meanLatency += latency;
+    }
+    meanLatency /= latencies.size();
+
+    printf("{\n"
+           "  \"mode\": \"replay\",\n"
+           "  \"channels\": %u,\n"
+           "  \"block_length\": %u,\n"
+           "  \"slots\": %u,\n"
+           "  \"frames\": %llu,\n"
+           "  \"filtered_frames\": %llu,\n"
+           "  \"seconds\": %.3f,\n"
+           "  \"samples_per_second\": %.0f,\n"
+           "  \"producer_waits\": %llu,\n"
+           "  \"reader_waits\": %llu,\n"
+           "  \"block_latency_mean_ns\": %.0f,\n"
+           "  \"block_latency_median_ns\": %llu,\n"
+           "  \"block_latency_p99_ns\": %llu,\n"
+           "  \"block_latency_max_ns\": %llu,\n"
+           "  \"checksum\": %llu\n"
+           "}\n",
+           traceHeader.channelCount,
+           input.header().blockLength,
+           input.header().slotCount,
+           static_cast<unsigned long long>(frame),
+           drainResult.frameCount,
+           seconds,
+           seconds > 0 ? frame*traceHeader.channelCount/seconds : 0.0,
+           static_cast<unsigned long long>(input.waitCount()),
+           drainResult.waitCount,
+           meanLatency,
+           static_cast<unsigned long long>(latencies[latencies.size()/2]),
+           static_cast<unsigned long long>(latencies[latencies.size()*99/100]),
+           static_cast<unsigned long long>(latencies.back()),
+           drainResult.checksum);
+
+    return !stalled && drainResult.frameCount == frame ? 0 : 1;
+}
+
+void printUsage()
+{
+    fprintf(stderr,
+            "Usage: filtertester-shm filter [options]\n"
+            "       filtertester-shm replay [options] trace\n"
+            "filter: the filter engine. Reads sample blocks from the input ring an acquisition process has created,\n"
+            "filters them in place with the EMA and simple noise filters and writes the filtered values to the output ring,\n"
+            "with the EMA values of the channels first and the simple values after them. Exits once the input ring is closed,\n"
+            "or with an error when no block arrives for --timeout.\n"
+            "replay: stands in for the acquisition process. Creates the input ring, replays an int32 .fttrace into it,\n"
+            "reads the filtered values back from the output ring and reports the throughput and the block latency.\n"
+            "Start the filter engine within --timeout of the replay.\n"
+            "\n"
+            "  --input-ring NAME       shared memory name of the input ring (/filtertester-input)\n"
+            "  --output-ring NAME      shared memory name of the output ring (/filtertester-output)\n"
+            "  --timeout MS            time to wait for the other process (10000)\n"
+            "replay options:\n"
+            "  --block N               frames per block (1024)\n"
+            "  --slots N               blocks in each ring, rounded up to a power of two (64)\n"
+            "  --rate X                frames/s, 0 for as fast as possible (0)\n"
+            "  --realtime              replay at the sample rate of the trace\n"
+            "  --loops N               replay the trace N times (1)\n"
+            "  --output-trace FILE     save the filtered values to an .fttrace file\n"
+            "\n"
+            "%s", FilterParameters::usage());
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    std::vector<std::string> arguments;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool consumedValue = value != nullptr;
+
+        if (option == "-h" || option == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (option == "--input-ring" && value)
+        {
+            options.inputRing = value;
+        }
+        else if (option == "--output-ring" && value)
+        {
+            options.outputRing = value;
+        }
+        else if (option == "--timeout" && value)
+        {
+            options.timeout = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--block" && value)
+        {
+            options.blockLength = std::max(1ul, strtoul(value, nullptr, 10));
+        }
+        else if (option == "--slots" && value)
+        {
+            options.slotCount = std::max(1ul, strtoul(value, nullptr, 10));
+        }
+        else if (option == "--rate" && value)
+        {
+            options.rate = atof(value);
+        }
+        else if (option == "--realtime")
+        {
+            options.realtime = true;
+            consumedValue = false;
+        }
+        else if (option == "--loops" && value)
+        {
+            options.loops = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--output-trace" && value)
+        {
+            options.outputTraceFileName = value;
+        }
+        else if (option.size() > 1 && option[0] == '-' && option[1] == '-')
+        {
+            if (!options.parameters.parseOption(option, value, &consumedValue))
+            {
+                fprintf(stderr, "Unknown option %s\n", option.c_str());
+                printUsage();
+                return 1;
+            }
+        }
+        else
+        {
+            arguments.push_back(option);
+            consumedValue = false;
+        }
+
+        i += consumedValue;
+    }
+
+    if (arguments.size() == 1 && arguments[0] == "filter")
+    {
+        return runFilter(options);
+    }
+    if (arguments.size() == 2 && arguments[0] == "replay")
+    {
+        options.traceFileName = arguments[1];
+        return runReplay(options);
+    }
+
+    printUsage();
+    return 1;
+}
@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "filterparameters.h"
+#include "parametersweep.h"
+#include "tracefile.h"
+#include "workstealingpool.h"
+
+//Sweeps the filter parameters over a recorded trace and ranks them by how close the output is to a ground truth signal.
+
+namespace {
+
+enum class OutputFormat
+{
+    Table,
+    Csv
+};
+
+struct Options
+{
+    Options():
+        inputChannel(0),
+        truthChannel(3),
+        randomCount(0),
+        seed(1),
+        threadCount(0),
+        lagWeight(1.0),
+        changeWeight(1.0),
+        top(10),
+        outputFormat(OutputFormat::Table)
+    {
+        ranges.snapMultiplier = { 0.001, 0.1, 20 };
+        ranges.emaActivityThreshold = { 0, 50, 26 };
+        ranges.simpleActivityThreshold = { 0, 50, 26 };
+        ranges.suppressionCount = { 0, 20, 21 };
+    }
+
+    std::string inputFileName;
+    std::string truthFileName;
+    uint32_t inputChannel;
+    uint32_t truthChannel;
+    SweepRanges ranges;
+    size_t randomCount;
+    unsigned int seed;
+    unsigned int threadCount;
+    double lagWeight;
+    double changeWeight;
+    size_t top;
+    OutputFormat outputFormat;
+};
+
+/**
+ * @brief cost combines the score into a single number to rank by, lower is better.
+ * The change count is per 1000 samples, so that the weights don't depend on the length of the trace.
+ */
+double cost(const SweepScore &score, size_t sampleCount, const Options &options)
+{
+    return score.rmsError
+           + options.lagWeight*fabs(score.lag)
+           + options.changeWeight*score.changeCount*1000.0/std::max<size_t>(sampleCount, 1);
+}
+
+bool readChannel(const std::string &fileName, uint32_t channel, std::vector<int> *samples)
+{
+    TraceReader trace;
+    if (!trace.open(fileName))
+    {
+        fprintf(stderr, "%s\n", trace.errorString().c_str());
+        return false;
+    }
+
+    if (!trace.readChannel<int32_t>(channel, samples))
+    {
+        fprintf(stderr, "%s: channel %u isn't an int32 channel of the trace\n", fileName.c_str(), channel);
+        return false;
+    }
+
+    return true;
+}
+
+void printUsage()
+{
+    fprintf(stderr,
+            "Usage: filtertester-sweep [options] trace.fttrace\n"
+            "Runs the EMA and simple noise filters over a recorded trace with every combination of the swept parameters\n"
+            "and ranks them by RMS error, lag and output changes against a ground truth channel.\n"
+            "Ranges are MIN:MAX:STEPS, or a single value.\n"
+            "\n"
+            "  --input-channel N            channel with the raw input (0)\n"
+            "  --truth FILE                 trace with the ground truth (the input trace)\n"
+            "  --truth-channel N            channel with the ground truth, the slider position\n"
+            "                               in GUI recordings (3)\n"
+            "  --snap-multipliers RANGE     EMA filter snap multipliers (0.001:0.1:20)\n"
+            "  --ema-thresholds RANGE       EMA filter activity thresholds (0:50:26)\n"
+            "  --simple-thresholds RANGE    simple filter activity thresholds (0:50:26)\n"
+            "  --suppression-counts RANGE   simple filter suppression counts (0:20:21)\n"
+            "  --random N                   N random configurations of each filter instead of the grid\n"
+            "  --seed N                     seed of the random configurations (1)\n"
+            "  --threads N                  worker threads, 0 for one per hardware thread (0)\n"
+            "  --lag-weight X               cost of a sample of lag, in RMS error units (1)\n"
+            "  --change-weight X            cost of an output change per 1000 samples, in RMS error units (1)\n"
+            "  --top N                      configurations listed per filter, 0 for all (10)\n"
+            "  --output FORMAT              table or csv (table)\n"
+            "\n"
+            "%s", FilterParameters::usage());
+}
+
+bool parseRange(const char *value, SweepRange *range)
+{
+    SweepRange parsed;
+    if (!parsed.parse(value))
+    {
+        fprintf(stderr, "Invalid range %s\n", value);
+        return false;
+    }
+
+    *range = parsed;
+    return true;
+}
+
+void printResults(const std::vector<SweepResult> &results, size_t sampleCount, const Options &options)
+{
+    if (options.outputFormat == OutputFormat::Csv)
+    {
+        printf("filter,snap_multiplier,activity_threshold,suppression_count,rms_error,lag,changes,cost\n");
+    }
+
+    const SweepConfiguration::Filter filters[] = { SweepConfiguration::EMA, SweepConfiguration::Simple };
+    for (SweepConfiguration::Filter filter : filters)
+    {
+        std::vector<const SweepResult *> ranked;
+        for (const SweepResult &result : results)
+        {
+            if (result.configuration.filter == filter)
+            {
+                ranked.push_back(&result);
+            }
+        }
+
+        std::stable_sort(ranked.begin(), ranked.end(), [&](const SweepResult *a, const SweepResult *b) {
+            return cost(a->score, sampleCount, options) < cost(b->score, sampleCount, options);
+        });
+
+        if (options.top > 0 && ranked.size() > options.top)
+        {
+            ranked.resize(options.top);
+        }
+
+        const char *name = filter == SweepConfiguration::EMA ? "ema" : "simple";
+        if (options.outputFormat == OutputFormat::Table && !ranked.empty())
+        {
+            printf("%s\n", filter == SweepConfiguration::EMA
+                           ? "EMA filter\n  snap    threshold      rms error        lag    changes       cost"
+                           : "Simple filter\n  threshold  suppression      rms error        lag    changes       cost");
+        }
+
+        for (const SweepResult *result : ranked)
+        {
+            const SweepConfiguration &configuration = result->configuration;
+            const SweepScore &score = result->score;
+            const double resultCost = cost(score, sampleCount, options);
+
+            if (options.outputFormat == OutputFormat::Csv)
+            {
+                printf("%s,%g,%d,%d,%.6f,%.6f,%llu,%.6f\n",
+                       name,
+                       configuration.snapMultiplier,
+                       configuration.activityThreshold,
+                       configuration.suppressionCount,
+                       score.rmsError,
+                       score.lag,
+                       static_cast<unsigned long long>(score.changeCount),
+                       resultCost);
+            }
+            else if (filter == SweepConfiguration::EMA)
+            {
+                printf("  %-7.4g %9d %14.4f %10.3f %10llu %10.4f\n",
+                       configuration.snapMultiplier,
+                       configuration.activityThreshold,
+                       score.rmsError,
+                       score.lag,
+                       static_cast<unsigned long long>(score.changeCount),
+                       resultCost);
+            }
+            else
+            {
+                printf("  %9d %12d %14.4f %10.3f %10llu %10.4f\n",
+                       configuration.activityThreshold,
+                       configuration.suppressionCount,
+                       score.rmsError,
+                       score.lag,
+                       static_cast<unsigned long long>(score.changeCount),
+                       resultCost);
+            }
+        }
+
+        if (options.outputFormat == OutputFormat::Table && !ranked.empty())
+        {
+            printf("\n");
+        }
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    FilterParameters parameters;
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool consumedValue = value != nullptr;
+
+        if (option == "-h" || option == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (option == "--input-channel" && value)
+        {
+            options.inputChannel = atoi(value);
+        }
+        else if (option == "--truth" && value)
+        {
+            options.truthFileName = value;
+        }
+        else if (option == "--truth-channel" && value)
+        {
+            options.truthChannel = atoi(value);
+        }
+        else if (option == "--snap-multipliers" && value)
+        {
+            if (!parseRange(value, &options.ranges.snapMultiplier))
+            {
+                return 1;
+            }
+        }
+        else if (option == "--ema-thresholds" && value)
+        {
+            if (!parseRange(value, &options.ranges.emaActivityThreshold))
+            {
+                return 1;
+            }
+        }
+        else if (option == "--simple-thresholds" && value)
+        {
+            if (!parseRange(value, &options.ranges.simpleActivityThreshold))
+            {
+                return 1;
+            }
+        }
+        else if (option == "--suppression-counts" && value)
+        {
+            if (!parseRange(value, &options.ranges.suppressionCount))
+            {
+                return 1;
+            }
+        }
+        else if (option == "--random" && value)
+        {
+            options.randomCount = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--seed" && value)
+        {
+            options.seed = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--threads" && value)
+        {
+            options.threadCount = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--lag-weight" && value)
+        {
+            options.lagWeight = atof(value);
+        }
+        else if (option == "--change-weight" && value)
+        {
+            options.changeWeight = atof(value);
+        }
+        else if (option == "--top" && value)
+        {
+            options.top = strtoul(value, nullptr, 10);
+        }
+        else if (option == "--output" && value && (std::string(value) == "table" || std::string(value) == "csv"))
+        {
+            options.outputFormat = std::string(value) == "csv" ? OutputFormat::Csv : OutputFormat::Table;
+        }
+        else if (option.size() > 1 && option[0] == '-' && option[1] == '-')
+        {
+            if (!parameters.parseOption(option, value, &consumedValue))
+            {
+                fprintf(stderr, "Unknown option %s\n", option.c_str());
+                printUsage();
+                return 1;
+            }
+        }
+        else if (options.inputFileName.empty())
+        {
+            options.inputFileName = option;
+            consumedValue = false;
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+
+        i += consumedValue;
+    }
+
+    if (options.inputFileName.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<int> input;
+    std::vector<int> truth;
+    if (!readChannel(options.inputFileName, options.inputChannel, &input)
+        || !readChannel(options.truthFileName.empty() ? options.inputFileName : options.truthFileName,
+                        options.truthChannel,
+                        &truth))
+    {
+        return 1;
+    }
+
+    if (truth.size() != input.size())
+    {
+        fprintf(stderr, "The input has %zu samples, the truth %zu\n", input.size(), truth.size());
+        return 1;
+    }
+
+    const std::vector<SweepConfiguration> configurations = options.randomCount > 0
+                                                           ? ParameterSweep::random(options.ranges, options.randomCount, options.seed)
+                                                           : ParameterSweep::grid(options.ranges);
+
+    WorkStealingPool pool(options.threadCount);
+    const ParameterSweep sweep(input.data(), truth.data(), input.size(), parameters);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::vector<SweepResult> results = sweep.run(configurations, pool);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printResults(results, input.size(), options);
+
+    const double sampleCount = static_cast<double>(input.size())*configurations.size();
+    fprintf(stderr,
+            "%zu configurations of %zu samples in %.3f s on %u threads, %.1f Msamples/s, %zu steals\n",
+            configurations.size(),
+            input.size(),
+            seconds,
+            pool.threadCount(),
+            seconds > 0 ? sampleCount/seconds/1e6 : 0.0,
+            pool.stealCount());
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include "filterworker.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "emanoisefilter.h"
+#include "simplenoisefilter.h"
+
+FilterWorker::FilterWorker(const FilterParameters &parameters, double sampleRate):
+    mParameters(parameters),
+    mFrames(Frame()),
+    mSamples(SampleQueueCapacity),
+    mDroppedSampleCount(0),
+    mInput(0),
+    mNoiseEnabled(false),
+    mNoise(static_cast<int>(SignalGenerator::Noise::Uniform)),
+    mSampleRate(sampleRate),
+    mStopping(false),
+    mRecording(false)
+{
+    mThread = std::thread(&FilterWorker::run, this);
+}
+
+FilterWorker::~FilterWorker()
+{
+    mStopping = true;
+    mThread.join();
+
+    std::string errorString;
+    stopRecording(&errorString);
+}
+
+bool FilterWorker::startRecording(const std::string &fileName,
+                                  int lowerBound,
+                                  int upperBound,
+                                  std::string *errorString)
+{
+    std::lock_guard<std::mutex> lock(mTraceMutex);
+
+    if (!mTraceWriter.open(fileName,
+                           TraceHeader::Int32,
+                           4,
+                           mSampleRate.load(std::memory_order_relaxed),
+                           lowerBound,
+                           upperBound))
+    {
+        *errorString = mTraceWriter.errorString();
+        return false;
+    }
+
+    mRecording = true;
+    return true;
+}
+
+bool FilterWorker::stopRecording(std::string *errorString)
+{
+    std::lock_guard<std::mutex> lock(mTraceMutex);
+    mRecording = false;
+
+    if (mTraceWriter.isOpen() && !mTraceWriter.close())
+    {
+        *errorString = mTraceWriter.errorString();
+        return false;
+    }
+    return true;
+}
+
+void FilterWorker::run()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    FilterParameters parameters;
+    mParameters.read(&parameters);
+
+    EMANoiseFilter<int> emaNoiseFilter(parameters.lowerBound,
+                                       parameters.upperBound,
+                                       parameters.sleepEnabled,
+                                       parameters.snapMultiplier);
+    SimpleNoiseFilter<int> simpleNoiseFilter(parameters.simpleActivityThreshold,
+                                             parameters.suppressionCount);
+    parameters.configure(emaNoiseFilter);
+    parameters.configure(simpleNoiseFilter);
+
+    // a fixed seed, so that every run of the tester gets the same noise
+    SignalGenerator generator(1);
+
+    int values[BlockSize];
+    int emaValues[BlockSize];
+    int simpleValues[BlockSize];
+    int32_t frames[BlockSize*4];
+    Sample samples[BlockSize];
+
+    Frame frame = Frame();
+    double sampleRate = 0;
+    Clock::time_point start;
+    uint64_t dueSampleCount = 0;
+
+    while (!mStopping.load(std::memory_order_relaxed))
+    {
+        if (mParameters.read(&parameters))
+        {
+            parameters.configure(emaNoiseFilter);
+            parameters.configure(simpleNoiseFilter);
+        }
+
+        const Clock::time_point now = Clock::now();
+        const double rate = mSampleRate.load(std::memory_order_relaxed);
+        if (rate != sampleRate)
+        {
+            sampleRate = rate;
+            generator.setSampleRate(rate);
+            start = now;
+            dueSampleCount = 0;
+        }
+
+        const double elapsed = std::chrono::duration<double>(now - start).count();
+        const uint64_t targetSampleCount = static_cast<uint64_t>(elapsed*sampleRate);
+        if (targetSampleCount - dueSampleCount > sampleRate*0.1 + BlockSize)
+        {
+            // more than 100 ms behind, the filters can't keep up with the rate: drop the backlog instead of spiralling
+            dueSampleCount = targetSampleCount - BlockSize;
+        }
+
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(targetSampleCount - dueSampleCount, BlockSize));
+        if (n == 0)
+        {
+            const double wait = sampleRate > 0 ? 1.0/sampleRate : 0.01;
+            std::this_thread::sleep_for(std::chrono::duration<double>(std::min(wait, 0.001)));
+            continue;
+        }
+        dueSampleCount += n;
+
+        // the uniform noise spans 1/40 of the range between the bounds, like the tester always had
+        const int input = mInput.load(std::memory_order_relaxed);
+        const double range = parameters.upperBound - parameters.lowerBound;
+        generator.setLevel(input);
+        generator.setNoise(mNoiseEnabled.load(std::memory_order_relaxed)
+                           ? static_cast<SignalGenerator::Noise>(mNoise.load(std::memory_order_relaxed))
+                           : SignalGenerator::Noise::None);
+        generator.setNoiseAmplitude(generator.noise() == SignalGenerator::Noise::Impulse ? range/10 : range/80);
+        generator.setImpulseProbability(0.01);
+        generator.setQuantizationStep(std::max(1.0, range/40));
+        generator.generate(values, n);
+        const int lastNoise = values[n - 1] - input;
+
+        emaNoiseFilter.update(values, emaValues, n);
+        simpleNoiseFilter.update(values, simpleValues, n);
+
+        if (mRecording.load(std::memory_order_relaxed))
+        {
+            // the slider position without the noise is the ground truth for filtertester-sweep
+            for (size_t i = 0; i < n; ++i)
+            {
+                frames[i*4] = values[i];
+                frames[i*4 + 1] = emaValues[i];
+                frames[i*4 + 2] = simpleValues[i];
+                frames[i*4 + 3] = input;
+            }
+
+            std::lock_guard<std::mutex> lock(mTraceMutex);
+            if (mTraceWriter.isOpen())
+            {
+                mTraceWriter.writeFrames(frames, n);
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            samples[i].value = values[i];
+            samples[i].emaOutput = emaValues[i];
+            samples[i].simpleOutput = simpleValues[i];
+        }
+
+        const size_t queued = mSamples.push(samples, n);
+        if (queued < n)
+        {
+            mDroppedSampleCount.store(mDroppedSampleCount.load(std::memory_order_relaxed) + n - queued,
+                                      std::memory_order_relaxed);
+        }
+
+        frame.input = input;
+        frame.noise = lastNoise;
+        frame.value = values[n - 1];
+        frame.emaOutput = emaValues[n - 1];
+        frame.simpleOutput = simpleValues[n - 1];
+        frame.sampleCount += n;
+        mFrames.publish(frame);
+    }
+}
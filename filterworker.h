@@ -0,0 +1,142 @@
+#ifndef FILTER_WORKER_H
+#define FILTER_WORKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "filterparameters.h"
+#include "signalgenerator.h"
+#include "spscringbuffer.h"
+#include "tracefile.h"
+#include "triplebuffer.h"
+
+/**
+ * Runs the EMA and simple noise filters of the tester on their own thread, at a simulated sample rate,
+ * so that the filter rate isn't bound by how fast the GUI can repaint.
+ *
+ * The GUI sets the input, noise and parameters through atomics and a TripleBuffer,
+ * and picks up the latest Frame with readFrame() whenever it repaints. Neither side waits for the other.
+ */
+class FilterWorker
+{
+  public:
+    struct Frame
+    {
+        int input;              // the slider position
+        int noise;              // the noise added to the last sample
+        int value;              // input + noise, what the filters got
+        int emaOutput;
+        int simpleOutput;
+        uint64_t sampleCount;   // samples filtered since the worker started
+    };
+
+    struct Sample
+    {
+        int32_t value;
+        int32_t emaOutput;
+        int32_t simpleOutput;
+    };
+
+    FilterWorker(const FilterParameters &parameters, double sampleRate);
+    ~FilterWorker();
+
+    FilterWorker(const FilterWorker &) = delete;
+    FilterWorker &operator=(const FilterWorker &) = delete;
+
+    void setParameters(const FilterParameters &parameters)
+    {
+        mParameters.publish(parameters);
+    }
+
+    void setInput(int input)
+    {
+        mInput.store(input, std::memory_order_relaxed);
+    }
+
+    void setNoiseEnabled(bool enabled)
+    {
+        mNoiseEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief setNoise selects the distribution of the noise, scaled to the range between the bounds
+     */
+    void setNoise(SignalGenerator::Noise noise)
+    {
+        mNoise.store(static_cast<int>(noise), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief setSampleRate
+     * @param sampleRate samples per second
+     */
+    void setSampleRate(double sampleRate)
+    {
+        mSampleRate.store(sampleRate, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief readFrame
+     * @param frame set to the latest frame
+     * @return true if there is a new frame since the last call
+     */
+    bool readFrame(Frame *frame)
+    {
+        return mFrames.read(frame);
+    }
+
+    /**
+     * @brief readSamples takes up to n of the samples filtered since the last call, e.g. for a plot.
+     * When they aren't read for a while the worker drops the newest ones, see droppedSampleCount().
+     * @return the number of samples read
+     */
+    size_t readSamples(Sample *samples, size_t n)
+    {
+        return mSamples.pop(samples, n);
+    }
+
+    uint64_t droppedSampleCount() const
+    {
+        return mDroppedSampleCount.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief startRecording records the input, both outputs and the slider position to a trace,
+     * with the current sample rate as its sample rate
+     */
+    bool startRecording(const std::string &fileName,
+                        int lowerBound,
+                        int upperBound,
+                        std::string *errorString);
+    bool stopRecording(std::string *errorString);
+
+  private:
+    static const size_t BlockSize = 1024;
+    static const size_t SampleQueueCapacity = 1 << 20;
+
+    void run();
+
+    TripleBuffer<FilterParameters> mParameters;
+    TripleBuffer<Frame> mFrames;
+    SpscRingBuffer<Sample> mSamples;
+    std::atomic<uint64_t> mDroppedSampleCount;
+    std::atomic<int> mInput;
+    std::atomic<bool> mNoiseEnabled;
+    std::atomic<int> mNoise;
+    std::atomic<double> mSampleRate;
+    std::atomic<bool> mStopping;
+
+    // the mutex is only taken once per block, and only while recording
+    std::mutex mTraceMutex;
+    std::atomic<bool> mRecording;
+    TraceWriter mTraceWriter;
+
+    std::thread mThread;
+};
+
+#endif
@@ -0,0 +1,416 @@
+#ifndef FIXED_POINT_EMA_NOISE_FILTER_H
+#define FIXED_POINT_EMA_NOISE_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Scalar version of the integer vector traits used by the fixed point kernel.
+ * Masks are 0 or -1 like the SIMD compare results, so the scalar and the vector code
+ * run exactly the same arithmetic and produce the same output.
+ */
+struct FixedPointScalar
+{
+    typedef int32_t Integer;
+    static const size_t Width = 1;
+
+    static Integer load(const int32_t *values) { return *values; }
+    static void store(int32_t *values, Integer v) { *values = v; }
+    static Integer set(int32_t value) { return value; }
+    static Integer add(Integer a, Integer b) { return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+    static Integer sub(Integer a, Integer b) { return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b)); }
+    static Integer mul(Integer a, Integer b) { return static_cast<int32_t>(static_cast<uint32_t>(a)*static_cast<uint32_t>(b)); }
+    static Integer min(Integer a, Integer b) { return a < b ? a : b; }
+    static Integer abs(Integer a) { return a < 0 ? -a : a; }
+    template<int Bits> static Integer shiftLeft(Integer a) { return static_cast<int32_t>(static_cast<uint32_t>(a) << Bits); }
+    template<int Bits> static Integer shiftRight(Integer a) { return a >> Bits; }
+    static Integer greater(Integer a, Integer b) { return -(a > b); }
+    static Integer equal(Integer a, Integer b) { return -(a == b); }
+    static Integer maskAnd(Integer a, Integer b) { return a & b; }
+    static Integer maskOr(Integer a, Integer b) { return a | b; }
+    static Integer maskXor(Integer a, Integer b) { return a ^ b; }
+    static Integer maskAndNot(Integer a, Integer b) { return ~a & b; }
+    static Integer select(Integer mask, Integer a, Integer b) { return (mask & a) | (~mask & b); }
+    static int bits(Integer mask) { return mask & 1; }
+};
+
+/**
+ * EMANoiseFilter<int>::getFilteredValue() in 32 bit integer arithmetic, without divisions or branches,
+ * written against the vector traits V (FixedPointScalar, or the SIMD traits of FixedPointEMANoiseFilterBank).
+ *
+ * Number formats:
+ * - the error EMA and the activity threshold are Q8 (8 fractional bits), the threshold is rounded up
+ *   so that comparing integers against it gives the same result as comparing against the real threshold
+ * - the snap multiplier is Q16, the snap curve and its reciprocal are Q15
+ * - the 0.4 error EMA coefficient is applied with shifts and adds, 0.4 = 0.375*(1 + 1/16)*(1 + 1/256)*(1 + 1/65536)
+ * - snapCurve(x) = 2 - 2/(1 + x) is 1 for x >= 1, which is a precomputed difference threshold (snapSaturation),
+ *   below it 1/(1 + x) is a linear estimate refined by two Newton-Raphson steps
+ * - results are truncated towards zero, like the double to int conversions of EMANoiseFilter<int>
+ *
+ * Nothing overflows as long as the values and bounds span at most 65535 (e.g. a 16 bit ADC) and stay within +-2^22.
+ */
+template<class V>
+struct FixedPointEMANoiseFilterKernel
+{
+    typedef typename V::Integer Integer;
+
+    struct Parameters
+    {
+        Integer lowerBound;
+        Integer upperBound;
+        Integer activityThreshold;  // Q8
+        Integer snapMultiplier;     // Q16
+        Integer snapSaturation;     // smallest difference for which the snap curve is 1
+    };
+
+    template<bool SleepEnabled, bool EdgeSnapEnabled>
+    static Integer filterValue(const Parameters &p, Integer &smoothValue, Integer &errorEMA, Integer &sleeping, Integer newValue)
+    {
+        const Integer zero = V::set(0);
+
+        // drag values close to an edge a little closer to it, see EMANoiseFilter
+        if (SleepEnabled && EdgeSnapEnabled)
+        {
+            const Integer lowerDistance = V::abs(V::sub(newValue, p.lowerBound));
+            const Integer upperDistance = V::abs(V::sub(newValue, p.upperBound));
+            const Integer nearLower = V::greater(p.activityThreshold, V::template shiftLeft<8>(lowerDistance));
+            const Integer nearUpper = V::maskAndNot(nearLower, V::greater(p.activityThreshold, V::template shiftLeft<8>(upperDistance)));
+
+            const Integer lowerOffset = V::abs(V::sub(V::template shiftLeft<9>(lowerDistance), p.activityThreshold));
+            const Integer upperOffset = V::abs(V::sub(V::template shiftLeft<9>(upperDistance), p.activityThreshold));
+
+            newValue = V::select(nearLower, addTruncated<8>(p.lowerBound, lowerOffset), newValue);
+            newValue = V::select(nearUpper, addTruncated<8>(p.upperBound, V::sub(zero, upperOffset)), newValue);
+        }
+
+        const Integer difference = V::sub(newValue, smoothValue);
+        const Integer absoluteDifference = V::abs(difference);
+
+        errorEMA = V::add(errorEMA, timesPoint4(V::sub(V::template shiftLeft<8>(difference), errorEMA)));
+
+        if (SleepEnabled)
+        {
+            sleeping = V::greater(p.activityThreshold, V::abs(errorEMA));
+
+            // Most of the time every lane is asleep, then the snap curve isn't needed
+            if (V::bits(sleeping) == (1 << V::Width) - 1)
+            {
+                return smoothValue;
+            }
+        }
+
+        // snap = 2 - 2/(1 + difference*snapMultiplier), 1 at and above snapSaturation
+        const Integer one = V::set(1 << 15);
+        const Integer x = V::template shiftRight<1>(V::mul(V::min(absoluteDifference, p.snapSaturation), p.snapMultiplier));
+        const Integer d = V::add(one, x);
+
+        Integer reciprocal = V::sub(V::set(46261), V::template shiftRight<15>(V::mul(V::set(15420), d))); // 24/17 - 8/17*d
+        reciprocal = V::template shiftRight<15>(V::mul(reciprocal, V::sub(V::set(2 << 15), V::template shiftRight<15>(V::mul(d, reciprocal)))));
+        reciprocal = V::template shiftRight<15>(V::mul(reciprocal, V::sub(V::set(2 << 15), V::template shiftRight<15>(V::mul(d, reciprocal)))));
+
+        Integer snap = V::min(V::sub(V::set(2 << 15), V::template shiftLeft<1>(reciprocal)), one);
+        snap = V::select(V::greater(p.snapSaturation, absoluteDifference), snap, one);
+
+        Integer filteredValue = addTruncated<15>(smoothValue, V::mul(difference, snap));
+
+        // ensure output is in bounds
+        Integer belowLower = V::greater(p.lowerBound, filteredValue);
+        if (EdgeSnapEnabled)
+        {
+            belowLower = V::maskOr(belowLower, V::greater(p.activityThreshold, V::template shiftLeft<8>(V::abs(V::sub(filteredValue, p.lowerBound)))));
+        }
+        filteredValue = V::select(belowLower, p.lowerBound, filteredValue);
+
+        Integer aboveUpper = V::greater(filteredValue, p.upperBound);
+        if (EdgeSnapEnabled)
+        {
+            aboveUpper = V::maskOr(aboveUpper, V::greater(p.activityThreshold, V::template shiftLeft<8>(V::abs(V::sub(filteredValue, p.upperBound)))));
+        }
+        filteredValue = V::select(aboveUpper, p.upperBound, filteredValue);
+
+        if (SleepEnabled)
+        {
+            filteredValue = V::select(sleeping, smoothValue, filteredValue);
+        }
+
+        smoothValue = filteredValue;
+        return filteredValue;
+    }
+
+  private:
+    /**
+     * @return integer + fraction/2^Bits, truncated towards zero
+     */
+    template<int Bits>
+    static Integer addTruncated(Integer integer, Integer fraction)
+    {
+        const Integer zero = V::set(0);
+        const Integer sum = V::add(integer, V::template shiftRight<Bits>(fraction));
+        const Integer remainder = V::maskAnd(fraction, V::set((1 << Bits) - 1));
+
+        // the shift rounded down, round negative sums with a remainder up instead
+        return V::sub(sum, V::maskAnd(V::greater(zero, sum), V::greater(remainder, zero)));
+    }
+
+    /**
+     * @return x*0.4, truncated towards zero
+     */
+    static Integer timesPoint4(Integer x)
+    {
+        const Integer sign = V::template shiftRight<31>(x);
+        const Integer magnitude = V::abs(x);
+
+        Integer y = V::add(V::template shiftRight<2>(magnitude), V::template shiftRight<3>(magnitude));
+        y = V::add(y, V::template shiftRight<4>(y));
+        y = V::add(y, V::template shiftRight<8>(y));
+        y = V::add(y, V::template shiftRight<16>(y));
+
+        return V::sub(V::maskXor(y, sign), sign);
+    }
+};
+
+class FixedPointEMANoiseFilterBank;
+
+/**
+ * EMANoiseFilter<int> in Q-format fixed point, for targets without an FPU and for integer SIMD lanes (FixedPointEMANoiseFilterBank).
+ * Only configuration (the double snap multiplier setter) touches floating point, update() is pure integer arithmetic.
+ * On CPUs with an FPU a single filter is slower than EMANoiseFilter<int>, because the Newton-Raphson steps make
+ * the dependency chain from one sample to the next longer than a division; the bank doesn't have that problem.
+ *
+ * The output follows EMANoiseFilter<int> but isn't bit identical, because the error EMA, the threshold and the snap curve are quantized.
+ * Against EMANoiseFilter<int> the largest difference follows from where the quantization can show, with t the activity threshold,
+ * s the snap curve and D the largest input change per sample that doesn't wake the filter by itself:
+ * - the smoothed values can differ by an off by one truncation, and keep differing by at most 1, as every update
+ *   scales the difference by 1 - s(difference) <= 1 before truncating again
+ * - with sleep the error EMA can cross t in one filter and not in the other, so one holds the value while the other moves.
+ *   The error EMA weighs the last differences to the input with 0.4*0.6^k, so it lags the current difference
+ *   by at most 0.4*sum(k*0.6^k)*D = 1.5*D, and the difference at a crossing is at most d = t + 1.5*D.
+ *   The filter that moves moves at most d*s(d)
+ * - with edge snap an off by one can put one value within t of a bound and the other not, so only one snaps to the bound.
+ *   It stays there as long as the input is within y of the bound, with y*s(y) = t, while the other follows the input,
+ *   which adds up to y
+ * so the largest difference is 1, plus d*s(d) with sleep, plus y with edge snap, all truncated.
+ * For 0..1024 with the default parameters, t = 10.24 and y = 25.3: 1 without sleep and edge snap, 26 with edge snap,
+ * 11 and 36 with sleep in the steps of filtertester-bench (D = 10, their noise), 18 and 43 in its random walk (D = 16).
+ * filtertester-check's fixed_point_accuracy checks these over 1M samples of each of filtertester-bench's inputs,
+ * for the filter and the bank.
+ * How often the outputs differ depends on how often the input makes the filter cross t, which is a property of the input
+ * and not derived: constant, small noise and ramp inputs give identical output, the steps and random walk inputs
+ * are checked against the larger measured fraction of the filter and the bank plus a quarter, 2.2e-5 and 0.51%
+ * of the steps without and with sleep, 2.6% and 5% of the random walk.
+ */
+class FixedPointEMANoiseFilter
+{
+    friend class FixedPointEMANoiseFilterBank;
+
+  public:
+    FixedPointEMANoiseFilter(int lowerBound,
+                             int upperBound,
+                             bool sleepEnabled = true,
+                             double snapMultiplier = 0.01):
+        mEnabled(upperBound > lowerBound),
+        mFirstValue(true),
+        mSleepEnabled(sleepEnabled),
+        mEdgeSnapEnabled(false),
+        mSmoothValue(0),
+        mErrorEMA(0),
+        mSleeping(0),
+        mFilteredValue(0),
+        mFilteredValueHasChanged(false)
+    {
+        mParameters.lowerBound = lowerBound;
+        mParameters.upperBound = upperBound;
+        mParameters.activityThreshold = defaultActivityThreshold(lowerBound, upperBound);
+        setSnapMultiplier(snapMultiplier);
+    }
+
+    /**
+     * @brief value
+     * @return returns the last filtered value after calling update()
+     */
+    int value() const
+    {
+        return mFilteredValue;
+    }
+
+    /**
+     * @brief hasChanged
+     * @return returns if the value has changed during the last update()
+     */
+    bool hasChanged() const
+    {
+        return mFilteredValueHasChanged;
+    }
+
+    bool isEnabled() const
+    {
+        return mEnabled;
+    }
+
+    void setEnabled(bool enabled)
+    {
+        mEnabled = enabled;
+    }
+
+    bool isSleeping() const
+    {
+        return mSleeping != 0;
+    }
+
+    int lowerBound() const
+    {
+        return mParameters.lowerBound;
+    }
+
+    void setLowerBound(int lowerBound)
+    {
+        mParameters.lowerBound = lowerBound;
+    }
+
+    int upperBound() const
+    {
+        return mParameters.upperBound;
+    }
+
+    void setUpperBound(int upperBound)
+    {
+        mParameters.upperBound = upperBound;
+    }
+
+    bool sleepEnabled() const
+    {
+        return mSleepEnabled;
+    }
+
+    void setSleepEnabled(bool sleepEnabled)
+    {
+        mSleepEnabled = sleepEnabled;
+    }
+
+    bool edgeSnapEnabled() const
+    {
+        return mEdgeSnapEnabled;
+    }
+
+    void setEdgeSnapEnabled(bool edgeSnapEnabled)
+    {
+        mEdgeSnapEnabled = edgeSnapEnabled;
+    }
+
+    /**
+     * @brief activityThreshold
+     * @return the activity threshold in Q8
+     */
+    int32_t activityThresholdQ8() const
+    {
+        return mParameters.activityThreshold;
+    }
+
+    void setActivityThreshold(int threshold)
+    {
+        mParameters.activityThreshold = threshold*256;
+    }
+
+    /**
+     * @brief snapMultiplierQ16
+     * @return the snap multiplier in Q16, 65536 is 1.0
+     */
+    int32_t snapMultiplierQ16() const
+    {
+        return mParameters.snapMultiplier;
+    }
+
+    void setSnapMultiplier(double multiplier)
+    {
+        setSnapMultiplierQ16(static_cast<int32_t>(multiplier*65536.0 + 0.5));
+    }
+
+    void setSnapMultiplierQ16(int32_t multiplier)
+    {
+        if (multiplier > 65536)
+        {
+            multiplier = 65536;
+        }
+        else if (multiplier < 0)
+        {
+            multiplier = 0;
+        }
+
+        mParameters.snapMultiplier = multiplier;
+        mParameters.snapSaturation = snapSaturation(multiplier);
+    }
+
+    /**
+     * @brief update
+     * @param rawValue updates the filtered value based on the raw value being sent in
+     * @return returns the filtered value
+     */
+    int update(int rawValue)
+    {
+        const int previousValue = mFilteredValue;
+
+        if (mEnabled)
+        {
+            if (mFirstValue)
+            {
+                mSmoothValue = rawValue;
+                mFirstValue = false;
+            }
+
+            if (mSleepEnabled)
+            {
+                mFilteredValue = mEdgeSnapEnabled
+                                 ? Kernel::filterValue<true, true>(mParameters, mSmoothValue, mErrorEMA, mSleeping, rawValue)
+                                 : Kernel::filterValue<true, false>(mParameters, mSmoothValue, mErrorEMA, mSleeping, rawValue);
+            }
+            else
+            {
+                mFilteredValue = mEdgeSnapEnabled
+                                 ? Kernel::filterValue<false, true>(mParameters, mSmoothValue, mErrorEMA, mSleeping, rawValue)
+                                 : Kernel::filterValue<false, false>(mParameters, mSmoothValue, mErrorEMA, mSleeping, rawValue);
+            }
+        }
+        else
+        {
+            mFilteredValue = rawValue;
+        }
+
+        mFilteredValueHasChanged = mFilteredValue != previousValue;
+        return mFilteredValue;
+    }
+
+  private:
+    typedef FixedPointEMANoiseFilterKernel<FixedPointScalar> Kernel;
+
+    /**
+     * @return 1% of the range in Q8, rounded up
+     */
+    static int32_t defaultActivityThreshold(int lowerBound, int upperBound)
+    {
+        return ((upperBound - lowerBound)*256 + 99)/100;
+    }
+
+    /**
+     * @return the smallest difference for which difference*multiplier >= 1, i.e. the snap curve is saturated
+     */
+    static int32_t snapSaturation(int32_t multiplier)
+    {
+        return multiplier > 0 ? (65536 + multiplier - 1)/multiplier : 65536;
+    }
+
+    bool mEnabled;
+    bool mFirstValue;
+    bool mSleepEnabled;
+    bool mEdgeSnapEnabled;
+
+    Kernel::Parameters mParameters;
+
+    int32_t mSmoothValue;
+    int32_t mErrorEMA;
+    int32_t mSleeping;
+
+    int mFilteredValue;
+    bool mFilteredValueHasChanged;
+};
+
+#endif
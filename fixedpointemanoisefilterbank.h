@@ -0,0 +1,319 @@
+#ifndef FIXED_POINT_EMA_NOISE_FILTER_BANK_H
+#define FIXED_POINT_EMA_NOISE_FILTER_BANK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#include "fixedpointemanoisefilter.h"
+
+#if defined(__AVX2__)
+/**
+ * 8 int32 channels per step
+ */
+struct FixedPointVector
+{
+    typedef __m256i Integer;
+    static const size_t Width = 8;
+
+    static Integer load(const int32_t *values) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values)); }
+    static void store(int32_t *values, Integer v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(values), v); }
+    static Integer set(int32_t value) { return _mm256_set1_epi32(value); }
+    static Integer add(Integer a, Integer b) { return _mm256_add_epi32(a, b); }
+    static Integer sub(Integer a, Integer b) { return _mm256_sub_epi32(a, b); }
+    static Integer mul(Integer a, Integer b) { return _mm256_mullo_epi32(a, b); }
+    static Integer min(Integer a, Integer b) { return _mm256_min_epi32(a, b); }
+    static Integer abs(Integer a) { return _mm256_abs_epi32(a); }
+    template<int Bits> static Integer shiftLeft(Integer a) { return _mm256_slli_epi32(a, Bits); }
+    template<int Bits> static Integer shiftRight(Integer a) { return _mm256_srai_epi32(a, Bits); }
+    static Integer greater(Integer a, Integer b) { return _mm256_cmpgt_epi32(a, b); }
+    static Integer equal(Integer a, Integer b) { return _mm256_cmpeq_epi32(a, b); }
+    static Integer maskAnd(Integer a, Integer b) { return _mm256_and_si256(a, b); }
+    static Integer maskOr(Integer a, Integer b) { return _mm256_or_si256(a, b); }
+    static Integer maskXor(Integer a, Integer b) { return _mm256_xor_si256(a, b); }
+    static Integer maskAndNot(Integer a, Integer b) { return _mm256_andnot_si256(a, b); }
+    static Integer select(Integer mask, Integer a, Integer b) { return _mm256_blendv_epi8(b, a, mask); }
+    static int bits(Integer mask) { return _mm256_movemask_ps(_mm256_castsi256_ps(mask)); }
+};
+#elif defined(__SSE4_1__)
+/**
+ * 4 int32 channels per step, SSE4.1 is needed for the 32 bit multiply
+ */
+struct FixedPointVector
+{
+    typedef __m128i Integer;
+    static const size_t Width = 4;
+
+    static Integer load(const int32_t *values) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(values)); }
+    static void store(int32_t *values, Integer v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(values), v); }
+    static Integer set(int32_t value) { return _mm_set1_epi32(value); }
+    static Integer add(Integer a, Integer b) { return _mm_add_epi32(a, b); }
+    static Integer sub(Integer a, Integer b) { return _mm_sub_epi32(a, b); }
+    static Integer mul(Integer a, Integer b) { return _mm_mullo_epi32(a, b); }
+    static Integer min(Integer a, Integer b) { return _mm_min_epi32(a, b); }
+    static Integer abs(Integer a) { return _mm_abs_epi32(a); }
+    template<int Bits> static Integer shiftLeft(Integer a) { return _mm_slli_epi32(a, Bits); }
+    template<int Bits> static Integer shiftRight(Integer a) { return _mm_srai_epi32(a, Bits); }
+    static Integer greater(Integer a, Integer b) { return _mm_cmpgt_epi32(a, b); }
+    static Integer equal(Integer a, Integer b) { return _mm_cmpeq_epi32(a, b); }
+    static Integer maskAnd(Integer a, Integer b) { return _mm_and_si128(a, b); }
+    static Integer maskOr(Integer a, Integer b) { return _mm_or_si128(a, b); }
+    static Integer maskXor(Integer a, Integer b) { return _mm_xor_si128(a, b); }
+    static Integer maskAndNot(Integer a, Integer b) { return _mm_andnot_si128(a, b); }
+    static Integer select(Integer mask, Integer a, Integer b) { return _mm_blendv_epi8(b, a, mask); }
+    static int bits(Integer mask) { return _mm_movemask_ps(_mm_castsi128_ps(mask)); }
+};
+#endif
+
+/**
+ * A bank of FixedPointEMANoiseFilter channels that are all updated with one sample per channel at a time.
+ * The channels are advanced in 32 bit integer lanes, 8 at a time with AVX2 or 4 at a time with SSE4.1,
+ * and the channels left over after the last full vector with the scalar kernel.
+ * Both run the same integer arithmetic, so the output is the same as running one FixedPointEMANoiseFilter per channel.
+ *
+ * All the parameters are shared by all channels.
+ */
+class FixedPointEMANoiseFilterBank
+{
+  public:
+    FixedPointEMANoiseFilterBank(size_t channelCount,
+                                 int lowerBound,
+                                 int upperBound,
+                                 bool sleepEnabled = true,
+                                 double snapMultiplier = 0.01):
+        mFilter(lowerBound, upperBound, sleepEnabled, snapMultiplier),
+        mSmoothValue(channelCount, 0),
+        mErrorEMA(channelCount, 0),
+        mSleeping(channelCount, 0),
+        mFilteredValue(channelCount, 0)
+    {
+    }
+
+    size_t channelCount() const
+    {
+        return mSmoothValue.size();
+    }
+
+    /**
+     * @brief value
+     * @return returns the last filtered value of the channel after calling update()
+     */
+    int value(size_t channel) const
+    {
+        return mFilteredValue[channel];
+    }
+
+    /**
+     * @brief values
+     * @return the last filtered values of all the channels
+     */
+    const int32_t *values() const
+    {
+        return mFilteredValue.data();
+    }
+
+    bool isSleeping(size_t channel) const
+    {
+        return mSleeping[channel] != 0;
+    }
+
+    bool isEnabled() const
+    {
+        return mFilter.isEnabled();
+    }
+
+    void setEnabled(bool enabled)
+    {
+        mFilter.setEnabled(enabled);
+    }
+
+    bool sleepEnabled() const
+    {
+        return mFilter.sleepEnabled();
+    }
+
+    void setSleepEnabled(bool sleepEnabled)
+    {
+        mFilter.setSleepEnabled(sleepEnabled);
+    }
+
+    bool edgeSnapEnabled() const
+    {
+        return mFilter.edgeSnapEnabled();
+    }
+
+    void setEdgeSnapEnabled(bool edgeSnapEnabled)
+    {
+        mFilter.setEdgeSnapEnabled(edgeSnapEnabled);
+    }
+
+    int lowerBound() const
+    {
+        return mFilter.lowerBound();
+    }
+
+    void setLowerBound(int lowerBound)
+    {
+        mFilter.setLowerBound(lowerBound);
+    }
+
+    int upperBound() const
+    {
+        return mFilter.upperBound();
+    }
+
+    void setUpperBound(int upperBound)
+    {
+        mFilter.setUpperBound(upperBound);
+    }
+
+    void setActivityThreshold(int threshold)
+    {
+        mFilter.setActivityThreshold(threshold);
+    }
+
+    void setSnapMultiplier(double multiplier)
+    {
+        mFilter.setSnapMultiplier(multiplier);
+    }
+
+    void setSnapMultiplierQ16(int32_t multiplier)
+    {
+        mFilter.setSnapMultiplierQ16(multiplier);
+    }
+
+    /**
+     * @brief update advances every channel by one sample
+     * @param rawValues one raw value per channel
+     * @param filteredValues optional, receives the filtered value of every channel
+     * @param changed optional, receives hasChanged() of every channel
+     * @return the number of channels whose filtered value has changed
+     */
+    size_t update(const int32_t *rawValues, int32_t *filteredValues = nullptr, bool *changed = nullptr)
+    {
+        const size_t count = channelCount();
+        size_t changeCount = 0;
+
+        if (!mFilter.mEnabled)
+        {
+            for (size_t channel = 0; channel < count; ++channel)
+            {
+                const bool hasChanged = rawValues[channel] != mFilteredValue[channel];
+                changeCount += hasChanged;
+                mFilteredValue[channel] = rawValues[channel];
+
+                if (filteredValues)
+                {
+                    filteredValues[channel] = rawValues[channel];
+                }
+
+                if (changed)
+                {
+                    changed[channel] = hasChanged;
+                }
+            }
+
+            return changeCount;
+        }
+
+        if (mFilter.mFirstValue)
+        {
+            mSmoothValue.assign(rawValues, rawValues + count);
+            mFilter.mFirstValue = false;
+        }
+
+        if (mFilter.mSleepEnabled)
+        {
+            return mFilter.mEdgeSnapEnabled
+                   ? updateChannels<true, true>(rawValues, filteredValues, changed)
+                   : updateChannels<true, false>(rawValues, filteredValues, changed);
+        }
+
+        return mFilter.mEdgeSnapEnabled
+               ? updateChannels<false, true>(rawValues, filteredValues, changed)
+               : updateChannels<false, false>(rawValues, filteredValues, changed);
+    }
+
+  private:
+    template<bool SleepEnabled, bool EdgeSnapEnabled>
+    size_t updateChannels(const int32_t *rawValues, int32_t *filteredValues, bool *changed)
+    {
+        size_t changeCount = 0;
+        size_t channel = 0;
+
+#if defined(__SSE4_1__)
+        channel = updateLanes<FixedPointVector, SleepEnabled, EdgeSnapEnabled>(channel, rawValues, filteredValues, changed, &changeCount);
+#endif
+        updateLanes<FixedPointScalar, SleepEnabled, EdgeSnapEnabled>(channel, rawValues, filteredValues, changed, &changeCount);
+
+        return changeCount;
+    }
+
+    /**
+     * Runs the kernel on V::Width channels at a time, starting at channel
+     * @return the first channel that is left, because it doesn't fill a whole vector
+     */
+    template<class V, bool SleepEnabled, bool EdgeSnapEnabled>
+    size_t updateLanes(size_t channel, const int32_t *rawValues, int32_t *filteredValues, bool *changed, size_t *changeCount)
+    {
+        typedef FixedPointEMANoiseFilterKernel<V> Kernel;
+        typedef typename V::Integer Integer;
+
+        const FixedPointEMANoiseFilterKernel<FixedPointScalar>::Parameters &parameters = mFilter.mParameters;
+        const typename Kernel::Parameters p = {
+            V::set(parameters.lowerBound),
+            V::set(parameters.upperBound),
+            V::set(parameters.activityThreshold),
+            V::set(parameters.snapMultiplier),
+            V::set(parameters.snapSaturation)
+        };
+
+        const size_t count = channelCount();
+        for (; channel + V::Width <= count; channel += V::Width)
+        {
+            Integer smoothValue = V::load(&mSmoothValue[channel]);
+            Integer errorEMA = V::load(&mErrorEMA[channel]);
+            Integer sleeping = V::load(&mSleeping[channel]);
+
+            const Integer filteredValue = Kernel::template filterValue<SleepEnabled, EdgeSnapEnabled>(p, smoothValue, errorEMA, sleeping, V::load(rawValues + channel));
+
+            V::store(&mSmoothValue[channel], smoothValue);
+            V::store(&mErrorEMA[channel], errorEMA);
+            V::store(&mSleeping[channel], sleeping);
+
+            const int changedBits = ~V::bits(V::equal(filteredValue, V::load(&mFilteredValue[channel])));
+            V::store(&mFilteredValue[channel], filteredValue);
+
+            if (filteredValues)
+            {
+                V::store(filteredValues + channel, filteredValue);
+            }
+
+            for (size_t lane = 0; lane < V::Width; ++lane)
+            {
+                const bool hasChanged = (changedBits >> lane) & 1;
+                *changeCount += hasChanged;
+
+                if (changed)
+                {
+                    changed[channel + lane] = hasChanged;
+                }
+            }
+        }
+
+        return channel;
+    }
+
+    FixedPointEMANoiseFilter mFilter; // only holds the parameters and flags shared by all channels
+
+    std::vector<int32_t> mSmoothValue;
+    std::vector<int32_t> mErrorEMA;
+    std::vector<int32_t> mSleeping;
+    std::vector<int32_t> mFilteredValue;
+};
+
+#endif
@@ -1,19 +1,17 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QTimer>
-#include <QDateTime>
+#include <QFile>
+#include <QFileDialog>
+#include <QMessageBox>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    mInput(0),
-    mNoise(0),
-    mEMANoiseFilter(0,
-                 1024,
-                 true),
-    mSimpleNoiseFilter(10,
-                       5),
-    mNoiseTimer(new QTimer(this))
+    mFilterWorker(mParameters, 50),
+    mFrameTimer(new QTimer(this)),
+    mSampleCount(0),
+    mSamples(4096)
 {
     ui->setupUi(this);
 
@@ -69,17 +67,28 @@ MainWindow::MainWindow(QWidget *parent) :
             SIGNAL(stateChanged(int)),
             this,
             SLOT(onNoiseEnabledChanged(int)));
+    connect(ui->noiseTypeComboBox,
+            SIGNAL(currentIndexChanged(int)),
+            this,
+            SLOT(onNoiseTypeChanged(int)));
 
 
-    connect(mNoiseTimer,
-            SIGNAL(timeout()),
+    connect(ui->recordButton,
+            SIGNAL(toggled(bool)),
             this,
-            SLOT(onNoiseTimerTriggered()));
+            SLOT(onRecordToggled(bool)));
 
-    connect(this,
+
+    connect(ui->sampleRateSpinBox,
             SIGNAL(valueChanged(int)),
             this,
-            SLOT(onValueChanged(int)));
+            SLOT(onSampleRateChanged(int)));
+
+
+    connect(mFrameTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(onFrameTimerTriggered()));
 
     ui->enableFiltersCheckbox->setCheckState(Qt::Checked);
 
@@ -90,7 +99,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->emaFilterUpperBoundSpinBox->setMaximum(10240);
     ui->emaFilterUpperBoundSpinBox->setValue(1024);
     ui->emaFilterSnapMultiplierSpinBox->setValue(0.01);
-    ui->emaActivityThresholdSpinBox->setValue(mEMANoiseFilter.activityThreshold());
+    ui->emaActivityThresholdSpinBox->setValue(mParameters.emaActivityThreshold);
     ui->enableSleepCheckBox->setCheckState(Qt::Checked);
     ui->enableSnaptoEdgesCheckBox->setCheckState(Qt::Checked);
 
@@ -98,8 +107,8 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->simpleFilterThresholdSpinBox->setMaximum(10240);
     ui->simpleFilterSuppressionCountSpinBox->setMinimum(0);
     ui->simpleFilterSuppressionCountSpinBox->setMaximum(10240);
-    ui->simpleFilterThresholdSpinBox->setValue(mSimpleNoiseFilter.activityThreshold());
-    ui->simpleFilterSuppressionCountSpinBox->setValue(mSimpleNoiseFilter.suppressionCount());
+    ui->simpleFilterThresholdSpinBox->setValue(mParameters.simpleActivityThreshold);
+    ui->simpleFilterSuppressionCountSpinBox->setValue(mParameters.suppressionCount);
 
     ui->inputSlider->setMinimum(0);
     ui->emaOutputSlider->setMinimum(0);
@@ -121,8 +130,19 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->effectiveInputSpinBox->setMinimum(-10240);
     ui->effectiveInputSpinBox->setMaximum(10240);
 
-    qsrand(QDateTime::currentMSecsSinceEpoch());
+    // The filters run on the worker at the simulated sample rate, the widgets are only updated once per frame
+    ui->sampleRateSpinBox->setMinimum(1);
+    ui->sampleRateSpinBox->setMaximum(10000000);
+    ui->sampleRateSpinBox->setValue(50);
+
+    ui->noiseTypeComboBox->addItem(tr("Uniform"), static_cast<int>(SignalGenerator::Noise::Uniform));
+    ui->noiseTypeComboBox->addItem(tr("Gaussian"), static_cast<int>(SignalGenerator::Noise::Gaussian));
+    ui->noiseTypeComboBox->addItem(tr("Impulse"), static_cast<int>(SignalGenerator::Noise::Impulse));
+    ui->noiseTypeComboBox->addItem(tr("Quantization"), static_cast<int>(SignalGenerator::Noise::Quantization));
     ui->enableNoiseCheckBox->setChecked(true);
+
+    mFrameTimer->setTimerType(Qt::PreciseTimer);
+    mFrameTimer->start(16);
 }
 
 MainWindow::~MainWindow()
@@ -130,100 +150,153 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+void MainWindow::updateParameters()
+{
+    mFilterWorker.setParameters(mParameters);
+}
+
 void MainWindow::onEMAActivityThresholdChanged(int threshold)
 {
-    mEMANoiseFilter.setActivityThreshold(threshold);
+    mParameters.emaActivityThreshold = threshold;
+    updateParameters();
 }
 
 void MainWindow::onEMAFilterLowerBoundChanged(int lowerBound)
 {
-    mEMANoiseFilter.setLowerBound(lowerBound);
+    mParameters.lowerBound = lowerBound;
+    updateParameters();
     ui->inputSlider->setMinimum(lowerBound);
     ui->emaOutputSlider->setMinimum(lowerBound);
     ui->simpleOutputSlider->setMinimum(lowerBound);
+    ui->plotWidget->setRange(lowerBound, mParameters.upperBound);
 }
 
 void MainWindow::onEMAFilterUpperBoundChanged(int upperBound)
 {
-    mEMANoiseFilter.setUpperBound(upperBound);
+    mParameters.upperBound = upperBound;
+    updateParameters();
     ui->inputSlider->setMaximum(upperBound);
     ui->emaOutputSlider->setMaximum(upperBound);
     ui->simpleOutputSlider->setMaximum(upperBound);
+    ui->plotWidget->setRange(mParameters.lowerBound, upperBound);
 }
 
 void MainWindow::onInputValueChanged(int value)
 {
-    mInput = value;
     ui->inputSpinBox->setValue(value);
-    emit valueChanged(mInput + mNoise);
+    mFilterWorker.setInput(value);
 }
 
-void MainWindow::onNoiseTimerTriggered()
+void MainWindow::onSampleRateChanged(int sampleRate)
 {
-    int noiseRange = (mEMANoiseFilter.upperBound() - mEMANoiseFilter.lowerBound())/40;
-    mNoise = noiseRange*(0.5 - static_cast<double>(qrand())/RAND_MAX);
-    ui->noiseSpinBox->setValue(mNoise);
-    emit valueChanged(mInput + mNoise);
+    mFilterWorker.setSampleRate(sampleRate);
 }
 
-void MainWindow::onValueChanged(int value)
+void MainWindow::onFrameTimerTriggered()
 {
-    auto outputValue = mEMANoiseFilter.update(value);
-    auto simpleOutputValue = mSimpleNoiseFilter.update(value);
+    while (size_t n = mFilterWorker.readSamples(mSamples.data(), mSamples.size()))
+    {
+        ui->plotWidget->append(mSamples.data(), n);
+    }
 
-    ui->effectiveInputSpinBox->setValue(value);
-    ui->effectiveInputSlider->setValue(value);
+    FilterWorker::Frame frame;
+    const bool fresh = mFilterWorker.readFrame(&frame);
 
-    ui->emaOutputSlider->setValue(outputValue);
-    ui->emaOutputSpinBox->setValue(outputValue);
+    ui->samplesPerFrameLabel->setText(QString::number(fresh ? frame.sampleCount - mSampleCount : 0));
+    if (!fresh)
+    {
+        return;
+    }
+    mSampleCount = frame.sampleCount;
+
+    ui->noiseSpinBox->setValue(frame.noise);
+
+    ui->effectiveInputSpinBox->setValue(frame.value);
+    ui->effectiveInputSlider->setValue(frame.value);
+
+    ui->emaOutputSlider->setValue(frame.emaOutput);
+    ui->emaOutputSpinBox->setValue(frame.emaOutput);
 
-    ui->simpleOutputSlider->setValue(simpleOutputValue);
-    ui->simpleOutputSpinBox->setValue(simpleOutputValue);
+    ui->simpleOutputSlider->setValue(frame.simpleOutput);
+    ui->simpleOutputSpinBox->setValue(frame.simpleOutput);
 }
 
 void MainWindow::onEMAFilterSnapMultiplierChanged(double snapMultiplier)
 {
-    mEMANoiseFilter.setSnapMultiplier(snapMultiplier);
+    mParameters.snapMultiplier = snapMultiplier;
+    updateParameters();
 }
 
 void MainWindow::onSimpleFilterThresholdChanged(int threshold)
 {
-    mSimpleNoiseFilter.setActivityThreshold(threshold);
+    mParameters.simpleActivityThreshold = threshold;
+    updateParameters();
 }
 
 void MainWindow::onSimpleFilterSuppressionCountChanged(int count)
 {
-    mSimpleNoiseFilter.setSuppressionCount(count);
+    mParameters.suppressionCount = count;
+    updateParameters();
 }
 
 void MainWindow::onFiltersEnabledChanged(int enabled)
 {
-    mEMANoiseFilter.setEnabled(enabled != Qt::Unchecked);
-    mSimpleNoiseFilter.setEnabled(enabled != Qt::Unchecked);
+    mParameters.filtersEnabled = enabled != Qt::Unchecked;
+    updateParameters();
 }
 
 void MainWindow::onSleepEnabledChanged(int enabled)
 {
-    mEMANoiseFilter.setSleepEnabled(enabled != Qt::Unchecked);
+    mParameters.sleepEnabled = enabled != Qt::Unchecked;
+    updateParameters();
 }
 
 void MainWindow::onSnapToEdgesChanged(int enabled)
 {
-    mEMANoiseFilter.setEdgeSnapEnabled(enabled != Qt::Unchecked);
+    mParameters.edgeSnapEnabled = enabled != Qt::Unchecked;
+    updateParameters();
 }
 
 void MainWindow::onNoiseEnabledChanged(int enabled)
 {
-    if (enabled != Qt::Unchecked)
+    mFilterWorker.setNoiseEnabled(enabled != Qt::Unchecked);
+}
+
+void MainWindow::onNoiseTypeChanged(int index)
+{
+    mFilterWorker.setNoise(static_cast<SignalGenerator::Noise>(ui->noiseTypeComboBox->itemData(index).toInt()));
+}
+
+void MainWindow::onRecordToggled(bool checked)
+{
+    std::string errorString;
+
+    if (!checked)
     {
-        mNoiseTimer->start(20);
+        if (!mFilterWorker.stopRecording(&errorString))
+        {
+            QMessageBox::warning(this, tr("Record Trace"), QString::fromStdString(errorString));
+        }
+        return;
     }
-    else
+
+    const QString fileName = QFileDialog::getSaveFileName(this,
+                                                          tr("Record Trace"),
+                                                          QString(),
+                                                          tr("Filter traces (*.fttrace)"));
+
+    // The trace gets the sample rate of the worker when the recording starts
+    if (fileName.isEmpty()
+        || !mFilterWorker.startRecording(QFile::encodeName(fileName).toStdString(),
+                                         mParameters.lowerBound,
+                                         mParameters.upperBound,
+                                         &errorString))
     {
-        mNoiseTimer->stop();
-    }
+        if (!fileName.isEmpty())
+        {
+            QMessageBox::warning(this, tr("Record Trace"), QString::fromStdString(errorString));
+        }
 
-    mNoise = 0;
-    ui->noiseSpinBox->setValue(0);
-    emit valueChanged(mNoise + mInput);
+        ui->recordButton->setChecked(false);
+    }
 }
@@ -3,8 +3,10 @@
 
 #include <QMainWindow>
 
-#include "emanoisefilter.h"
-#include "simplenoisefilter.h"
+#include <vector>
+
+#include "filterparameters.h"
+#include "filterworker.h"
 
 namespace Ui {
 class MainWindow;
@@ -20,9 +22,6 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
-signals:
-    void valueChanged(int value);
-
 public slots:
     void onEMAActivityThresholdChanged(int threshold);
     void onEMAFilterLowerBoundChanged(int lowerBound);
@@ -33,22 +32,26 @@ public slots:
     void onSimpleFilterSuppressionCountChanged(int count);
 
     void onInputValueChanged(int value);
-    void onNoiseTimerTriggered();
-    void onValueChanged(int value);
+    void onSampleRateChanged(int sampleRate);
+    void onFrameTimerTriggered();
 
 
     void onFiltersEnabledChanged(int enabled);
     void onSleepEnabledChanged(int enabled);
     void onSnapToEdgesChanged(int enabled);
     void onNoiseEnabledChanged(int enabled);
+    void onNoiseTypeChanged(int index);
+    void onRecordToggled(bool checked);
 
 private:
+    void updateParameters();
+
     Ui::MainWindow *ui;
-    int mInput;
-    int mNoise;
-    EMANoiseFilter<int> mEMANoiseFilter;
-    SimpleNoiseFilter<int> mSimpleNoiseFilter;
-    QTimer *mNoiseTimer;
+    FilterParameters mParameters;
+    FilterWorker mFilterWorker;
+    QTimer *mFrameTimer;
+    uint64_t mSampleCount;
+    std::vector<FilterWorker::Sample> mSamples;
 };
 
 #endif // MAINWINDOW_H
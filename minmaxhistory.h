@@ -0,0 +1,230 @@
+#ifndef MIN_MAX_HISTORY_H
+#define MIN_MAX_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * The last capacity frames of a few channels, with a min/max pyramid over them,
+ * so that the minimum and maximum of any range can be found in O(log(range)) instead of O(range).
+ *
+ * Level 0 are the samples themselves, each level above holds the minimum and maximum of Fanout buckets of the level below.
+ * Every level is a ring indexed by the absolute frame index, like the samples, so that a bucket gets replaced
+ * exactly when its first frame falls out of the history and buckets entirely inside the history are always valid.
+ * Level 1 is updated with every frame, the levels above only when a bucket of the level below is complete,
+ * which costs less than 1/(Fanout - 1) extra updates per frame; ranges that end inside an incomplete bucket
+ * never use that bucket, they are covered by the finer levels.
+ */
+template<class T>
+class MinMaxHistory
+{
+  public:
+    static const unsigned int FanoutShift = 3;
+    static const size_t Fanout = size_t(1) << FanoutShift;
+
+    /**
+     * @param capacity frames kept, rounded up to a power of Fanout
+     */
+    MinMaxHistory(size_t channelCount, size_t capacity):
+        mSize(0)
+    {
+        size_t levelCount = 1;
+        mCapacity = 1;
+        while (mCapacity < capacity)
+        {
+            mCapacity <<= FanoutShift;
+            ++levelCount;
+        }
+
+        mChannels.resize(channelCount);
+        for (Channel &channel : mChannels)
+        {
+            channel.levels.resize(levelCount);
+            for (size_t level = 0; level < levelCount; ++level)
+            {
+                const size_t bucketCount = mCapacity >> (level*FanoutShift);
+                channel.levels[level].minimums.resize(bucketCount);
+                if (level > 0)
+                {
+                    channel.levels[level].maximums.resize(bucketCount);
+                }
+            }
+        }
+    }
+
+    size_t channelCount() const
+    {
+        return mChannels.size();
+    }
+
+    size_t capacity() const
+    {
+        return mCapacity;
+    }
+
+    /**
+     * @brief end
+     * @return the absolute index of the next frame, the number of frames appended so far
+     */
+    uint64_t end() const
+    {
+        return mSize;
+    }
+
+    /**
+     * @brief begin
+     * @return the absolute index of the oldest frame still in the history
+     */
+    uint64_t begin() const
+    {
+        return mSize > mCapacity ? mSize - mCapacity : 0;
+    }
+
+    void clear()
+    {
+        mSize = 0;
+    }
+
+    /**
+     * @brief append appends one frame
+     * @param frame one value per channel
+     */
+    void append(const T *frame)
+    {
+        const uint64_t index = mSize++;
+        const size_t levelCount = mChannels[0].levels.size();
+
+        for (size_t c = 0; c < mChannels.size(); ++c)
+        {
+            Channel &channel = mChannels[c];
+            const T value = frame[c];
+            channel.levels[0].minimums[index & (mCapacity - 1)] = value;
+
+            if (levelCount == 1)
+            {
+                continue;
+            }
+
+            Level &first = channel.levels[1];
+            const size_t bucket = (index >> FanoutShift) & (first.minimums.size() - 1);
+            if ((index & (Fanout - 1)) == 0)
+            {
+                first.minimums[bucket] = value;
+                first.maximums[bucket] = value;
+            }
+            else
+            {
+                first.minimums[bucket] = std::min(first.minimums[bucket], value);
+                first.maximums[bucket] = std::max(first.maximums[bucket], value);
+            }
+
+            // fold completed buckets into the level above
+            for (size_t level = 1; level + 1 < levelCount; ++level)
+            {
+                const unsigned int shift = level*FanoutShift;
+                if (((index + 1) & ((uint64_t(1) << shift) - 1)) != 0)
+                {
+                    break;
+                }
+
+                const Level &below = channel.levels[level];
+                Level &above = channel.levels[level + 1];
+                const uint64_t child = index >> shift;
+                const size_t from = child & (below.minimums.size() - 1);
+                const size_t to = (child >> FanoutShift) & (above.minimums.size() - 1);
+
+                if ((child & (Fanout - 1)) == 0)
+                {
+                    above.minimums[to] = below.minimums[from];
+                    above.maximums[to] = below.maximums[from];
+                }
+                else
+                {
+                    above.minimums[to] = std::min(above.minimums[to], below.minimums[from]);
+                    above.maximums[to] = std::max(above.maximums[to], below.maximums[from]);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief value
+     * @param index absolute index, between begin() and end()
+     */
+    T value(size_t channel, uint64_t index) const
+    {
+        return mChannels[channel].levels[0].minimums[index & (mCapacity - 1)];
+    }
+
+    /**
+     * @brief minMax finds the minimum and maximum of the frames [first, last) of a channel,
+     * which has to be a non empty range between begin() and end()
+     */
+    void minMax(size_t channel, uint64_t first, uint64_t last, T *minimum, T *maximum) const
+    {
+        const std::vector<Level> &levels = mChannels[channel].levels;
+        T lowest = value(channel, first);
+        T highest = lowest;
+
+        // first and last stay aligned to the bucket size of the current level
+        for (size_t level = 0; first < last; ++level)
+        {
+            const unsigned int shift = level*FanoutShift;
+            const uint64_t size = uint64_t(1) << shift;
+
+            if (level + 1 == levels.size())
+            {
+                for (; first < last; first += size)
+                {
+                    include(levels[level], level, first >> shift, &lowest, &highest);
+                }
+                break;
+            }
+
+            const uint64_t parentMask = (size << FanoutShift) - 1;
+            while (first < last && (first & parentMask) != 0)
+            {
+                include(levels[level], level, first >> shift, &lowest, &highest);
+                first += size;
+            }
+
+            while (first < last && (last & parentMask) != 0)
+            {
+                last -= size;
+                include(levels[level], level, last >> shift, &lowest, &highest);
+            }
+        }
+
+        *minimum = lowest;
+        *maximum = highest;
+    }
+
+  private:
+    struct Level
+    {
+        std::vector<T> minimums;    // the samples on level 0
+        std::vector<T> maximums;    // empty on level 0
+    };
+
+    struct Channel
+    {
+        std::vector<Level> levels;
+    };
+
+    static void include(const Level &level, size_t index, uint64_t bucket, T *minimum, T *maximum)
+    {
+        const size_t i = bucket & (level.minimums.size() - 1);
+        const std::vector<T> &maximums = index == 0 ? level.minimums : level.maximums;
+        *minimum = std::min(*minimum, level.minimums[i]);
+        *maximum = std::max(*maximum, maximums[i]);
+    }
+
+    std::vector<Channel> mChannels;
+    size_t mCapacity;
+    uint64_t mSize;
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "parametersweep.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+
+#include "emanoisefilter.h"
+#include "simplenoisefilter.h"
+#include "workstealingpool.h"
+
+namespace {
+
+// Samples filtered per block, small enough for the block to stay in L2
+const size_t BlockSize = 16*1024;
+
+/**
+ * @return twice the central difference of truth at i, one sided at the ends
+ */
+int64_t truthSlope(const int *truth, size_t sampleCount, size_t i)
+{
+    const size_t previous = i > 0 ? i - 1 : i;
+    const size_t next = i + 1 < sampleCount ? i + 1 : i;
+    if (next == previous)
+    {
+        return 0;
+    }
+    return (static_cast<int64_t>(truth[next]) - truth[previous])*(2/static_cast<int64_t>(next - previous));
+}
+
+}
+
+void SweepConfiguration::apply(FilterParameters *parameters) const
+{
+    if (filter == EMA)
+    {
+        parameters->snapMultiplier = snapMultiplier;
+        parameters->emaActivityThreshold = activityThreshold;
+    }
+    else
+    {
+        parameters->simpleActivityThreshold = activityThreshold;
+        parameters->suppressionCount = suppressionCount;
+    }
+}
+
+bool SweepRange::parse(const std::string &range)
+{
+    char *end = nullptr;
+    minimum = strtod(range.c_str(), &end);
+    if (end == range.c_str())
+    {
+        return false;
+    }
+
+    if (*end == 0)
+    {
+        maximum = minimum;
+        steps = 1;
+        return true;
+    }
+
+    if (*end != ':')
+    {
+        return false;
+    }
+
+    const char *maximumBegin = end + 1;
+    maximum = strtod(maximumBegin, &end);
+    if (end == maximumBegin || *end != ':')
+    {
+        return false;
+    }
+
+    const char *stepsBegin = end + 1;
+    steps = static_cast<int>(strtol(stepsBegin, &end, 10));
+    return end != stepsBegin && *end == 0 && steps > 0;
+}
+
+ParameterSweep::ParameterSweep(const int *input,
+                               const int *truth,
+                               size_t sampleCount,
+                               const FilterParameters &parameters):
+    mInput(input),
+    mTruth(truth),
+    mSampleCount(sampleCount),
+    mParameters(parameters),
+    mTruthSlopeSquares(0)
+{
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        const int64_t slope = truthSlope(truth, sampleCount, i);
+        mTruthSlopeSquares += slope*slope;
+    }
+}
+
+std::vector<SweepConfiguration> ParameterSweep::grid(const SweepRanges &ranges)
+{
+    std::vector<SweepConfiguration> configurations;
+
+    for (int i = 0; i < ranges.snapMultiplier.steps; ++i)
+    {
+        for (int j = 0; j < ranges.emaActivityThreshold.steps; ++j)
+        {
+            const SweepConfiguration configuration = {
+                SweepConfiguration::EMA,
+                ranges.snapMultiplier.value(i),
+                static_cast<int>(lround(ranges.emaActivityThreshold.value(j))),
+                0
+            };
+            configurations.push_back(configuration);
+        }
+    }
+
+    for (int i = 0; i < ranges.simpleActivityThreshold.steps; ++i)
+    {
+        for (int j = 0; j < ranges.suppressionCount.steps; ++j)
+        {
+            const SweepConfiguration configuration = {
+                SweepConfiguration::Simple,
+                0,
+                static_cast<int>(lround(ranges.simpleActivityThreshold.value(i))),
+                static_cast<int>(lround(ranges.suppressionCount.value(j)))
+            };
+            configurations.push_back(configuration);
+        }
+    }
+
+    return configurations;
+}
+
+std::vector<SweepConfiguration> ParameterSweep::random(const SweepRanges &ranges, size_t count, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> snapMultiplier(ranges.snapMultiplier.minimum, ranges.snapMultiplier.maximum);
+    std::uniform_real_distribution<double> emaActivityThreshold(ranges.emaActivityThreshold.minimum, ranges.emaActivityThreshold.maximum);
+    std::uniform_real_distribution<double> simpleActivityThreshold(ranges.simpleActivityThreshold.minimum, ranges.simpleActivityThreshold.maximum);
+    std::uniform_real_distribution<double> suppressionCount(ranges.suppressionCount.minimum, ranges.suppressionCount.maximum);
+
+    std::vector<SweepConfiguration> configurations;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const SweepConfiguration configuration = {
+            SweepConfiguration::EMA,
+            snapMultiplier(generator),
+            static_cast<int>(lround(emaActivityThreshold(generator))),
+            0
+        };
+        configurations.push_back(configuration);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const SweepConfiguration configuration = {
+            SweepConfiguration::Simple,
+            0,
+            static_cast<int>(lround(simpleActivityThreshold(generator))),
+            static_cast<int>(lround(suppressionCount(generator)))
+        };
+        configurations.push_back(configuration);
+    }
+
+    return configurations;
+}
+
+std::vector<SweepResult> ParameterSweep::run(const std::vector<SweepConfiguration> &configurations, WorkStealingPool &pool) const
+{
+    std::vector<SweepResult> results(configurations.size());
+    std::vector<std::vector<int>> scratch(pool.threadCount());
+
+    // every configuration filters the whole trace, so one configuration per range is plenty to keep the overhead down
+    pool.run(configurations.size(), 1, [&](size_t begin, size_t end, unsigned worker) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            results[i].configuration = configurations[i];
+            results[i].score = evaluate(configurations[i], scratch[worker]);
+        }
+    });
+
+    return results;
+}
+
+SweepScore ParameterSweep::evaluate(const SweepConfiguration &configuration, std::vector<int> &scratch) const
+{
+    FilterParameters parameters = mParameters;
+    configuration.apply(&parameters);
+
+    if (configuration.filter == SweepConfiguration::EMA)
+    {
+        EMANoiseFilter<int> filter(parameters.lowerBound, parameters.upperBound);
+        parameters.configure(filter);
+        return score(filter, scratch);
+    }
+
+    SimpleNoiseFilter<int> filter(parameters.simpleActivityThreshold, parameters.suppressionCount);
+    parameters.configure(filter);
+    return score(filter, scratch);
+}
+
+template<class Filter>
+SweepScore ParameterSweep::score(Filter &filter, std::vector<int> &scratch) const
+{
+    scratch.resize(BlockSize);
+
+    SweepScore score = { 0, 0, 0 };
+    int64_t errorSquares = 0;
+    int64_t errorSlopes = 0;
+
+    for (size_t begin = 0; begin < mSampleCount; begin += BlockSize)
+    {
+        const size_t n = std::min(BlockSize, mSampleCount - begin);
+        score.changeCount += filter.update(mInput + begin, scratch.data(), n);
+
+        // only the first and the last sample need the one sided slope, keep the branches out of the loop
+        const size_t first = begin == 0 ? 1 : 0;
+        const size_t last = begin + n == mSampleCount ? n - 1 : n;
+        const int *truth = mTruth + begin;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const int64_t error = static_cast<int64_t>(truth[i]) - scratch[i];
+            errorSquares += error*error;
+        }
+
+        for (size_t i = first; i < last; ++i)
+        {
+            const int64_t error = static_cast<int64_t>(truth[i]) - scratch[i];
+            errorSlopes += error*(static_cast<int64_t>(truth[i + 1]) - truth[i - 1]);
+        }
+
+        if (first == 1)
+        {
+            errorSlopes += (static_cast<int64_t>(truth[0]) - scratch[0])*truthSlope(mTruth, mSampleCount, begin);
+        }
+        if (last < n && begin + last > 0)
+        {
+            errorSlopes += (static_cast<int64_t>(truth[last]) - scratch[last])*truthSlope(mTruth, mSampleCount, begin + last);
+        }
+    }
+
+    score.rmsError = mSampleCount > 0 ? sqrt(static_cast<double>(errorSquares)/mSampleCount) : 0;
+    score.lag = mTruthSlopeSquares > 0 ? 2.0*errorSlopes/mTruthSlopeSquares : 0;
+    return score;
+}
@@ -0,0 +1,134 @@
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "filterparameters.h"
+
+class WorkStealingPool;
+
+/**
+ * One setting of the filter parameters tuned with the GUI spin boxes.
+ * The EMA and the simple filter don't influence each other, so each configuration only sets the parameters of one of them.
+ */
+struct SweepConfiguration
+{
+    enum Filter
+    {
+        EMA,
+        Simple
+    };
+
+    Filter filter;
+    double snapMultiplier;  // EMA only
+    int activityThreshold;  // the EMA or the simple filter threshold
+    int suppressionCount;   // simple filter only
+
+    /**
+     * @brief apply sets the parameters of the configured filter, leaving the rest as they are
+     */
+    void apply(FilterParameters *parameters) const;
+};
+
+struct SweepScore
+{
+    double rmsError;        // root mean square of output - truth
+    double lag;             // samples the output lags behind the truth, least squares estimate
+    uint64_t changeCount;   // number of times the output changed
+};
+
+struct SweepResult
+{
+    SweepConfiguration configuration;
+    SweepScore score;
+};
+
+/**
+ * A parameter range, steps values from minimum to maximum
+ */
+struct SweepRange
+{
+    double minimum;
+    double maximum;
+    int steps;
+
+    double value(int step) const
+    {
+        return steps > 1 ? minimum + (maximum - minimum)*step/(steps - 1) : minimum;
+    }
+
+    /**
+     * @brief parse parses "minimum:maximum:steps", or a single value
+     */
+    bool parse(const std::string &range);
+};
+
+struct SweepRanges
+{
+    SweepRange snapMultiplier;
+    SweepRange emaActivityThreshold;
+    SweepRange simpleActivityThreshold;
+    SweepRange suppressionCount;
+};
+
+/**
+ * Runs the filters over a recorded input with every configuration and scores the output against a ground truth signal,
+ * e.g. the slider position of a GUI recording, whose input has the noise added.
+ *
+ * The lag is the least squares fit of output(t) = truth(t - lag) to first order,
+ * truth(t - lag) ~ truth(t) - lag*truth'(t), which can be computed in the same pass as the error:
+ * lag = sum((truth - output)*truth')/sum(truth'^2), with truth' the central difference.
+ */
+class ParameterSweep
+{
+  public:
+    /**
+     * @param input the raw samples, must stay valid while the sweep runs
+     * @param truth what the filtered input should be, sampleCount samples as well
+     * @param parameters the parameters that aren't swept, e.g. the bounds and sleep
+     */
+    ParameterSweep(const int *input,
+                   const int *truth,
+                   size_t sampleCount,
+                   const FilterParameters &parameters);
+
+    /**
+     * @brief grid
+     * @return every combination of the ranges, EMA configurations first
+     */
+    static std::vector<SweepConfiguration> grid(const SweepRanges &ranges);
+
+    /**
+     * @brief random
+     * @return count configurations of each filter, drawn uniformly from the ranges
+     */
+    static std::vector<SweepConfiguration> random(const SweepRanges &ranges, size_t count, unsigned int seed);
+
+    /**
+     * @brief run scores all the configurations, spread over the workers of the pool
+     * @return one result per configuration, in the same order
+     */
+    std::vector<SweepResult> run(const std::vector<SweepConfiguration> &configurations, WorkStealingPool &pool) const;
+
+    /**
+     * @brief evaluate scores one configuration
+     * @param scratch holds the filtered samples, resized as needed
+     */
+    SweepScore evaluate(const SweepConfiguration &configuration, std::vector<int> &scratch) const;
+
+  private:
+    template<class Filter>
+    SweepScore score(Filter &filter, std::vector<int> &scratch) const;
+
+    const int *mInput;
+    const int *mTruth;
+    size_t mSampleCount;
+    FilterParameters mParameters;
+    int64_t mTruthSlopeSquares;
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "plotwidget.h"
+
+#include <QCursor>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWheelEvent>
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const size_t HistoryCapacity = size_t(1) << 24;
+const double MinimumVisibleSampleCount = 16;
+const double ZoomFactor = 1.25;
+
+const Qt::GlobalColor ChannelColors[] = { Qt::gray, Qt::blue, Qt::red };
+const char *const ChannelNames[] = {
+    QT_TRANSLATE_NOOP("PlotWidget", "Effective Input"),
+    QT_TRANSLATE_NOOP("PlotWidget", "EMA Filter Output"),
+    QT_TRANSLATE_NOOP("PlotWidget", "Simple Filter Output")
+};
+
+int16_t saturate(int value)
+{
+    return static_cast<int16_t>(std::max<int>(std::numeric_limits<int16_t>::min(),
+                                              std::min<int>(std::numeric_limits<int16_t>::max(), value)));
+}
+
+}
+
+PlotWidget::PlotWidget(QWidget *parent) :
+    QWidget(parent),
+    mHistory(3, HistoryCapacity),
+    mMinimum(0),
+    mMaximum(1024),
+    mVisibleSampleCount(1000),
+    mFollowing(true),
+    mViewEnd(0),
+    mDragging(false),
+    mDragX(0),
+    mDragViewEnd(0)
+{
+    setMinimumHeight(150);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void PlotWidget::append(const FilterWorker::Sample *samples, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Value frame[] = {
+            saturate(samples[i].value),
+            saturate(samples[i].emaOutput),
+            saturate(samples[i].simpleOutput)
+        };
+        mHistory.append(frame);
+    }
+
+    if (n > 0 && mFollowing)
+    {
+        update();
+    }
+}
+
+void PlotWidget::setRange(int minimum, int maximum)
+{
+    mMinimum = minimum;
+    mMaximum = maximum;
+    update();
+}
+
+uint64_t PlotWidget::viewEnd() const
+{
+    if (mFollowing)
+    {
+        return mHistory.end();
+    }
+
+    return static_cast<uint64_t>(std::max(0.0, std::min(mViewEnd, static_cast<double>(mHistory.end()))));
+}
+
+void PlotWidget::setViewEnd(double viewEnd)
+{
+    mFollowing = viewEnd >= mHistory.end();
+    mViewEnd = viewEnd;
+    update();
+}
+
+void PlotWidget::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::white);
+
+    const int width = this->width();
+    const int height = this->height();
+    const double range = std::max(1, mMaximum - mMinimum);
+    auto y = [&](int value) {
+        return static_cast<int>((height - 1)*(mMaximum - value)/range);
+    };
+
+    const uint64_t end = viewEnd();
+    const double samplesPerPixel = mVisibleSampleCount/width;
+    const double start = end - mVisibleSampleCount;
+
+    for (size_t channel = 0; channel < mHistory.channelCount(); ++channel)
+    {
+        painter.setPen(ChannelColors[channel]);
+
+        if (samplesPerPixel < 1)
+        {
+            // zoomed in far enough to see the samples, connect them
+            const uint64_t first = std::max<uint64_t>(mHistory.begin(), static_cast<uint64_t>(std::max(0.0, start)));
+            QPoint previous;
+            for (uint64_t index = first; index < end; ++index)
+            {
+                const QPoint point(static_cast<int>((index - start)/samplesPerPixel),
+                                   y(mHistory.value(channel, index)));
+                if (index > first)
+                {
+                    painter.drawLine(previous, point);
+                }
+                previous = point;
+            }
+            continue;
+        }
+
+        int previousLow = 0;
+        int previousHigh = 0;
+        bool hasPrevious = false;
+        for (int x = 0; x < width; ++x)
+        {
+            const double columnStart = start + x*samplesPerPixel;
+            const uint64_t first = std::max<uint64_t>(mHistory.begin(), static_cast<uint64_t>(std::max(0.0, columnStart)));
+            const uint64_t last = std::min<uint64_t>(end, static_cast<uint64_t>(std::max(0.0, columnStart + samplesPerPixel)));
+            if (first >= last)
+            {
+                hasPrevious = false;
+                continue;
+            }
+
+            Value minimum;
+            Value maximum;
+            mHistory.minMax(channel, first, last, &minimum, &maximum);
+
+            // extend the column to the previous one, so that steps are drawn as connected lines
+            const int low = y(minimum);
+            const int high = y(maximum);
+            const int top = hasPrevious ? std::min(high, previousLow) : high;
+            const int bottom = hasPrevious ? std::max(low, previousHigh) : low;
+            painter.drawLine(x, top, x, bottom);
+
+            previousLow = low;
+            previousHigh = high;
+            hasPrevious = true;
+        }
+    }
+
+    int legendY = painter.fontMetrics().height();
+    for (size_t channel = 0; channel < mHistory.channelCount(); ++channel)
+    {
+        painter.setPen(ChannelColors[channel]);
+        painter.drawText(4, legendY, tr(ChannelNames[channel]));
+        legendY += painter.fontMetrics().height();
+    }
+
+    painter.setPen(Qt::black);
+    painter.drawText(rect().adjusted(0, 0, -4, -4),
+                     Qt::AlignRight | Qt::AlignBottom,
+                     tr("%1 samples%2").arg(static_cast<qlonglong>(mVisibleSampleCount))
+                                       .arg(mFollowing ? QString() : tr(", paused")));
+}
+
+void PlotWidget::wheelEvent(QWheelEvent *event)
+{
+    const int x = mapFromGlobal(QCursor::pos()).x();
+    const double end = static_cast<double>(viewEnd());
+    const double samplesPerPixel = mVisibleSampleCount/width();
+    const double anchor = end - mVisibleSampleCount + x*samplesPerPixel;
+
+    const double steps = event->angleDelta().y()/120.0;
+    const double visibleSampleCount = std::max(MinimumVisibleSampleCount,
+                                               std::min(static_cast<double>(mHistory.capacity()),
+                                                        mVisibleSampleCount*pow(ZoomFactor, -steps)));
+
+    // keep the sample under the cursor where it is, but keep following the input when zooming while following
+    const double newEnd = anchor + (width() - x)*visibleSampleCount/width();
+    mVisibleSampleCount = visibleSampleCount;
+    if (!mFollowing)
+    {
+        setViewEnd(newEnd);
+    }
+    update();
+    event->accept();
+}
+
+void PlotWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        mDragging = true;
+        mDragX = event->pos().x();
+        mDragViewEnd = static_cast<double>(viewEnd());
+    }
+}
+
+void PlotWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (mDragging)
+    {
+        setViewEnd(mDragViewEnd - (event->pos().x() - mDragX)*mVisibleSampleCount/width());
+    }
+}
+
+void PlotWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        mDragging = false;
+    }
+}
+
+void PlotWidget::mouseDoubleClickEvent(QMouseEvent *)
+{
+    mFollowing = true;
+    update();
+}
@@ -0,0 +1,61 @@
+#ifndef PLOTWIDGET_H
+#define PLOTWIDGET_H
+
+#include <QWidget>
+
+#include "filterworker.h"
+#include "minmaxhistory.h"
+
+/**
+ * Scrolling plot of the effective input and the outputs of both filters over the last 16M samples.
+ *
+ * Each pixel column is drawn as the range between the minimum and maximum of its samples,
+ * looked up in the pyramid of a MinMaxHistory, so a repaint costs O(width) however many samples are visible.
+ * The wheel zooms around the cursor, dragging pans back in time and a double click goes back to following the input.
+ */
+class PlotWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PlotWidget(QWidget *parent = nullptr);
+
+    /**
+     * @brief append appends samples to the history and schedules a repaint if they are visible
+     */
+    void append(const FilterWorker::Sample *samples, size_t n);
+
+    /**
+     * @brief setRange sets the values at the bottom and the top of the plot
+     */
+    void setRange(int minimum, int maximum);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private:
+    // int16_t keeps the 16M samples of 3 channels at about 120 MB including the pyramid
+    typedef int16_t Value;
+
+    uint64_t viewEnd() const;
+    void setViewEnd(double viewEnd);
+
+    MinMaxHistory<Value> mHistory;
+    int mMinimum;
+    int mMaximum;
+
+    double mVisibleSampleCount;     // samples across the width of the plot
+    bool mFollowing;                // the right edge is the newest sample
+    double mViewEnd;                // absolute index of the right edge when not following
+
+    bool mDragging;
+    int mDragX;
+    double mDragViewEnd;
+};
+
+#endif // PLOTWIDGET_H
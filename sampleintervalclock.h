@@ -0,0 +1,89 @@
+#ifndef SAMPLE_INTERVAL_CLOCK_H
+#define SAMPLE_INTERVAL_CLOCK_H
+
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * Counts the sample intervals between the timestamps of the timestamped update() of the filters,
+ * whose coefficients are per sample interval.
+ */
+template<class Real>
+class SampleIntervalClock
+{
+  public:
+    SampleIntervalClock():
+        mSampleInterval(1),
+        mTimestamp(0),
+        mHasTimestamp(false)
+    {
+    }
+
+    /**
+     * @brief sampleInterval
+     * @return the time between two samples the filter is tuned for, in the unit of the timestamps
+     */
+    uint64_t sampleInterval() const
+    {
+        return mSampleInterval;
+    }
+
+    void setSampleInterval(uint64_t interval)
+    {
+        mSampleInterval = interval > 0 ? interval : 1;
+    }
+
+    /**
+     * @brief reset forgets the previous timestamp, e.g. when the filter is restored from a snapshot
+     */
+    void reset()
+    {
+        mHasTimestamp = false;
+    }
+
+    /**
+     * @return the number of sample intervals since the previous timestamp.
+     * The first timestamp counts as one interval, one that isn't after the previous one as none.
+     */
+    Real elapsedIntervals(uint64_t timestamp)
+    {
+        const uint64_t elapsed = timestamp > mTimestamp ? timestamp - mTimestamp : 0;
+        const Real intervals = mHasTimestamp ? static_cast<Real>(elapsed)/static_cast<Real>(mSampleInterval) : Real(1);
+
+        mTimestamp = timestamp;
+        mHasTimestamp = true;
+        return intervals;
+    }
+
+    /**
+     * @return the weight of an exponential moving average with the given weight per interval, over intervals:
+     * 1 - (1 - weight)^intervals. Whole numbers of intervals, as from decimation or dropped samples,
+     * are raised by squaring rather than with pow().
+     */
+    static Real compounded(Real weight, Real intervals)
+    {
+        Real base = Real(1) - weight;
+        if (!(intervals <= Real(64)) || static_cast<unsigned>(intervals) != intervals)
+        {
+            return Real(1) - std::pow(base, intervals);
+        }
+
+        Real power = Real(1);
+        for (unsigned exponent = static_cast<unsigned>(intervals); exponent; exponent >>= 1)
+        {
+            if (exponent & 1)
+            {
+                power *= base;
+            }
+            base *= base;
+        }
+        return Real(1) - power;
+    }
+
+  private:
+    uint64_t mSampleInterval;
+    uint64_t mTimestamp;
+    bool mHasTimestamp;
+};
+
+#endif
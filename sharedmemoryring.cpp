@@ -0,0 +1,407 @@
+#include "sharedmemoryring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+namespace {
+
+const char RingMagic[8] = { 'F', 'T', 'S', 'H', 'M', 'R', 'G', 0 };
+const uint32_t RingByteOrder = 0x01020304;
+const uint32_t RingVersion = 1;
+const size_t SlotsOffset = sizeof(SharedRingHeader) + sizeof(SharedRingProducer) + sizeof(SharedRingConsumer);
+
+size_t sampleSizeOf(uint32_t sampleType)
+{
+    switch (sampleType)
+    {
+    case TraceHeader::Int32:
+        return sizeof(int32_t);
+    case TraceHeader::Float32:
+        return sizeof(float);
+    case TraceHeader::Float64:
+        return sizeof(double);
+    }
+    return 0;
+}
+
+std::string objectName(const std::string &name)
+{
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+int64_t milliseconds()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Sleeps until word changes from value, is woken or timeout milliseconds (negative: no timeout) have passed.
+ * The futex isn't private, the word is shared with the other process.
+ */
+void waitOn(std::atomic<uint32_t> &word, uint32_t value, int timeout)
+{
+#if defined(__linux__)
+    struct timespec time = { timeout/1000, (timeout % 1000)*1000000L };
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, value, timeout >= 0 ? &time : nullptr, nullptr, 0);
+#else
+    // without futexes, poll
+    const int64_t end = milliseconds() + (timeout >= 0 ? timeout : 1000);
+    while (word.load(std::memory_order_acquire) == value && milliseconds() < end)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+#endif
+}
+
+void wakeOn(std::atomic<uint32_t> &word)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+}
+
+SharedMemoryRing::SharedMemoryRing():
+    mData(nullptr),
+    mSize(0),
+    mCreated(false),
+    mHeader(nullptr),
+    mProducer(nullptr),
+    mConsumer(nullptr),
+    mSlots(nullptr),
+    mCachedSequence(0),
+    mWaitCount(0)
+{
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    close();
+}
+
+bool SharedMemoryRing::create(const std::string &name,
+                              TraceHeader::SampleType sampleType,
+                              uint32_t channelCount,
+                              uint32_t blockLength,
+                              uint32_t slotCount,
+                              double sampleRate,
+                              double lowerBound,
+                              double upperBound)
+{
+    close();
+
+    uint32_t slots = 1;
+    while (slots < slotCount)
+    {
+        slots *= 2;
+    }
+
+    const size_t sampleSize = sampleSizeOf(sampleType);
+    if (sampleSize == 0 || channelCount == 0 || blockLength == 0)
+    {
+        mErrorString = "invalid ring format";
+        return false;
+    }
+
+    const uint64_t slotSize = (sizeof(SharedRingSlot) + uint64_t(channelCount)*blockLength*sampleSize + 63)/64*64;
+    const size_t size = SlotsOffset + slots*slotSize;
+
+    mName = objectName(name);
+    shm_unlink(mName.c_str());
+    const int fd = shm_open(mName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        mErrorString = mName + ": " + strerror(errno);
+        return false;
+    }
+
+    mCreated = true;
+    if (ftruncate(fd, size) != 0 || !map(fd, size))
+    {
+        mErrorString = mName + ": " + strerror(errno);
+        ::close(fd);
+        close();
+        return false;
+    }
+    ::close(fd);
+
+    // ftruncate() zeroed the counters. The magic goes in last, open() doesn't take the ring before it sees it.
+    SharedRingHeader header;
+    memset(&header, 0, sizeof(header));
+    header.byteOrder = RingByteOrder;
+    header.version = RingVersion;
+    header.sampleType = sampleType;
+    header.channelCount = channelCount;
+    header.blockLength = blockLength;
+    header.slotCount = slots;
+    header.slotSize = slotSize;
+    header.sampleRate = sampleRate;
+    header.lowerBound = lowerBound;
+    header.upperBound = upperBound;
+    memcpy(mHeader, &header, sizeof(header));
+
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(mHeader->magic, RingMagic, sizeof(RingMagic));
+
+    mErrorString.clear();
+    return true;
+}
+
+bool SharedMemoryRing::open(const std::string &name, unsigned timeout)
+{
+    close();
+
+    mName = objectName(name);
+    const int64_t end = milliseconds() + timeout;
+
+    // until the creator has created, sized and filled in the ring
+    for (;;)
+    {
+        const int fd = shm_open(mName.c_str(), O_RDWR, 0);
+        if (fd < 0 && errno != ENOENT)
+        {
+            mErrorString = mName + ": " + strerror(errno);
+            return false;
+        }
+
+        struct stat status;
+        if (fd >= 0 && fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) > SlotsOffset)
+        {
+            const bool mapped = map(fd, status.st_size);
+            ::close(fd);
+            if (!mapped)
+            {
+                mErrorString = mName + ": " + strerror(errno);
+                return false;
+            }
+
+            if (memcmp(mHeader->magic, RingMagic, sizeof(RingMagic)) == 0)
+            {
+                break;
+            }
+            close();
+        }
+        else if (fd >= 0)
+        {
+            ::close(fd);
+        }
+
+        if (milliseconds() >= end)
+        {
+            mErrorString = mName + ": no ring";
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    const SharedRingHeader &header = *mHeader;
+    const size_t sampleSize = sampleSizeOf(header.sampleType);
+    if (header.byteOrder != RingByteOrder
+        || header.version != RingVersion
+        || sampleSize == 0
+        || header.channelCount == 0
+        || header.blockLength == 0
+        || header.slotCount == 0
+        || (header.slotCount & (header.slotCount - 1)) != 0
+        || header.slotSize < sizeof(SharedRingSlot)
+        || header.slotSize > (mSize - SlotsOffset)/header.slotCount
+        || (header.slotSize - sizeof(SharedRingSlot))/sampleSize/header.channelCount < header.blockLength)
+    {
+        mErrorString = mName + ": not a valid ring";
+        close();
+        return false;
+    }
+
+    mErrorString.clear();
+    return true;
+}
+
+void SharedMemoryRing::close()
+{
+    if (mData)
+    {
+        munmap(mData, mSize);
+    }
+
+    // the other side keeps its mapping, the name is only needed to open the ring
+    if (mCreated)
+    {
+        shm_unlink(mName.c_str());
+    }
+
+    mData = nullptr;
+    mSize = 0;
+    mCreated = false;
+    mHeader = nullptr;
+    mProducer = nullptr;
+    mConsumer = nullptr;
+    mSlots = nullptr;
+    mCachedSequence = 0;
+    mWaitCount = 0;
+}
+
+SharedRingSlot *SharedMemoryRing::beginWrite(int timeout)
+{
+    if (!canWrite() && !wait(mProducer->producerWaiting, mConsumer->readEvent, timeout, &SharedMemoryRing::canWrite))
+    {
+        return nullptr;
+    }
+
+    return slot(mProducer->writeSequence.load(std::memory_order_relaxed));
+}
+
+void SharedMemoryRing::publish()
+{
+    mProducer->writeSequence.store(mProducer->writeSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    wake(mConsumer->consumerWaiting, mProducer->writeEvent);
+}
+
+void SharedMemoryRing::closeWriting()
+{
+    mProducer->closed.store(1, std::memory_order_release);
+    wake(mConsumer->consumerWaiting, mProducer->writeEvent);
+}
+
+const SharedRingSlot *SharedMemoryRing::beginRead(int timeout)
+{
+    if (!canRead() && !wait(mConsumer->consumerWaiting, mProducer->writeEvent, timeout, &SharedMemoryRing::canRead))
+    {
+        return nullptr;
+    }
+
+    // canRead() is also true once the ring is closed
+    const uint64_t sequence = mConsumer->readSequence.load(std::memory_order_relaxed);
+    return sequence < mCachedSequence ? slot(sequence) : nullptr;
+}
+
+void SharedMemoryRing::release()
+{
+    mConsumer->readSequence.store(mConsumer->readSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    wake(mProducer->producerWaiting, mConsumer->readEvent);
+}
+
+bool SharedMemoryRing::isFinished() const
+{
+    return mProducer->closed.load(std::memory_order_acquire) != 0
+           && mConsumer->readSequence.load(std::memory_order_acquire) == mProducer->writeSequence.load(std::memory_order_acquire);
+}
+
+bool SharedMemoryRing::waitUntilRead(int timeout)
+{
+    return isRead() || wait(mProducer->producerWaiting, mConsumer->readEvent, timeout, &SharedMemoryRing::isRead);
+}
+
+SharedRingSlot *SharedMemoryRing::slot(uint64_t sequence) const
+{
+    return reinterpret_cast<SharedRingSlot *>(mSlots + (sequence & (mHeader->slotCount - 1))*mHeader->slotSize);
+}
+
+bool SharedMemoryRing::map(int fd, size_t size)
+{
+    mData = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mData == MAP_FAILED)
+    {
+        mData = nullptr;
+        return false;
+    }
+
+    mSize = size;
+    mHeader = static_cast<SharedRingHeader *>(mData);
+    mProducer = reinterpret_cast<SharedRingProducer *>(mHeader + 1);
+    mConsumer = reinterpret_cast<SharedRingConsumer *>(mProducer + 1);
+    mSlots = static_cast<char *>(mData) + SlotsOffset;
+    return true;
+}
+
+/**
+ * Sleeps on the other side's event counter until ready().
+ * The waiting flag is set and ready() checked again after a full fence, and wake() increments the event counter
+ * and checks the flag after one, so that either the waiter sees the other side's progress or the other side sees the flag.
+ */
+bool SharedMemoryRing::wait(std::atomic<uint32_t> &waiting, std::atomic<uint32_t> &event, int timeout, bool (SharedMemoryRing::*ready)())
+{
+    const int64_t end = milliseconds() + timeout;
+    for (;;)
+    {
+        const uint32_t value = event.load(std::memory_order_acquire);
+        waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if ((this->*ready)())
+        {
+            waiting.store(0, std::memory_order_relaxed);
+            return true;
+        }
+
+        const int64_t remaining = end - milliseconds();
+        if (timeout >= 0 && remaining <= 0)
+        {
+            waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+
+        ++mWaitCount;
+        waitOn(event, value, timeout >= 0 ? static_cast<int>(remaining) : -1);
+        waiting.store(0, std::memory_order_relaxed);
+    }
+}
+
+void SharedMemoryRing::wake(std::atomic<uint32_t> &waiting, std::atomic<uint32_t> &event)
+{
+    event.fetch_add(1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (waiting.load(std::memory_order_relaxed))
+    {
+        wakeOn(event);
+    }
+}
+
+bool SharedMemoryRing::canWrite()
+{
+    const uint64_t sequence = mProducer->writeSequence.load(std::memory_order_relaxed);
+    if (sequence - mCachedSequence < mHeader->slotCount)
+    {
+        return true;
+    }
+
+    mCachedSequence = mConsumer->readSequence.load(std::memory_order_acquire);
+    return sequence - mCachedSequence < mHeader->slotCount;
+}
+
+bool SharedMemoryRing::canRead()
+{
+    const uint64_t sequence = mConsumer->readSequence.load(std::memory_order_relaxed);
+    if (sequence < mCachedSequence)
+    {
+        return true;
+    }
+
+    // closed before writeSequence, after the last publish() the producer sets closed
+    const bool closed = mProducer->closed.load(std::memory_order_acquire) != 0;
+    mCachedSequence = mProducer->writeSequence.load(std::memory_order_acquire);
+    return sequence < mCachedSequence || closed;
+}
+
+bool SharedMemoryRing::isRead()
+{
+    return mConsumer->readSequence.load(std::memory_order_acquire) == mProducer->writeSequence.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,204 @@
+#ifndef SHARED_MEMORY_RING_H
+#define SHARED_MEMORY_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "tracefile.h"
+
+/**
+ * Layout of a shared memory ring (POSIX shm_open() object), all fields in native byte order.
+ *
+ * The object starts with the 64 byte SharedRingHeader, which the creator fills in and never changes,
+ * followed by the 64 byte SharedRingProducer line, which only the producer writes,
+ * and the 64 byte SharedRingConsumer line, which only the consumer writes. The slots follow from byte 192,
+ * slotSize bytes each. A slot starts with a 64 byte SharedRingSlot, followed by channelCount runs of
+ * blockLength samples: the frameCount samples of channel c start at sample c*blockLength of the run,
+ * the rest of the run is unused. As in planar traces, the samples of a channel are contiguous
+ * and can be handed to the filters' block update() straight out of the slot.
+ *
+ * writeSequence counts the blocks the producer has published, readSequence the blocks the consumer has released,
+ * both only ever grow. Block s is stored in slot s % slotCount. The producer fills block writeSequence
+ * while writeSequence - readSequence < slotCount and publishes it by incrementing writeSequence,
+ * the consumer reads block readSequence while readSequence < writeSequence and releases it by incrementing readSequence.
+ *
+ * A side that finds the ring empty or full sets its waiting flag and sleeps on a futex on the other side's
+ * event counter, which the other side increments after every publish or release, and wakes the futex
+ * only when the waiting flag is set, so that a side that keeps up never makes a system call.
+ */
+struct SharedRingHeader
+{
+    char magic[8];          // "FTSHMRG" followed by a 0
+    uint32_t byteOrder;     // 0x01020304 written in native byte order
+    uint32_t version;       // 1
+    uint32_t sampleType;    // TraceHeader::SampleType
+    uint32_t channelCount;
+    uint32_t blockLength;   // frames per slot
+    uint32_t slotCount;     // a power of two
+    uint64_t slotSize;      // bytes per slot, including the SharedRingSlot, a multiple of 64
+    double sampleRate;      // Hz, 0 if the samples aren't taken at a fixed rate
+    double lowerBound;
+    double upperBound;
+};
+
+struct SharedRingProducer
+{
+    std::atomic<uint64_t> writeSequence;
+    std::atomic<uint32_t> writeEvent;       // futex word, incremented after every publish and at closeWriting()
+    std::atomic<uint32_t> producerWaiting;  // the producer sleeps on readEvent
+    std::atomic<uint32_t> closed;           // the producer won't publish any more slots
+    char padding[44];
+};
+
+struct SharedRingConsumer
+{
+    std::atomic<uint64_t> readSequence;
+    std::atomic<uint32_t> readEvent;        // futex word, incremented after every release
+    std::atomic<uint32_t> consumerWaiting;  // the consumer sleeps on writeEvent
+    char padding[48];
+};
+
+struct SharedRingSlot
+{
+    uint64_t firstFrame;    // index of the first frame of the slot in the stream
+    uint64_t timestamp;     // steady clock ns when the samples were taken, carried over from input to output rings
+    uint32_t frameCount;    // up to blockLength
+    char padding[44];
+};
+
+static_assert(sizeof(SharedRingHeader) == 64, "SharedRingHeader must stay 64 bytes");
+static_assert(sizeof(SharedRingProducer) == 64, "SharedRingProducer must take one cache line");
+static_assert(sizeof(SharedRingConsumer) == 64, "SharedRingConsumer must take one cache line");
+static_assert(sizeof(SharedRingSlot) == 64, "SharedRingSlot must stay 64 bytes so that the samples are aligned");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "the ring counters are shared between processes, they must not be implemented with locks");
+
+/**
+ * One side of a ring of sample blocks in POSIX shared memory, between exactly one producer process and one consumer process.
+ *
+ * The producer fills a slot in place between beginWrite() and publish(), the consumer reads it in place
+ * between beginRead() and release(), so that a block travels from one process to the other without a copy
+ * and, while neither side waits for the other, without a system call.
+ * One side create()s the ring and unlinks it again when it closes, the other side open()s it.
+ */
+class SharedMemoryRing
+{
+  public:
+    SharedMemoryRing();
+    ~SharedMemoryRing();
+
+    SharedMemoryRing(const SharedMemoryRing &) = delete;
+    SharedMemoryRing &operator=(const SharedMemoryRing &) = delete;
+
+    /**
+     * @brief create creates the shared memory object, replacing a stale one of the same name
+     * @param name shm_open() name, a leading / is added if it is missing
+     * @param slotCount rounded up to a power of two
+     */
+    bool create(const std::string &name,
+                TraceHeader::SampleType sampleType,
+                uint32_t channelCount,
+                uint32_t blockLength,
+                uint32_t slotCount,
+                double sampleRate,
+                double lowerBound,
+                double upperBound);
+
+    /**
+     * @brief open maps a ring created by another process
+     * @param timeout milliseconds to wait for the ring to be created, 0 to fail right away
+     */
+    bool open(const std::string &name, unsigned timeout = 0);
+
+    void close();
+
+    bool isOpen() const { return mData != nullptr; }
+    const std::string &errorString() const { return mErrorString; }
+    const SharedRingHeader &header() const { return *mHeader; }
+
+    /**
+     * @brief beginWrite called by the producer, waits for a free slot
+     * @param timeout milliseconds, negative to wait for as long as it takes
+     * @return the next slot to fill, nullptr on timeout
+     */
+    SharedRingSlot *beginWrite(int timeout = -1);
+
+    /**
+     * @brief publish called by the producer, hands the slot of the last beginWrite() to the consumer
+     */
+    void publish();
+
+    /**
+     * @brief closeWriting called by the producer, after the last publish()
+     */
+    void closeWriting();
+
+    /**
+     * @brief beginRead called by the consumer, waits for a published slot
+     * @param timeout milliseconds, negative to wait for as long as it takes
+     * @return the next slot to read, nullptr on timeout or once the producer has closed the ring and every slot has been read
+     */
+    const SharedRingSlot *beginRead(int timeout = -1);
+
+    /**
+     * @brief release called by the consumer, hands the slot of the last beginRead() back to the producer
+     */
+    void release();
+
+    /**
+     * @brief isFinished
+     * @return true once the producer has closed the ring and the consumer has released every slot,
+     * tells the consumer why beginRead() returned nullptr
+     */
+    bool isFinished() const;
+
+    /**
+     * @brief waitUntilRead called by the producer, waits until the consumer has released every published slot
+     * @return false on timeout
+     */
+    bool waitUntilRead(int timeout = -1);
+
+    /**
+     * @brief waitCount
+     * @return the number of times this side found the ring full or empty and had to sleep
+     */
+    uint64_t waitCount() const { return mWaitCount; }
+
+    template<class T>
+    T *samples(SharedRingSlot *slot, uint32_t channel) const
+    {
+        return reinterpret_cast<T *>(slot + 1) + size_t(channel)*mHeader->blockLength;
+    }
+
+    template<class T>
+    const T *samples(const SharedRingSlot *slot, uint32_t channel) const
+    {
+        return reinterpret_cast<const T *>(slot + 1) + size_t(channel)*mHeader->blockLength;
+    }
+
+  private:
+    SharedRingSlot *slot(uint64_t sequence) const;
+    bool map(int fd, size_t size);
+    bool wait(std::atomic<uint32_t> &waiting, std::atomic<uint32_t> &event, int timeout, bool (SharedMemoryRing::*ready)());
+    void wake(std::atomic<uint32_t> &waiting, std::atomic<uint32_t> &event);
+    bool canWrite();
+    bool canRead();
+    bool isRead();
+
+    std::string mName;
+    std::string mErrorString;
+    void *mData;
+    size_t mSize;
+    bool mCreated;
+    SharedRingHeader *mHeader;
+    SharedRingProducer *mProducer;
+    SharedRingConsumer *mConsumer;
+    char *mSlots;
+    uint64_t mCachedSequence;   // the other side's sequence, only reloaded when the ring looks full or empty
+    uint64_t mWaitCount;
+};
+
+#endif
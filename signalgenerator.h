@@ -0,0 +1,410 @@
+#ifndef SIGNAL_GENERATOR_H
+#define SIGNAL_GENERATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <algorithm>
+
+/**
+ * xoshiro256** 1.0 by Blackman and Vigna: 256 bits of state, a few cycles per 64 bit number,
+ * and unlike std::mt19937 with the std distributions the same sequence on every platform and standard library.
+ */
+class Xoshiro256
+{
+  public:
+    explicit Xoshiro256(uint64_t seed = 1)
+    {
+        setSeed(seed);
+    }
+
+    /**
+     * @brief setSeed expands seed into the state with splitmix64, as recommended by the authors
+     */
+    void setSeed(uint64_t seed)
+    {
+        for (uint64_t &s : mState)
+        {
+            seed += 0x9e3779b97f4a7c15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+            s = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next()
+    {
+        const uint64_t result = rotateLeft(mState[1]*5, 7)*9;
+        const uint64_t t = mState[1] << 17;
+
+        mState[2] ^= mState[0];
+        mState[3] ^= mState[1];
+        mState[1] ^= mState[2];
+        mState[0] ^= mState[3];
+        mState[2] ^= t;
+        mState[3] = rotateLeft(mState[3], 45);
+
+        return result;
+    }
+
+    /**
+     * @brief uniform
+     * @return a uniformly distributed double in [0, 1), from the upper 53 bits
+     */
+    double uniform()
+    {
+        return (next() >> 11)*(1.0/9007199254740992.0);
+    }
+
+    /**
+     * @brief below
+     * @return a uniformly distributed integer in [0, n), without modulo bias (Lemire's method)
+     */
+    uint32_t below(uint32_t n)
+    {
+        uint64_t product = (next() >> 32)*n;
+        if (static_cast<uint32_t>(product) < n)
+        {
+            const uint32_t threshold = (0u - n) % n;
+            while (static_cast<uint32_t>(product) < threshold)
+            {
+                product = (next() >> 32)*n;
+            }
+        }
+        return static_cast<uint32_t>(product >> 32);
+    }
+
+    /**
+     * @brief jump advances the state by 2^128 numbers,
+     * so that generators copied from the same seed and jumped 0, 1, 2... times give non overlapping streams for threads
+     */
+    void jump()
+    {
+        static const uint64_t Jump[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+
+        uint64_t state[4] = { 0, 0, 0, 0 };
+        for (uint64_t word : Jump)
+        {
+            for (int bit = 0; bit < 64; ++bit)
+            {
+                if (word & (uint64_t(1) << bit))
+                {
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        state[i] ^= mState[i];
+                    }
+                }
+                next();
+            }
+        }
+
+        std::copy(state, state + 4, mState);
+    }
+
+  private:
+    static uint64_t rotateLeft(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t mState[4];
+};
+
+/**
+ * Generates test signals in bulk on a virtual clock: sample i is taken at i/sampleRate seconds,
+ * however fast or slow generate() is called, so a simulation runs as fast as the CPU allows
+ * and the same seed and settings give the same samples on every run.
+ *
+ * A sample is a shape plus noise:
+ * Shape        the clean signal, also returned as the truth
+ * Constant     level
+ * Step         level, and level + amplitude during the second half of every period
+ * Ramp         triangle from level to level + amplitude and back, once per period
+ * Sine         level + amplitude*sin(2 pi t/period)
+ *
+ * Noise        what's added
+ * Uniform      uniform in [-noiseAmplitude, noiseAmplitude]
+ * Gaussian     normal with a standard deviation of noiseAmplitude
+ * Impulse      +-noiseAmplitude spikes with impulseProbability per sample, nothing otherwise
+ * Quantization none, the signal is rounded to multiples of quantizationStep instead
+ */
+class SignalGenerator
+{
+  public:
+    enum class Shape
+    {
+        Constant,
+        Step,
+        Ramp,
+        Sine
+    };
+
+    enum class Noise
+    {
+        None,
+        Uniform,
+        Gaussian,
+        Impulse,
+        Quantization
+    };
+
+    explicit SignalGenerator(uint64_t seed = 1, double sampleRate = 1000):
+        mSeed(seed),
+        mRandom(seed),
+        mSampleRate(sampleRate),
+        mSampleIndex(0),
+        mShape(Shape::Constant),
+        mLevel(0),
+        mAmplitude(0),
+        mPeriod(1),
+        mNoise(Noise::None),
+        mNoiseAmplitude(0),
+        mImpulseProbability(0.001),
+        mQuantizationStep(1),
+        mHasSpareGaussian(false),
+        mSpareGaussian(0)
+    {
+    }
+
+    /**
+     * @brief reset restarts the clock and the random sequence, so that generate() repeats the same samples
+     */
+    void reset()
+    {
+        mRandom.setSeed(mSeed);
+        mSampleIndex = 0;
+        mHasSpareGaussian = false;
+    }
+
+    uint64_t seed() const { return mSeed; }
+    void setSeed(uint64_t seed) { mSeed = seed; reset(); }
+
+    double sampleRate() const { return mSampleRate; }
+    void setSampleRate(double sampleRate) { mSampleRate = sampleRate; }
+
+    /**
+     * @brief time
+     * @return the virtual time of the next sample in seconds
+     */
+    double time() const { return mSampleIndex/mSampleRate; }
+    uint64_t sampleIndex() const { return mSampleIndex; }
+
+    Shape shape() const { return mShape; }
+    void setShape(Shape shape) { mShape = shape; }
+
+    double level() const { return mLevel; }
+    void setLevel(double level) { mLevel = level; }
+
+    double amplitude() const { return mAmplitude; }
+    void setAmplitude(double amplitude) { mAmplitude = amplitude; }
+
+    double period() const { return mPeriod; }
+
+    /**
+     * @brief setPeriod
+     * @param period in seconds of virtual time
+     */
+    void setPeriod(double period) { mPeriod = period; }
+
+    Noise noise() const { return mNoise; }
+    void setNoise(Noise noise) { mNoise = noise; }
+
+    double noiseAmplitude() const { return mNoiseAmplitude; }
+    void setNoiseAmplitude(double amplitude) { mNoiseAmplitude = amplitude; }
+
+    double impulseProbability() const { return mImpulseProbability; }
+    void setImpulseProbability(double probability) { mImpulseProbability = probability; }
+
+    double quantizationStep() const { return mQuantizationStep; }
+    void setQuantizationStep(double step) { mQuantizationStep = step; }
+
+    /**
+     * @brief generate generates the next n samples, rounded to the nearest integer for integer T
+     * @param truth if not nullptr, set to the shape without the noise
+     */
+    template<class T>
+    void generate(T *values, size_t n, T *truth = nullptr)
+    {
+        double clean[ChunkSize];
+        double noisy[ChunkSize];
+
+        for (size_t begin = 0; begin < n; begin += ChunkSize)
+        {
+            const size_t count = std::min(ChunkSize, n - begin);
+            generateShape(clean, count);
+            addNoise(clean, noisy, count);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                values[begin + i] = convert<T>(noisy[i]);
+            }
+            if (truth)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    truth[begin + i] = convert<T>(clean[i]);
+                }
+            }
+
+            mSampleIndex += count;
+        }
+    }
+
+  private:
+    static const size_t ChunkSize = 256;
+    static constexpr double Pi = 3.14159265358979323846;
+
+    template<class T>
+    static T convert(double value)
+    {
+        if (T(0.5) != 0)
+        {
+            return static_cast<T>(value);
+        }
+
+        // floor(value + 0.5) without the libm call, the cast truncates towards zero
+        const double rounded = value + 0.5;
+        const T result = static_cast<T>(rounded);
+        return result > rounded ? result - 1 : result;
+    }
+
+    void generateShape(double *clean, size_t n) const
+    {
+        const double samplesPerPeriod = std::max(1.0, mPeriod*mSampleRate);
+
+        switch (mShape)
+        {
+        case Shape::Constant:
+            std::fill(clean, clean + n, mLevel);
+            break;
+        case Shape::Step:
+        {
+            // the phase is only computed exactly once per chunk, and counted up within it
+            double phase = fmod(static_cast<double>(mSampleIndex), samplesPerPeriod);
+            for (size_t i = 0; i < n; ++i)
+            {
+                clean[i] = phase < samplesPerPeriod/2 ? mLevel : mLevel + mAmplitude;
+                phase = phase + 1 < samplesPerPeriod ? phase + 1 : phase + 1 - samplesPerPeriod;
+            }
+            break;
+        }
+        case Shape::Ramp:
+        {
+            const double slope = 2*mAmplitude/samplesPerPeriod;
+            double phase = fmod(static_cast<double>(mSampleIndex), samplesPerPeriod);
+            for (size_t i = 0; i < n; ++i)
+            {
+                clean[i] = mLevel + (phase < samplesPerPeriod/2 ? slope*phase : slope*(samplesPerPeriod - phase));
+                phase = phase + 1 < samplesPerPeriod ? phase + 1 : phase + 1 - samplesPerPeriod;
+            }
+            break;
+        }
+        case Shape::Sine:
+        {
+            // rotate a phasor instead of calling sin() per sample, and start every chunk from an exact sin/cos
+            // so that the rounding errors of the rotation don't add up over long runs
+            const double step = 2*Pi/samplesPerPeriod;
+            const double angle = step*fmod(static_cast<double>(mSampleIndex), samplesPerPeriod);
+            const double stepCos = cos(step);
+            const double stepSin = sin(step);
+            double s = sin(angle);
+            double c = cos(angle);
+            for (size_t i = 0; i < n; ++i)
+            {
+                clean[i] = mLevel + mAmplitude*s;
+                const double nextS = s*stepCos + c*stepSin;
+                c = c*stepCos - s*stepSin;
+                s = nextS;
+            }
+            break;
+        }
+        }
+    }
+
+    void addNoise(const double *clean, double *noisy, size_t n)
+    {
+        switch (mNoise)
+        {
+        case Noise::None:
+            std::copy(clean, clean + n, noisy);
+            break;
+        case Noise::Uniform:
+            for (size_t i = 0; i < n; ++i)
+            {
+                noisy[i] = clean[i] + mNoiseAmplitude*(2*mRandom.uniform() - 1);
+            }
+            break;
+        case Noise::Gaussian:
+            for (size_t i = 0; i < n; ++i)
+            {
+                noisy[i] = clean[i] + mNoiseAmplitude*gaussian();
+            }
+            break;
+        case Noise::Impulse:
+        {
+            // compare the raw 64 bits against the probability, which needs no conversion to double per sample
+            const uint64_t threshold = static_cast<uint64_t>(std::min(1.0, std::max(0.0, mImpulseProbability))*18446744073709549568.0);
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint64_t random = mRandom.next();
+                noisy[i] = clean[i];
+                if (random < threshold)
+                {
+                    noisy[i] += (random & 1) ? mNoiseAmplitude : -mNoiseAmplitude;
+                }
+            }
+            break;
+        }
+        case Noise::Quantization:
+        {
+            const double step = mQuantizationStep > 0 ? mQuantizationStep : 1;
+            for (size_t i = 0; i < n; ++i)
+            {
+                noisy[i] = step*convert<int64_t>(clean[i]/step);
+            }
+            break;
+        }
+        }
+    }
+
+    /**
+     * @brief gaussian
+     * @return a standard normal number, from the Box-Muller transform, which gives them in pairs
+     */
+    double gaussian()
+    {
+        if (mHasSpareGaussian)
+        {
+            mHasSpareGaussian = false;
+            return mSpareGaussian;
+        }
+
+        const double radius = sqrt(-2*log(1 - mRandom.uniform()));
+        const double angle = 2*Pi*mRandom.uniform();
+        mSpareGaussian = radius*sin(angle);
+        mHasSpareGaussian = true;
+        return radius*cos(angle);
+    }
+
+    uint64_t mSeed;
+    Xoshiro256 mRandom;
+    double mSampleRate;
+    uint64_t mSampleIndex;
+
+    Shape mShape;
+    double mLevel;
+    double mAmplitude;
+    double mPeriod;
+
+    Noise mNoise;
+    double mNoiseAmplitude;
+    double mImpulseProbability;
+    double mQuantizationStep;
+
+    bool mHasSpareGaussian;
+    double mSpareGaussian;
+};
+
+#endif
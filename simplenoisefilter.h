@@ -2,19 +2,40 @@
 #define SIMPLE_NOISE_FILTER_H
 
 #include <math.h>
+#include <stddef.h>
+#include <stdint.h>
 
+#include <algorithm>
 
-template<class T>
+#include "filterinstrumentation.h"
+#include "sampleintervalclock.h"
+
+template<class Filter>
+struct FilterChainStage;
+
+/**
+ * T is the type of the values, Real the type the average of two values is computed in, double by default
+ */
+template<class T, class Real = double>
 class SimpleNoiseFilter
 {
+    template<class>
+    friend struct FilterChainStage;
+
   public:
     SimpleNoiseFilter(T threshold,
                       int suppressCount):
         mEnabled(true),
         mFirstValue(true),
+        mPrevResponsiveValue(T()),
+        mSmoothValue(T()),
+        mRawValue(T()),
+        mFilteredValue(T()),
+        mFilteredValueHasChanged(false),
         mActivityThreshold(threshold),
         mSuppressionCount(suppressCount),
-        mCurrentSuppressionCount(0)
+        mCurrentSuppressionCount(0),
+        mSuppressedIntervals(0)
     {
     }
 
@@ -63,6 +84,54 @@ class SimpleNoiseFilter
         mEnabled = enabled;
     }
 
+    /**
+     * Everything update() carries over from one value to the next, without the settings,
+     * which are set up again when the filter is constructed.
+     * Plain data, so that arrays of snapshots can be written to a file and mapped back in, see filterstate.h.
+     */
+    struct Snapshot
+    {
+        T smoothValue;
+        T filteredValue;
+        T previousValue;
+        int32_t currentSuppressionCount;
+        uint8_t firstValue;
+        uint8_t hasChanged;
+    };
+
+    /**
+     * @brief snapshot
+     * @return the state restore() continues from
+     */
+    Snapshot snapshot() const
+    {
+        Snapshot snapshot = {
+            mSmoothValue,
+            mFilteredValue,
+            mPrevResponsiveValue,
+            mCurrentSuppressionCount,
+            mFirstValue,
+            mFilteredValueHasChanged
+        };
+        return snapshot;
+    }
+
+    /**
+     * @brief restore continues from a snapshot, e.g. of the filter of the same channel before a restart.
+     * Timestamps aren't part of the snapshot, the first timestamped update() after restore() counts as one sample interval.
+     */
+    void restore(const Snapshot &snapshot)
+    {
+        mClock.reset();
+        mSuppressedIntervals = snapshot.currentSuppressionCount;
+        mSmoothValue = snapshot.smoothValue;
+        mFilteredValue = snapshot.filteredValue;
+        mPrevResponsiveValue = snapshot.previousValue;
+        mCurrentSuppressionCount = snapshot.currentSuppressionCount;
+        mFirstValue = snapshot.firstValue != 0;
+        mFilteredValueHasChanged = snapshot.hasChanged != 0;
+    }
+
     /**
      * @brief update
      * @param rawValue updates the filtered value based on the raw value being sent in
@@ -70,15 +139,189 @@ class SimpleNoiseFilter
      */
     T update(T rawValue)
     {
+        InstrumentationCounters counters = InstrumentationCounters();
+
+        mPrevResponsiveValue = mFilteredValue;
+        mFilteredValue = mEnabled
+                         ? getFilteredValue(rawValue, counters)
+                         : rawValue;
+
+        mFilteredValueHasChanged = mFilteredValue != mPrevResponsiveValue;
+
+        counters.countUpdates(1);
+        counters.countChanges(mFilteredValueHasChanged);
+        FilterInstrumentation::add(FilterInstrumentation::Simple, counters);
+        return mFilteredValue;
+    }
+
+    /**
+     * @brief update for raw values that don't come every sampleInterval(), e.g. when samples are dropped or coalesced under load.
+     * The suppression counts sample intervals instead of values, so suppressionCount() is a time,
+     * and the averaging with the new value is per interval and compounded over the intervals since the previous
+     * timestamped update, as if the raw value had been held for all of them.
+     * With timestamps exactly sampleInterval() apart, the output is the same as that of update(rawValue).
+     * A filter should either be updated with timestamps or without.
+     * @param timestamp of the raw value, in the unit of sampleInterval(), e.g. ns. The first one counts as one sample interval,
+     * one that isn't after the previous one as none.
+     * @return returns the filtered value
+     */
+    T update(T rawValue, uint64_t timestamp)
+    {
+        const Real intervals = mClock.elapsedIntervals(timestamp);
+        InstrumentationCounters counters = InstrumentationCounters();
+
         mPrevResponsiveValue = mFilteredValue;
         mFilteredValue = mEnabled
-                         ? getFilteredValue(rawValue)
+                         ? getFilteredValue(rawValue, intervals, counters)
                          : rawValue;
 
         mFilteredValueHasChanged = mFilteredValue != mPrevResponsiveValue;
+
+        counters.countUpdates(1);
+        counters.countChanges(mFilteredValueHasChanged);
+        FilterInstrumentation::add(FilterInstrumentation::Simple, counters);
         return mFilteredValue;
     }
 
+    /**
+     * @brief update filters a block of raw values in one go.
+     * The output is identical to calling update() on every value, but the
+     * enabled check is done once per block instead of once per value.
+     * @param rawValues the n raw values to be filtered
+     * @param filteredValues receives the n filtered values, can be the same buffer as rawValues
+     * @param n number of values in the block
+     * @param changed optional, receives hasChanged() for every value
+     * @return the number of values for which the filtered value has changed
+     */
+    size_t update(const T *rawValues, T *filteredValues, size_t n, bool *changed = nullptr)
+    {
+        if (n == 0)
+        {
+            return 0;
+        }
+
+        if (!mEnabled)
+        {
+            return updateBlock<false>(rawValues, filteredValues, n, changed);
+        }
+
+        if (mFirstValue)
+        {
+            mSmoothValue = rawValues[0];
+            mFirstValue = false;
+        }
+
+        return updateBlock<true>(rawValues, filteredValues, n, changed);
+    }
+
+    /**
+     * @brief advance is the same as calling update(rawValue) count times, for runs of identical raw values, e.g. of idle channels.
+     * Values that get suppressed only count up the suppression count, so a run of them is skipped in one step,
+     * and once an update leaves the state as it was, the rest of the run is skipped. A breakthrough whose average
+     * truncates back onto the smooth value, e.g. 0 and 1 with an activity threshold of 0, starts a cycle
+     * of suppressionCount + 1 updates that keeps returning to the same state, the whole cycles are skipped as well.
+     * A run costs a few updates per halving of the distance to rawValue, however long it is.
+     * @return returns the filtered value
+     */
+    T advance(T rawValue, size_t count)
+    {
+        if (count == 0)
+        {
+            return mFilteredValue;
+        }
+
+        InstrumentationCounters counters = InstrumentationCounters();
+
+        if (!mEnabled)
+        {
+            counters.countUpdates(count);
+            counters.countChanges(rawValue != mFilteredValue);
+            FilterInstrumentation::add(FilterInstrumentation::Simple, counters);
+
+            mPrevResponsiveValue = count > 1 ? rawValue : mFilteredValue;
+            mFilteredValue = rawValue;
+            mFilteredValueHasChanged = mFilteredValue != mPrevResponsiveValue;
+            return mFilteredValue;
+        }
+
+        if (mFirstValue)
+        {
+            mSmoothValue = rawValue;
+            mFirstValue = false;
+        }
+
+        const Parameters p = parameters();
+        State s = state();
+        T previousValue = mFilteredValue;
+        T filteredValue = previousValue;
+        size_t changeCount = 0;
+
+        for (size_t i = 0; i < count;)
+        {
+            const State before = s;
+            size_t repeatCount = 1;
+
+            if (std::abs(rawValue - s.smoothValue) > p.activityThreshold && s.currentSuppressionCount < p.suppressionCount)
+            {
+                // suppressed until the count exceeds suppressionCount, without touching the smooth value
+                repeatCount = std::min<size_t>(count - i, p.suppressionCount - s.currentSuppressionCount);
+                s.currentSuppressionCount += static_cast<int>(repeatCount);
+                counters.countSuppressedSamples(repeatCount);
+            }
+            else
+            {
+                filterValue(p, s, rawValue, counters);
+            }
+
+            previousValue = filteredValue;
+            filteredValue = s.smoothValue;
+            changeCount += filteredValue != previousValue;
+            if (repeatCount > 1)
+            {
+                previousValue = filteredValue;
+            }
+            i += repeatCount;
+
+            if (s.smoothValue == before.smoothValue && s.currentSuppressionCount == 0
+                && std::abs(rawValue - s.smoothValue) > p.activityThreshold)
+            {
+                // a breakthrough that averaged back onto the smooth value, as integer T truncates 0 and 1 to 0:
+                // every further suppressionCount suppressed values and a breakthrough return to this state,
+                // so whole cycles are skipped, only what they count changes
+                const size_t cycleLength = static_cast<size_t>(std::max(p.suppressionCount, 0)) + 1;
+                const size_t cycleCount = (count - i)/cycleLength;
+                counters.countSuppressedSamples(cycleCount*(cycleLength - 1));
+                counters.countSuppressionBreakthroughs(cycleCount);
+                i += cycleCount*cycleLength;
+                if (cycleCount > 0)
+                {
+                    previousValue = filteredValue;
+                }
+                continue;
+            }
+
+            if (s.smoothValue == before.smoothValue && s.currentSuppressionCount == before.currentSuppressionCount)
+            {
+                // the remaining updates repeat this one and return the same value
+                if (i < count)
+                {
+                    previousValue = filteredValue;
+                }
+                break;
+            }
+        }
+
+        setState(s);
+        mPrevResponsiveValue = previousValue;
+        mFilteredValue = filteredValue;
+        mFilteredValueHasChanged = filteredValue != previousValue;
+
+        counters.countUpdates(count);
+        counters.countChanges(changeCount);
+        FilterInstrumentation::add(FilterInstrumentation::Simple, counters);
+        return filteredValue;
+    }
+
     int suppressionCount() const
     {
         return mSuppressionCount;
@@ -99,9 +342,80 @@ class SimpleNoiseFilter
         mActivityThreshold = threshold;
     }
 
+    /**
+     * @brief sampleInterval
+     * @return the time between two samples the filter is tuned for, in the unit of the timestamps of the timestamped update()
+     */
+    uint64_t sampleInterval() const
+    {
+        return mClock.sampleInterval();
+    }
+
+    void setSampleInterval(uint64_t interval)
+    {
+        mClock.setSampleInterval(interval);
+    }
+
   private:
 
-    T getFilteredValue(T newValue)
+    /**
+     * The configuration getFilteredValue() depends on, copied out of the members
+     * so that the block update can keep it in registers.
+     */
+    struct Parameters
+    {
+        T activityThreshold;
+        int suppressionCount;
+    };
+
+    /**
+     * The part of the filter state that changes on every getFilteredValue()
+     */
+    struct State
+    {
+        T smoothValue;
+        int currentSuppressionCount;
+    };
+
+    Parameters parameters() const
+    {
+        Parameters parameters = { mActivityThreshold, mSuppressionCount };
+        return parameters;
+    }
+
+    State state() const
+    {
+        State state = { mSmoothValue, mCurrentSuppressionCount };
+        return state;
+    }
+
+    void setState(const State &state)
+    {
+        mSmoothValue = state.smoothValue;
+        mCurrentSuppressionCount = state.currentSuppressionCount;
+    }
+
+    template<class Counters>
+    T getFilteredValue(T newValue, Counters &counters)
+    {
+        if (mFirstValue)
+        {
+            mSmoothValue = newValue;
+            mFirstValue = false;
+        }
+
+        State s = state();
+        newValue = filterValue(parameters(), s, newValue, counters);
+        setState(s);
+        return newValue;
+    }
+
+    /**
+     * The timestamped filterValue(), which suppresses for suppressionCount intervals instead of values.
+     * Values within the threshold are averaged in once per interval, values that break through once per breakthrough.
+     */
+    template<class Counters>
+    T getFilteredValue(T newValue, Real intervals, Counters &counters)
     {
         if (mFirstValue)
         {
@@ -109,29 +423,124 @@ class SimpleNoiseFilter
             mFirstValue = false;
         }
 
-        //If the change is greater than activity threshold,
-        //Try suppressing it
         if (std::abs(newValue - mSmoothValue) > mActivityThreshold)
         {
+            mSuppressedIntervals += intervals;
             mCurrentSuppressionCount++;
 
-            //If unable to suppress, The new value is the average of the old and new.
-            if(mCurrentSuppressionCount > mSuppressionCount)
+            if (mSuppressedIntervals > mSuppressionCount)
             {
-                mSmoothValue = (mSmoothValue + newValue)/2.0;
+                // one breakthrough every suppressionCount + 1 intervals, as without timestamps
+                const Real breakthroughs = std::max(std::floor(mSuppressedIntervals/(mSuppressionCount + 1)), Real(1));
+                mSmoothValue = average(mSmoothValue, newValue, breakthroughs);
+                mSuppressedIntervals = std::max(mSuppressedIntervals - breakthroughs*(mSuppressionCount + 1), Real(0));
                 mCurrentSuppressionCount = 0;
+                counters.countSuppressionBreakthroughs(1);
+            }
+            else
+            {
+                counters.countSuppressedSamples(1);
             }
         }
         else
         {
-            //Else the new value is the average of old and new value
-            mSmoothValue = (mSmoothValue + newValue)/2.0;
+            mSmoothValue = average(mSmoothValue, newValue, intervals);
+            mSuppressedIntervals = 0;
             mCurrentSuppressionCount = 0;
         }
 
         return mSmoothValue;
     }
 
+    /**
+     * @return the average of the old and new value, compounded over intervals
+     */
+    static T average(T smoothValue, T newValue, Real intervals)
+    {
+        if (intervals == Real(1))
+        {
+            return (smoothValue + newValue)/Real(2);
+        }
+
+        return smoothValue + (newValue - smoothValue)*SampleIntervalClock<Real>::compounded(Real(0.5), intervals);
+    }
+
+    template<bool Enabled>
+    size_t updateBlock(const T *rawValues, T *filteredValues, size_t n, bool *changed)
+    {
+        const Parameters p = parameters();
+        State s = state();
+        T previousValue = mFilteredValue;
+        T filteredValue = previousValue;
+        size_t changeCount = 0;
+        InstrumentationCounters counters = InstrumentationCounters();
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            previousValue = filteredValue;
+            filteredValue = Enabled
+                            ? filterValue(p, s, rawValues[i], counters)
+                            : rawValues[i];
+
+            const bool hasChanged = filteredValue != previousValue;
+            changeCount += hasChanged;
+            filteredValues[i] = filteredValue;
+
+            if (changed)
+            {
+                changed[i] = hasChanged;
+            }
+        }
+
+        if (Enabled)
+        {
+            setState(s);
+        }
+
+        mPrevResponsiveValue = previousValue;
+        mFilteredValue = filteredValue;
+        mFilteredValueHasChanged = filteredValue != previousValue;
+
+        counters.countUpdates(n);
+        counters.countChanges(changeCount);
+        FilterInstrumentation::addBlock(FilterInstrumentation::Simple, counters);
+        return changeCount;
+    }
+
+    /**
+     * Counters is FilterCounters or NoFilterCounters, see filterinstrumentation.h
+     */
+    template<class Counters>
+    static T filterValue(const Parameters &p, State &s, T newValue, Counters &counters)
+    {
+        //If the change is greater than activity threshold,
+        //Try suppressing it
+        if (std::abs(newValue - s.smoothValue) > p.activityThreshold)
+        {
+            s.currentSuppressionCount++;
+
+            //If unable to suppress, The new value is the average of the old and new.
+            if(s.currentSuppressionCount > p.suppressionCount)
+            {
+                s.smoothValue = (s.smoothValue + newValue)/Real(2);
+                s.currentSuppressionCount = 0;
+                counters.countSuppressionBreakthroughs(1);
+            }
+            else
+            {
+                counters.countSuppressedSamples(1);
+            }
+        }
+        else
+        {
+            //Else the new value is the average of old and new value
+            s.smoothValue = (s.smoothValue + newValue)/Real(2);
+            s.currentSuppressionCount = 0;
+        }
+
+        return s.smoothValue;
+    }
+
 
     bool mEnabled;
     bool mFirstValue;
@@ -146,6 +555,9 @@ class SimpleNoiseFilter
     T mActivityThreshold;
     int mSuppressionCount;
     int mCurrentSuppressionCount;
+
+    SampleIntervalClock<Real> mClock;
+    Real mSuppressedIntervals;
 };
 
 #endif
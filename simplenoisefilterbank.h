@@ -0,0 +1,325 @@
+#ifndef SIMPLE_NOISE_FILTER_BANK_H
+#define SIMPLE_NOISE_FILTER_BANK_H
+
+#include <stddef.h>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "simplenoisefilter.h"
+
+/**
+ * Pointers into the structure of arrays of a SimpleNoiseFilterBank,
+ * handed to the SIMD kernels so that they don't depend on the bank itself.
+ */
+template<class T>
+struct SimpleNoiseFilterBankLanes
+{
+    const T *rawValues;
+    T *filteredValues;
+    bool *changed;
+
+    T *smoothValues;
+    int *currentSuppressionCounts;
+    T *values;
+
+    T activityThreshold;
+    int suppressionCount;
+};
+
+/**
+ * SIMD kernels used by SimpleNoiseFilterBank.
+ * The generic version doesn't process any channel and leaves everything to the scalar fallback,
+ * the int specialization below processes as many channels as fit in whole vectors.
+ */
+template<class T>
+struct SimpleNoiseFilterBankSimd
+{
+    static size_t update(const SimpleNoiseFilterBankLanes<T> &, size_t, size_t *)
+    {
+        return 0;
+    }
+};
+
+#if defined(__SSE2__)
+
+#if defined(__AVX2__)
+/**
+ * 8 int channels per step
+ */
+struct SimpleNoiseFilterBankVector
+{
+    typedef __m256i Integer;
+    static const size_t Width = 8;
+
+    static Integer load(const int *values) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values)); }
+    static void store(int *values, Integer v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(values), v); }
+    static Integer set(int value) { return _mm256_set1_epi32(value); }
+    static Integer add(Integer a, Integer b) { return _mm256_add_epi32(a, b); }
+    static Integer sub(Integer a, Integer b) { return _mm256_sub_epi32(a, b); }
+    static Integer abs(Integer a) { return _mm256_abs_epi32(a); }
+    static Integer half(Integer a) { return _mm256_srai_epi32(_mm256_add_epi32(a, _mm256_srli_epi32(a, 31)), 1); }
+    static Integer greater(Integer a, Integer b) { return _mm256_cmpgt_epi32(a, b); }
+    static Integer equal(Integer a, Integer b) { return _mm256_cmpeq_epi32(a, b); }
+    static Integer maskOr(Integer a, Integer b) { return _mm256_or_si256(a, b); }
+    static Integer maskAndNot(Integer a, Integer b) { return _mm256_andnot_si256(a, b); }
+    static Integer select(Integer mask, Integer a, Integer b) { return _mm256_blendv_epi8(b, a, mask); }
+    static int bits(Integer mask) { return _mm256_movemask_ps(_mm256_castsi256_ps(mask)); }
+};
+#else
+/**
+ * 4 int channels per step
+ */
+struct SimpleNoiseFilterBankVector
+{
+    typedef __m128i Integer;
+    static const size_t Width = 4;
+
+    static Integer load(const int *values) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(values)); }
+    static void store(int *values, Integer v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(values), v); }
+    static Integer set(int value) { return _mm_set1_epi32(value); }
+    static Integer add(Integer a, Integer b) { return _mm_add_epi32(a, b); }
+    static Integer sub(Integer a, Integer b) { return _mm_sub_epi32(a, b); }
+    static Integer abs(Integer a) { const Integer sign = _mm_srai_epi32(a, 31); return _mm_sub_epi32(_mm_xor_si128(a, sign), sign); }
+    static Integer half(Integer a) { return _mm_srai_epi32(_mm_add_epi32(a, _mm_srli_epi32(a, 31)), 1); }
+    static Integer greater(Integer a, Integer b) { return _mm_cmpgt_epi32(a, b); }
+    static Integer equal(Integer a, Integer b) { return _mm_cmpeq_epi32(a, b); }
+    static Integer maskOr(Integer a, Integer b) { return _mm_or_si128(a, b); }
+    static Integer maskAndNot(Integer a, Integer b) { return _mm_andnot_si128(a, b); }
+    static Integer select(Integer mask, Integer a, Integer b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+    static int bits(Integer mask) { return _mm_movemask_ps(_mm_castsi128_ps(mask)); }
+};
+#endif
+
+template<>
+struct SimpleNoiseFilterBankSimd<int>
+{
+    /**
+     * Runs SimpleNoiseFilter<int>::getFilteredValue() on Width channels at a time.
+     * (smoothValue + newValue)/2.0 truncated back to int is the same as the int division by 2,
+     * so the whole filter stays in integer lanes.
+     * @return the number of channels processed, the rest is left to the scalar fallback
+     */
+    static size_t update(const SimpleNoiseFilterBankLanes<int> &lanes, size_t channelCount, size_t *changeCount)
+    {
+        typedef SimpleNoiseFilterBankVector V;
+        typedef V::Integer Integer;
+
+        const Integer activityThreshold = V::set(lanes.activityThreshold);
+        const Integer suppressionCount = V::set(lanes.suppressionCount);
+
+        size_t channel = 0;
+        for (; channel + V::Width <= channelCount; channel += V::Width)
+        {
+            const Integer newValue = V::load(lanes.rawValues + channel);
+            Integer smoothValue = V::load(lanes.smoothValues + channel);
+
+            // the change is suppressed while it is above the threshold and the suppression count isn't exceeded yet,
+            // otherwise the new value is the average of the old and new value
+            const Integer aboveThreshold = V::greater(V::abs(V::sub(newValue, smoothValue)), activityThreshold);
+            const Integer currentSuppressionCount = V::sub(V::load(lanes.currentSuppressionCounts + channel), aboveThreshold);
+            const Integer accepted = V::maskOr(V::greater(currentSuppressionCount, suppressionCount),
+                                               V::maskAndNot(aboveThreshold, V::set(-1)));
+
+            smoothValue = V::select(accepted, V::half(V::add(smoothValue, newValue)), smoothValue);
+            V::store(lanes.smoothValues + channel, smoothValue);
+            V::store(lanes.currentSuppressionCounts + channel, V::maskAndNot(accepted, currentSuppressionCount));
+
+            const int changedBits = ~V::bits(V::equal(smoothValue, V::load(lanes.values + channel)));
+            V::store(lanes.values + channel, smoothValue);
+
+            if (lanes.filteredValues)
+            {
+                V::store(lanes.filteredValues + channel, smoothValue);
+            }
+
+            for (size_t lane = 0; lane < V::Width; ++lane)
+            {
+                const bool hasChanged = (changedBits >> lane) & 1;
+                *changeCount += hasChanged;
+
+                if (lanes.changed)
+                {
+                    lanes.changed[channel + lane] = hasChanged;
+                }
+            }
+        }
+
+        return channel;
+    }
+};
+
+#endif
+
+/**
+ * A bank of SimpleNoiseFilter<T> channels that are all updated with one sample per channel at a time.
+ * The smooth value and suppression count of every channel are stored as a structure of arrays
+ * and the suppress/accept decision is made with masks instead of branches, so noisy inputs don't cause
+ * branch mispredictions. For T = int the channels are advanced with SSE2 (4 channels)
+ * or AVX2 (8 channels, build with -mavx2) integer instructions.
+ *
+ * The output is the same as running one SimpleNoiseFilter<T> per channel.
+ * The activity threshold, suppression count and enabled are shared by all channels.
+ */
+template<class T>
+class SimpleNoiseFilterBank
+{
+  public:
+    SimpleNoiseFilterBank(size_t channelCount,
+                          T threshold,
+                          int suppressCount):
+        mEnabled(true),
+        mFirstValue(true),
+        mActivityThreshold(threshold),
+        mSuppressionCount(suppressCount),
+        mSmoothValue(channelCount),
+        mCurrentSuppressionCount(channelCount, 0),
+        mFilteredValue(channelCount)
+    {
+    }
+
+    size_t channelCount() const
+    {
+        return mSmoothValue.size();
+    }
+
+    /**
+     * @brief value
+     * @return returns the last filtered value of the channel after calling update()
+     */
+    T value(size_t channel) const
+    {
+        return mFilteredValue[channel];
+    }
+
+    /**
+     * @brief values
+     * @return the last filtered values of all the channels
+     */
+    const T *values() const
+    {
+        return mFilteredValue.data();
+    }
+
+    bool isEnabled() const
+    {
+        return mEnabled;
+    }
+
+    void setEnabled(bool enabled)
+    {
+        mEnabled = enabled;
+    }
+
+    int suppressionCount() const
+    {
+        return mSuppressionCount;
+    }
+
+    void setSuppressionCount(int count)
+    {
+        mSuppressionCount = count;
+    }
+
+    T activityThreshold() const
+    {
+        return mActivityThreshold;
+    }
+
+    void setActivityThreshold(T threshold)
+    {
+        mActivityThreshold = threshold;
+    }
+
+    /**
+     * @brief update advances every channel by one sample
+     * @param rawValues one raw value per channel
+     * @param filteredValues optional, receives the filtered value of every channel
+     * @param changed optional, receives hasChanged() of every channel
+     * @return the number of channels whose filtered value has changed
+     */
+    size_t update(const T *rawValues, T *filteredValues = nullptr, bool *changed = nullptr)
+    {
+        const size_t count = channelCount();
+        size_t changeCount = 0;
+        size_t channel = 0;
+
+        if (!mEnabled)
+        {
+            for (; channel < count; ++channel)
+            {
+                publish(channel, rawValues[channel], filteredValues, changed, &changeCount);
+            }
+
+            return changeCount;
+        }
+
+        if (mFirstValue)
+        {
+            mSmoothValue.assign(rawValues, rawValues + count);
+            mFirstValue = false;
+        }
+
+        const SimpleNoiseFilterBankLanes<T> lanes = {
+            rawValues,
+            filteredValues,
+            changed,
+            mSmoothValue.data(),
+            mCurrentSuppressionCount.data(),
+            mFilteredValue.data(),
+            mActivityThreshold,
+            mSuppressionCount
+        };
+
+        channel = SimpleNoiseFilterBankSimd<T>::update(lanes, count, &changeCount);
+
+        for (; channel < count; ++channel)
+        {
+            const T newValue = rawValues[channel];
+            const T smoothValue = mSmoothValue[channel];
+
+            const bool aboveThreshold = std::abs(newValue - smoothValue) > mActivityThreshold;
+            const int currentSuppressionCount = mCurrentSuppressionCount[channel] + aboveThreshold;
+            const bool accepted = !aboveThreshold || currentSuppressionCount > mSuppressionCount;
+            const T average = (smoothValue + newValue)/2.0;
+
+            mSmoothValue[channel] = accepted ? average : smoothValue;
+            mCurrentSuppressionCount[channel] = accepted ? 0 : currentSuppressionCount;
+
+            publish(channel, mSmoothValue[channel], filteredValues, changed, &changeCount);
+        }
+
+        return changeCount;
+    }
+
+  private:
+    void publish(size_t channel, T filteredValue, T *filteredValues, bool *changed, size_t *changeCount)
+    {
+        const bool hasChanged = filteredValue != mFilteredValue[channel];
+        *changeCount += hasChanged;
+        mFilteredValue[channel] = filteredValue;
+
+        if (filteredValues)
+        {
+            filteredValues[channel] = filteredValue;
+        }
+
+        if (changed)
+        {
+            changed[channel] = hasChanged;
+        }
+    }
+
+    bool mEnabled;
+    bool mFirstValue;
+    T mActivityThreshold;
+    int mSuppressionCount;
+
+    std::vector<T> mSmoothValue;
+    std::vector<int> mCurrentSuppressionCount;
+    std::vector<T> mFilteredValue;
+};
+
+#endif
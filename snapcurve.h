@@ -0,0 +1,177 @@
+#ifndef SNAP_CURVE_H
+#define SNAP_CURVE_H
+
+#include <stddef.h>
+
+#if defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+/**
+ * The snap curve used by EMANoiseFilter, f(x) = min(1, 2 - 2/(1 + x)) for x >= 0.
+ * Exact is the original curve, the others avoid its division at the cost of a small deviation,
+ * measured by filtertester-bench (snap_curve_accuracy) by evaluating every curve on a dense grid of x:
+ *
+ * Curve        max |f(x) - exact(x)|
+ * Table        7.6e-6
+ * Newton       1.8e-7 (2.9e-10 without SSE)
+ * Polynomial   1.3e-5
+ *
+ * All of them are exactly 1 for x >= 1. The deviations are far below what changes the output of EMANoiseFilter<int>,
+ * except for the occasional value that lands on the other side of an integer truncation.
+ * Whether they are faster depends on the CPU: a single filter is bound by the latency from one sample to the next,
+ * and on CPUs with a fast divider only the polynomial has a shorter latency than the division (see filtertester-bench).
+ *
+ * value() is evaluated in the type of x, double or float, the compute type of the filter.
+ */
+enum class SnapCurve
+{
+    Exact,
+    Table,
+    Newton,
+    Polynomial
+};
+
+/**
+ * The original curve with its division
+ */
+struct SnapCurveExact
+{
+    template<class Real>
+    static Real value(Real x)
+    {
+        Real y = Real(1) / (x + Real(1));
+        y = (Real(1) - y) * Real(2);
+
+        if(y > Real(1))
+        {
+          y = Real(1);
+        }
+
+        return y;
+    }
+};
+
+/**
+ * Linear interpolation in a table of Size + 1 samples of the curve between 0 and 1,
+ * where the curve saturates. The table is filled during static initialization,
+ * so filters shouldn't be updated from other static initializers.
+ */
+template<size_t Size>
+class SnapCurveLookupTable
+{
+  public:
+    template<class Real>
+    static Real value(Real x)
+    {
+        if (x >= Real(1))
+        {
+            return Real(1);
+        }
+
+        const Real position = x*Size;
+        const size_t index = static_cast<size_t>(position);
+        return sTable.values(Real())[index] + sTable.slopes(Real())[index]*(position - index);
+    }
+
+  private:
+    struct Table
+    {
+        Table()
+        {
+            for (size_t i = 0; i <= Size; ++i)
+            {
+                doubleValues[i] = SnapCurveExact::value(static_cast<double>(i)/Size);
+            }
+
+            for (size_t i = 0; i < Size; ++i)
+            {
+                doubleSlopes[i] = doubleValues[i + 1] - doubleValues[i];
+            }
+            doubleSlopes[Size] = 0;
+
+            for (size_t i = 0; i <= Size; ++i)
+            {
+                floatValues[i] = static_cast<float>(doubleValues[i]);
+                floatSlopes[i] = static_cast<float>(doubleSlopes[i]);
+            }
+        }
+
+        // selected by the compute type
+        const double *values(double) const { return doubleValues; }
+        const double *slopes(double) const { return doubleSlopes; }
+        const float *values(float) const { return floatValues; }
+        const float *slopes(float) const { return floatSlopes; }
+
+        double doubleValues[Size + 1];
+        double doubleSlopes[Size + 1];
+        float floatValues[Size + 1];
+        float floatSlopes[Size + 1];
+    };
+
+    static const Table sTable;
+};
+
+template<size_t Size>
+const typename SnapCurveLookupTable<Size>::Table SnapCurveLookupTable<Size>::sTable;
+
+typedef SnapCurveLookupTable<256> SnapCurveTable;
+
+/**
+ * 2 - 2r with r an estimate of 1/(1 + x) refined by Newton-Raphson steps r = r*(2 - (1 + x)*r).
+ * The estimate is the 12 bit rcpss with SSE, otherwise 24/17 - 8/17*(1 + x), which is good to 1/17 for 0 <= x < 1.
+ */
+struct SnapCurveNewton
+{
+    template<class Real>
+    static Real value(Real x)
+    {
+        if (x >= Real(1))
+        {
+            return Real(1);
+        }
+
+        const Real d = x + Real(1);
+
+#if defined(__SSE__)
+        Real r = _mm_cvtss_f32(_mm_rcp_ss(_mm_set_ss(static_cast<float>(d))));
+        r = r*(Real(2) - d*r);
+#else
+        Real r = Real(24.0/17.0) - Real(8.0/17.0)*d;
+        r = r*(Real(2) - d*r);
+        r = r*(Real(2) - d*r);
+        r = r*(Real(2) - d*r);
+#endif
+
+        const Real y = Real(2) - Real(2)*r;
+        return y > Real(1) ? Real(1) : y;
+    }
+};
+
+/**
+ * Degree 6 minimax polynomial of the curve on [0, 1).
+ * This stands in for a rational approximation: the curve is a rational function already,
+ * so any rational approximation would still need the division this is meant to remove.
+ */
+struct SnapCurvePolynomial
+{
+    template<class Real>
+    static Real value(Real x)
+    {
+        if (x >= Real(1))
+        {
+            return Real(1);
+        }
+
+        // Estrin's scheme, so that the terms don't all wait for each other like they would with Horner's
+        const Real x2 = x*x;
+        const Real x4 = x2*x2;
+        const Real y = (Real(1.2754450926343674e-05) + Real(1.9985977612579122)*x)
+                       + (Real(-1.974595149970191) + Real(1.821994503762616)*x)*x2
+                       + ((Real(-1.365819644125126) + Real(0.6720420422774394)*x) - Real(0.1522450221045028)*x2)*x4;
+
+        return y > Real(1) ? Real(1) : y;
+    }
+};
+
+#endif
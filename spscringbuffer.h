@@ -0,0 +1,167 @@
+#ifndef SPSC_RING_BUFFER_H
+#define SPSC_RING_BUFFER_H
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+/**
+ * A bounded lock free queue between exactly one producer thread and one consumer thread.
+ *
+ * The capacity is rounded up to a power of two so that the indices can run freely and wrap with a mask.
+ * The producer only writes mTail and the consumer only writes mHead, each on its own cache line,
+ * and each side keeps a copy of the other side's index that it only refreshes when the queue looks full or empty,
+ * so that in the steady state the two cores don't bounce the index cache lines at every element.
+ * The block push() and pop() publish a whole block with a single release store.
+ */
+template<class T>
+class SpscRingBuffer
+{
+  public:
+    explicit SpscRingBuffer(size_t capacity):
+        mHead(0),
+        mCachedTail(0),
+        mTail(0),
+        mCachedHead(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+
+        mValues.resize(size);
+        mMask = size - 1;
+    }
+
+    SpscRingBuffer(const SpscRingBuffer &) = delete;
+    SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+    size_t capacity() const
+    {
+        return mValues.size();
+    }
+
+    /**
+     * @brief size
+     * @return the number of queued elements, only exact when called from the producer or the consumer thread
+     * while the other one is idle
+     */
+    size_t size() const
+    {
+        return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /**
+     * @brief push called by the producer
+     * @return false if the queue is full
+     */
+    bool push(const T &value)
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mCachedHead == mValues.size())
+        {
+            mCachedHead = mHead.load(std::memory_order_acquire);
+            if (tail - mCachedHead == mValues.size())
+            {
+                return false;
+            }
+        }
+
+        mValues[tail & mMask] = value;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief push called by the producer, pushes as many of the n values as fit
+     * @return the number of values pushed
+     */
+    size_t push(const T *values, size_t n)
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (mValues.size() - (tail - mCachedHead) < n)
+        {
+            mCachedHead = mHead.load(std::memory_order_acquire);
+        }
+
+        n = std::min(n, mValues.size() - (tail - mCachedHead));
+        for (size_t i = 0; i < n; ++i)
+        {
+            mValues[(tail + i) & mMask] = values[i];
+        }
+
+        mTail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief pop called by the consumer
+     * @return false if the queue is empty
+     */
+    bool pop(T *value)
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mCachedTail)
+        {
+            mCachedTail = mTail.load(std::memory_order_acquire);
+            if (head == mCachedTail)
+            {
+                return false;
+            }
+        }
+
+        *value = mValues[head & mMask];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief pop called by the consumer, pops up to n values
+     * @return the number of values popped
+     */
+    size_t pop(T *values, size_t n)
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (mCachedTail - head < n)
+        {
+            mCachedTail = mTail.load(std::memory_order_acquire);
+        }
+
+        n = std::min(n, mCachedTail - head);
+        for (size_t i = 0; i < n; ++i)
+        {
+            values[i] = mValues[(head + i) & mMask];
+        }
+
+        mHead.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+  private:
+    // Padding rather than alignas, operator new doesn't honour over alignment before C++17
+    static const size_t CacheLineSize = 64;
+
+    std::vector<T> mValues;
+    size_t mMask;
+    char mPadding0[CacheLineSize];
+
+    // consumer side
+    std::atomic<size_t> mHead;
+    size_t mCachedTail;
+    char mPadding1[CacheLineSize];
+
+    // producer side
+    std::atomic<size_t> mTail;
+    size_t mCachedHead;
+    char mPadding2[CacheLineSize];
+};
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef STATIC_EMA_NOISE_FILTER_H
+#define STATIC_EMA_NOISE_FILTER_H
+
+#include <stddef.h>
+
+#include "emanoisefilter.h"
+
+/**
+ * EMANoiseFilter with its options fixed at compile time, for deployments that never change them.
+ * It runs the same filterValue() as EMANoiseFilter, so both produce identical output for the same options,
+ * but there is no per sample check of the sleep and edge snap flags, and update() inlines into tight loops.
+ * Like EMANoiseFilter it is disabled by bounds with upperBound <= lowerBound and passes the raw values through then,
+ * unless AlwaysEnabled is passed, which drops the per sample enabled check as well.
+ *
+ * SleepEnabled, EdgeSnapEnabled - same as EMANoiseFilter::setSleepEnabled() and setEdgeSnapEnabled()
+ * ClampEnabled - when false the smoothed value isn't clamped to the bounds. Only safe if the input stays within the bounds,
+ * as the filtered value never leaves the range of the input values then.
+ * AlwaysEnabled - when false the filter can be disabled at runtime with setEnabled(), like EMANoiseFilter,
+ * and is disabled by degenerate bounds. When true it always filters, with degenerate bounds too, where it
+ * differs from EMANoiseFilter, so only pass true for bounds with upperBound > lowerBound.
+ * Curve - the snap curve implementation, see snapcurve.h
+ * Real - the type the filter computes in, see EMANoiseFilter
+ */
+template<class T,
+         bool SleepEnabled = true,
+         bool EdgeSnapEnabled = true,
+         bool ClampEnabled = true,
+         bool AlwaysEnabled = false,
+         class Curve = SnapCurveExact,
+         class Real = double>
+class StaticEMANoiseFilter
+{
+    template<class>
+    friend struct FilterChainStage;
+
+  public:
+    StaticEMANoiseFilter(T lowerBound,
+                         T upperBound,
+                         Real snapMultiplier = Real(0.01)):
+        mEnabled(upperBound > lowerBound),
+        mFirstValue(true),
+        mFilteredValue(T()),
+        mFilteredValueHasChanged(false)
+    {
+        mParameters.lowerBound = lowerBound;
+        mParameters.upperBound = upperBound;
+        mParameters.snapMultiplier = 0;
+        mParameters.activityThreshold = (upperBound - lowerBound)*Real(0.01); //Activity threshold is 1%
+        setSnapMultiplier(snapMultiplier);
+
+        mState.smoothValue = T();
+        mState.errorEMA = 0;
+        mState.sleeping = false;
+    }
+
+    /**
+     * @brief value
+     * @return returns the last filtered value after calling update()
+     */
+    T value() const
+    {
+        return mFilteredValue;
+    }
+
+    /**
+     * @brief hasChanged
+     * @return returns if the value has changed during the last update()
+     */
+    bool hasChanged() const
+    {
+        return mFilteredValueHasChanged;
+    }
+
+    /**
+     * @brief isSleeping
+     * @return If the filter hasn't responded to any change during the last update().
+     */
+    bool isSleeping() const
+    {
+        return SleepEnabled && mState.sleeping;
+    }
+
+    /**
+     * @brief isEnabled
+     * @return always true with AlwaysEnabled, even for bounds that disable EMANoiseFilter
+     */
+    bool isEnabled() const
+    {
+        return AlwaysEnabled || mEnabled;
+    }
+
+    /**
+     * @brief setEnabled only has an effect when AlwaysEnabled is false
+     */
+    void setEnabled(bool enabled)
+    {
+        mEnabled = enabled;
+    }
+
+    T lowerBound() const
+    {
+        return mParameters.lowerBound;
+    }
+
+    void setLowerBound(T lowerBound)
+    {
+        mParameters.lowerBound = lowerBound;
+    }
+
+    T upperBound() const
+    {
+        return mParameters.upperBound;
+    }
+
+    void setUpperBound(T upperBound)
+    {
+        mParameters.upperBound = upperBound;
+    }
+
+    Real snapMultiplier() const
+    {
+        return mParameters.snapMultiplier;
+    }
+
+    void setSnapMultiplier(Real multiplier)
+    {
+        mParameters.snapMultiplier = multiplier > Real(1) ? Real(1) : multiplier < Real(0) ? Real(0) : multiplier;
+    }
+
+    T activityThreshold() const
+    {
+        return mParameters.activityThreshold;
+    }
+
+    void setActivityThreshold(T threshold)
+    {
+        mParameters.activityThreshold = threshold;
+    }
+
+    static constexpr bool sleepEnabled() { return SleepEnabled; }
+    static constexpr bool edgeSnapEnabled() { return EdgeSnapEnabled; }
+
+    /**
+     * @brief update
+     * @param rawValue updates the filtered value based on the raw value being sent in
+     * @return returns the filtered value
+     */
+    T update(T rawValue)
+    {
+        const T previousValue = mFilteredValue;
+
+        if (isEnabled())
+        {
+            if (mFirstValue)
+            {
+                mState.smoothValue = rawValue;
+                mFirstValue = false;
+            }
+
+            mFilteredValue = Filter::template filterValue<SleepEnabled, EdgeSnapEnabled, ClampEnabled, Curve>(mParameters, mState, rawValue);
+        }
+        else
+        {
+            mFilteredValue = rawValue;
+        }
+
+        mFilteredValueHasChanged = mFilteredValue != previousValue;
+        return mFilteredValue;
+    }
+
+    /**
+     * @brief update filters a block of raw values, same as EMANoiseFilter::update(const T *, T *, size_t, bool *)
+     * @return the number of values for which the filtered value has changed
+     */
+    size_t update(const T *rawValues, T *filteredValues, size_t n, bool *changed = nullptr)
+    {
+        if (n == 0)
+        {
+            return 0;
+        }
+
+        if (!isEnabled())
+        {
+            return updateBlock<false>(rawValues, filteredValues, n, changed);
+        }
+
+        if (mFirstValue)
+        {
+            mState.smoothValue = rawValues[0];
+            mFirstValue = false;
+        }
+
+        return updateBlock<true>(rawValues, filteredValues, n, changed);
+    }
+
+  private:
+    typedef EMANoiseFilter<T, Real> Filter;
+    typedef typename Filter::Parameters Parameters;
+    typedef typename Filter::State State;
+
+    template<bool Enabled>
+    size_t updateBlock(const T *rawValues, T *filteredValues, size_t n, bool *changed)
+    {
+        const Parameters p = mParameters;
+        State s = mState;
+        T previousValue = mFilteredValue;
+        T filteredValue = previousValue;
+        size_t changeCount = 0;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            previousValue = filteredValue;
+            filteredValue = Enabled
+                            ? Filter::template filterValue<SleepEnabled, EdgeSnapEnabled, ClampEnabled, Curve>(p, s, rawValues[i])
+                            : rawValues[i];
+
+            const bool hasChanged = filteredValue != previousValue;
+            changeCount += hasChanged;
+            filteredValues[i] = filteredValue;
+
+            if (changed)
+            {
+                changed[i] = hasChanged;
+            }
+        }
+
+        mState = s;
+        mFilteredValue = filteredValue;
+        mFilteredValueHasChanged = filteredValue != previousValue;
+        return changeCount;
+    }
+
+    bool mEnabled;
+    bool mFirstValue;
+
+    Parameters mParameters;
+    State mState;
+
+    T mFilteredValue;
+    bool mFilteredValueHasChanged;
+};
+
+#endif
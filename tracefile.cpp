@@ -0,0 +1,300 @@
+#include "tracefile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char TraceMagic[8] = { 'F', 'T', 'T', 'R', 'A', 'C', 'E', 0 };
+const uint32_t TraceByteOrder = 0x01020304;
+const uint32_t TraceVersion = 1;
+
+size_t sampleSizeOf(uint32_t sampleType)
+{
+    switch (sampleType)
+    {
+    case TraceHeader::Int32:
+        return sizeof(int32_t);
+    case TraceHeader::Float32:
+        return sizeof(float);
+    case TraceHeader::Float64:
+        return sizeof(double);
+    }
+    return 0;
+}
+
+}
+
+TraceReader::TraceReader():
+    mData(nullptr),
+    mFd(-1),
+    mSize(0),
+    mSamples(nullptr),
+    mReleased(0)
+{
+    memset(&mHeader, 0, sizeof(mHeader));
+}
+
+TraceReader::~TraceReader()
+{
+    close();
+}
+
+bool TraceReader::open(const std::string &fileName)
+{
+    close();
+
+    const int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        mErrorString = fileName + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(TraceHeader))
+    {
+        mErrorString = fileName + ": not a trace file";
+        ::close(fd);
+        return false;
+    }
+
+    // the descriptor stays open for release()
+    mSize = status.st_size;
+    mData = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (mData == MAP_FAILED)
+    {
+        mData = nullptr;
+        mErrorString = fileName + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    mFd = fd;
+
+    madvise(mData, mSize, MADV_SEQUENTIAL);
+    memcpy(&mHeader, mData, sizeof(mHeader));
+
+    // by division, a product of the header fields could wrap around and pass
+    const uint64_t frameSize = uint64_t(mHeader.channelCount)*sampleSizeOf(mHeader.sampleType);
+    if (memcmp(mHeader.magic, TraceMagic, sizeof(TraceMagic)) != 0
+        || mHeader.byteOrder != TraceByteOrder
+        || mHeader.version != TraceVersion
+        || frameSize == 0
+        || (mHeader.layout == TraceHeader::Planar && mHeader.blockLength == 0)
+        || mHeader.layout > TraceHeader::Planar
+        || mHeader.frameCount > (mSize - sizeof(TraceHeader))/frameSize)
+    {
+        mErrorString = fileName + ": not a valid trace file";
+        close();
+        return false;
+    }
+
+    mSamples = static_cast<const char *>(mData) + sizeof(TraceHeader);
+    mErrorString.clear();
+    return true;
+}
+
+void TraceReader::close()
+{
+    if (mData)
+    {
+        munmap(mData, mSize);
+    }
+    if (mFd >= 0)
+    {
+        ::close(mFd);
+    }
+
+    mData = nullptr;
+    mFd = -1;
+    mSize = 0;
+    mSamples = nullptr;
+    mReleased = 0;
+}
+
+size_t TraceReader::sampleSize() const
+{
+    return sampleSizeOf(mHeader.sampleType);
+}
+
+uint64_t TraceReader::blockCount() const
+{
+    if (mHeader.layout == TraceHeader::Interleaved)
+    {
+        return 1;
+    }
+
+    return (mHeader.frameCount + mHeader.blockLength - 1)/mHeader.blockLength;
+}
+
+size_t TraceReader::blockFrameCount(uint64_t block) const
+{
+    if (mHeader.layout == TraceHeader::Interleaved)
+    {
+        return mHeader.frameCount;
+    }
+
+    const uint64_t blockStart = block*mHeader.blockLength;
+    return blockStart + mHeader.blockLength <= mHeader.frameCount
+           ? mHeader.blockLength
+           : mHeader.frameCount - blockStart;
+}
+
+void TraceReader::release(uint64_t frame)
+{
+    if (!mData)
+    {
+        return;
+    }
+
+    // planar blocks store channel after channel, so a frame in the middle of a block is only behind in the first channel,
+    // the samples of the others from frame on lie between that and the end of the block
+    uint64_t sampleOffset = frame*mHeader.channelCount;
+    if (mHeader.layout == TraceHeader::Planar)
+    {
+        const uint64_t blockStart = frame/mHeader.blockLength*mHeader.blockLength;
+        sampleOffset = blockStart*mHeader.channelCount + (frame - blockStart);
+    }
+
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t end = (sizeof(TraceHeader) + sampleOffset*sampleSize())/pageSize*pageSize;
+    // MADV_DONTNEED only unmaps the pages from this process, the kernel drops them from the page cache on POSIX_FADV_DONTNEED
+    if (end > mReleased)
+    {
+        madvise(static_cast<char *>(mData) + mReleased, end - mReleased, MADV_DONTNEED);
+        posix_fadvise(mFd, mReleased, end - mReleased, POSIX_FADV_DONTNEED);
+        mReleased = end;
+    }
+}
+
+TraceWriter::TraceWriter():
+    mFile(nullptr),
+    mSampleSize(0),
+    mBlockFrames(0)
+{
+    memset(&mHeader, 0, sizeof(mHeader));
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool TraceWriter::open(const std::string &fileName,
+                       TraceHeader::SampleType sampleType,
+                       uint32_t channelCount,
+                       double sampleRate,
+                       double lowerBound,
+                       double upperBound,
+                       TraceHeader::Layout layout,
+                       uint32_t blockLength)
+{
+    close();
+
+    memset(&mHeader, 0, sizeof(mHeader));
+    memcpy(mHeader.magic, TraceMagic, sizeof(TraceMagic));
+    mHeader.byteOrder = TraceByteOrder;
+    mHeader.version = TraceVersion;
+    mHeader.sampleType = sampleType;
+    mHeader.layout = layout;
+    mHeader.channelCount = channelCount;
+    mHeader.blockLength = layout == TraceHeader::Planar ? blockLength : 0;
+    mHeader.sampleRate = sampleRate;
+    mHeader.lowerBound = lowerBound;
+    mHeader.upperBound = upperBound;
+
+    mSampleSize = sampleSizeOf(sampleType);
+    if (mSampleSize == 0 || channelCount == 0 || (layout == TraceHeader::Planar && blockLength == 0))
+    {
+        mErrorString = "invalid trace format";
+        return false;
+    }
+
+    mFile = fopen(fileName.c_str(), "wb");
+    if (!mFile)
+    {
+        mErrorString = fileName + ": " + strerror(errno);
+        return false;
+    }
+
+    fwrite(&mHeader, sizeof(mHeader), 1, mFile);
+
+    mBlock.resize(layout == TraceHeader::Planar ? mSampleSize*channelCount*blockLength : 0);
+    mPlanarBlock.resize(mBlock.size());
+    mBlockFrames = 0;
+    mErrorString.clear();
+    return true;
+}
+
+bool TraceWriter::close()
+{
+    if (!mFile)
+    {
+        return true;
+    }
+
+    if (mBlockFrames)
+    {
+        writeBlock();
+    }
+
+    fseek(mFile, 0, SEEK_SET);
+    fwrite(&mHeader, sizeof(mHeader), 1, mFile);
+
+    const bool ok = !ferror(mFile);
+    if (!ok)
+    {
+        mErrorString = strerror(errno);
+    }
+
+    fclose(mFile);
+    mFile = nullptr;
+    return ok;
+}
+
+void TraceWriter::writeRawFrames(const void *samples, size_t frameCount)
+{
+    const size_t frameSize = mSampleSize*mHeader.channelCount;
+
+    if (mHeader.layout == TraceHeader::Interleaved)
+    {
+        fwrite(samples, frameSize, frameCount, mFile);
+        mHeader.frameCount += frameCount;
+        return;
+    }
+
+    const char *frame = static_cast<const char *>(samples);
+    for (size_t i = 0; i < frameCount; ++i, frame += frameSize)
+    {
+        memcpy(&mBlock[mBlockFrames*frameSize], frame, frameSize);
+
+        if (++mBlockFrames == mHeader.blockLength)
+        {
+            writeBlock();
+        }
+    }
+}
+
+void TraceWriter::writeBlock()
+{
+    const size_t frameSize = mSampleSize*mHeader.channelCount;
+    char *planar = mPlanarBlock.data();
+
+    for (uint32_t channel = 0; channel < mHeader.channelCount; ++channel)
+    {
+        for (size_t frame = 0; frame < mBlockFrames; ++frame, planar += mSampleSize)
+        {
+            memcpy(planar, &mBlock[frame*frameSize + channel*mSampleSize], mSampleSize);
+        }
+    }
+
+    fwrite(mPlanarBlock.data(), frameSize, mBlockFrames, mFile);
+
+    mHeader.frameCount += mBlockFrames;
+    mBlockFrames = 0;
+}
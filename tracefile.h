@@ -0,0 +1,230 @@
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/**
+ * Binary sample trace format (.fttrace), all fields in native byte order.
+ *
+ * The file starts with a 64 byte TraceHeader, followed by the samples.
+ * Interleaved traces store one frame (one sample per channel) after the other.
+ * Planar traces store blocks of blockLength frames, where each block holds blockLength samples of
+ * channel 0, then blockLength samples of channel 1 and so on. The last block can be shorter.
+ * Either way a channel's samples within a block, or all the samples of a single channel trace,
+ * are contiguous and can be handed to the filters' block update() straight out of the mapping.
+ */
+struct TraceHeader
+{
+    enum SampleType : uint32_t
+    {
+        Int32 = 1,
+        Float32 = 2,
+        Float64 = 3
+    };
+
+    enum Layout : uint32_t
+    {
+        Interleaved = 0,
+        Planar = 1
+    };
+
+    char magic[8];          // "FTTRACE" followed by a 0
+    uint32_t byteOrder;     // 0x01020304 written in native byte order
+    uint32_t version;       // 1
+    uint32_t sampleType;    // SampleType
+    uint32_t layout;        // Layout
+    uint32_t channelCount;
+    uint32_t blockLength;   // frames per block for planar traces, 0 for interleaved
+    uint64_t frameCount;    // samples per channel
+    double sampleRate;      // Hz, 0 if the samples weren't taken at a fixed rate
+    double lowerBound;
+    double upperBound;
+};
+
+static_assert(sizeof(TraceHeader) == 64, "TraceHeader must stay 64 bytes so that the samples are aligned");
+
+template<class T> struct TraceSampleType;
+template<> struct TraceSampleType<int32_t> { static const TraceHeader::SampleType value = TraceHeader::Int32; };
+template<> struct TraceSampleType<float> { static const TraceHeader::SampleType value = TraceHeader::Float32; };
+template<> struct TraceSampleType<double> { static const TraceHeader::SampleType value = TraceHeader::Float64; };
+
+/**
+ * Memory maps a trace for reading.
+ * The samples are never copied, the pointers returned point into the mapping
+ * and stay valid until the reader is closed.
+ */
+class TraceReader
+{
+  public:
+    TraceReader();
+    ~TraceReader();
+
+    bool open(const std::string &fileName);
+    void close();
+
+    bool isOpen() const { return mData != nullptr; }
+    const std::string &errorString() const { return mErrorString; }
+    const TraceHeader &header() const { return mHeader; }
+
+    size_t sampleSize() const;
+
+    /**
+     * @brief blockCount
+     * @return the number of planar blocks, 1 for interleaved traces
+     */
+    uint64_t blockCount() const;
+
+    /**
+     * @brief blockFrameCount
+     * @return the number of frames in the block
+     */
+    size_t blockFrameCount(uint64_t block) const;
+
+    /**
+     * @brief frames
+     * @return the interleaved samples of the frames starting at frame, nullptr if the trace isn't interleaved
+     */
+    template<class T>
+    const T *frames(uint64_t frame = 0) const
+    {
+        return hasType<T>() && mHeader.layout == TraceHeader::Interleaved
+               ? reinterpret_cast<const T *>(mSamples) + frame*mHeader.channelCount
+               : nullptr;
+    }
+
+    /**
+     * @brief channel
+     * @return the blockFrameCount(block) contiguous samples of the channel in the block,
+     * nullptr unless the trace is planar or has a single channel
+     */
+    template<class T>
+    const T *channel(uint64_t block, uint32_t index) const
+    {
+        if (!hasType<T>() || index >= mHeader.channelCount)
+        {
+            return nullptr;
+        }
+
+        if (mHeader.layout == TraceHeader::Interleaved)
+        {
+            return mHeader.channelCount == 1 ? reinterpret_cast<const T *>(mSamples) : nullptr;
+        }
+
+        const uint64_t blockStart = block*mHeader.blockLength*mHeader.channelCount;
+        return reinterpret_cast<const T *>(mSamples) + blockStart + index*blockFrameCount(block);
+    }
+
+    /**
+     * @brief readChannel copies all the samples of a channel, whatever the layout
+     * @return false if the trace doesn't have the channel or the sample type
+     */
+    template<class T>
+    bool readChannel(uint32_t index, std::vector<T> *samples) const
+    {
+        if (!hasType<T>() || index >= mHeader.channelCount)
+        {
+            return false;
+        }
+
+        samples->resize(mHeader.frameCount);
+
+        if (mHeader.layout == TraceHeader::Interleaved)
+        {
+            const T *frame = frames<T>() + index;
+            for (uint64_t i = 0; i < mHeader.frameCount; ++i, frame += mHeader.channelCount)
+            {
+                (*samples)[i] = *frame;
+            }
+            return true;
+        }
+
+        T *destination = samples->data();
+        for (uint64_t block = 0; block < blockCount(); ++block)
+        {
+            const size_t blockFrames = blockFrameCount(block);
+            const T *source = channel<T>(block, index);
+            std::copy(source, source + blockFrames, destination);
+            destination += blockFrames;
+        }
+        return true;
+    }
+
+    /**
+     * @brief release tells the kernel that the samples of all channels up to frame won't be read again,
+     * so that replaying a trace larger than memory doesn't push everything else out of the page cache.
+     * In a planar block that's only the samples of the first channel up to frame, the rest of the block is kept.
+     */
+    void release(uint64_t frame);
+
+  private:
+    template<class T>
+    bool hasType() const
+    {
+        return mData && mHeader.sampleType == TraceSampleType<T>::value;
+    }
+
+    TraceHeader mHeader;
+    std::string mErrorString;
+    void *mData;
+    int mFd;
+    size_t mSize;
+    const char *mSamples;
+    size_t mReleased;
+};
+
+/**
+ * Writes a trace through a buffered stream, frame by frame.
+ * The frame count in the header is filled in by close().
+ */
+class TraceWriter
+{
+  public:
+    TraceWriter();
+    ~TraceWriter();
+
+    bool open(const std::string &fileName,
+              TraceHeader::SampleType sampleType,
+              uint32_t channelCount,
+              double sampleRate,
+              double lowerBound,
+              double upperBound,
+              TraceHeader::Layout layout = TraceHeader::Interleaved,
+              uint32_t blockLength = 4096);
+    bool close();
+
+    bool isOpen() const { return mFile != nullptr; }
+    const std::string &errorString() const { return mErrorString; }
+    uint64_t frameCount() const { return mHeader.frameCount; }
+
+    /**
+     * @brief writeFrames appends frames of channelCount interleaved samples
+     */
+    template<class T>
+    void writeFrames(const T *samples, size_t frameCount)
+    {
+        if (mFile && mHeader.sampleType == TraceSampleType<T>::value)
+        {
+            writeRawFrames(samples, frameCount);
+        }
+    }
+
+  private:
+    void writeRawFrames(const void *samples, size_t frameCount);
+    void writeBlock();
+
+    TraceHeader mHeader;
+    std::string mErrorString;
+    FILE *mFile;
+    size_t mSampleSize;
+    std::vector<char> mBlock;
+    std::vector<char> mPlanarBlock;
+    size_t mBlockFrames;
+};
+
+#endif
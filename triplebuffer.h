@@ -0,0 +1,86 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+/**
+ * Hands the latest value from one writer thread to one reader thread without locks or waiting.
+ *
+ * The writer fills the back buffer and publish() swaps it with the middle one, the reader's read() swaps
+ * the front buffer with the middle one if something was published since. Neither side ever waits for the other,
+ * and values the reader didn't get to are simply overwritten, which is what a display wants.
+ */
+template<class T>
+class TripleBuffer
+{
+  public:
+    TripleBuffer():
+        mBack(0),
+        mMiddle(1),
+        mFront(2)
+    {
+    }
+
+    explicit TripleBuffer(const T &value):
+        TripleBuffer()
+    {
+        mBuffers[0] = mBuffers[1] = mBuffers[2] = value;
+    }
+
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    /**
+     * @brief back
+     * @return the buffer the writer fills before calling publish()
+     */
+    T &back()
+    {
+        return mBuffers[mBack];
+    }
+
+    /**
+     * @brief publish makes the back buffer the latest value, called by the writer
+     */
+    void publish()
+    {
+        mBack = mMiddle.exchange(mBack | Fresh, std::memory_order_acq_rel) & IndexMask;
+    }
+
+    /**
+     * @brief publish copies value into the back buffer and publishes it
+     */
+    void publish(const T &value)
+    {
+        back() = value;
+        publish();
+    }
+
+    /**
+     * @brief read called by the reader
+     * @param value set to the latest published value
+     * @return true if the value was published since the last read()
+     */
+    bool read(T *value)
+    {
+        const bool fresh = (mMiddle.load(std::memory_order_relaxed) & Fresh) != 0;
+        if (fresh)
+        {
+            mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & IndexMask;
+        }
+
+        *value = mBuffers[mFront];
+        return fresh;
+    }
+
+  private:
+    static const unsigned int IndexMask = 3;
+    static const unsigned int Fresh = 4;
+
+    T mBuffers[3];
+    unsigned int mBack;                 // writer only
+    std::atomic<unsigned int> mMiddle;  // index of the middle buffer, with Fresh if it hasn't been read yet
+    unsigned int mFront;                // reader only
+};
+
+#endif
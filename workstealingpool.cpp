@@ -0,0 +1,154 @@
+#include "workstealingpool.h"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount):
+    mGeneration(0),
+    mStopping(false),
+    mFunction(nullptr),
+    mGrain(1),
+    mRemaining(0),
+    mStealCount(0)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        mWorkers.emplace_back(new Worker);
+    }
+
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        mWorkers[i]->thread = std::thread(&WorkStealingPool::work, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mStart.notify_all();
+
+    for (const std::unique_ptr<Worker> &worker : mWorkers)
+    {
+        worker->thread.join();
+    }
+}
+
+void WorkStealingPool::run(size_t count, size_t grain, const Function &function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // A worker still spinning at the end of the last run() can pop a range as soon as it is in a deque,
+    // so the job has to be in place before the first range is
+    std::unique_lock<std::mutex> lock(mMutex);
+    mFunction = &function;
+    mGrain = grain > 0 ? grain : 1;
+    mRemaining = count;
+    mStealCount = 0;
+
+    const size_t workerCount = mWorkers.size();
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        const Range range = { count*i/workerCount, count*(i + 1)/workerCount };
+        if (range.end > range.begin)
+        {
+            std::lock_guard<std::mutex> workerLock(mWorkers[i]->mutex);
+            mWorkers[i]->ranges.push_back(range);
+        }
+    }
+
+    ++mGeneration;
+    mStart.notify_all();
+
+    mDone.wait(lock, [this]() { return mRemaining == 0; });
+    mFunction = nullptr;
+}
+
+void WorkStealingPool::work(unsigned index)
+{
+    unsigned generation = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStart.wait(lock, [&]() { return mStopping || mGeneration != generation; });
+            if (mStopping)
+            {
+                return;
+            }
+            generation = mGeneration;
+        }
+
+        Range range;
+        while (mRemaining > 0)
+        {
+            if (!pop(index, &range) && !steal(index, &range))
+            {
+                // the last ranges are being worked on by others
+                std::this_thread::yield();
+                continue;
+            }
+
+            // keep the upper halves for later, or for others to steal
+            while (range.end - range.begin > mGrain)
+            {
+                const Range upper = { range.begin + (range.end - range.begin)/2, range.end };
+                range.end = upper.begin;
+
+                std::lock_guard<std::mutex> lock(mWorkers[index]->mutex);
+                mWorkers[index]->ranges.push_back(upper);
+            }
+
+            (*mFunction)(range.begin, range.end, index);
+
+            if (mRemaining.fetch_sub(range.end - range.begin) == range.end - range.begin)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mDone.notify_all();
+            }
+        }
+    }
+}
+
+bool WorkStealingPool::pop(unsigned index, Range *range)
+{
+    Worker &worker = *mWorkers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.ranges.empty())
+    {
+        return false;
+    }
+
+    *range = worker.ranges.back();
+    worker.ranges.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(unsigned index, Range *range)
+{
+    const size_t workerCount = mWorkers.size();
+    for (size_t i = 1; i < workerCount; ++i)
+    {
+        Worker &victim = *mWorkers[(index + i) % workerCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.ranges.empty())
+        {
+            *range = victim.ranges.front();
+            victim.ranges.pop_front();
+            ++mStealCount;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,94 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that run index ranges of a job.
+ *
+ * run() hands every worker an equal share of the range. A worker splits the range it is working on in half
+ * until it is down to the grain size, keeping the halves it hasn't got to yet in its own deque,
+ * and works through its deque from the back, so that it stays on the indices it touched last.
+ * A worker whose deque is empty steals from the front of another worker's deque,
+ * which holds the largest and oldest range there, so that uneven work evens out with few steals.
+ */
+class WorkStealingPool
+{
+  public:
+    /**
+     * @brief Function called with [begin, end) and the index of the worker running it,
+     * which is below threadCount() and can be used to pick per worker scratch buffers
+     */
+    typedef std::function<void(size_t begin, size_t end, unsigned worker)> Function;
+
+    /**
+     * @param threadCount number of workers, 0 for one per hardware thread
+     */
+    explicit WorkStealingPool(unsigned threadCount = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    unsigned threadCount() const
+    {
+        return static_cast<unsigned>(mWorkers.size());
+    }
+
+    /**
+     * @brief run calls function on every index in [0, count), in ranges of at most grain indices,
+     * and returns when all of them are done. Only one run() can be in progress at a time.
+     */
+    void run(size_t count, size_t grain, const Function &function);
+
+    /**
+     * @brief stealCount
+     * @return the number of ranges taken from another worker during the last run()
+     */
+    size_t stealCount() const
+    {
+        return mStealCount;
+    }
+
+  private:
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+        std::thread thread;
+    };
+
+    void work(unsigned index);
+    bool pop(unsigned index, Range *range);
+    bool steal(unsigned index, Range *range);
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mDone;
+    unsigned mGeneration;
+    bool mStopping;
+
+    const Function *mFunction;
+    size_t mGrain;
+    std::atomic<size_t> mRemaining;
+    std::atomic<size_t> mStealCount;
+};
+
+#endif